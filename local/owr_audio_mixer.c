@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrAudioMixer
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_audio_mixer.h"
+
+#include "owr_media_source.h"
+#include "owr_media_source_private.h"
+#include "owr_message_origin.h"
+#include "owr_private.h"
+#include "owr_types.h"
+#include "owr_utils.h"
+
+#include <gst/gst.h>
+
+GST_DEBUG_CATEGORY_EXTERN(_owraudiomixer_debug);
+#define GST_CAT_DEFAULT _owraudiomixer_debug
+
+/* Every input is converted to this format once, in its own source pipeline,
+ * so that audiomixer can sum the samples without any further conversion */
+#define MIXER_FORMAT "S16LE"
+#define MIXER_RATE 48000
+#define MIXER_CHANNELS 1
+
+/* How long each mix waits for late inputs before mixing without them */
+#define MIXER_LATENCY (20 * GST_MSECOND)
+
+/* Each input is queued in front of every mix it goes into, and an input that
+ * gets further behind than this loses its oldest samples */
+#define MIXER_QUEUE_TIME (2 * MIXER_LATENCY)
+
+/* 10 ms of silence per buffer keeps every mix running with no inputs */
+#define SILENCE_SAMPLES_PER_BUFFER (MIXER_RATE / 100)
+
+#define OWR_AUDIO_MIXER_GET_PRIVATE(obj) \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), OWR_TYPE_AUDIO_MIXER, OwrAudioMixerPrivate))
+
+#define LINK_ELEMENTS(a, b) do { \
+    if (!gst_element_link(a, b)) \
+        GST_ERROR("Failed to link " #a " -> " #b); \
+} while (0)
+
+#define CREATE_ELEMENT(elem, factory, name) do { \
+    elem = gst_element_factory_make(factory, name); \
+    if (!elem) \
+        GST_ERROR("Could not create " name " from factory " factory); \
+    g_assert(elem); \
+} while (0)
+
+static guint unique_bin_id = 0;
+
+static void owr_message_origin_interface_init(OwrMessageOriginInterface *interface);
+
+G_DEFINE_TYPE_WITH_CODE(OwrAudioMixer, owr_audio_mixer, OWR_TYPE_MEDIA_SOURCE,
+    G_IMPLEMENT_INTERFACE(OWR_TYPE_MESSAGE_ORIGIN, owr_message_origin_interface_init))
+
+typedef struct {
+    /* NULL for the silence input */
+    OwrMediaSource *source;
+    GstElement *src;
+    GstElement *tee;
+    /* The tee pad feeding each output, by output */
+    GHashTable *tee_pads;
+} MixerInput;
+
+struct _OwrAudioMixerPrivate {
+    OwrMessageOriginBusSet *message_origin_bus_set;
+
+    /* Set on mix-minus outputs, which share the pipeline and the inputs of
+     * the mixer that created them */
+    OwrAudioMixer *main_mixer;
+    OwrMediaSource *excluded;
+
+    /* queue per input -> audiomixer -> capsfilter -> tee, in a bin of the
+     * shared pipeline */
+    GstElement *output_bin;
+    GstElement *audiomixer;
+
+    /* Only used on the main mixer, everything below is protected by lock */
+    GMutex lock;
+    GstElement *pipeline;
+    GSource *bus_source;
+    MixerInput *silence;
+    GList *inputs;
+    /* The main mixer itself followed by its mix-minus outputs */
+    GList *outputs;
+};
+
+static void unlink_input(MixerInput *input, OwrAudioMixer *output);
+static void mixer_input_free(MixerInput *input);
+
+static void owr_audio_mixer_finalize(GObject *object)
+{
+    OwrAudioMixer *mixer = OWR_AUDIO_MIXER(object);
+    OwrAudioMixerPrivate *priv = mixer->priv;
+    OwrAudioMixer *main_mixer = priv->main_mixer;
+    GList *item;
+
+    if (main_mixer) {
+        /* Take this mix-minus out of the shared pipeline, the main mixer
+         * is kept alive until then */
+        g_mutex_lock(&main_mixer->priv->lock);
+        main_mixer->priv->outputs = g_list_remove(main_mixer->priv->outputs, mixer);
+        unlink_input(main_mixer->priv->silence, mixer);
+        for (item = main_mixer->priv->inputs; item; item = item->next)
+            unlink_input(item->data, mixer);
+        gst_element_set_state(priv->output_bin, GST_STATE_NULL);
+        gst_bin_remove(GST_BIN(main_mixer->priv->pipeline), priv->output_bin);
+        g_mutex_unlock(&main_mixer->priv->lock);
+
+        if (priv->excluded)
+            g_object_unref(priv->excluded);
+        g_object_unref(main_mixer);
+    } else if (priv->pipeline) {
+        g_list_free_full(priv->inputs, (GDestroyNotify)mixer_input_free);
+        priv->inputs = NULL;
+        gst_element_set_state(priv->pipeline, GST_STATE_NULL);
+        mixer_input_free(priv->silence);
+        priv->silence = NULL;
+        g_list_free(priv->outputs);
+        priv->outputs = NULL;
+
+        g_source_destroy(priv->bus_source);
+        g_source_unref(priv->bus_source);
+        gst_object_unref(priv->pipeline);
+        priv->pipeline = NULL;
+    }
+
+    if (priv->output_bin)
+        gst_object_unref(priv->output_bin);
+    if (priv->audiomixer)
+        gst_object_unref(priv->audiomixer);
+
+    g_mutex_clear(&priv->lock);
+
+    owr_message_origin_bus_set_free(priv->message_origin_bus_set);
+    priv->message_origin_bus_set = NULL;
+
+    G_OBJECT_CLASS(owr_audio_mixer_parent_class)->finalize(object);
+}
+
+static void owr_audio_mixer_class_init(OwrAudioMixerClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+    g_type_class_add_private(klass, sizeof(OwrAudioMixerPrivate));
+
+    gobject_class->finalize = owr_audio_mixer_finalize;
+}
+
+static gpointer owr_audio_mixer_get_bus_set(OwrMessageOrigin *origin)
+{
+    return OWR_AUDIO_MIXER(origin)->priv->message_origin_bus_set;
+}
+
+static void owr_message_origin_interface_init(OwrMessageOriginInterface *interface)
+{
+    interface->get_bus_set = owr_audio_mixer_get_bus_set;
+}
+
+static void owr_audio_mixer_init(OwrAudioMixer *mixer)
+{
+    OwrAudioMixerPrivate *priv;
+
+    mixer->priv = priv = OWR_AUDIO_MIXER_GET_PRIVATE(mixer);
+
+    priv->message_origin_bus_set = owr_message_origin_bus_set_new();
+    priv->main_mixer = NULL;
+    priv->excluded = NULL;
+    priv->output_bin = NULL;
+    priv->audiomixer = NULL;
+    g_mutex_init(&priv->lock);
+    priv->pipeline = NULL;
+    priv->bus_source = NULL;
+    priv->silence = NULL;
+    priv->inputs = NULL;
+    priv->outputs = NULL;
+}
+
+static GstCaps *create_mixer_caps(void)
+{
+    return gst_caps_new_simple("audio/x-raw",
+        "format", G_TYPE_STRING, MIXER_FORMAT,
+        "layout", G_TYPE_STRING, "interleaved",
+        "rate", G_TYPE_INT, MIXER_RATE,
+        "channels", G_TYPE_INT, MIXER_CHANNELS,
+        NULL);
+}
+
+static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+    OwrAudioMixer *mixer = user_data;
+    GstElement *pipeline = mixer->priv->pipeline;
+    GError *error;
+    gchar *debug;
+    gboolean ret;
+
+    OWR_UNUSED(bus);
+
+    switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_LATENCY:
+        ret = gst_bin_recalculate_latency(GST_BIN(pipeline));
+        g_warn_if_fail(ret);
+        break;
+
+    case GST_MESSAGE_CLOCK_LOST:
+        gst_element_set_state(pipeline, GST_STATE_PAUSED);
+        gst_element_set_state(pipeline, GST_STATE_PLAYING);
+        break;
+
+    case GST_MESSAGE_WARNING:
+        gst_message_parse_warning(msg, &error, &debug);
+        GST_WARNING_OBJECT(mixer, "Warning in element %s: %s (%s)",
+            GST_OBJECT_NAME(msg->src), error->message, debug ? debug : "none");
+        g_error_free(error);
+        g_free(debug);
+        break;
+
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(msg, &error, &debug);
+        GST_ERROR_OBJECT(mixer, "Error in element %s: %s (%s)",
+            GST_OBJECT_NAME(msg->src), error->message, debug ? debug : "none");
+        g_error_free(error);
+        g_free(debug);
+        OWR_POST_ERROR(mixer, PROCESSING_ERROR, NULL);
+        break;
+
+    default:
+        break;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* call with the main mixer lock */
+static void link_input(MixerInput *input, OwrAudioMixer *output)
+{
+    OwrAudioMixerPrivate *priv = output->priv;
+    GstPad *srcpad, *mixpad, *ghostpad, *queuepad;
+    GstElement *queue;
+
+    if (input->source && input->source == priv->excluded)
+        return;
+
+    /* The tee must not push into the aggregator itself, or the input's
+     * thread would block whenever one of its mixes waits for other inputs
+     * and hold up all the other mixes with it */
+    queue = gst_element_factory_make("queue", NULL);
+    g_assert(queue);
+    g_object_set(queue, "max-size-buffers", 0, "max-size-bytes", 0,
+        "max-size-time", MIXER_QUEUE_TIME, "leaky", 2, NULL);
+    gst_bin_add(GST_BIN(priv->output_bin), queue);
+
+    mixpad = gst_element_get_request_pad(priv->audiomixer, "sink_%u");
+    g_assert(mixpad);
+    queuepad = gst_element_get_static_pad(queue, "src");
+    if (gst_pad_link(queuepad, mixpad) != GST_PAD_LINK_OK)
+        GST_ERROR_OBJECT(output, "Failed to link %s to %s", GST_OBJECT_NAME(queue),
+            GST_OBJECT_NAME(priv->audiomixer));
+    gst_object_unref(queuepad);
+
+    /* The queue sits inside the output bin, so it is exposed through a
+     * ghost pad that goes away together with the link */
+    queuepad = gst_element_get_static_pad(queue, "sink");
+    ghostpad = gst_ghost_pad_new(GST_OBJECT_NAME(mixpad), queuepad);
+    gst_object_unref(queuepad);
+    gst_object_unref(mixpad);
+    gst_pad_set_active(ghostpad, TRUE);
+    gst_element_add_pad(priv->output_bin, ghostpad);
+    gst_element_sync_state_with_parent(queue);
+
+    srcpad = gst_element_get_request_pad(input->tee, "src_%u");
+    g_assert(srcpad);
+    if (gst_pad_link(srcpad, ghostpad) != GST_PAD_LINK_OK)
+        GST_ERROR_OBJECT(output, "Failed to link %s to %s", GST_OBJECT_NAME(input->tee),
+            GST_OBJECT_NAME(priv->output_bin));
+    g_hash_table_insert(input->tee_pads, output, srcpad);
+}
+
+/* call with the main mixer lock */
+static void unlink_input(MixerInput *input, OwrAudioMixer *output)
+{
+    OwrAudioMixerPrivate *priv = output->priv;
+    GstPad *srcpad, *mixpad, *ghostpad, *queuepad;
+    GstElement *queue;
+
+    srcpad = g_hash_table_lookup(input->tee_pads, output);
+    if (!srcpad)
+        return;
+
+    ghostpad = gst_pad_get_peer(srcpad);
+    if (ghostpad) {
+        gst_pad_unlink(srcpad, ghostpad);
+        queuepad = gst_ghost_pad_get_target(GST_GHOST_PAD(ghostpad));
+        gst_element_remove_pad(priv->output_bin, ghostpad);
+        gst_object_unref(ghostpad);
+        if (queuepad) {
+            queue = gst_pad_get_parent_element(queuepad);
+            gst_object_unref(queuepad);
+
+            /* Stop the queue's thread before its mixer pad goes away */
+            queuepad = gst_element_get_static_pad(queue, "src");
+            mixpad = gst_pad_get_peer(queuepad);
+            gst_object_unref(queuepad);
+            gst_element_set_state(queue, GST_STATE_NULL);
+            if (mixpad) {
+                gst_element_release_request_pad(priv->audiomixer, mixpad);
+                gst_object_unref(mixpad);
+            }
+            gst_bin_remove(GST_BIN(priv->output_bin), queue);
+            gst_object_unref(queue);
+        }
+    }
+
+    gst_element_release_request_pad(input->tee, srcpad);
+    g_hash_table_remove(input->tee_pads, output);
+}
+
+/* call with the main mixer lock */
+static MixerInput *mixer_input_new(OwrAudioMixer *mixer, OwrMediaSource *source, GstElement *src)
+{
+    OwrAudioMixerPrivate *priv = mixer->priv;
+    MixerInput *input;
+    gchar *tee_name;
+    GList *item;
+
+    input = g_slice_new0(MixerInput);
+    input->source = source ? g_object_ref(source) : NULL;
+    input->src = gst_object_ref(src);
+    input->tee_pads = g_hash_table_new_full(NULL, NULL, NULL, gst_object_unref);
+
+    tee_name = g_strdup_printf("%s-tee", GST_OBJECT_NAME(src));
+    input->tee = gst_element_factory_make("tee", tee_name);
+    g_free(tee_name);
+    g_assert(input->tee);
+    g_object_set(input->tee, "allow-not-linked", TRUE, NULL);
+    gst_object_ref(input->tee);
+
+    gst_bin_add_many(GST_BIN(priv->pipeline), src, input->tee, NULL);
+    LINK_ELEMENTS(src, input->tee);
+
+    for (item = priv->outputs; item; item = item->next)
+        link_input(input, item->data);
+
+    gst_element_sync_state_with_parent(input->tee);
+    gst_element_sync_state_with_parent(src);
+
+    return input;
+}
+
+static void mixer_input_free(MixerInput *input)
+{
+    GstElement *pipeline;
+    GList *outputs, *item;
+
+    if (input->source)
+        _owr_media_source_release_source(input->source, input->src);
+    gst_element_set_state(input->src, GST_STATE_NULL);
+
+    outputs = g_hash_table_get_keys(input->tee_pads);
+    for (item = outputs; item; item = item->next)
+        unlink_input(input, item->data);
+    g_list_free(outputs);
+    gst_element_set_state(input->tee, GST_STATE_NULL);
+
+    pipeline = GST_ELEMENT(gst_object_get_parent(GST_OBJECT(input->src)));
+    if (pipeline) {
+        gst_bin_remove_many(GST_BIN(pipeline), input->src, input->tee, NULL);
+        gst_object_unref(pipeline);
+    }
+
+    g_hash_table_destroy(input->tee_pads);
+    gst_object_unref(input->tee);
+    gst_object_unref(input->src);
+    if (input->source)
+        g_object_unref(input->source);
+    g_slice_free(MixerInput, input);
+}
+
+static MixerInput *find_input(OwrAudioMixer *mixer, OwrMediaSource *source)
+{
+    GList *item;
+
+    for (item = mixer->priv->inputs; item; item = item->next) {
+        if (((MixerInput *)item->data)->source == source)
+            return item->data;
+    }
+
+    return NULL;
+}
+
+static GstElement *create_silence_source(void)
+{
+    GstElement *bin, *src, *capsfilter;
+    GstCaps *caps;
+    GstPad *srcpad;
+
+    bin = gst_bin_new("audio-mixer-silence");
+
+    CREATE_ELEMENT(src, "audiotestsrc", "audio-mixer-silence-source");
+    gst_util_set_object_arg(G_OBJECT(src), "wave", "silence");
+    g_object_set(src, "is-live", TRUE,
+        "samplesperbuffer", SILENCE_SAMPLES_PER_BUFFER, NULL);
+
+    CREATE_ELEMENT(capsfilter, "capsfilter", "audio-mixer-silence-capsfilter");
+    caps = create_mixer_caps();
+    g_object_set(capsfilter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    gst_bin_add_many(GST_BIN(bin), src, capsfilter, NULL);
+    LINK_ELEMENTS(src, capsfilter);
+
+    srcpad = gst_element_get_static_pad(capsfilter, "src");
+    gst_element_add_pad(bin, gst_ghost_pad_new("src", srcpad));
+    gst_object_unref(srcpad);
+
+    return bin;
+}
+
+/* call with the main mixer lock */
+static void add_output(OwrAudioMixer *main_mixer, OwrAudioMixer *output)
+{
+    OwrAudioMixerPrivate *priv = output->priv;
+    GstElement *capsfilter, *tee;
+    GstCaps *caps;
+    gchar *bin_name;
+    GList *item;
+
+    bin_name = g_strdup_printf("audio-mixer-output-%u", g_atomic_int_add(&unique_bin_id, 1));
+    priv->output_bin = gst_bin_new(bin_name);
+    g_free(bin_name);
+    gst_object_ref(priv->output_bin);
+
+    /* audiomixer waits for every input up to its latency on the shared clock
+     * and sums them with ORC-generated SIMD code */
+    CREATE_ELEMENT(priv->audiomixer, "audiomixer", "audio-mixer");
+    gst_object_ref(priv->audiomixer);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(priv->audiomixer), "latency"))
+        g_object_set(priv->audiomixer, "latency", (guint64)MIXER_LATENCY, NULL);
+
+    CREATE_ELEMENT(capsfilter, "capsfilter", "audio-mixer-capsfilter");
+    caps = create_mixer_caps();
+    g_object_set(capsfilter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    CREATE_ELEMENT(tee, "tee", "audio-mixer-tee");
+    g_object_set(tee, "allow-not-linked", TRUE, NULL);
+
+    gst_bin_add_many(GST_BIN(priv->output_bin), priv->audiomixer, capsfilter, tee, NULL);
+    LINK_ELEMENTS(priv->audiomixer, capsfilter);
+    LINK_ELEMENTS(capsfilter, tee);
+    gst_bin_add(GST_BIN(main_mixer->priv->pipeline), priv->output_bin);
+
+    main_mixer->priv->outputs = g_list_append(main_mixer->priv->outputs, output);
+
+    if (main_mixer->priv->silence)
+        link_input(main_mixer->priv->silence, output);
+    for (item = main_mixer->priv->inputs; item; item = item->next)
+        link_input(item->data, output);
+
+    gst_element_sync_state_with_parent(priv->output_bin);
+
+    g_mutex_lock(&OWR_MEDIA_SOURCE(output)->lock);
+    _owr_media_source_set_source_bin(OWR_MEDIA_SOURCE(output), priv->output_bin);
+    _owr_media_source_set_source_tee(OWR_MEDIA_SOURCE(output), tee);
+    g_mutex_unlock(&OWR_MEDIA_SOURCE(output)->lock);
+}
+
+/**
+ * owr_audio_mixer_new: (constructor)
+ *
+ * Creates an audio source that mixes all the audio sources added to it. The
+ * mix can be rendered with an #OwrAudioRenderer or sent in an
+ * #OwrMediaSession like any other source.
+ *
+ * Returns: The new #OwrAudioMixer
+ */
+OwrAudioMixer *owr_audio_mixer_new(void)
+{
+    OwrAudioMixer *mixer;
+    OwrAudioMixerPrivate *priv;
+    GstBus *bus;
+    gchar *bin_name;
+
+    mixer = g_object_new(OWR_TYPE_AUDIO_MIXER,
+        "name", "audio-mixer",
+        "media-type", OWR_MEDIA_TYPE_AUDIO,
+        NULL);
+    priv = mixer->priv;
+
+    /* All owr pipelines share the clock and base time, so timestamps of the
+     * inputs can be mixed without any adjustment */
+    bin_name = g_strdup_printf("audio-mixer-%u", g_atomic_int_add(&unique_bin_id, 1));
+    priv->pipeline = gst_pipeline_new(bin_name);
+    g_free(bin_name);
+    gst_pipeline_use_clock(GST_PIPELINE(priv->pipeline), gst_system_clock_obtain());
+    gst_element_set_base_time(priv->pipeline, _owr_get_base_time());
+    gst_element_set_start_time(priv->pipeline, GST_CLOCK_TIME_NONE);
+
+#ifdef OWR_DEBUG
+    g_signal_connect(priv->pipeline, "deep-notify", G_CALLBACK(_owr_deep_notify), NULL);
+#endif
+
+    bus = gst_pipeline_get_bus(GST_PIPELINE(priv->pipeline));
+    priv->bus_source = gst_bus_create_watch(bus);
+    g_source_set_callback(priv->bus_source, (GSourceFunc) bus_call, mixer, NULL);
+    g_source_attach(priv->bus_source, _owr_get_main_context());
+    gst_object_unref(bus);
+
+    g_mutex_lock(&priv->lock);
+    add_output(mixer, mixer);
+    priv->silence = mixer_input_new(mixer, NULL, create_silence_source());
+    g_mutex_unlock(&priv->lock);
+
+    if (gst_element_set_state(priv->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+        GST_ERROR_OBJECT(mixer, "Failed to set %s to playing", GST_OBJECT_NAME(priv->pipeline));
+
+    return mixer;
+}
+
+static gboolean add_source(GHashTable *args)
+{
+    OwrAudioMixer *mixer;
+    OwrMediaSource *source;
+    OwrAudioMixerPrivate *priv;
+    GstElement *src;
+    GstCaps *caps;
+
+    mixer = g_hash_table_lookup(args, "mixer");
+    source = g_hash_table_lookup(args, "source");
+    priv = mixer->priv;
+
+    g_mutex_lock(&priv->lock);
+
+    if (find_input(mixer, source)) {
+        GST_DEBUG_OBJECT(mixer, "Source %p is already mixed", source);
+        goto end;
+    }
+
+    caps = create_mixer_caps();
+    src = _owr_media_source_request_source(source, caps);
+    gst_caps_unref(caps);
+    if (!src) {
+        GST_ERROR_OBJECT(mixer, "Failed to get audio from source %p", source);
+        goto end;
+    }
+
+    priv->inputs = g_list_append(priv->inputs, mixer_input_new(mixer, source, src));
+    GST_DEBUG_OBJECT(mixer, "Mixing %u sources", g_list_length(priv->inputs));
+
+end:
+    g_mutex_unlock(&priv->lock);
+    g_object_unref(mixer);
+    g_object_unref(source);
+    g_hash_table_unref(args);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * owr_audio_mixer_add_source:
+ * @mixer:
+ * @source: (transfer none): an audio source, typically an #OwrRemoteMediaSource
+ *
+ * Adds @source to the mix and to all mix-minus outputs that don't exclude it.
+ */
+void owr_audio_mixer_add_source(OwrAudioMixer *mixer, OwrMediaSource *source)
+{
+    GHashTable *args;
+    OwrMediaType media_type;
+
+    g_return_if_fail(OWR_IS_AUDIO_MIXER(mixer));
+    g_return_if_fail(!mixer->priv->main_mixer);
+    g_return_if_fail(OWR_IS_MEDIA_SOURCE(source));
+    g_return_if_fail(source != OWR_MEDIA_SOURCE(mixer));
+
+    g_object_get(source, "media-type", &media_type, NULL);
+    g_return_if_fail(media_type == OWR_MEDIA_TYPE_AUDIO);
+
+    args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(mixer));
+    g_hash_table_insert(args, "mixer", g_object_ref(mixer));
+    g_hash_table_insert(args, "source", g_object_ref(source));
+
+    _owr_schedule_with_hash_table((GSourceFunc)add_source, args);
+}
+
+static gboolean remove_source(GHashTable *args)
+{
+    OwrAudioMixer *mixer;
+    OwrMediaSource *source;
+    OwrAudioMixerPrivate *priv;
+    MixerInput *input;
+
+    mixer = g_hash_table_lookup(args, "mixer");
+    source = g_hash_table_lookup(args, "source");
+    priv = mixer->priv;
+
+    g_mutex_lock(&priv->lock);
+
+    input = find_input(mixer, source);
+    if (input) {
+        priv->inputs = g_list_remove(priv->inputs, input);
+        mixer_input_free(input);
+        GST_DEBUG_OBJECT(mixer, "Mixing %u sources", g_list_length(priv->inputs));
+    }
+
+    g_mutex_unlock(&priv->lock);
+    g_object_unref(mixer);
+    g_object_unref(source);
+    g_hash_table_unref(args);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * owr_audio_mixer_remove_source:
+ * @mixer:
+ * @source: (transfer none):
+ *
+ * Removes @source from the mix and from all mix-minus outputs.
+ */
+void owr_audio_mixer_remove_source(OwrAudioMixer *mixer, OwrMediaSource *source)
+{
+    GHashTable *args;
+
+    g_return_if_fail(OWR_IS_AUDIO_MIXER(mixer));
+    g_return_if_fail(!mixer->priv->main_mixer);
+    g_return_if_fail(OWR_IS_MEDIA_SOURCE(source));
+
+    args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(mixer));
+    g_hash_table_insert(args, "mixer", g_object_ref(mixer));
+    g_hash_table_insert(args, "source", g_object_ref(source));
+
+    _owr_schedule_with_hash_table((GSourceFunc)remove_source, args);
+}
+
+/**
+ * owr_audio_mixer_new_mix_minus: (constructor)
+ * @mixer: the main mixer
+ * @excluded: (transfer none): the source left out of this mix
+ *
+ * Creates a further output of @mixer that mixes all of its sources except
+ * @excluded, typically the participant that the mix is sent back to. The
+ * output runs in the pipeline of @mixer and shares its inputs, so an N-1 mix
+ * per participant costs an audiomixer element rather than a pipeline.
+ *
+ * Returns: The new mix-minus output
+ */
+OwrAudioMixer *owr_audio_mixer_new_mix_minus(OwrAudioMixer *mixer, OwrMediaSource *excluded)
+{
+    OwrAudioMixer *output;
+    gchar *name, *excluded_name;
+
+    g_return_val_if_fail(OWR_IS_AUDIO_MIXER(mixer), NULL);
+    g_return_val_if_fail(!mixer->priv->main_mixer, NULL);
+    g_return_val_if_fail(OWR_IS_MEDIA_SOURCE(excluded), NULL);
+
+    g_object_get(excluded, "name", &excluded_name, NULL);
+    name = g_strdup_printf("audio-mixer minus %s", excluded_name ? excluded_name : "unnamed");
+    g_free(excluded_name);
+
+    output = g_object_new(OWR_TYPE_AUDIO_MIXER,
+        "name", name,
+        "media-type", OWR_MEDIA_TYPE_AUDIO,
+        NULL);
+    g_free(name);
+
+    output->priv->main_mixer = g_object_ref(mixer);
+    output->priv->excluded = g_object_ref(excluded);
+
+    g_mutex_lock(&mixer->priv->lock);
+    add_output(mixer, output);
+    g_mutex_unlock(&mixer->priv->lock);
+
+    return output;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrAudioMixer
+/*/
+
+#ifndef __OWR_AUDIO_MIXER_H__
+#define __OWR_AUDIO_MIXER_H__
+
+#include "owr_media_source.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define OWR_TYPE_AUDIO_MIXER            (owr_audio_mixer_get_type())
+#define OWR_AUDIO_MIXER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), OWR_TYPE_AUDIO_MIXER, OwrAudioMixer))
+#define OWR_AUDIO_MIXER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), OWR_TYPE_AUDIO_MIXER, OwrAudioMixerClass))
+#define OWR_IS_AUDIO_MIXER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), OWR_TYPE_AUDIO_MIXER))
+#define OWR_IS_AUDIO_MIXER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), OWR_TYPE_AUDIO_MIXER))
+#define OWR_AUDIO_MIXER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), OWR_TYPE_AUDIO_MIXER, OwrAudioMixerClass))
+
+typedef struct _OwrAudioMixer        OwrAudioMixer;
+typedef struct _OwrAudioMixerClass   OwrAudioMixerClass;
+typedef struct _OwrAudioMixerPrivate OwrAudioMixerPrivate;
+
+struct _OwrAudioMixer {
+    OwrMediaSource parent_instance;
+
+    /*< private >*/
+    OwrAudioMixerPrivate *priv;
+};
+
+struct _OwrAudioMixerClass {
+    OwrMediaSourceClass parent_class;
+};
+
+GType owr_audio_mixer_get_type(void) G_GNUC_CONST;
+
+OwrAudioMixer *owr_audio_mixer_new(void);
+void owr_audio_mixer_add_source(OwrAudioMixer *mixer, OwrMediaSource *source);
+void owr_audio_mixer_remove_source(OwrAudioMixer *mixer, OwrMediaSource *source);
+OwrAudioMixer *owr_audio_mixer_new_mix_minus(OwrAudioMixer *mixer, OwrMediaSource *excluded);
+
+G_END_DECLS
+
+#endif /* __OWR_AUDIO_MIXER_H__ */
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrFrameRenderer
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_frame_renderer.h"
+
+#include "owr_media_renderer_private.h"
+#include "owr_private.h"
+#include "owr_utils.h"
+
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN(_owrframerenderer_debug);
+#define GST_CAT_DEFAULT _owrframerenderer_debug
+
+#define DEFAULT_FORMAT OWR_FRAME_FORMAT_I420
+#define DEFAULT_WIDTH 0
+#define DEFAULT_HEIGHT 0
+#define DEFAULT_MAX_FRAMERATE 0.0
+#define DEFAULT_MAX_QUEUE_DEPTH 2
+
+#define OWR_FRAME_RENDERER_GET_PRIVATE(obj)    (G_TYPE_INSTANCE_GET_PRIVATE((obj), OWR_TYPE_FRAME_RENDERER, OwrFrameRendererPrivate))
+
+G_DEFINE_TYPE(OwrFrameRenderer, owr_frame_renderer, OWR_TYPE_MEDIA_RENDERER)
+
+static guint unique_bin_id = 0;
+
+enum {
+    PROP_0,
+    PROP_FORMAT,
+    PROP_WIDTH,
+    PROP_HEIGHT,
+    PROP_MAX_FRAMERATE,
+    PROP_MAX_QUEUE_DEPTH,
+    N_PROPERTIES
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = {NULL, };
+
+static void owr_frame_renderer_set_property(GObject *object, guint property_id,
+    const GValue *value, GParamSpec *pspec);
+static void owr_frame_renderer_get_property(GObject *object, guint property_id,
+    GValue *value, GParamSpec *pspec);
+static void owr_frame_renderer_constructed(GObject *object);
+static void owr_frame_renderer_finalize(GObject *object);
+
+static GstCaps *owr_frame_renderer_get_caps(OwrMediaRenderer *renderer);
+
+struct _OwrFrameRendererPrivate {
+    OwrFrameFormat format;
+    guint width;
+    guint height;
+    gdouble max_framerate;
+    guint max_queue_depth;
+
+    GMutex closure_mutex;
+    GClosure *frame_closure;
+};
+
+static void owr_frame_renderer_class_init(OwrFrameRendererClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    OwrMediaRendererClass *media_renderer_class = OWR_MEDIA_RENDERER_CLASS(klass);
+
+    g_type_class_add_private(klass, sizeof(OwrFrameRendererPrivate));
+
+    obj_properties[PROP_FORMAT] = g_param_spec_enum("format", "format",
+        "Raw format of the delivered frames", OWR_TYPE_FRAME_FORMAT, DEFAULT_FORMAT,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_WIDTH] = g_param_spec_uint("width", "width",
+        "Video width in pixels (0 for the source width, applied when a source is set)",
+        0, G_MAXUINT, DEFAULT_WIDTH,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_HEIGHT] = g_param_spec_uint("height", "height",
+        "Video height in pixels (0 for the source height, applied when a source is set)",
+        0, G_MAXUINT, DEFAULT_HEIGHT,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_MAX_FRAMERATE] = g_param_spec_double("max-framerate", "max-framerate",
+        "Maximum video frames per second (0 for the source framerate, applied when a source"
+        " is set)", 0.0, G_MAXDOUBLE, DEFAULT_MAX_FRAMERATE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_MAX_QUEUE_DEPTH] = g_param_spec_uint("max-queue-depth", "max-queue-depth",
+        "Maximum number of frames waiting for the callback, older frames are dropped"
+        " when the callback falls behind", 1, G_MAXUINT, DEFAULT_MAX_QUEUE_DEPTH,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+    gobject_class->set_property = owr_frame_renderer_set_property;
+    gobject_class->get_property = owr_frame_renderer_get_property;
+    gobject_class->constructed = owr_frame_renderer_constructed;
+    gobject_class->finalize = owr_frame_renderer_finalize;
+
+    media_renderer_class->get_caps = (void *(*)(OwrMediaRenderer *))owr_frame_renderer_get_caps;
+
+    g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
+}
+
+static void owr_frame_renderer_init(OwrFrameRenderer *renderer)
+{
+    OwrFrameRendererPrivate *priv;
+    renderer->priv = priv = OWR_FRAME_RENDERER_GET_PRIVATE(renderer);
+
+    priv->format = DEFAULT_FORMAT;
+    priv->width = DEFAULT_WIDTH;
+    priv->height = DEFAULT_HEIGHT;
+    priv->max_framerate = DEFAULT_MAX_FRAMERATE;
+    priv->max_queue_depth = DEFAULT_MAX_QUEUE_DEPTH;
+
+    g_mutex_init(&priv->closure_mutex);
+    priv->frame_closure = NULL;
+}
+
+static void owr_frame_renderer_finalize(GObject *object)
+{
+    OwrFrameRendererPrivate *priv = OWR_FRAME_RENDERER(object)->priv;
+
+    if (priv->frame_closure)
+        g_closure_unref(priv->frame_closure);
+    g_mutex_clear(&priv->closure_mutex);
+
+    G_OBJECT_CLASS(owr_frame_renderer_parent_class)->finalize(object);
+}
+
+static void owr_frame_renderer_set_property(GObject *object, guint property_id,
+    const GValue *value, GParamSpec *pspec)
+{
+    OwrFrameRendererPrivate *priv;
+
+    g_return_if_fail(object);
+    priv = OWR_FRAME_RENDERER_GET_PRIVATE(object);
+
+    switch (property_id) {
+    case PROP_FORMAT:
+        priv->format = g_value_get_enum(value);
+        break;
+    case PROP_WIDTH:
+        priv->width = g_value_get_uint(value);
+        break;
+    case PROP_HEIGHT:
+        priv->height = g_value_get_uint(value);
+        break;
+    case PROP_MAX_FRAMERATE:
+        priv->max_framerate = g_value_get_double(value);
+        break;
+    case PROP_MAX_QUEUE_DEPTH:
+        priv->max_queue_depth = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void owr_frame_renderer_get_property(GObject *object, guint property_id,
+    GValue *value, GParamSpec *pspec)
+{
+    OwrFrameRendererPrivate *priv;
+
+    g_return_if_fail(object);
+    priv = OWR_FRAME_RENDERER_GET_PRIVATE(object);
+
+    switch (property_id) {
+    case PROP_FORMAT:
+        g_value_set_enum(value, priv->format);
+        break;
+    case PROP_WIDTH:
+        g_value_set_uint(value, priv->width);
+        break;
+    case PROP_HEIGHT:
+        g_value_set_uint(value, priv->height);
+        break;
+    case PROP_MAX_FRAMERATE:
+        g_value_set_double(value, priv->max_framerate);
+        break;
+    case PROP_MAX_QUEUE_DEPTH:
+        g_value_set_uint(value, priv->max_queue_depth);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+
+/**
+ * owr_frame_renderer_new: (constructor)
+ * @format: the raw format frames are delivered in
+ *
+ * Returns: The new #OwrFrameRenderer
+ */
+OwrFrameRenderer *owr_frame_renderer_new(OwrFrameFormat format)
+{
+    return g_object_new(OWR_TYPE_FRAME_RENDERER,
+        "media-type", OWR_MEDIA_TYPE_VIDEO,
+        "format", format,
+        NULL);
+}
+
+
+#define LINK_ELEMENTS(a, b) \
+    if (!gst_element_link(a, b)) \
+        GST_ERROR("Failed to link " #a " -> " #b); \
+
+static GstFlowReturn on_new_sample(GstAppSink *appsink, OwrFrameRenderer *renderer)
+{
+    OwrFrameRendererPrivate *priv = renderer->priv;
+    GstSample *sample;
+    gboolean disabled = FALSE;
+    GValue params[1] = { G_VALUE_INIT };
+
+    sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    g_object_get(renderer, "disabled", &disabled, NULL);
+
+    g_mutex_lock(&priv->closure_mutex);
+    if (priv->frame_closure && !disabled) {
+        g_value_init(&params[0], G_TYPE_POINTER);
+        g_value_set_pointer(&params[0], sample);
+        g_closure_invoke(priv->frame_closure, NULL, 1, (const GValue *)&params, NULL);
+        g_value_unset(&params[0]);
+    }
+    g_mutex_unlock(&priv->closure_mutex);
+
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+/* appsink doesn't answer allocation queries, advertise video meta so that
+ * decoders and converters can hand over padded frames without copying them */
+static GstPadProbeReturn add_video_meta(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+
+    OWR_UNUSED(pad);
+    OWR_UNUSED(user_data);
+
+    if (GST_QUERY_TYPE(query) == GST_QUERY_ALLOCATION
+        && !gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL))
+        gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstElement *owr_frame_renderer_get_element(OwrMediaRenderer *renderer)
+{
+    OwrFrameRendererPrivate *priv = OWR_FRAME_RENDERER(renderer)->priv;
+    GstElement *renderer_bin;
+    GstElement *queue, *convert_in, *flip, *convert_out, *sink;
+    GstPad *ghostpad, *sinkpad;
+    GstAppSinkCallbacks callbacks;
+    gchar *bin_name;
+
+    bin_name = g_strdup_printf("frame-renderer-bin-%u", g_atomic_int_add(&unique_bin_id, 1));
+    renderer_bin = gst_bin_new(bin_name);
+    g_free(bin_name);
+
+    /* Frames are delivered from the queue's thread, so a slow callback only
+     * drops frames here and never holds back the source */
+    queue = gst_element_factory_make("queue", "frame-renderer-queue");
+    g_assert(queue);
+    g_object_set(queue, "max-size-buffers", priv->max_queue_depth, "max-size-bytes", 0,
+        "max-size-time", G_GUINT64_CONSTANT(0), "leaky", 2, NULL);
+
+    sink = gst_element_factory_make("appsink", "frame-renderer-appsink");
+    g_assert(sink);
+    g_object_set(sink, "sync", FALSE, "max-buffers", 1, "enable-last-sample", FALSE, NULL);
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.new_sample = (GstFlowReturn (*)(GstAppSink *, gpointer))on_new_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, renderer, NULL);
+
+    sinkpad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, add_video_meta, NULL, NULL);
+    gst_object_unref(sinkpad);
+
+    gst_bin_add_many(GST_BIN(renderer_bin), queue, sink, NULL);
+
+    /* Received streams may signal their orientation instead of being rotated
+     * by the sender. videoflip has no NV12, hence the conversions around it,
+     * which are passthrough for the other formats. */
+    flip = _owr_video_orientation_flip_new("frame-renderer-flip");
+    if (flip) {
+        convert_in = gst_element_factory_make("videoconvert", "frame-renderer-flip-convert-in");
+        convert_out = gst_element_factory_make("videoconvert", "frame-renderer-flip-convert-out");
+        g_assert(convert_in && convert_out);
+        gst_bin_add_many(GST_BIN(renderer_bin), convert_in, flip, convert_out, NULL);
+        LINK_ELEMENTS(queue, convert_in);
+        LINK_ELEMENTS(convert_in, flip);
+        LINK_ELEMENTS(flip, convert_out);
+        LINK_ELEMENTS(convert_out, sink);
+    } else {
+        g_warning("The videoflip GStreamer element isn't available. Signalled video orientation is thus ignored.");
+        LINK_ELEMENTS(queue, sink);
+    }
+
+    sinkpad = gst_element_get_static_pad(queue, "sink");
+    g_assert(sinkpad);
+    ghostpad = gst_ghost_pad_new("sink", sinkpad);
+    gst_pad_set_active(ghostpad, TRUE);
+    gst_element_add_pad(renderer_bin, ghostpad);
+    gst_object_unref(sinkpad);
+
+    return renderer_bin;
+}
+
+static void owr_frame_renderer_constructed(GObject *object)
+{
+    OwrMediaRenderer *renderer = OWR_MEDIA_RENDERER(object);
+
+    _owr_media_renderer_set_sink(renderer, owr_frame_renderer_get_element(renderer));
+
+    G_OBJECT_CLASS(owr_frame_renderer_parent_class)->constructed(object);
+}
+
+static GstCaps *owr_frame_renderer_get_caps(OwrMediaRenderer *renderer)
+{
+    OwrFrameRendererPrivate *priv = OWR_FRAME_RENDERER(renderer)->priv;
+    GstCaps *caps;
+    gint fps_n = 0, fps_d = 1;
+    static const gchar *formats[] = { "I420", "NV12", "BGRA" };
+
+    caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, formats[priv->format], NULL);
+    if (priv->width > 0)
+        gst_caps_set_simple(caps, "width", G_TYPE_INT, priv->width, NULL);
+    if (priv->height > 0)
+        gst_caps_set_simple(caps, "height", G_TYPE_INT, priv->height, NULL);
+    if (priv->max_framerate > 0.0) {
+        gst_util_double_to_fraction(priv->max_framerate, &fps_n, &fps_d);
+        GST_DEBUG_OBJECT(renderer, "Setting the framerate to %d/%d", fps_n, fps_d);
+        gst_caps_set_simple(caps, "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
+    }
+
+    return caps;
+}
+
+/**
+ * OwrFrameRendererFrameCallback:
+ * @sample: (transfer none): the frame, with its caps. Take a reference to
+ * keep it beyond the callback, the buffer goes back to its pool when released.
+ * Use gst_video_frame_map() to get at the planes, rows may be padded.
+ * @user_data: (allow-none): the data passed to owr_frame_renderer_set_frame_callback
+ *
+ * Prototype for the callback passed to owr_frame_renderer_set_frame_callback()
+ */
+
+/**
+ * owr_frame_renderer_set_frame_callback: Configure the GClosure to invoke for
+ * every decoded frame. It is called from a streaming thread.
+ *
+ * @renderer:
+ * @callback: function receiving the frames. The parameters passed are an OwrGstSample* and the @user_data gpointer.
+ * @user_data: extra data passed as last argument of the @callback.
+ * @destroy_data: function invoked when disposing the user_data of the GClosure.
+ */
+void owr_frame_renderer_set_frame_callback(OwrFrameRenderer *renderer, OwrFrameRendererFrameCallback callback, gpointer user_data, GDestroyNotify destroy_data)
+{
+    g_return_if_fail(OWR_IS_FRAME_RENDERER(renderer));
+
+    g_mutex_lock(&renderer->priv->closure_mutex);
+    if (renderer->priv->frame_closure)
+        g_closure_unref(renderer->priv->frame_closure);
+
+    renderer->priv->frame_closure = callback ? g_cclosure_new(G_CALLBACK(callback), user_data, (GClosureNotify) destroy_data) : NULL;
+    if (renderer->priv->frame_closure)
+        g_closure_set_marshal(renderer->priv->frame_closure, g_cclosure_marshal_generic);
+    g_mutex_unlock(&renderer->priv->closure_mutex);
+}
@@ -37,8 +37,10 @@
 #include "owr_image_renderer_private.h"
 #include "owr_media_renderer_private.h"
 #include "owr_private.h"
+#include "owr_utils.h"
 
 #include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
 
 #include <string.h>
 
@@ -79,18 +81,56 @@ static void owr_image_renderer_set_property(GObject *object, guint property_id,
 static void owr_image_renderer_get_property(GObject *object, guint property_id,
     GValue *value, GParamSpec *pspec);
 static void owr_image_renderer_constructed(GObject *object);
+static void owr_image_renderer_finalize(GObject *object);
 
 static GstElement *owr_image_renderer_get_element(OwrMediaRenderer *renderer);
 static GstCaps *owr_image_renderer_get_caps(OwrMediaRenderer *renderer);
+static GstFlowReturn on_raw_sample(GstAppSink *appsink, OwrImageRenderer *image_renderer);
+
+static const gchar *encoder_factories[OWR_IMAGE_ENCODING_N] = {
+    "jpegenc",
+    "webpenc",
+};
+
+/* An encoder branch is only created once somebody streams the format, and
+ * every new frame is encoded once and shared by all subscribers */
+typedef struct {
+    GstElement *appsink;
+    GstPad *tee_pad;
+    volatile gint subscribers;
+
+    GBytes *frame;
+    guint64 sequence;
+} EncodedStream;
 
 struct _OwrImageRendererPrivate {
     guint width;
     guint height;
     gdouble max_framerate;
 
+    GstElement *renderer_bin;
+    GstElement *tee;
     GstElement *appsink;
+
+    GMutex frame_lock;
+    GCond frame_cond;
+
+    /* The BMP image is only created on request, once per sample */
+    GstSample *latest_sample;
+    guint64 latest_sequence;
+    GBytes *bmp_header;
+    GBytes *bmp_pixels;
+    guint64 bmp_sequence;
+
+    EncodedStream encoded[OWR_IMAGE_ENCODING_N];
+    GList *frame_notifies;
 };
 
+typedef struct {
+    OwrImageFrameNotify func;
+    gpointer user_data;
+} FrameNotify;
+
 static void owr_image_renderer_class_init(OwrImageRendererClass *klass)
 {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
@@ -113,6 +153,7 @@ static void owr_image_renderer_class_init(OwrImageRendererClass *klass)
     gobject_class->set_property = owr_image_renderer_set_property;
     gobject_class->get_property = owr_image_renderer_get_property;
     gobject_class->constructed = owr_image_renderer_constructed;
+    gobject_class->finalize = owr_image_renderer_finalize;
 
     media_renderer_class->get_caps = (void *(*)(OwrMediaRenderer *))owr_image_renderer_get_caps;
 
@@ -127,6 +168,42 @@ static void owr_image_renderer_init(OwrImageRenderer *renderer)
     priv->width = DEFAULT_WIDTH;
     priv->height = DEFAULT_HEIGHT;
     priv->max_framerate = DEFAULT_MAX_FRAMERATE;
+
+    g_mutex_init(&priv->frame_lock);
+    g_cond_init(&priv->frame_cond);
+
+    /* Used as ETag, so start somewhere else than a previous renderer with
+     * the same tag did */
+    priv->latest_sequence = (guint64)g_random_int() << 32;
+    priv->latest_sample = NULL;
+    priv->bmp_header = NULL;
+    priv->bmp_pixels = NULL;
+    priv->bmp_sequence = 0;
+}
+
+static void owr_image_renderer_finalize(GObject *object)
+{
+    OwrImageRendererPrivate *priv = OWR_IMAGE_RENDERER(object)->priv;
+    guint i;
+
+    for (i = 0; i < OWR_IMAGE_ENCODING_N; i++) {
+        if (priv->encoded[i].tee_pad)
+            gst_object_unref(priv->encoded[i].tee_pad);
+        if (priv->encoded[i].frame)
+            g_bytes_unref(priv->encoded[i].frame);
+    }
+    g_list_free_full(priv->frame_notifies, g_free);
+    if (priv->latest_sample)
+        gst_sample_unref(priv->latest_sample);
+    if (priv->bmp_header)
+        g_bytes_unref(priv->bmp_header);
+    if (priv->bmp_pixels)
+        g_bytes_unref(priv->bmp_pixels);
+
+    g_cond_clear(&priv->frame_cond);
+    g_mutex_clear(&priv->frame_lock);
+
+    G_OBJECT_CLASS(owr_image_renderer_parent_class)->finalize(object);
 }
 
 static void owr_image_renderer_set_property(GObject *object, guint property_id,
@@ -201,8 +278,9 @@ static GstElement *owr_image_renderer_get_element(OwrMediaRenderer *renderer)
     OwrImageRenderer *image_renderer;
     OwrImageRendererPrivate *priv;
     GstElement *renderer_bin;
-    GstElement *sink;
+    GstElement *flip, *tee, *sink;
     GstPad *ghostpad, *sinkpad;
+    GstAppSinkCallbacks callbacks;
     gchar *bin_name;
 
     g_assert(renderer);
@@ -213,6 +291,11 @@ static GstElement *owr_image_renderer_get_element(OwrMediaRenderer *renderer)
     bin_name = g_strdup_printf("image-renderer-bin-%u", g_atomic_int_add(&unique_bin_id, 1));
     renderer_bin = gst_bin_new(bin_name);
     g_free(bin_name);
+    priv->renderer_bin = renderer_bin;
+
+    tee = gst_element_factory_make("tee", "image-renderer-tee");
+    g_assert(tee);
+    priv->tee = tee;
 
     sink = gst_element_factory_make("appsink", "image-renderer-appsink");
     g_assert(sink);
@@ -220,9 +303,24 @@ static GstElement *owr_image_renderer_get_element(OwrMediaRenderer *renderer)
 
     g_object_set(sink, "max-buffers", 1, "drop", TRUE, "qos", TRUE, "enable-last-sample", FALSE, NULL);
 
-    gst_bin_add_many(GST_BIN(renderer_bin), sink, NULL);
-
-    sinkpad = gst_element_get_static_pad(sink, "sink");
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.new_sample = (GstFlowReturn (*)(GstAppSink *, gpointer))on_raw_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, image_renderer, NULL);
+
+    gst_bin_add_many(GST_BIN(renderer_bin), tee, sink, NULL);
+    LINK_ELEMENTS(tee, sink);
+
+    /* Received streams may signal their orientation instead of being rotated
+     * by the sender, and both the raw and the encoded images are upright */
+    flip = _owr_video_orientation_flip_new("image-renderer-flip");
+    if (flip) {
+        gst_bin_add(GST_BIN(renderer_bin), flip);
+        LINK_ELEMENTS(flip, tee);
+        sinkpad = gst_element_get_static_pad(flip, "sink");
+    } else {
+        g_warning("The videoflip GStreamer element isn't available. Signalled video orientation is thus ignored.");
+        sinkpad = gst_element_get_static_pad(tee, "sink");
+    }
     g_assert(sinkpad);
     ghostpad = gst_ghost_pad_new("sink", sinkpad);
     gst_pad_set_active(ghostpad, TRUE);
@@ -301,7 +399,8 @@ static void fill_bmp_header(guint8 *image_data, guint image_width, guint image_h
     data += 4;
     GST_WRITE_UINT32_LE(data, image_width);
     data += 4;
-    GST_WRITE_UINT32_LE(data, image_height);
+    /* negative height for a top-down image, so frames can be sent as is */
+    GST_WRITE_UINT32_LE(data, (guint32)(-(gint32)image_height));
     data += 4;
     GST_WRITE_UINT16_LE(data, DIB_COLOR_PLANES);
     data += 2;
@@ -321,37 +420,35 @@ static void fill_bmp_header(guint8 *image_data, guint image_width, guint image_h
     data += 4;
 }
 
-/**
- * _owr_image_renderer_pull_bmp_image:
- * @image_renderer:
- *
- * Returns: (transfer full):
- */
-GBytes * _owr_image_renderer_pull_bmp_image(OwrImageRenderer *image_renderer)
+typedef struct {
+    GstBuffer *buffer;
+    GstMapInfo info;
+} MappedBuffer;
+
+static void mapped_buffer_free(MappedBuffer *mapped)
+{
+    gst_buffer_unmap(mapped->buffer, &mapped->info);
+    gst_buffer_unref(mapped->buffer);
+    g_slice_free(MappedBuffer, mapped);
+}
+
+/* Wraps the frame without copying when the rows are tightly packed, which
+ * they are unless upstream used a padded pool */
+static GBytes *create_bmp_pixels(OwrImageRenderer *image_renderer, GstSample *sample,
+    guint8 header[BMP_HEADER_SIZE])
 {
     GstCaps *caps;
-    GstSample *sample;
     GstBuffer *buf = NULL;
-    GstMapInfo info;
+    GstVideoMeta *meta;
+    MappedBuffer *mapped;
     GstStructure *s;
-    guint bufsize, total_size, src_rowsize, dest_rowsize, image_width, image_height;
-    guint8 *image_data, *src_data, *srcpos, *destpos;
+    guint row_size, image_size, image_width, image_height, offset, stride, row;
+    guint8 *image_data;
     gboolean ret, disabled = FALSE;
 
-    g_return_val_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer), NULL);
-
-    if (!image_renderer->priv->appsink)
-        return NULL;
-
-    sample = gst_app_sink_pull_sample(GST_APP_SINK(image_renderer->priv->appsink));
-    if (!sample)
-        return NULL;
-
     buf = gst_sample_get_buffer(sample);
-    if (!buf) {
-        gst_sample_unref(sample);
+    if (!buf)
         return NULL;
-    }
 
     caps = gst_sample_get_caps(sample);
     s = gst_caps_get_structure(caps, 0);
@@ -363,36 +460,420 @@ GBytes * _owr_image_renderer_pull_bmp_image(OwrImageRenderer *image_renderer)
         image_width = 0;
         image_height = 0;
     }
+    fill_bmp_header(header, image_width, image_height);
 
-    if (!gst_buffer_map(buf, &info, GST_MAP_READ))
-        g_assert_not_reached();
+    row_size = DIB_BITS_PER_PIXEL * image_width / 8;
+    image_size = row_size * image_height;
+    meta = gst_buffer_get_video_meta(buf);
+    offset = meta ? (guint)meta->offset[0] : 0;
+    stride = meta ? (guint)meta->stride[0] : row_size;
 
-    g_assert(info.data);
+    mapped = g_slice_new(MappedBuffer);
+    if (!gst_buffer_map(buf, &mapped->info, GST_MAP_READ))
+        g_assert_not_reached();
+    g_assert(mapped->info.data);
+    mapped->buffer = gst_buffer_ref(buf);
 
-    g_object_get(image_renderer, "disabled", &disabled, NULL);
-    bufsize = (guint) info.size;
-    total_size = BMP_HEADER_SIZE + bufsize;
-    image_data = disabled ? g_malloc0(total_size) : g_malloc(total_size);
-    if (!image_data) {
-        g_critical("%s Allocate mem failed (g_malloc(total_size))", __FUNCTION__);
+    if (offset + (image_height ? stride * (image_height - 1) + row_size : 0) > mapped->info.size) {
+        GST_WARNING_OBJECT(image_renderer, "Frame is smaller than its caps");
+        mapped_buffer_free(mapped);
         return NULL;
     }
-    fill_bmp_header(image_data, image_width, image_height);
 
-    src_rowsize = DIB_BITS_PER_PIXEL * image_width / 8;
-    dest_rowsize = ((DIB_BITS_PER_PIXEL * image_width  + 31) / 32) * 4;
-    src_data = info.data;
-    destpos = image_data + total_size;
+    g_object_get(image_renderer, "disabled", &disabled, NULL);
+    if (!disabled && !offset && stride == row_size) {
+        return g_bytes_new_with_free_func(mapped->info.data, image_size,
+            (GDestroyNotify)mapped_buffer_free, mapped);
+    }
 
+    image_data = disabled ? g_malloc0(image_size) : g_malloc(image_size);
     if (!disabled) {
-        for (srcpos = src_data; srcpos < src_data + bufsize; srcpos += src_rowsize) {
-            destpos -= dest_rowsize;
-            memcpy(destpos, srcpos, src_rowsize);
-        }
+        for (row = 0; row < image_height; row++)
+            memcpy(image_data + row * row_size, mapped->info.data + offset + row * stride, row_size);
+    }
+    mapped_buffer_free(mapped);
+
+    return g_bytes_new_take(image_data, image_size);
+}
+
+static GstFlowReturn on_raw_sample(GstAppSink *appsink, OwrImageRenderer *image_renderer)
+{
+    OwrImageRendererPrivate *priv = image_renderer->priv;
+    GstSample *sample, *old_sample;
+
+    sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    g_mutex_lock(&priv->frame_lock);
+    old_sample = priv->latest_sample;
+    priv->latest_sample = sample;
+    priv->latest_sequence++;
+    g_cond_broadcast(&priv->frame_cond);
+    g_mutex_unlock(&priv->frame_lock);
+
+    if (old_sample)
+        gst_sample_unref(old_sample);
+
+    return GST_FLOW_OK;
+}
+
+static void wake_frame_waiters(GCancellable *cancellable, OwrImageRenderer *image_renderer)
+{
+    OwrImageRendererPrivate *priv = image_renderer->priv;
+
+    OWR_UNUSED(cancellable);
+
+    g_mutex_lock(&priv->frame_lock);
+    g_cond_broadcast(&priv->frame_cond);
+    g_mutex_unlock(&priv->frame_lock);
+}
+
+/**
+ * _owr_image_renderer_get_bmp_image:
+ * @image_renderer:
+ * @sequence: (inout): the frame sequence number the caller already has, or 0
+ * @timeout: how long to wait for a first frame, in microseconds
+ * @cancellable: (allow-none): cancels the wait for a first frame
+ * @header: (out) (transfer full): the BMP header
+ * @pixels: (out) (transfer full): the pixel data following the header
+ *
+ * Gets the latest frame as a top-down BMP image. The pixel data is normally
+ * the mapped frame itself, which is kept alive until @pixels is released.
+ * Both are shared by all requests until the next frame.
+ *
+ * Returns: %FALSE if the caller already has the latest frame (*@sequence is
+ * left as is) or there was no frame in time (*@sequence is set to 0)
+ */
+gboolean _owr_image_renderer_get_bmp_image(OwrImageRenderer *image_renderer,
+    guint64 *sequence, gint64 timeout, GCancellable *cancellable, GBytes **header, GBytes **pixels)
+{
+    OwrImageRendererPrivate *priv;
+    GstSample *sample;
+    guint8 header_data[BMP_HEADER_SIZE];
+    guint64 latest_sequence;
+    gint64 end_time;
+    gulong cancelled_handler = 0;
+
+    g_return_val_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer), FALSE);
+    g_return_val_if_fail(sequence && header && pixels, FALSE);
+    g_return_val_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable), FALSE);
+    priv = image_renderer->priv;
+
+    end_time = g_get_monotonic_time() + timeout;
+
+    /* Connected outside of frame_lock, the handler takes it */
+    if (cancellable && timeout > 0)
+        cancelled_handler = g_cancellable_connect(cancellable, G_CALLBACK(wake_frame_waiters),
+            image_renderer, NULL);
+
+    g_mutex_lock(&priv->frame_lock);
+    while (!priv->latest_sample && !g_cancellable_is_cancelled(cancellable)) {
+        if (timeout <= 0 || !g_cond_wait_until(&priv->frame_cond, &priv->frame_lock, end_time))
+            break;
     }
+    g_mutex_unlock(&priv->frame_lock);
 
-    gst_buffer_unmap(buf, &info);
+    if (cancelled_handler)
+        g_cancellable_disconnect(cancellable, cancelled_handler);
+
+    g_mutex_lock(&priv->frame_lock);
+    if (!priv->latest_sample) {
+        g_mutex_unlock(&priv->frame_lock);
+        *sequence = 0;
+        return FALSE;
+    }
+
+    latest_sequence = priv->latest_sequence;
+    if (latest_sequence == *sequence) {
+        g_mutex_unlock(&priv->frame_lock);
+        return FALSE;
+    }
+
+    if (priv->bmp_pixels && priv->bmp_sequence == latest_sequence) {
+        *header = g_bytes_ref(priv->bmp_header);
+        *pixels = g_bytes_ref(priv->bmp_pixels);
+        g_mutex_unlock(&priv->frame_lock);
+        *sequence = latest_sequence;
+        return TRUE;
+    }
+    sample = gst_sample_ref(priv->latest_sample);
+    g_mutex_unlock(&priv->frame_lock);
+
+    /* Concurrent requests for a new frame may both get here, the result is
+     * the same either way */
+    *pixels = create_bmp_pixels(image_renderer, sample, header_data);
     gst_sample_unref(sample);
+    if (!*pixels) {
+        *sequence = 0;
+        return FALSE;
+    }
 
-    return g_bytes_new_take(image_data, total_size);
+    g_mutex_lock(&priv->frame_lock);
+    /* the header only changes with the frame size */
+    if (!priv->bmp_header || memcmp(g_bytes_get_data(priv->bmp_header, NULL), header_data,
+        BMP_HEADER_SIZE)) {
+        if (priv->bmp_header)
+            g_bytes_unref(priv->bmp_header);
+        priv->bmp_header = g_bytes_new(header_data, BMP_HEADER_SIZE);
+    }
+    *header = g_bytes_ref(priv->bmp_header);
+    if (priv->latest_sequence == latest_sequence) {
+        if (priv->bmp_pixels)
+            g_bytes_unref(priv->bmp_pixels);
+        priv->bmp_pixels = g_bytes_ref(*pixels);
+        priv->bmp_sequence = latest_sequence;
+    }
+    g_mutex_unlock(&priv->frame_lock);
+
+    *sequence = latest_sequence;
+    return TRUE;
+}
+
+static GstFlowReturn on_encoded_sample(GstAppSink *appsink, OwrImageRenderer *image_renderer)
+{
+    OwrImageRendererPrivate *priv = image_renderer->priv;
+    GstSample *sample;
+    MappedBuffer *mapped;
+    GBytes *frame;
+    GList *l;
+    FrameNotify *notify;
+    guint i;
+
+    sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    mapped = g_slice_new(MappedBuffer);
+    mapped->buffer = gst_buffer_ref(gst_sample_get_buffer(sample));
+    gst_sample_unref(sample);
+    if (!gst_buffer_map(mapped->buffer, &mapped->info, GST_MAP_READ)) {
+        gst_buffer_unref(mapped->buffer);
+        g_slice_free(MappedBuffer, mapped);
+        return GST_FLOW_OK;
+    }
+
+    /* The encoded data is shared with the clients without copying, the
+     * buffer stays mapped until the last of them is done with it */
+    frame = g_bytes_new_with_free_func(mapped->info.data, mapped->info.size,
+        (GDestroyNotify)mapped_buffer_free, mapped);
+
+    g_mutex_lock(&priv->frame_lock);
+    for (i = 0; i < OWR_IMAGE_ENCODING_N; i++) {
+        if (priv->encoded[i].appsink == GST_ELEMENT(appsink)) {
+            if (priv->encoded[i].frame)
+                g_bytes_unref(priv->encoded[i].frame);
+            priv->encoded[i].frame = frame;
+            frame = NULL;
+            priv->encoded[i].sequence++;
+            break;
+        }
+    }
+    g_cond_broadcast(&priv->frame_cond);
+    for (l = priv->frame_notifies; l && i < OWR_IMAGE_ENCODING_N; l = l->next) {
+        notify = l->data;
+        notify->func(image_renderer, (OwrImageEncoding)i, notify->user_data);
+    }
+    g_mutex_unlock(&priv->frame_lock);
+
+    if (frame)
+        g_bytes_unref(frame);
+
+    return GST_FLOW_OK;
+}
+
+static GstPadProbeReturn drop_unsubscribed(GstPad *pad, GstPadProbeInfo *info,
+    EncodedStream *stream)
+{
+    OWR_UNUSED(pad);
+    OWR_UNUSED(info);
+
+    return g_atomic_int_get(&stream->subscribers) ? GST_PAD_PROBE_OK : GST_PAD_PROBE_DROP;
+}
+
+static gboolean add_encoder_branch(OwrImageRenderer *image_renderer, OwrImageEncoding encoding)
+{
+    OwrImageRendererPrivate *priv = image_renderer->priv;
+    EncodedStream *stream = &priv->encoded[encoding];
+    GstElement *queue, *convert, *encoder, *sink;
+    GstPad *sinkpad;
+    GstAppSinkCallbacks callbacks;
+
+    encoder = gst_element_factory_make(encoder_factories[encoding], NULL);
+    if (!encoder) {
+        GST_WARNING_OBJECT(image_renderer, "No %s element, can't stream this format",
+            encoder_factories[encoding]);
+        return FALSE;
+    }
+
+    queue = gst_element_factory_make("queue", NULL);
+    g_object_set(queue, "max-size-buffers", 1, "max-size-bytes", 0, "max-size-time",
+        G_GUINT64_CONSTANT(0), "leaky", 2, NULL);
+    convert = gst_element_factory_make("videoconvert", NULL);
+    sink = gst_element_factory_make("appsink", NULL);
+    g_object_set(sink, "max-buffers", 1, "drop", TRUE, "sync", FALSE,
+        "enable-last-sample", FALSE, NULL);
+
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.new_sample = (GstFlowReturn (*)(GstAppSink *, gpointer))on_encoded_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, image_renderer, NULL);
+
+    gst_bin_add_many(GST_BIN(priv->renderer_bin), queue, convert, encoder, sink, NULL);
+    LINK_ELEMENTS(queue, convert);
+    LINK_ELEMENTS(convert, encoder);
+    LINK_ELEMENTS(encoder, sink);
+    gst_element_sync_state_with_parent(sink);
+    gst_element_sync_state_with_parent(encoder);
+    gst_element_sync_state_with_parent(convert);
+    gst_element_sync_state_with_parent(queue);
+
+    stream->appsink = sink;
+    stream->tee_pad = gst_element_get_request_pad(priv->tee, "src_%u");
+    gst_pad_add_probe(stream->tee_pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback)drop_unsubscribed, stream, NULL);
+    sinkpad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_link(stream->tee_pad, sinkpad);
+    gst_object_unref(sinkpad);
+
+    return TRUE;
+}
+
+/**
+ * _owr_image_renderer_subscribe_encoded:
+ * @image_renderer:
+ * @encoding:
+ *
+ * Starts encoding frames in @encoding for a new client, the encoder branch
+ * is created on first use and left idle when the last client unsubscribes.
+ *
+ * Returns: %FALSE if the encoder is not available
+ */
+gboolean _owr_image_renderer_subscribe_encoded(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding)
+{
+    OwrImageRendererPrivate *priv;
+    gboolean ret = TRUE;
+
+    g_return_val_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer), FALSE);
+    g_return_val_if_fail(encoding < OWR_IMAGE_ENCODING_N, FALSE);
+    priv = image_renderer->priv;
+
+    g_mutex_lock(&priv->frame_lock);
+    if (!priv->encoded[encoding].appsink)
+        ret = add_encoder_branch(image_renderer, encoding);
+    if (ret)
+        g_atomic_int_inc(&priv->encoded[encoding].subscribers);
+    g_mutex_unlock(&priv->frame_lock);
+
+    return ret;
+}
+
+void _owr_image_renderer_unsubscribe_encoded(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding)
+{
+    g_return_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer));
+    g_return_if_fail(encoding < OWR_IMAGE_ENCODING_N);
+
+    g_atomic_int_add(&image_renderer->priv->encoded[encoding].subscribers, -1);
+}
+
+/**
+ * _owr_image_renderer_wait_encoded_frame:
+ * @image_renderer:
+ * @encoding:
+ * @sequence: (inout): sequence number of the last frame the caller got
+ * @timeout: maximum time to wait in microseconds
+ *
+ * Waits for a frame newer than @sequence. Frames encoded in between are
+ * skipped, so a slow client always gets the latest one.
+ *
+ * Returns: (transfer full): the frame, or %NULL on timeout
+ */
+GBytes * _owr_image_renderer_wait_encoded_frame(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding, guint64 *sequence, gint64 timeout)
+{
+    OwrImageRendererPrivate *priv;
+    EncodedStream *stream;
+    GBytes *frame = NULL;
+    gint64 end_time;
+
+    g_return_val_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer), NULL);
+    g_return_val_if_fail(encoding < OWR_IMAGE_ENCODING_N, NULL);
+    g_return_val_if_fail(sequence, NULL);
+    priv = image_renderer->priv;
+    stream = &priv->encoded[encoding];
+
+    end_time = g_get_monotonic_time() + timeout;
+
+    g_mutex_lock(&priv->frame_lock);
+    while (stream->sequence <= *sequence || !stream->frame) {
+        if (timeout <= 0 || !g_cond_wait_until(&priv->frame_cond, &priv->frame_lock, end_time))
+            break;
+    }
+    if (stream->sequence > *sequence && stream->frame) {
+        frame = g_bytes_ref(stream->frame);
+        *sequence = stream->sequence;
+    }
+    g_mutex_unlock(&priv->frame_lock);
+
+    return frame;
+}
+
+/**
+ * _owr_image_renderer_add_frame_notify:
+ * @image_renderer:
+ * @func: called from the streaming thread with the renderer lock held, so it
+ * must not call back into @image_renderer
+ * @user_data:
+ *
+ * Adds a callback that is invoked when a new encoded frame is available, for
+ * clients that can't block in _owr_image_renderer_wait_encoded_frame().
+ */
+void _owr_image_renderer_add_frame_notify(OwrImageRenderer *image_renderer,
+    OwrImageFrameNotify func, gpointer user_data)
+{
+    OwrImageRendererPrivate *priv;
+    FrameNotify *notify;
+
+    g_return_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer));
+    g_return_if_fail(func);
+    priv = image_renderer->priv;
+
+    notify = g_new(FrameNotify, 1);
+    notify->func = func;
+    notify->user_data = user_data;
+
+    g_mutex_lock(&priv->frame_lock);
+    priv->frame_notifies = g_list_append(priv->frame_notifies, notify);
+    g_mutex_unlock(&priv->frame_lock);
+}
+
+/**
+ * _owr_image_renderer_remove_frame_notify:
+ * @image_renderer:
+ * @func:
+ * @user_data:
+ *
+ * Once this returns, @func is not running and won't be called again.
+ */
+void _owr_image_renderer_remove_frame_notify(OwrImageRenderer *image_renderer,
+    OwrImageFrameNotify func, gpointer user_data)
+{
+    OwrImageRendererPrivate *priv;
+    FrameNotify *notify;
+    GList *l;
+
+    g_return_if_fail(OWR_IS_IMAGE_RENDERER(image_renderer));
+    priv = image_renderer->priv;
+
+    g_mutex_lock(&priv->frame_lock);
+    for (l = priv->frame_notifies; l; l = l->next) {
+        notify = l->data;
+        if (notify->func == func && notify->user_data == user_data) {
+            priv->frame_notifies = g_list_delete_link(priv->frame_notifies, l);
+            g_free(notify);
+            break;
+        }
+    }
+    g_mutex_unlock(&priv->frame_lock);
 }
@@ -34,11 +34,34 @@
 
 #include "owr_image_renderer.h"
 
+#include <gio/gio.h>
+
 #ifndef __GTK_DOC_IGNORE__
 
 G_BEGIN_DECLS
 
-GBytes * _owr_image_renderer_pull_bmp_image(OwrImageRenderer *image_renderer);
+typedef enum {
+    OWR_IMAGE_ENCODING_JPEG,
+    OWR_IMAGE_ENCODING_WEBP,
+    OWR_IMAGE_ENCODING_N
+} OwrImageEncoding;
+
+typedef void (*OwrImageFrameNotify)(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding, gpointer user_data);
+
+gboolean _owr_image_renderer_get_bmp_image(OwrImageRenderer *image_renderer,
+    guint64 *sequence, gint64 timeout, GCancellable *cancellable, GBytes **header, GBytes **pixels);
+
+gboolean _owr_image_renderer_subscribe_encoded(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding);
+void _owr_image_renderer_unsubscribe_encoded(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding);
+GBytes * _owr_image_renderer_wait_encoded_frame(OwrImageRenderer *image_renderer,
+    OwrImageEncoding encoding, guint64 *sequence, gint64 timeout);
+void _owr_image_renderer_add_frame_notify(OwrImageRenderer *image_renderer,
+    OwrImageFrameNotify func, gpointer user_data);
+void _owr_image_renderer_remove_frame_notify(OwrImageRenderer *image_renderer,
+    OwrImageFrameNotify func, gpointer user_data);
 
 G_END_DECLS
 
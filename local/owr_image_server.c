@@ -45,6 +45,11 @@ GST_DEBUG_CATEGORY_EXTERN(_owrimageserver_debug);
 
 #define DEFAULT_PORT 3325
 #define DEFAULT_ALLOW_ORIGIN "null"
+#define DEFAULT_ASYNC FALSE
+
+#define ASYNC_LISTEN_BACKLOG 1024
+#define ASYNC_MAX_REQUEST_SIZE 8192
+#define ASYNC_BMP_THREADS 4
 
 #define OWR_IMAGE_SERVER_GET_PRIVATE(obj)    (G_TYPE_INSTANCE_GET_PRIVATE((obj), OWR_TYPE_IMAGE_SERVER, OwrImageServerPrivate))
 
@@ -54,6 +59,7 @@ enum {
     PROP_0,
     PROP_PORT,
     PROP_ALLOW_ORIGIN,
+    PROP_ASYNC,
     N_PROPERTIES
 };
 
@@ -64,18 +70,40 @@ static void owr_image_server_set_property(GObject *object, guint property_id,
 static void owr_image_server_get_property(GObject *object, guint property_id,
     GValue *value, GParamSpec *pspec);
 
+static void owr_image_server_constructed(GObject *object);
+
 static gboolean on_incoming_connection(GThreadedSocketService *service,
     GSocketConnection *connection, GObject *source_object, OwrImageServer *image_server);
 
+static void async_server_start(OwrImageServer *image_server);
+static void async_server_stop(OwrImageServer *image_server);
+static void on_encoded_frame(OwrImageRenderer *image_renderer, OwrImageEncoding encoding,
+    OwrImageServer *image_server);
+static void async_close_renderer_clients(OwrImageServer *image_server,
+    OwrImageRenderer *image_renderer);
+
 struct _OwrImageServerPrivate {
     guint port;
     gchar *allow_origin;
+    gboolean async;
 
     GHashTable *image_renderers;
     GMutex image_renderers_mutex;
 
     GSocketService *socket_service;
     gboolean socket_service_is_started;
+
+    /* async mode, everything below is only touched from the server thread
+     * while it's running */
+    GMainContext *context;
+    GMainLoop *main_loop;
+    GThread *thread;
+    GSocket *listen_socket;
+    GSource *listen_source;
+    GHashTable *clients;
+    GThreadPool *bmp_pool;
+    GCancellable *bmp_cancellable;
+    volatile gint fan_out_pending;
 };
 
 static void owr_image_server_finalize(GObject *object)
@@ -83,9 +111,20 @@ static void owr_image_server_finalize(GObject *object)
 
     OwrImageServer *renderer = OWR_IMAGE_SERVER(object);
     OwrImageServerPrivate *priv = renderer->priv;
-
-    g_socket_service_stop(priv->socket_service);
-    g_object_unref(priv->socket_service);
+    GHashTableIter iter;
+    gpointer image_renderer;
+
+    if (priv->async) {
+        g_hash_table_iter_init(&iter, priv->image_renderers);
+        while (g_hash_table_iter_next(&iter, NULL, &image_renderer)) {
+            _owr_image_renderer_remove_frame_notify(image_renderer,
+                (OwrImageFrameNotify)on_encoded_frame, renderer);
+        }
+        async_server_stop(renderer);
+    } else {
+        g_socket_service_stop(priv->socket_service);
+        g_object_unref(priv->socket_service);
+    }
 
     g_mutex_lock(&priv->image_renderers_mutex);
     g_hash_table_destroy(priv->image_renderers);
@@ -114,8 +153,15 @@ static void owr_image_server_class_init(OwrImageServerClass *klass)
         DEFAULT_ALLOW_ORIGIN,
         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    obj_properties[PROP_ASYNC] = g_param_spec_boolean("async", "Async",
+        "Serve all connections from a single event driven thread instead of"
+        " a thread per connection",
+        DEFAULT_ASYNC,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
     gobject_class->set_property = owr_image_server_set_property;
     gobject_class->get_property = owr_image_server_get_property;
+    gobject_class->constructed = owr_image_server_constructed;
 
     gobject_class->finalize = owr_image_server_finalize;
 
@@ -130,12 +176,42 @@ static void owr_image_server_init(OwrImageServer *image_server)
     priv->port = DEFAULT_PORT;
     priv->allow_origin = g_strdup(DEFAULT_ALLOW_ORIGIN);
 
+    priv->async = DEFAULT_ASYNC;
+
     priv->image_renderers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
     g_mutex_init(&priv->image_renderers_mutex);
 
-    priv->socket_service = g_threaded_socket_service_new(8);
+    priv->socket_service = NULL;
     priv->socket_service_is_started = FALSE;
-    g_signal_connect(priv->socket_service, "run", G_CALLBACK(on_incoming_connection), image_server);
+}
+
+static gpointer run_async_server(OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+
+    g_main_context_push_thread_default(priv->context);
+    g_main_loop_run(priv->main_loop);
+    g_main_context_pop_thread_default(priv->context);
+
+    return NULL;
+}
+
+static void owr_image_server_constructed(GObject *object)
+{
+    OwrImageServer *image_server = OWR_IMAGE_SERVER(object);
+    OwrImageServerPrivate *priv = image_server->priv;
+
+    if (priv->async) {
+        priv->context = g_main_context_new();
+        priv->main_loop = g_main_loop_new(priv->context, FALSE);
+        priv->thread = g_thread_new("owr-image-server", (GThreadFunc)run_async_server,
+            image_server);
+    } else {
+        priv->socket_service = g_threaded_socket_service_new(8);
+        g_signal_connect(priv->socket_service, "run", G_CALLBACK(on_incoming_connection), image_server);
+    }
+
+    G_OBJECT_CLASS(owr_image_server_parent_class)->constructed(object);
 }
 
 static void owr_image_server_set_property(GObject *object, guint property_id,
@@ -157,6 +233,10 @@ static void owr_image_server_set_property(GObject *object, guint property_id,
         g_strdelimit(priv->allow_origin, "\r\n", ' ');
         break;
 
+    case PROP_ASYNC:
+        priv->async = g_value_get_boolean(value);
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -180,6 +260,10 @@ static void owr_image_server_get_property(GObject *object, guint property_id,
         g_value_set_string(value, priv->allow_origin);
         break;
 
+    case PROP_ASYNC:
+        g_value_set_boolean(value, priv->async);
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -218,16 +302,25 @@ void owr_image_server_add_image_renderer(OwrImageServer *image_server,
 
     g_mutex_lock(&priv->image_renderers_mutex);
 
-    if (!g_hash_table_contains(priv->image_renderers, tag))
+    if (!g_hash_table_contains(priv->image_renderers, tag)) {
         g_hash_table_insert(priv->image_renderers, g_strdup(tag), image_renderer);
-    else {
+        if (priv->async) {
+            _owr_image_renderer_add_frame_notify(image_renderer,
+                (OwrImageFrameNotify)on_encoded_frame, image_server);
+        }
+    } else {
         g_object_unref(image_renderer);
         g_warning("Image renderer not added, an image renderer is already added for this tag");
     }
 
     g_mutex_unlock(&priv->image_renderers_mutex);
 
-    if (!priv->socket_service_is_started) {
+    if (priv->async) {
+        if (!priv->socket_service_is_started) {
+            async_server_start(image_server);
+            priv->socket_service_is_started = TRUE;
+        }
+    } else if (!priv->socket_service_is_started) {
         g_socket_listener_add_address(G_SOCKET_LISTENER(priv->socket_service),
             g_inet_socket_address_new(g_inet_address_new_from_string("127.0.0.1"),
             (guint16)priv->port), G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
@@ -240,6 +333,7 @@ void owr_image_server_add_image_renderer(OwrImageServer *image_server,
 void owr_image_server_remove_image_renderer(OwrImageServer *image_server, const gchar *tag)
 {
     OwrImageServerPrivate *priv;
+    OwrImageRenderer *image_renderer;
 
     g_return_if_fail(OWR_IS_IMAGE_SERVER(image_server));
 
@@ -247,6 +341,13 @@ void owr_image_server_remove_image_renderer(OwrImageServer *image_server, const
 
     g_mutex_lock(&priv->image_renderers_mutex);
 
+    image_renderer = g_hash_table_lookup(priv->image_renderers, tag);
+    if (image_renderer && priv->async) {
+        _owr_image_renderer_remove_frame_notify(image_renderer,
+            (OwrImageFrameNotify)on_encoded_frame, image_server);
+        async_close_renderer_clients(image_server, image_renderer);
+    }
+
     if (!g_hash_table_remove(priv->image_renderers, tag))
         g_warning("Image renderer not removed, no image renderer exists with this tag");
 
@@ -262,19 +363,195 @@ void owr_image_server_remove_image_renderer(OwrImageServer *image_server, const
 "Access-Control-Allow-Origin: %s\r\n" \
 "\r\n"
 
+/* no-store would keep clients from revalidating with If-None-Match */
+#define HTTP_IMAGE_HEADER_TEMPLATE \
+"HTTP/1.1 200 OK\r\n" \
+"Content-Type: image/bmp\r\n" \
+"Content-Length: %u\r\n" \
+"ETag: \"%" G_GINT64_MODIFIER "x\"\r\n" \
+"Cache-Control: no-cache\r\n" \
+"Pragma: no-cache\r\n" \
+"Access-Control-Allow-Origin: %s\r\n" \
+"\r\n"
+
+#define HTTP_NOT_MODIFIED_TEMPLATE \
+"HTTP/1.1 304 Not Modified\r\n" \
+"ETag: \"%" G_GINT64_MODIFIER "x\"\r\n" \
+"Cache-Control: no-cache\r\n" \
+"Pragma: no-cache\r\n" \
+"Access-Control-Allow-Origin: %s\r\n" \
+"\r\n"
+
+/* How long an image request waits for the first frame of a renderer */
+#define FIRST_FRAME_TIMEOUT (5 * G_USEC_PER_SEC)
+
+#define MULTIPART_BOUNDARY "owrimageframe"
+
+#define HTTP_STREAM_HEADER_TEMPLATE \
+"HTTP/1.1 200 OK\r\n" \
+"Content-Type: multipart/x-mixed-replace;boundary=" MULTIPART_BOUNDARY "\r\n" \
+"Cache-Control: no-cache,no-store\r\n" \
+"Pragma: no-cache\r\n" \
+"Connection: close\r\n" \
+"Access-Control-Allow-Origin: %s\r\n" \
+"\r\n"
+
+#define HTTP_STREAM_PART_TEMPLATE \
+"--" MULTIPART_BOUNDARY "\r\n" \
+"Content-Type: %s\r\n" \
+"Content-Length: %u\r\n" \
+"\r\n"
+
+/* How often a stream without new frames checks that its renderer is still served */
+#define STREAM_FRAME_TIMEOUT (5 * G_USEC_PER_SEC)
+
+static const struct {
+    const gchar *path;
+    const gchar *content_type;
+} stream_formats[OWR_IMAGE_ENCODING_N] = {
+    { "mjpeg", "image/jpeg" },
+    { "webp", "image/webp" },
+};
+
+/* "/__<tag>-mjpeg" and "/__<tag>-webp" request a multipart stream, anything
+ * else after the tag is a cache buster for a single BMP image */
+static gboolean parse_stream_encoding(const gchar *path, OwrImageEncoding *encoding)
+{
+    gsize len;
+    guint i;
+
+    for (i = 0; i < OWR_IMAGE_ENCODING_N; i++) {
+        len = strlen(stream_formats[i].path);
+        if (!strncmp(path, stream_formats[i].path, len) && (path[len] == ' ' || !path[len])) {
+            *encoding = (OwrImageEncoding)i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Returns the tag of a "GET /__<tag>-..." request line */
+static gchar *parse_request_line(const gchar *line, gsize line_length, gboolean *streaming,
+    OwrImageEncoding *encoding)
+{
+    gchar *tag;
+    gsize i;
+
+    *streaming = FALSE;
+    if (line_length <= 6)
+        return NULL;
+
+    tag = g_strdup(line + 7);
+    for (i = 0; i < strlen(tag); i++) {
+        if (tag[i] == '-') {
+            tag[i] = '\0';
+            *streaming = parse_stream_encoding(tag + i + 1, encoding);
+            break;
+        }
+    }
+
+    return tag;
+}
+
+/* The ETag of an image is the renderer's frame sequence number */
+static gboolean parse_if_none_match(const gchar *line, guint64 *sequence)
+{
+    const gchar *value;
+
+    if (g_ascii_strncasecmp(line, "If-None-Match:", 14))
+        return FALSE;
+
+    value = line + 14;
+    while (*value == ' ' || *value == '\t')
+        value++;
+    if (g_str_has_prefix(value, "W/"))
+        value += 2;
+    if (*value == '"')
+        value++;
+    *sequence = g_ascii_strtoull(value, NULL, 16);
+
+    return TRUE;
+}
+
+/* A NULL image means the client already has frame @sequence */
+static gchar *create_image_response_header(OwrImageServer *image_server, GBytes *bmp_header,
+    GBytes *pixels, guint64 sequence)
+{
+    if (!bmp_header) {
+        return g_strdup_printf(HTTP_NOT_MODIFIED_TEMPLATE, sequence,
+            image_server->priv->allow_origin);
+    }
+
+    return g_strdup_printf(HTTP_IMAGE_HEADER_TEMPLATE,
+        (guint)(g_bytes_get_size(bmp_header) + g_bytes_get_size(pixels)),
+        sequence, image_server->priv->allow_origin);
+}
+
+static gboolean is_image_renderer_served(OwrImageServer *image_server, const gchar *tag,
+    OwrImageRenderer *image_renderer)
+{
+    gboolean ret;
+
+    g_mutex_lock(&image_server->priv->image_renderers_mutex);
+    ret = g_hash_table_lookup(image_server->priv->image_renderers, tag) == image_renderer;
+    g_mutex_unlock(&image_server->priv->image_renderers_mutex);
+
+    return ret;
+}
+
+static void stream_encoded_frames(OwrImageServer *image_server, const gchar *tag,
+    OwrImageRenderer *image_renderer, OwrImageEncoding encoding, GOutputStream *os)
+{
+    gchar *header;
+    GBytes *frame;
+    gconstpointer data;
+    gsize size;
+    guint64 sequence = 0;
+    gboolean ok;
+
+    header = g_strdup_printf(HTTP_STREAM_HEADER_TEMPLATE, image_server->priv->allow_origin);
+    ok = g_output_stream_write_all(os, header, strlen(header), NULL, NULL, NULL);
+    g_free(header);
+
+    while (ok) {
+        frame = _owr_image_renderer_wait_encoded_frame(image_renderer, encoding, &sequence,
+            STREAM_FRAME_TIMEOUT);
+        if (!frame) {
+            ok = is_image_renderer_served(image_server, tag, image_renderer);
+            continue;
+        }
+
+        data = g_bytes_get_data(frame, &size);
+        header = g_strdup_printf(HTTP_STREAM_PART_TEMPLATE,
+            stream_formats[encoding].content_type, (guint)size);
+        ok = g_output_stream_write_all(os, header, strlen(header), NULL, NULL, NULL)
+            && g_output_stream_write_all(os, data, size, NULL, NULL, NULL)
+            && g_output_stream_write_all(os, "\r\n", 2, NULL, NULL, NULL);
+        g_free(header);
+        g_bytes_unref(frame);
+    }
+
+    GST_DEBUG_OBJECT(image_server, "Stopped streaming %s frames of %s",
+        stream_formats[encoding].path, tag);
+}
+
 static gboolean on_incoming_connection(GThreadedSocketService *service,
     GSocketConnection *connection, GObject *source_object, OwrImageServer *image_server)
 {
     GOutputStream *bos;
     GDataInputStream *dis;
-    gchar *error_body, *error_header = NULL, *response_header = NULL;
+    gchar *error_body, *error_header = NULL, *response_header;
     gchar *line, *tag;
-    gsize line_length, i;
-    guint content_length = 0;
+    gsize line_length;
+    guint64 known_sequence, sequence;
+    gboolean streaming;
+    OwrImageEncoding encoding = OWR_IMAGE_ENCODING_JPEG;
     OwrImageRenderer *image_renderer;
-    GBytes *image;
-    gconstpointer image_data;
-    gsize image_data_size = 0;
+    GBytes *bmp_header, *pixels;
+    gboolean got_image;
+    gconstpointer data;
+    gsize size;
 
     OWR_UNUSED(service);
     OWR_UNUSED(source_object);
@@ -294,20 +571,12 @@ static gboolean on_incoming_connection(GThreadedSocketService *service,
         if (!line)
             break;
 
-        if (line_length > 6) {
-            tag = g_strdup(line + 7);
-            for (i = 0; i < strlen(tag); i++) {
-                if (tag[i] == '-') {
-                    tag[i] = '\0';
-                    break;
-                }
-            }
-        } else
-            tag = NULL;
-
+        tag = parse_request_line(line, line_length, &streaming, &encoding);
         g_free(line);
 
+        known_sequence = 0;
         while ((line = g_data_input_stream_read_line(dis, &line_length, NULL, NULL))) {
+            parse_if_none_match(line, &known_sequence);
             g_free(line);
 
             if (!line_length) {
@@ -316,8 +585,10 @@ static gboolean on_incoming_connection(GThreadedSocketService *service,
             }
         }
 
-        if (!line)
+        if (!line) {
+            g_free(tag);
             break;
+        }
 
         g_mutex_lock(&image_server->priv->image_renderers_mutex);
         image_renderer = tag ? g_hash_table_lookup(image_server->priv->image_renderers, tag) : NULL;
@@ -325,38 +596,667 @@ static gboolean on_incoming_connection(GThreadedSocketService *service,
             g_object_ref(image_renderer);
         g_mutex_unlock(&image_server->priv->image_renderers_mutex);
 
-        image = image_renderer ? _owr_image_renderer_pull_bmp_image(image_renderer) : NULL;
-
-        if (image_renderer)
+        if (image_renderer && streaming) {
+            if (_owr_image_renderer_subscribe_encoded(image_renderer, encoding)) {
+                stream_encoded_frames(image_server, tag, image_renderer, encoding,
+                    g_io_stream_get_output_stream(G_IO_STREAM(connection)));
+                _owr_image_renderer_unsubscribe_encoded(image_renderer, encoding);
+                g_object_unref(image_renderer);
+                g_free(tag);
+                break;
+            }
             g_object_unref(image_renderer);
+            image_renderer = NULL;
+        }
+        g_free(tag);
+
+        got_image = FALSE;
+        bmp_header = pixels = NULL;
+        sequence = 0;
+        if (image_renderer) {
+            sequence = known_sequence;
+            got_image = _owr_image_renderer_get_bmp_image(image_renderer, &sequence,
+                FIRST_FRAME_TIMEOUT, NULL, &bmp_header, &pixels);
+            g_object_unref(image_renderer);
+        }
 
-        if (!image) {
+        if (!got_image && !sequence) {
             g_output_stream_write(bos, error_header, strlen(error_header), NULL, NULL);
             g_output_stream_write(bos, error_body, strlen(error_body), NULL, NULL);
             break;
         }
 
-        image_data = g_bytes_get_data(image, &image_data_size);
-
-        if (content_length != image_data_size) {
-            content_length = image_data_size;
-            g_free(response_header);
-            response_header = g_strdup_printf(HTTP_RESPONSE_HEADER_TEMPLATE, 200, "OK",
-                "image/bmp", content_length, image_server->priv->allow_origin);
-            g_buffered_output_stream_set_buffer_size(G_BUFFERED_OUTPUT_STREAM(bos),
-                strlen(response_header) + content_length);
-        }
+        response_header = create_image_response_header(image_server, bmp_header, pixels,
+            sequence);
         g_output_stream_write(bos, response_header, strlen(response_header), NULL, NULL);
-        g_output_stream_write(bos, image_data, image_data_size, NULL, NULL);
+        g_free(response_header);
+        if (got_image) {
+            data = g_bytes_get_data(bmp_header, &size);
+            g_output_stream_write(bos, data, size, NULL, NULL);
+        }
         g_output_stream_flush(bos, NULL, NULL);
 
-        g_bytes_unref(image);
+        /* The frame goes straight to the socket rather than through the
+         * buffered stream, which would copy it */
+        if (got_image) {
+            data = g_bytes_get_data(pixels, &size);
+            g_output_stream_write_all(g_io_stream_get_output_stream(G_IO_STREAM(connection)),
+                data, size, NULL, NULL, NULL);
+            g_bytes_unref(bmp_header);
+            g_bytes_unref(pixels);
+        }
     }
 
-    g_free(response_header);
     g_free(error_header);
     g_object_unref(dis);
     g_object_unref(bos);
 
     return FALSE;
 }
+
+
+/* Async mode: a single thread runs a main context with a source per socket.
+ * Output is queued per client as GBytes, so encoded frames are shared by all
+ * clients without copying, and a streaming client only gets a new frame once
+ * it has written the previous one. Image requests for a renderer that has
+ * no frame yet wait for it in a small thread pool. */
+
+typedef struct {
+    volatile gint ref_count;
+    OwrImageServer *image_server;
+    GMainContext *context;
+    GSocket *socket;
+    GSource *source;
+    GIOCondition condition;
+    gboolean closed;
+
+    GString *request;
+    gboolean busy;
+
+    GQueue pending;
+    gsize pending_offset;
+    gboolean close_when_written;
+
+    OwrImageRenderer *stream_renderer;
+    OwrImageEncoding encoding;
+    guint64 sequence;
+} AsyncClient;
+
+typedef struct {
+    AsyncClient *client;
+    OwrImageRenderer *image_renderer;
+    gboolean got_image;
+    GBytes *bmp_header;
+    GBytes *pixels;
+    guint64 sequence;
+    GCancellable *cancellable;
+} BmpJob;
+
+static gboolean on_async_client_io(GSocket *socket, GIOCondition condition, AsyncClient *client);
+static void async_client_process_requests(AsyncClient *client);
+
+static AsyncClient *async_client_ref(AsyncClient *client)
+{
+    g_atomic_int_inc(&client->ref_count);
+    return client;
+}
+
+static void async_client_unref(AsyncClient *client)
+{
+    if (!g_atomic_int_dec_and_test(&client->ref_count))
+        return;
+
+    g_assert(!client->source);
+    g_queue_foreach(&client->pending, (GFunc)g_bytes_unref, NULL);
+    g_queue_clear(&client->pending);
+    g_string_free(client->request, TRUE);
+    if (client->stream_renderer)
+        g_object_unref(client->stream_renderer);
+    g_object_unref(client->socket);
+    g_main_context_unref(client->context);
+    g_slice_free(AsyncClient, client);
+}
+
+static void async_client_close(AsyncClient *client)
+{
+    if (client->closed)
+        return;
+    client->closed = TRUE;
+
+    if (client->source) {
+        g_source_destroy(client->source);
+        g_source_unref(client->source);
+        client->source = NULL;
+    }
+    g_socket_close(client->socket, NULL);
+
+    if (client->stream_renderer)
+        _owr_image_renderer_unsubscribe_encoded(client->stream_renderer, client->encoding);
+
+    /* drops the reference held by the table */
+    g_hash_table_remove(client->image_server->priv->clients, client);
+}
+
+static void async_client_update_source(AsyncClient *client)
+{
+    GIOCondition condition = G_IO_IN;
+
+    if (client->closed)
+        return;
+
+    if (!g_queue_is_empty(&client->pending))
+        condition |= G_IO_OUT;
+
+    if (client->source && client->condition == condition)
+        return;
+
+    if (client->source) {
+        g_source_destroy(client->source);
+        g_source_unref(client->source);
+    }
+
+    client->condition = condition;
+    client->source = g_socket_create_source(client->socket, condition, NULL);
+    g_source_set_callback(client->source, (GSourceFunc)on_async_client_io,
+        async_client_ref(client), (GDestroyNotify)async_client_unref);
+    g_source_attach(client->source, client->context);
+}
+
+static void async_client_queue(AsyncClient *client, GBytes *bytes)
+{
+    if (g_bytes_get_size(bytes))
+        g_queue_push_tail(&client->pending, bytes);
+    else
+        g_bytes_unref(bytes);
+}
+
+static void async_client_queue_string(AsyncClient *client, gchar *str)
+{
+    async_client_queue(client, g_bytes_new_take(str, strlen(str)));
+}
+
+/* Returns FALSE if the connection should be closed */
+static gboolean async_client_write(AsyncClient *client)
+{
+    GBytes *bytes;
+    const guint8 *data;
+    gsize size;
+    gssize written;
+    GError *error = NULL;
+
+    while ((bytes = g_queue_peek_head(&client->pending))) {
+        data = g_bytes_get_data(bytes, &size);
+        written = g_socket_send(client->socket, (const gchar *)data + client->pending_offset,
+            size - client->pending_offset, NULL, &error);
+        if (written < 0) {
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free(error);
+                return TRUE;
+            }
+            GST_DEBUG_OBJECT(client->image_server, "Failed to write to client: %s",
+                error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+
+        client->pending_offset += written;
+        if (client->pending_offset == size) {
+            g_bytes_unref(g_queue_pop_head(&client->pending));
+            client->pending_offset = 0;
+        }
+    }
+
+    return !client->close_when_written;
+}
+
+static void async_client_queue_frame(AsyncClient *client)
+{
+    GBytes *frame;
+
+    frame = _owr_image_renderer_wait_encoded_frame(client->stream_renderer, client->encoding,
+        &client->sequence, 0);
+    if (!frame)
+        return;
+
+    async_client_queue_string(client, g_strdup_printf(HTTP_STREAM_PART_TEMPLATE,
+        stream_formats[client->encoding].content_type, (guint)g_bytes_get_size(frame)));
+    async_client_queue(client, frame);
+    async_client_queue(client, g_bytes_new_static("\r\n", 2));
+}
+
+/* Writes what can be written right away and waits for the socket for the rest */
+static void async_client_flush(AsyncClient *client)
+{
+    if (client->closed)
+        return;
+
+    if (!async_client_write(client)) {
+        async_client_close(client);
+        return;
+    }
+
+    if (client->stream_renderer && g_queue_is_empty(&client->pending)) {
+        async_client_queue_frame(client);
+        if (!async_client_write(client)) {
+            async_client_close(client);
+            return;
+        }
+    }
+
+    async_client_update_source(client);
+}
+
+static void async_client_queue_not_found(AsyncClient *client)
+{
+    const gchar *body = "404 Not Found";
+
+    async_client_queue_string(client, g_strdup_printf(HTTP_RESPONSE_HEADER_TEMPLATE, 404,
+        "Not Found", "text/plain", (guint)strlen(body), "*"));
+    async_client_queue(client, g_bytes_new_static(body, strlen(body)));
+    client->close_when_written = TRUE;
+}
+
+/* Takes ownership of the image, see _owr_image_renderer_get_bmp_image() */
+static void async_client_queue_image(AsyncClient *client, gboolean got_image,
+    GBytes *bmp_header, GBytes *pixels, guint64 sequence)
+{
+    if (!got_image && !sequence) {
+        async_client_queue_not_found(client);
+        return;
+    }
+
+    async_client_queue_string(client,
+        create_image_response_header(client->image_server, bmp_header, pixels, sequence));
+    if (got_image) {
+        async_client_queue(client, bmp_header);
+        async_client_queue(client, pixels);
+    }
+}
+
+static gboolean on_bmp_image_pulled(BmpJob *job)
+{
+    AsyncClient *client = job->client;
+
+    if (!client->closed) {
+        client->busy = FALSE;
+
+        async_client_queue_image(client, job->got_image, job->bmp_header, job->pixels,
+            job->sequence);
+        job->got_image = FALSE;
+
+        async_client_process_requests(client);
+        async_client_flush(client);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void bmp_job_free(BmpJob *job)
+{
+    if (job->got_image) {
+        g_bytes_unref(job->bmp_header);
+        g_bytes_unref(job->pixels);
+    }
+    g_object_unref(job->image_renderer);
+    g_object_unref(job->cancellable);
+    async_client_unref(job->client);
+    g_slice_free(BmpJob, job);
+}
+
+static void pull_bmp_image(BmpJob *job, gpointer user_data)
+{
+    GSource *source;
+
+    OWR_UNUSED(user_data);
+
+    job->got_image = _owr_image_renderer_get_bmp_image(job->image_renderer, &job->sequence,
+        FIRST_FRAME_TIMEOUT, job->cancellable, &job->bmp_header, &job->pixels);
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, (GSourceFunc)on_bmp_image_pulled, job,
+        (GDestroyNotify)bmp_job_free);
+    g_source_attach(source, job->client->context);
+    g_source_unref(source);
+}
+
+/* @request is the request line and headers, split into lines */
+static void async_client_handle_request(AsyncClient *client, gchar **request)
+{
+    OwrImageServerPrivate *priv = client->image_server->priv;
+    OwrImageRenderer *image_renderer;
+    OwrImageEncoding encoding = OWR_IMAGE_ENCODING_JPEG;
+    gboolean streaming;
+    guint64 sequence = 0;
+    GBytes *bmp_header = NULL, *pixels = NULL;
+    gboolean got_image;
+    gchar *tag;
+    BmpJob *job;
+    guint i;
+
+    if (!request[0]) {
+        async_client_queue_not_found(client);
+        return;
+    }
+
+    tag = parse_request_line(request[0], strlen(request[0]), &streaming, &encoding);
+    for (i = 1; request[i]; i++)
+        parse_if_none_match(request[i], &sequence);
+
+    g_mutex_lock(&priv->image_renderers_mutex);
+    image_renderer = tag ? g_hash_table_lookup(priv->image_renderers, tag) : NULL;
+    if (image_renderer)
+        g_object_ref(image_renderer);
+    g_mutex_unlock(&priv->image_renderers_mutex);
+    g_free(tag);
+
+    if (!image_renderer) {
+        async_client_queue_not_found(client);
+        return;
+    }
+
+    if (streaming) {
+        if (_owr_image_renderer_subscribe_encoded(image_renderer, encoding)) {
+            client->stream_renderer = image_renderer;
+            client->encoding = encoding;
+            async_client_queue_string(client, g_strdup_printf(HTTP_STREAM_HEADER_TEMPLATE,
+                priv->allow_origin));
+        } else {
+            g_object_unref(image_renderer);
+            async_client_queue_not_found(client);
+        }
+        return;
+    }
+
+    got_image = _owr_image_renderer_get_bmp_image(image_renderer, &sequence, 0, NULL,
+        &bmp_header, &pixels);
+    if (got_image || sequence) {
+        async_client_queue_image(client, got_image, bmp_header, pixels, sequence);
+        g_object_unref(image_renderer);
+        return;
+    }
+
+    job = g_slice_new0(BmpJob);
+    job->client = async_client_ref(client);
+    job->image_renderer = image_renderer;
+    job->cancellable = g_object_ref(priv->bmp_cancellable);
+    client->busy = TRUE;
+    g_thread_pool_push(priv->bmp_pool, job, NULL);
+}
+
+static void async_client_process_requests(AsyncClient *client)
+{
+    gchar *end, **request;
+
+    while (!client->busy && !client->closed && !client->stream_renderer
+        && !client->close_when_written
+        && (end = strstr(client->request->str, "\r\n\r\n"))) {
+        *end = '\0';
+        request = g_strsplit(client->request->str, "\r\n", -1);
+        async_client_handle_request(client, request);
+        g_strfreev(request);
+        g_string_erase(client->request, 0, end + 4 - client->request->str);
+    }
+}
+
+/* Returns FALSE if the connection should be closed */
+static gboolean async_client_read(AsyncClient *client)
+{
+    gchar buf[1024];
+    gssize len;
+    GError *error = NULL;
+
+    while (TRUE) {
+        len = g_socket_receive(client->socket, buf, sizeof(buf), NULL, &error);
+        if (len < 0) {
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free(error);
+                break;
+            }
+            g_error_free(error);
+            return FALSE;
+        }
+        if (!len)
+            return FALSE;
+
+        /* streaming clients have nothing more to say */
+        if (!client->stream_renderer)
+            g_string_append_len(client->request, buf, len);
+        if (client->request->len > ASYNC_MAX_REQUEST_SIZE)
+            return FALSE;
+    }
+
+    async_client_process_requests(client);
+
+    return TRUE;
+}
+
+static gboolean on_async_client_io(GSocket *socket, GIOCondition condition, AsyncClient *client)
+{
+    OWR_UNUSED(socket);
+
+    async_client_ref(client);
+
+    if (condition & (G_IO_IN | G_IO_HUP | G_IO_ERR)) {
+        if (!async_client_read(client))
+            async_client_close(client);
+    }
+    async_client_flush(client);
+
+    async_client_unref(client);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_async_incoming(GSocket *listen_socket, GIOCondition condition,
+    OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+    AsyncClient *client;
+    GSocket *socket;
+    GError *error = NULL;
+
+    OWR_UNUSED(condition);
+
+    while ((socket = g_socket_accept(listen_socket, NULL, &error))) {
+        g_socket_set_blocking(socket, FALSE);
+
+        client = g_slice_new0(AsyncClient);
+        client->ref_count = 1;
+        client->image_server = image_server;
+        client->context = g_main_context_ref(priv->context);
+        client->socket = socket;
+        client->request = g_string_new(NULL);
+        g_queue_init(&client->pending);
+
+        g_hash_table_add(priv->clients, client);
+        async_client_update_source(client);
+    }
+
+    if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        GST_WARNING_OBJECT(image_server, "Failed to accept connection: %s", error->message);
+    g_clear_error(&error);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void async_server_start(OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+    GInetAddress *inet_address;
+    GSocketAddress *address;
+    GError *error = NULL;
+
+    priv->clients = g_hash_table_new_full(NULL, NULL, (GDestroyNotify)async_client_unref, NULL);
+    priv->bmp_pool = g_thread_pool_new((GFunc)pull_bmp_image, NULL, ASYNC_BMP_THREADS,
+        FALSE, NULL);
+    priv->bmp_cancellable = g_cancellable_new();
+
+    priv->listen_socket = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+        G_SOCKET_PROTOCOL_TCP, &error);
+    if (!priv->listen_socket) {
+        g_warning("Failed to create image server socket: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+    g_socket_set_blocking(priv->listen_socket, FALSE);
+    g_socket_set_listen_backlog(priv->listen_socket, ASYNC_LISTEN_BACKLOG);
+
+    inet_address = g_inet_address_new_from_string("127.0.0.1");
+    address = g_inet_socket_address_new(inet_address, (guint16)priv->port);
+    if (!g_socket_bind(priv->listen_socket, address, TRUE, &error)
+        || !g_socket_listen(priv->listen_socket, &error)) {
+        g_warning("Image server failed to listen on port %u: %s", priv->port, error->message);
+        g_error_free(error);
+    } else {
+        priv->listen_source = g_socket_create_source(priv->listen_socket, G_IO_IN, NULL);
+        g_source_set_callback(priv->listen_source, (GSourceFunc)on_async_incoming,
+            image_server, NULL);
+        g_source_attach(priv->listen_source, priv->context);
+    }
+    g_object_unref(address);
+    g_object_unref(inet_address);
+}
+
+static gboolean quit_main_loop(GMainLoop *main_loop)
+{
+    g_main_loop_quit(main_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void async_server_stop(OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+    GSource *source;
+    GList *clients, *l;
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, (GSourceFunc)quit_main_loop, priv->main_loop, NULL);
+    g_source_attach(source, priv->context);
+    g_source_unref(source);
+    g_thread_join(priv->thread);
+
+    if (priv->listen_source) {
+        g_source_destroy(priv->listen_source);
+        g_source_unref(priv->listen_source);
+    }
+    if (priv->listen_socket) {
+        g_socket_close(priv->listen_socket, NULL);
+        g_object_unref(priv->listen_socket);
+    }
+
+    if (priv->clients) {
+        clients = g_hash_table_get_keys(priv->clients);
+        for (l = clients; l; l = l->next)
+            async_client_close(l->data);
+        g_list_free(clients);
+    }
+
+    /* Jobs still pulling an image attach their result to the context, which
+     * holds a reference to the job until dispatched. With the clients closed
+     * nothing new gets queued. Cancelling makes running and queued jobs give
+     * up waiting for a first frame, so the pool drains right away, and then
+     * dispatching what is left only releases the jobs */
+    if (priv->bmp_cancellable)
+        g_cancellable_cancel(priv->bmp_cancellable);
+    if (priv->bmp_pool)
+        g_thread_pool_free(priv->bmp_pool, FALSE, TRUE);
+    while (g_main_context_iteration(priv->context, FALSE))
+        ;
+
+    if (priv->clients)
+        g_hash_table_destroy(priv->clients);
+    if (priv->bmp_cancellable)
+        g_object_unref(priv->bmp_cancellable);
+
+    g_main_loop_unref(priv->main_loop);
+    g_main_context_unref(priv->context);
+}
+
+static gboolean fan_out_frames(OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+    GList *clients, *l;
+    AsyncClient *client;
+
+    g_atomic_int_set(&priv->fan_out_pending, 0);
+
+    clients = g_hash_table_get_keys(priv->clients);
+    g_list_foreach(clients, (GFunc)async_client_ref, NULL);
+    for (l = clients; l; l = l->next) {
+        client = l->data;
+        /* clients still writing an earlier frame skip this one */
+        if (client->stream_renderer && g_queue_is_empty(&client->pending))
+            async_client_flush(client);
+        async_client_unref(client);
+    }
+    g_list_free(clients);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void on_encoded_frame(OwrImageRenderer *image_renderer, OwrImageEncoding encoding,
+    OwrImageServer *image_server)
+{
+    OwrImageServerPrivate *priv = image_server->priv;
+    GSource *source;
+
+    OWR_UNUSED(image_renderer);
+    OWR_UNUSED(encoding);
+
+    if (!priv->clients || !g_atomic_int_compare_and_exchange(&priv->fan_out_pending, 0, 1))
+        return;
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, (GSourceFunc)fan_out_frames, image_server, NULL);
+    g_source_attach(source, priv->context);
+    g_source_unref(source);
+}
+
+typedef struct {
+    OwrImageServer *image_server;
+    OwrImageRenderer *image_renderer;
+} RemovedRenderer;
+
+static gboolean close_removed_renderer_clients(RemovedRenderer *removed)
+{
+    GList *clients, *l;
+    AsyncClient *client;
+
+    clients = g_hash_table_get_keys(removed->image_server->priv->clients);
+    g_list_foreach(clients, (GFunc)async_client_ref, NULL);
+    for (l = clients; l; l = l->next) {
+        client = l->data;
+        if (client->stream_renderer == removed->image_renderer)
+            async_client_close(client);
+        async_client_unref(client);
+    }
+    g_list_free(clients);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void removed_renderer_free(RemovedRenderer *removed)
+{
+    g_object_unref(removed->image_renderer);
+    g_slice_free(RemovedRenderer, removed);
+}
+
+static void async_close_renderer_clients(OwrImageServer *image_server,
+    OwrImageRenderer *image_renderer)
+{
+    RemovedRenderer *removed;
+    GSource *source;
+
+    if (!image_server->priv->clients)
+        return;
+
+    removed = g_slice_new(RemovedRenderer);
+    removed->image_server = image_server;
+    removed->image_renderer = g_object_ref(image_renderer);
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, (GSourceFunc)close_removed_renderer_clients, removed,
+        (GDestroyNotify)removed_renderer_free);
+    g_source_attach(source, image_server->priv->context);
+    g_source_unref(source);
+}
@@ -39,6 +39,7 @@
 
 #include "owr_media_source.h"
 #include "owr_media_source_private.h"
+#include "owr_message_data_private.h"
 #include "owr_message_origin.h"
 #include "owr_private.h"
 #include "owr_types.h"
@@ -105,9 +106,16 @@ struct _OwrLocalMediaSourcePrivate {
     /* Volume and mute are for before source_volume gets created */
     double volume;
     gboolean mute;
+
+    /* The capture mode of video sources is picked from the caps that all
+     * consumers requested, by source element returned to them */
+    GHashTable *consumer_caps;
+    GstElement *video_source;
+    GstElement *video_capsfilter;
 };
 
 static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_source, GstCaps *caps);
+static void owr_local_media_source_release_source(OwrMediaSource *media_source, GstElement *source);
 
 static void owr_local_media_source_set_property(GObject *object, guint property_id,
     const GValue *value, GParamSpec *pspec);
@@ -130,6 +138,11 @@ static void owr_local_media_source_finalize(GObject *object)
     source->priv->message_origin_bus_set = NULL;
 
     g_clear_object(&source->priv->source_volume);
+    g_clear_object(&source->priv->video_source);
+    g_clear_object(&source->priv->video_capsfilter);
+    g_hash_table_destroy(source->priv->consumer_caps);
+
+    G_OBJECT_CLASS(owr_local_media_source_parent_class)->finalize(object);
 }
 
 static void owr_local_media_source_class_init(OwrLocalMediaSourceClass *klass)
@@ -145,6 +158,7 @@ static void owr_local_media_source_class_init(OwrLocalMediaSourceClass *klass)
     g_type_class_add_private(klass, sizeof(OwrLocalMediaSourcePrivate));
 
     media_source_class->request_source = (void *(*)(OwrMediaSource *, void *))owr_local_media_source_request_source;
+    media_source_class->release_source = (void (*)(OwrMediaSource *, void *))owr_local_media_source_release_source;
 
     g_object_class_install_property(gobject_class, PROP_DEVICE_INDEX,
         g_param_spec_int("device-index", "Device index",
@@ -184,6 +198,9 @@ static void owr_local_media_source_init(OwrLocalMediaSource *source)
     priv->source_volume = NULL;
     priv->volume = 0.8;
     priv->mute = FALSE;
+    priv->consumer_caps = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) gst_caps_unref);
+    priv->video_source = NULL;
+    priv->video_capsfilter = NULL;
 }
 
 static void owr_local_media_source_set_property(GObject *object, guint property_id,
@@ -419,16 +436,15 @@ static gboolean shutdown_media_source(GHashTable *args)
     OwrMediaSource *media_source;
     OwrLocalMediaSource *local_media_source;
     GstElement *source_pipeline, *source_tee;
-    GHashTable *event_data;
-    GValue *value;
-
-    event_data = _owr_value_table_new();
-    value = _owr_value_table_add(event_data, "start_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
+    OwrMessageData *event_data;
 
     media_source = g_hash_table_lookup(args, "media_source");
     g_assert(media_source);
 
+    event_data = OWR_WANTS_EVENT(media_source) ? _owr_message_data_new(2) : NULL;
+    if (event_data)
+        _owr_message_data_add_int64(event_data, "start_time", g_get_monotonic_time());
+
     local_media_source = OWR_LOCAL_MEDIA_SOURCE(media_source);
     if (local_media_source->priv->source_volume)
         gst_object_unref(local_media_source->priv->source_volume);
@@ -458,14 +474,17 @@ static gboolean shutdown_media_source(GHashTable *args)
 
     _owr_media_source_set_source_bin(media_source, NULL);
     _owr_media_source_set_source_tee(media_source, NULL);
+    g_clear_object(&local_media_source->priv->video_source);
+    g_clear_object(&local_media_source->priv->video_capsfilter);
 
     gst_element_set_state(source_pipeline, GST_STATE_NULL);
     gst_object_unref(source_pipeline);
     gst_object_unref(source_tee);
 
-    value = _owr_value_table_add(event_data, "end_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
-    OWR_POST_EVENT(media_source, LOCAL_SOURCE_STOPPED, event_data);
+    if (event_data) {
+        _owr_message_data_add_int64(event_data, "end_time", g_get_monotonic_time());
+        OWR_POST_EVENT(media_source, LOCAL_SOURCE_STOPPED, event_data);
+    }
 
     g_object_unref(media_source);
     g_hash_table_unref(args);
@@ -549,6 +568,192 @@ done:
     return TRUE;
 }
 
+/* Fixates the size of a capture mode towards the given one and returns its area */
+static gint64 fixate_capture_mode(GstStructure *mode, gint width, gint height, gint fps_n, gint fps_d)
+{
+    gint fixed_width = 0, fixed_height = 0;
+
+    gst_structure_fixate_field_nearest_int(mode, "width", width);
+    gst_structure_fixate_field_nearest_int(mode, "height", height);
+    if (fps_n)
+        gst_structure_fixate_field_nearest_fraction(mode, "framerate", fps_n, fps_d);
+    else
+        gst_structure_remove_field(mode, "framerate");
+
+    gst_structure_get_int(mode, "width", &fixed_width);
+    gst_structure_get_int(mode, "height", &fixed_height);
+
+    return (gint64) fixed_width * fixed_height;
+}
+
+/*
+ * Returns the smallest raw mode of srcpad that is at least as large and fast
+ * as every one of consumer_caps, or the largest mode if none is. NULL if the
+ * consumers don't ask for a size.
+ */
+static GstCaps *select_capture_caps(GstPad *srcpad, GList *consumer_caps, const gchar *format)
+{
+    GstCaps *device_caps, *ret = NULL;
+    GstStructure *requirement, *best = NULL, *largest = NULL, *mode;
+    gint max_width = 0, max_height = 0, fps_n = 0, fps_d = 1;
+    gint64 area, best_area = G_MAXINT64, largest_area = -1;
+    GList *item;
+    guint i;
+
+    for (item = consumer_caps; item; item = item->next) {
+        GstCaps *caps = item->data;
+        GstStructure *s;
+        gint width, height, n, d;
+
+        if (gst_caps_is_empty(caps) || gst_caps_is_any(caps))
+            continue;
+
+        s = gst_caps_get_structure(caps, 0);
+        if (gst_structure_get_int(s, "width", &width))
+            max_width = MAX(max_width, width);
+        if (gst_structure_get_int(s, "height", &height))
+            max_height = MAX(max_height, height);
+        if (gst_structure_get_fraction(s, "framerate", &n, &d) && n && d
+            && (!fps_n || gst_util_fraction_compare(n, d, fps_n, fps_d) > 0)) {
+            fps_n = n;
+            fps_d = d;
+        }
+    }
+
+    if (!max_width || !max_height)
+        return NULL;
+
+    requirement = gst_structure_new("video/x-raw",
+        "width", GST_TYPE_INT_RANGE, max_width, G_MAXINT,
+        "height", GST_TYPE_INT_RANGE, max_height, G_MAXINT, NULL);
+    if (fps_n)
+        gst_structure_set(requirement, "framerate", GST_TYPE_FRACTION_RANGE, fps_n, fps_d, G_MAXINT, 1, NULL);
+    if (format)
+        gst_structure_set(requirement, "format", G_TYPE_STRING, format, NULL);
+
+    device_caps = gst_pad_query_caps(srcpad, NULL);
+    if (gst_caps_is_any(device_caps)) {
+        best = gst_structure_copy(requirement);
+        fixate_capture_mode(best, max_width, max_height, fps_n, fps_d);
+    }
+
+    for (i = 0; !gst_caps_is_any(device_caps) && i < gst_caps_get_size(device_caps); i++) {
+        GstStructure *s = gst_caps_get_structure(device_caps, i);
+        GstCapsFeatures *features = gst_caps_get_features(device_caps, i);
+
+        if (!gst_structure_has_name(s, "video/x-raw"))
+            continue;
+        if (features && !gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY))
+            continue;
+
+        if ((mode = gst_structure_intersect(s, requirement))) {
+            area = fixate_capture_mode(mode, max_width, max_height, fps_n, fps_d);
+            if (area < best_area) {
+                if (best)
+                    gst_structure_free(best);
+                best = mode;
+                best_area = area;
+            } else
+                gst_structure_free(mode);
+        } else if (!best) {
+            mode = gst_structure_copy(s);
+            if (format && gst_structure_has_field(mode, "format")
+                && !gst_structure_can_intersect(mode, requirement))
+                gst_structure_remove_field(mode, "format");
+            area = fixate_capture_mode(mode, G_MAXINT, G_MAXINT, fps_n, fps_d);
+            if (area > largest_area) {
+                if (largest)
+                    gst_structure_free(largest);
+                largest = mode;
+                largest_area = area;
+            } else
+                gst_structure_free(mode);
+        }
+    }
+
+    gst_caps_unref(device_caps);
+    gst_structure_free(requirement);
+
+    if (!best) {
+        best = largest;
+        largest = NULL;
+    }
+    if (largest)
+        gst_structure_free(largest);
+
+    if (best) {
+        ret = gst_caps_new_empty();
+        gst_caps_append_structure(ret, best);
+    }
+
+    return ret;
+}
+
+/* Returns the caps a consumer fed from a pyramid level needs from the
+ * capture, its requested size doubled once per level */
+static GstCaps *scale_to_pyramid_level(GstCaps *caps, guint level)
+{
+    GstStructure *s;
+    gint width, height;
+
+    caps = gst_caps_copy(caps);
+    if (gst_caps_is_empty(caps) || gst_caps_is_any(caps))
+        return caps;
+
+    s = gst_caps_get_structure(caps, 0);
+    if (gst_structure_get_int(s, "width", &width))
+        gst_structure_set(s, "width", G_TYPE_INT, width << level, NULL);
+    if (gst_structure_get_int(s, "height", &height))
+        gst_structure_set(s, "height", G_TYPE_INT, height << level, NULL);
+
+    return caps;
+}
+
+/* call with the media_source lock */
+static void update_capture_caps(OwrLocalMediaSource *local_source)
+{
+    OwrLocalMediaSourcePrivate *priv = local_source->priv;
+    GstCaps *current_caps = NULL, *caps;
+    const gchar *format = NULL;
+    GstPad *srcpad;
+    GList *consumer_caps = NULL;
+    GHashTableIter iter;
+    GstElement *source_element;
+    guint level;
+
+    if (!priv->video_source || !priv->video_capsfilter)
+        return;
+
+    /* Keep a format that was forced on the source */
+    g_object_get(priv->video_capsfilter, "caps", &current_caps, NULL);
+    if (current_caps && !gst_caps_is_empty(current_caps) && !gst_caps_is_any(current_caps))
+        format = gst_structure_get_string(gst_caps_get_structure(current_caps, 0), "format");
+
+    /* Consumers fed from a downscaled pyramid level keep that level, so the
+     * capture must stay large enough for the level not to upscale */
+    g_hash_table_iter_init(&iter, priv->consumer_caps);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &source_element, (gpointer *) &caps)) {
+        level = _owr_media_source_get_pyramid_level(OWR_MEDIA_SOURCE(local_source), source_element);
+        consumer_caps = g_list_prepend(consumer_caps,
+            level ? scale_to_pyramid_level(caps, level) : gst_caps_ref(caps));
+    }
+    srcpad = gst_element_get_static_pad(priv->video_source, "src");
+    caps = select_capture_caps(srcpad, consumer_caps, format);
+    gst_object_unref(srcpad);
+    g_list_free_full(consumer_caps, (GDestroyNotify) gst_caps_unref);
+
+    if (caps && !(current_caps && gst_caps_is_equal(caps, current_caps))) {
+        GST_INFO_OBJECT(local_source, "Switching capture mode to %" GST_PTR_FORMAT, caps);
+        /* The capsfilter makes the source renegotiate */
+        g_object_set(priv->video_capsfilter, "caps", caps, NULL);
+    }
+
+    if (caps)
+        gst_caps_unref(caps);
+    if (current_caps)
+        gst_caps_unref(current_caps);
+}
+
 static void on_caps(GstElement *source, GParamSpec *pspec, OwrMediaSource *media_source)
 {
     gchar *media_source_name;
@@ -597,8 +802,7 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
     OwrLocalMediaSourcePrivate *priv;
     GstElement *source_element = NULL;
     GstElement *source_pipeline;
-    GHashTable *event_data;
-    GValue *value;
+    OwrMessageData *event_data;
 #if defined(__linux__) && !defined(__ANDROID__)
     gchar *tmp;
 #endif
@@ -624,9 +828,9 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
         GstBus *bus;
         GSource *bus_source;
 
-        event_data = _owr_value_table_new();
-        value = _owr_value_table_add(event_data, "start_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
+        event_data = OWR_WANTS_EVENT(media_source) ? _owr_message_data_new(2) : NULL;
+        if (event_data)
+            _owr_message_data_add_int64(event_data, "start_time", g_get_monotonic_time());
 
         g_object_get(media_source, "media-type", &media_type, "type", &source_type, NULL);
 
@@ -800,6 +1004,18 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
             }
 
             gst_caps_unref(device_caps);
+
+            /* Prefer the smallest device mode that covers what is requested,
+             * later consumers update it through update_capture_caps() */
+            if (!source_process) {
+                GList consumer_caps = { caps, NULL, NULL };
+                GstCaps *mode_caps = select_capture_caps(srcpad, &consumer_caps, NULL);
+
+                if (mode_caps) {
+                    gst_caps_unref(source_caps);
+                    source_caps = mode_caps;
+                }
+            }
             gst_object_unref(srcpad);
 
 #if defined(__APPLE__) && TARGET_OS_IPHONE && !TARGET_IPHONE_SIMULATOR
@@ -814,6 +1030,12 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
             gst_caps_unref(source_caps);
             gst_bin_add(GST_BIN(source_pipeline), capsfilter);
 
+            /* Scaling covers any size, so there is no capture mode to pick */
+            if (!source_process) {
+                priv->video_source = gst_object_ref(source);
+                priv->video_capsfilter = gst_object_ref(capsfilter);
+            }
+
             break;
         }
         case OWR_MEDIA_TYPE_UNKNOWN:
@@ -833,10 +1055,9 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
         gst_bin_add_many(GST_BIN(source_pipeline), source, tee, NULL);
 
         /* Many sources don't like reconfiguration and it's pointless
-         * here anyway right now. No need to reconfigure whenever something
-         * is added to the tee or removed.
-         * We will have to implement reconfiguration differently later by
-         * selecting the best caps based on all consumers.
+         * here anyway. No need to reconfigure whenever something is added
+         * to the tee or removed. Video sources are instead reconfigured from
+         * the capsfilter when the consumers change, see update_capture_caps().
          */
         sinkpad = gst_element_get_static_pad(tee, "sink");
         gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, drop_reconfigure_event, NULL, NULL);
@@ -872,9 +1093,10 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
             /* FIXME: We should handle this and don't expose the source */
         }
 
-        value = _owr_value_table_add(event_data, "end_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
-        OWR_POST_EVENT(media_source, LOCAL_SOURCE_STARTED, event_data);
+        if (event_data) {
+            _owr_message_data_add_int64(event_data, "end_time", g_get_monotonic_time());
+            OWR_POST_EVENT(media_source, LOCAL_SOURCE_STARTED, event_data);
+        }
 
         g_signal_connect(tee, "pad-removed", G_CALLBACK(tee_pad_removed_cb), media_source);
     }
@@ -882,10 +1104,25 @@ static GstElement *owr_local_media_source_request_source(OwrMediaSource *media_s
 
     source_element = OWR_MEDIA_SOURCE_CLASS(owr_local_media_source_parent_class)->request_source(media_source, caps);
 
+    if (source_element && priv->video_capsfilter) {
+        g_hash_table_insert(priv->consumer_caps, source_element, gst_caps_ref(caps));
+        update_capture_caps(local_source);
+    }
+
 done:
     return source_element;
 }
 
+static void owr_local_media_source_release_source(OwrMediaSource *media_source, GstElement *source)
+{
+    OwrLocalMediaSource *local_source = OWR_LOCAL_MEDIA_SOURCE(media_source);
+
+    OWR_MEDIA_SOURCE_CLASS(owr_local_media_source_parent_class)->release_source(media_source, source);
+
+    if (g_hash_table_remove(local_source->priv->consumer_caps, source))
+        update_capture_caps(local_source);
+}
+
 static OwrLocalMediaSource *_owr_local_media_source_new(gint device_index, const gchar *name,
     OwrMediaType media_type, OwrSourceType source_type)
 {
@@ -53,11 +53,15 @@ GST_DEBUG_CATEGORY_EXTERN(_owrmediarenderer_debug);
 #define DEFAULT_MEDIA_TYPE OWR_MEDIA_TYPE_UNKNOWN
 #define DEFAULT_SOURCE NULL
 #define DEFAULT_DISABLED FALSE
+#define DEFAULT_LINK_POLICY OWR_LINK_POLICY_BLOCK
+#define DEFAULT_LINK_DEPTH 0
 
 enum {
     PROP_0,
     PROP_MEDIA_TYPE,
     PROP_DISABLED,
+    PROP_LINK_POLICY,
+    PROP_LINK_DEPTH,
     N_PROPERTIES
 };
 
@@ -76,6 +80,8 @@ struct _OwrMediaRendererPrivate {
     OwrMediaType media_type;
     OwrMediaSource *source;
     gboolean disabled;
+    OwrLinkPolicy link_policy;
+    guint link_depth;
 
     GstElement *pipeline;
     GstElement *src, *sink;
@@ -130,6 +136,18 @@ static void owr_media_renderer_class_init(OwrMediaRendererClass *klass)
         "Whether this renderer is disabled or not", DEFAULT_DISABLED,
         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    obj_properties[PROP_LINK_POLICY] = g_param_spec_enum("link-policy", "Link policy",
+        "What to do with new buffers from the source when the renderer is not keeping up"
+        " (applied when a source is set)",
+        OWR_TYPE_LINK_POLICY, DEFAULT_LINK_POLICY,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_LINK_DEPTH] = g_param_spec_uint("link-depth", "Link depth",
+        "The number of buffers queued for the renderer before the link policy applies,"
+        " 0 for the queue defaults (applied when a source is set)",
+        0, G_MAXUINT, DEFAULT_LINK_DEPTH,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     gobject_class->set_property = owr_media_renderer_set_property;
     gobject_class->get_property = owr_media_renderer_get_property;
 
@@ -220,6 +238,8 @@ static void owr_media_renderer_init(OwrMediaRenderer *renderer)
     priv->media_type = DEFAULT_MEDIA_TYPE;
     priv->source = DEFAULT_SOURCE;
     priv->disabled = DEFAULT_DISABLED;
+    priv->link_policy = DEFAULT_LINK_POLICY;
+    priv->link_depth = DEFAULT_LINK_DEPTH;
 
     priv->message_origin_bus_set = owr_message_origin_bus_set_new();
 
@@ -263,6 +283,14 @@ static void owr_media_renderer_set_property(GObject *object, guint property_id,
         priv->disabled = g_value_get_boolean(value);
         break;
 
+    case PROP_LINK_POLICY:
+        priv->link_policy = g_value_get_enum(value);
+        break;
+
+    case PROP_LINK_DEPTH:
+        priv->link_depth = g_value_get_uint(value);
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -286,6 +314,14 @@ static void owr_media_renderer_get_property(GObject *object, guint property_id,
         g_value_set_boolean(value, priv->disabled);
         break;
 
+    case PROP_LINK_POLICY:
+        g_value_set_enum(value, priv->link_policy);
+        break;
+
+    case PROP_LINK_DEPTH:
+        g_value_set_uint(value, priv->link_depth);
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -308,6 +344,18 @@ static void on_caps(GstElement *sink, GParamSpec *pspec, OwrMediaRenderer *media
     }
 }
 
+static void post_link_stats(OwrMediaRenderer *renderer)
+{
+    OwrMessageData *stats_data;
+
+    if (!renderer->priv->src || !OWR_WANTS_STATS(renderer))
+        return;
+
+    stats_data = _owr_media_source_get_link_stats(renderer->priv->src);
+    if (stats_data)
+        OWR_POST_STATS(renderer, SOURCE_LINK, stats_data);
+}
+
 static void maybe_start_renderer(OwrMediaRenderer *renderer)
 {
     OwrMediaRendererPrivate *priv;
@@ -330,6 +378,7 @@ static void maybe_start_renderer(OwrMediaRenderer *renderer)
     src = _owr_media_source_request_source(priv->source, caps);
     gst_caps_unref(caps);
     g_assert(src);
+    _owr_media_source_set_link_policy(src, priv->link_policy, priv->link_depth);
     srcpad = gst_element_get_static_pad(src, "src");
     g_assert(srcpad);
     priv->src = src;
@@ -371,6 +420,7 @@ static gboolean set_source(GHashTable *args)
     }
 
     if (priv->source) {
+        post_link_stats(renderer);
         _owr_media_source_release_source(priv->source, priv->src);
         gst_element_set_state(priv->src, GST_STATE_NULL);
         gst_bin_remove(GST_BIN(priv->pipeline), priv->src);
@@ -453,6 +503,7 @@ void _owr_media_renderer_set_sink(OwrMediaRenderer *renderer, gpointer sink_ptr)
 
     if (!sink) {
         if (priv->src) {
+            post_link_stats(renderer);
             _owr_media_source_release_source(priv->source, priv->src);
             gst_bin_remove(GST_BIN(priv->pipeline), priv->src);
             priv->src = NULL;
@@ -58,6 +58,8 @@ GST_DEBUG_CATEGORY_EXTERN(_owrvideorenderer_debug);
 #define DEFAULT_HEIGHT 0
 #define DEFAULT_MAX_FRAMERATE 0.0
 #define DEFAULT_ROTATION 0
+#define DEFAULT_LINK_POLICY OWR_LINK_POLICY_LEAK_OLDEST
+#define DEFAULT_LINK_DEPTH 8
 #define DEFAULT_MIRROR FALSE
 #define DEFAULT_TAG NULL
 
@@ -96,6 +98,9 @@ struct _OwrVideoRendererPrivate {
     gdouble max_framerate;
     gint rotation;
     gboolean mirror;
+    /* Orientation signalled with the rendered stream, applied before the
+     * rotation and mirroring of the renderer */
+    volatile gint stream_flip_method;
     gchar *tag;
     GMutex closure_mutex;
     GClosure *request_context;
@@ -176,8 +181,12 @@ static void owr_video_renderer_init(OwrVideoRenderer *renderer)
     priv->tag = DEFAULT_TAG;
     priv->rotation = DEFAULT_ROTATION;
     priv->mirror = DEFAULT_MIRROR;
+    priv->stream_flip_method = 0;
     g_mutex_init(&priv->closure_mutex);
     priv->request_context = NULL;
+
+    /* A late frame is worth less than a fresh one, unlike audio samples */
+    g_object_set(renderer, "link-policy", DEFAULT_LINK_POLICY, "link-depth", DEFAULT_LINK_DEPTH, NULL);
 }
 
 static void owr_video_renderer_set_property(GObject *object, guint property_id,
@@ -293,9 +302,30 @@ static void update_flip_method(OwrMediaRenderer *renderer, GParamSpec *pspec, Gs
 
     g_object_get(renderer, "rotation", &rotation, "mirror", &mirror, NULL);
     flip_method = _owr_rotation_and_mirror_to_video_flip_method(rotation, mirror);
+    flip_method = _owr_video_flip_method_compose(
+        g_atomic_int_get(&OWR_VIDEO_RENDERER(renderer)->priv->stream_flip_method), flip_method);
     g_object_set(flip, "method", flip_method, NULL);
 }
 
+static GstPadProbeReturn probe_stream_orientation(GstPad *pad, GstPadProbeInfo *info,
+    OwrVideoRenderer *renderer)
+{
+    GstElement *flip;
+    gint flip_method;
+
+    if (!_owr_video_orientation_event_parse(GST_PAD_PROBE_INFO_EVENT(info), &flip_method))
+        return GST_PAD_PROBE_OK;
+
+    g_atomic_int_set(&renderer->priv->stream_flip_method, flip_method);
+    flip = gst_pad_get_parent_element(pad);
+    if (flip) {
+        update_flip_method(OWR_MEDIA_RENDERER(renderer), NULL, flip);
+        gst_object_unref(flip);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
 static void disable_last_sample_on_sink(const GValue *item, gpointer data)
 {
     GstElement *element = GST_ELEMENT_CAST(g_value_get_object(item));
@@ -341,7 +371,13 @@ static GstElement *owr_video_renderer_get_element(OwrMediaRenderer *renderer, gu
     } else {
         g_signal_connect_object(renderer, "notify::rotation", G_CALLBACK(update_flip_method), flip, 0);
         g_signal_connect_object(renderer, "notify::mirror", G_CALLBACK(update_flip_method), flip, 0);
+        g_atomic_int_set(&priv->stream_flip_method, 0);
         update_flip_method(renderer, NULL, flip);
+
+        sinkpad = gst_element_get_static_pad(flip, "sink");
+        gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+            (GstPadProbeCallback)probe_stream_orientation, video_renderer, NULL);
+        gst_object_unref(sinkpad);
     }
 
     sink = OWR_MEDIA_RENDERER_GET_CLASS(renderer)->get_sink(renderer);
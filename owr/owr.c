@@ -42,6 +42,7 @@
 
 #include "owr.h"
 #include "owr_private.h"
+#include "owr_message_data_private.h"
 #include "owr_utils.h"
 
 #include <gst/gst.h>
@@ -62,9 +63,20 @@ static gboolean owr_initialized = FALSE;
 static GMainContext *owr_main_context = NULL;
 static GMainLoop *owr_main_loop = NULL;
 
+/* Shard 0 is owr_main_context, the others are run by owr_run_shards_in_background().
+ * The shard arrays are read from any thread creating a transport agent, so they
+ * are only accessed with the shards lock held. */
+G_LOCK_DEFINE_STATIC(shards);
+static guint owr_n_shards = 1;
+static GMainContext **owr_shard_contexts = NULL;
+static GMainLoop **owr_shard_loops = NULL;
+static GThread **owr_shard_threads = NULL;
+static guint owr_next_shard = 0;
+
 G_LOCK_DEFINE_STATIC(base_time);
 static GstClockTime owr_base_time = GST_CLOCK_TIME_NONE;
 
+GST_DEBUG_CATEGORY(_owraudiomixer_debug);
 GST_DEBUG_CATEGORY(_owraudiopayload_debug);
 GST_DEBUG_CATEGORY(_owraudiorenderer_debug);
 GST_DEBUG_CATEGORY(_owrbridge_debug);
@@ -74,6 +86,7 @@ GST_DEBUG_CATEGORY(_owrdatachannel_debug);
 GST_DEBUG_CATEGORY(_owrdatasession_debug);
 GST_DEBUG_CATEGORY(_owrcrypto_debug);
 GST_DEBUG_CATEGORY(_owrdevicelist_debug);
+GST_DEBUG_CATEGORY(_owrframerenderer_debug);
 GST_DEBUG_CATEGORY(_owrimagerenderer_debug);
 GST_DEBUG_CATEGORY(_owrimageserver_debug);
 GST_DEBUG_CATEGORY(_owrlocal_debug);
@@ -216,6 +229,8 @@ void owr_init(GMainContext *main_context)
     gst_init(NULL, NULL);
     owr_initialized = TRUE;
 
+    GST_DEBUG_CATEGORY_INIT(_owraudiomixer_debug, "owraudiomixer", 0,
+        "OpenWebRTC Audio Mixer");
     GST_DEBUG_CATEGORY_INIT(_owraudiopayload_debug, "owraudiopayload", 0,
         "OpenWebRTC Audio Payload");
     GST_DEBUG_CATEGORY_INIT(_owraudiorenderer_debug, "owraudiorenderer", 0,
@@ -234,6 +249,8 @@ void owr_init(GMainContext *main_context)
         "OpenWebRTC Data Session");
     GST_DEBUG_CATEGORY_INIT(_owrdevicelist_debug, "owrdevicelist", 0,
         "OpenWebRTC Device List");
+    GST_DEBUG_CATEGORY_INIT(_owrframerenderer_debug, "owrframerenderer", 0,
+        "OpenWebRTC Frame Renderer");
     GST_DEBUG_CATEGORY_INIT(_owrimagerenderer_debug, "owrimagerenderer", 0,
         "OpenWebRTC Image Renderer");
     GST_DEBUG_CATEGORY_INIT(_owrimageserver_debug, "owrimageserver", 0,
@@ -380,13 +397,165 @@ void owr_run_in_background(void)
     g_async_queue_unref(msg_queue);
 }
 
+typedef struct {
+    GMainLoop *main_loop;
+    GAsyncQueue *msg_queue;
+} ShardStartData;
+
+static gpointer owr_shard_thread_func(ShardStartData *start_data)
+{
+    GMainContext *context;
+    GMainLoop *main_loop;
+    GAsyncQueue *msg_queue;
+    GSource *idle_source;
+
+    g_return_val_if_fail(start_data, NULL);
+
+    /* start_data is owned by the caller, which waits for the loop to run */
+    main_loop = start_data->main_loop;
+    msg_queue = start_data->msg_queue;
+    context = g_main_loop_get_context(main_loop);
+
+    idle_source = g_idle_source_new();
+    g_source_set_callback(idle_source, (GSourceFunc) owr_running_callback, msg_queue, NULL);
+    g_source_set_priority(idle_source, G_PRIORITY_DEFAULT);
+    g_source_attach(idle_source, context);
+    g_source_unref(idle_source);
+
+    g_main_context_push_thread_default(context);
+    g_main_loop_run(main_loop);
+    g_main_context_pop_thread_default(context);
+    g_main_loop_unref(main_loop);
+
+    return NULL;
+}
+
+/**
+ * owr_run_shards_in_background:
+ * @n_shards: the total number of main-loops to spread transport agents over
+ *
+ * Creates @n_shards - 1 additional main-loops, each running in its own thread.
+ * Together with the main-loop started by owr_run() or owr_run_in_background()
+ * they form the shards that transport agents are assigned to, see
+ * #OwrTransportAgent:shard. All work of a transport agent and its sessions
+ * runs on the thread of its shard. Must be called after owr_init() and before
+ * any transport agent is created. This function does not return until all
+ * threads have started and their main-loops are running.
+ */
+void owr_run_shards_in_background(guint n_shards)
+{
+    ShardStartData start_data;
+    GMainContext **contexts;
+    GMainLoop **loops;
+    GThread **threads;
+    gchar *thread_name;
+    guint i;
+
+    g_return_if_fail(owr_main_context);
+    g_return_if_fail(n_shards > 0);
+    g_return_if_fail(!owr_shard_contexts);
+
+    if (n_shards == 1)
+        return;
+
+    contexts = g_new0(GMainContext *, n_shards);
+    loops = g_new0(GMainLoop *, n_shards);
+    threads = g_new0(GThread *, n_shards);
+    contexts[0] = g_main_context_ref(owr_main_context);
+
+    start_data.msg_queue = g_async_queue_new();
+    for (i = 1; i < n_shards; i++) {
+        contexts[i] = g_main_context_new();
+        loops[i] = g_main_loop_new(contexts[i], FALSE);
+        start_data.main_loop = g_main_loop_ref(loops[i]);
+
+        thread_name = g_strdup_printf("owr_shard_%u", i);
+        threads[i] = g_thread_new(thread_name, (GThreadFunc) owr_shard_thread_func, &start_data);
+        g_free(thread_name);
+
+        /* Wait for "ready" so that owr_quit() can't race the start of the loop */
+        g_async_queue_pop(start_data.msg_queue);
+    }
+    g_async_queue_unref(start_data.msg_queue);
+
+    G_LOCK(shards);
+    owr_shard_contexts = contexts;
+    owr_shard_loops = loops;
+    owr_shard_threads = threads;
+    owr_n_shards = n_shards;
+    G_UNLOCK(shards);
+}
+
+/**
+ * owr_get_n_shards:
+ *
+ * Returns: the number of main-loops that transport agents are spread over
+ */
+guint owr_get_n_shards(void)
+{
+    guint n_shards;
+
+    G_LOCK(shards);
+    n_shards = owr_n_shards;
+    G_UNLOCK(shards);
+
+    return n_shards;
+}
+
+/* Transport agents that are still alive keep a reference to the context of
+ * their shard, so only the arrays and the loops go away here. */
+static void owr_stop_shards(void)
+{
+    GMainContext **contexts;
+    GMainLoop **loops;
+    GThread **threads;
+    guint n_shards, i;
+
+    G_LOCK(shards);
+    contexts = owr_shard_contexts;
+    loops = owr_shard_loops;
+    threads = owr_shard_threads;
+    n_shards = owr_n_shards;
+    owr_shard_contexts = NULL;
+    owr_shard_loops = NULL;
+    owr_shard_threads = NULL;
+    owr_n_shards = 1;
+    G_UNLOCK(shards);
+
+    if (!contexts)
+        return;
+
+    for (i = 1; i < n_shards; i++)
+        g_main_loop_quit(loops[i]);
+
+    for (i = 1; i < n_shards; i++) {
+        /* owr_quit() may be called from a shard, which can't wait for itself */
+        if (threads[i] == g_thread_self())
+            g_thread_unref(threads[i]);
+        else
+            g_thread_join(threads[i]);
+        g_main_loop_unref(loops[i]);
+    }
+    for (i = 0; i < n_shards; i++)
+        g_main_context_unref(contexts[i]);
+
+    g_free(threads);
+    g_free(loops);
+    g_free(contexts);
+}
+
 /**
  * owr_quit:
  *
  * Quits the OpenWebRTC main-loop, and stops the background thread if owr_run_in_background was used.
+ * The threads started by owr_run_shards_in_background() are stopped and joined as well.
+ * Transport agents that are still alive stay valid, but no further work runs on
+ * their shards.
  */
 void owr_quit(void)
 {
+    owr_stop_shards();
+
     g_return_if_fail(owr_main_loop);
     g_main_loop_quit(owr_main_loop);
     owr_main_loop = NULL;
@@ -402,6 +571,78 @@ GMainContext * _owr_get_main_context()
     return owr_main_context;
 }
 
+/**
+ * _owr_get_shard_main_context:
+ * @shard: (inout): the requested shard, or -1 to pick the next one round-robin
+ *
+ * Returns: (transfer full): the main context of @shard, which is set to the
+ * index of the shard that was picked
+ */
+GMainContext * _owr_get_shard_main_context(gint *shard)
+{
+    GMainContext *context;
+    guint index;
+
+    g_return_val_if_fail(shard, g_main_context_ref(owr_main_context));
+
+    G_LOCK(shards);
+    if (*shard < 0)
+        index = owr_next_shard++ % owr_n_shards;
+    else
+        index = (guint) *shard % owr_n_shards;
+
+    /* Referenced under the lock, owr_quit() may drop the shards right after */
+    context = g_main_context_ref(owr_shard_contexts ? owr_shard_contexts[index] : owr_main_context);
+    G_UNLOCK(shards);
+
+    *shard = index;
+
+    return context;
+}
+
+static GQuark main_context_quark(void)
+{
+    static gsize quark = 0;
+
+    if (g_once_init_enter(&quark)) {
+        GQuark q = g_quark_from_static_string("owr-main-context");
+        g_once_init_leave(&quark, q);
+    }
+
+    return (GQuark) quark;
+}
+
+/**
+ * _owr_set_main_context_for_object:
+ * @object: the object whose scheduled work should run on @context
+ * @context: (transfer none): a main context returned by _owr_get_shard_main_context()
+ */
+void _owr_set_main_context_for_object(gpointer object, GMainContext *context)
+{
+    g_return_if_fail(G_IS_OBJECT(object));
+    g_return_if_fail(context);
+
+    g_object_set_qdata_full(G_OBJECT(object), main_context_quark(), g_main_context_ref(context),
+        (GDestroyNotify) g_main_context_unref);
+}
+
+/**
+ * _owr_get_main_context_for_object:
+ * @object: an object
+ *
+ * Returns: (transfer none): the main context that work for @object is scheduled on
+ */
+GMainContext * _owr_get_main_context_for_object(gpointer object)
+{
+    GMainContext *context;
+
+    g_return_val_if_fail(G_IS_OBJECT(object), owr_main_context);
+
+    context = g_object_get_qdata(G_OBJECT(object), main_context_quark());
+
+    return context ? context : owr_main_context;
+}
+
 GstClockTime _owr_get_base_time()
 {
     G_LOCK(base_time);
@@ -417,18 +658,23 @@ GstClockTime _owr_get_base_time()
 }
 
 void _owr_schedule_with_user_data(GSourceFunc func, gpointer user_data)
+{
+    _owr_schedule_with_user_data_on_context(owr_main_context, func, user_data);
+}
+
+void _owr_schedule_with_user_data_on_context(GMainContext *context, GSourceFunc func, gpointer user_data)
 {
     GSource *source = g_idle_source_new();
 
     g_source_set_callback(source, func, user_data, NULL);
     g_source_set_priority(source, G_PRIORITY_DEFAULT);
-    g_source_attach(source, owr_main_context);
+    g_source_attach(source, context);
 }
 
 static gboolean time_schedule_func(gpointer user_data)
 {
-    GHashTable *table, *data;
-    GValue *value;
+    GHashTable *table;
+    OwrMessageData *data;
     OwrMessageOrigin *origin;
     GSourceFunc func;
     gboolean result;
@@ -439,15 +685,13 @@ static gboolean time_schedule_func(gpointer user_data)
     origin = g_hash_table_lookup(table, "__origin");
     data = g_hash_table_lookup(table, "__data");
 
-    value = _owr_value_table_add(data, "call_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
+    _owr_message_data_add_int64(data, "call_time", g_get_monotonic_time());
 
     result = func(table);
 
     g_return_val_if_fail(OWR_IS_MESSAGE_ORIGIN(origin), result);
 
-    value = _owr_value_table_add(data, "end_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
+    _owr_message_data_add_int64(data, "end_time", g_get_monotonic_time());
 
     OWR_POST_STATS(origin, SCHEDULE, data);
 
@@ -459,31 +703,47 @@ static gboolean time_schedule_func(gpointer user_data)
  * @func:
  * @hash_table: (transfer full):
  *
+ * The call is scheduled on the main context stored under "__context", if any,
+ * otherwise on the owr main context.
  */
 void _owr_schedule_with_hash_table(GSourceFunc func, GHashTable *hash_table)
 {
+    GMainContext *context;
+
+    context = g_hash_table_lookup(hash_table, "__context");
+    if (!context)
+        context = owr_main_context;
+
     if (g_hash_table_lookup(hash_table, "__data")) {
         g_hash_table_insert(hash_table, "__func", func);
-        _owr_schedule_with_user_data(time_schedule_func, hash_table);
+        _owr_schedule_with_user_data_on_context(context, time_schedule_func, hash_table);
     } else
-        _owr_schedule_with_user_data(func, hash_table);
+        _owr_schedule_with_user_data_on_context(context, func, hash_table);
 }
 
 GHashTable *_owr_create_schedule_table_func(OwrMessageOrigin *origin, const gchar *function_name)
 {
-    GHashTable *args, *stats_table;
-    GValue *value;
+    GHashTable *args;
+    OwrMessageData *stats_data;
+    GMainContext *context;
 
-    stats_table = _owr_value_table_new();
+    args = g_hash_table_new(g_str_hash, g_str_equal);
 
-    value = _owr_value_table_add(stats_table, "start_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
+    /* Work for objects pinned to a shard runs on that shard */
+    context = _owr_get_main_context_for_object(origin);
+    if (context != owr_main_context)
+        g_hash_table_insert(args, "__context", context);
 
-    value = _owr_value_table_add(stats_table, "function_name", G_TYPE_STRING);
-    g_value_set_static_string(value, function_name);
+    /* Without a bus listening for stats the call is scheduled untimed */
+    if (!OWR_WANTS_STATS(origin))
+        return args;
 
-    args = g_hash_table_new(g_str_hash, g_str_equal);
-    g_hash_table_insert(args, "__data", stats_table);
+    /* start_time, function_name, call_time and end_time */
+    stats_data = _owr_message_data_new(4);
+    _owr_message_data_add_int64(stats_data, "start_time", g_get_monotonic_time());
+    _owr_message_data_add_static_string(stats_data, "function_name", function_name);
+
+    g_hash_table_insert(args, "__data", stats_data);
     g_hash_table_insert(args, "__origin", g_object_ref(origin));
 
     return args;
@@ -35,6 +35,8 @@ G_BEGIN_DECLS
 void owr_init(GMainContext *main_context);
 void owr_run(void);
 void owr_run_in_background(void);
+void owr_run_shards_in_background(guint n_shards);
+guint owr_get_n_shards(void);
 void owr_quit(void);
 
 G_END_DECLS
@@ -33,20 +33,32 @@
 #include "owr_bus.h"
 
 #include "owr_bus_private.h"
+#include "owr_message_data_private.h"
 #include "owr_message_origin_private.h"
 
 #include "owr_utils.h"
 
 #include <gst/gst.h>
 
+#include <string.h>
+
 GST_DEBUG_CATEGORY_EXTERN(_owrbus_debug);
 #define GST_CAT_DEFAULT _owrbus_debug
 
 #define DEFAULT_MESSAGE_TYPE_MASK (OWR_MESSAGE_TYPE_ERROR | OWR_MESSAGE_TYPE_STATS | OWR_MESSAGE_TYPE_EVENT)
+#define DEFAULT_MAX_QUEUE_LENGTH 0
+#define DEFAULT_MAX_BATCH_SIZE 16
+
+#define MAX_BATCH_SIZE_MAX 1024
+
+/* One slot per OwrMessageType flag */
+#define N_MESSAGE_TYPES 3
 
 enum {
     PROP_0,
     PROP_MESSAGE_TYPE_MASK,
+    PROP_MAX_QUEUE_LENGTH,
+    PROP_MAX_BATCH_SIZE,
     N_PROPERTIES
 };
 
@@ -60,9 +72,21 @@ G_DEFINE_TYPE(OwrBus, owr_bus, G_TYPE_OBJECT)
 struct _OwrBusPrivate {
     OwrMessageType message_type_mask;
     GThread *thread;
-    GAsyncQueue *queue;
+
+    /* queue_mutex protects everything in this block */
+    GMutex queue_mutex;
+    GCond queue_cond;
+    GQueue queue;
+    gboolean stopping;
+    guint max_queue_length;
+    guint max_batch_size;
+    OwrBusDropPolicy drop_policies[N_MESSAGE_TYPES];
+    guint64 dropped_messages[N_MESSAGE_TYPES];
 
     OwrBusMessageCallback callback_func;
+    OwrBusMessageDataCallback data_callback_func;
+    OwrBusMessageBatchCallback batch_callback_func;
+    OwrBusMessageDataBatchCallback data_batch_callback_func;
     gpointer callback_user_data;
     GDestroyNotify callback_destroy_data;
     GMutex callback_mutex;
@@ -73,8 +97,6 @@ static void owr_bus_set_property(GObject *, guint property_id, const GValue *, G
 static void owr_bus_get_property(GObject *, guint property_id, GValue *, GParamSpec *);
 static gpointer bus_thread_func(OwrBus *bus);
 
-static OwrMessage last_message;
-
 static void owr_bus_class_init(OwrBusClass *klass)
 {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
@@ -87,6 +109,17 @@ static void owr_bus_class_init(OwrBusClass *klass)
         OWR_TYPE_MESSAGE_TYPE, DEFAULT_MESSAGE_TYPE_MASK,
         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    obj_properties[PROP_MAX_QUEUE_LENGTH] = g_param_spec_uint("max-queue-length", "max-queue-length",
+        "The maximum number of messages waiting to be delivered, the drop policy of each message"
+        " type decides what happens when the queue is full (0 = unbounded)",
+        0, G_MAXUINT, DEFAULT_MAX_QUEUE_LENGTH,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    obj_properties[PROP_MAX_BATCH_SIZE] = g_param_spec_uint("max-batch-size", "max-batch-size",
+        "The maximum number of messages delivered in one call to a batch callback",
+        1, MAX_BATCH_SIZE_MAX, DEFAULT_MAX_BATCH_SIZE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     gobject_class->set_property = owr_bus_set_property;
     gobject_class->get_property = owr_bus_get_property;
 
@@ -103,13 +136,26 @@ static void owr_bus_init(OwrBus *bus)
 
     priv->message_type_mask = DEFAULT_MESSAGE_TYPE_MASK;
 
-    priv->queue = g_async_queue_new_full((GDestroyNotify) _owr_message_unref);
-    priv->thread = g_thread_new("owr-bus-thread", (GThreadFunc) bus_thread_func, bus);
+    g_mutex_init(&priv->queue_mutex);
+    g_cond_init(&priv->queue_cond);
+    g_queue_init(&priv->queue);
+    priv->stopping = FALSE;
+    priv->max_queue_length = DEFAULT_MAX_QUEUE_LENGTH;
+    priv->max_batch_size = DEFAULT_MAX_BATCH_SIZE;
+    priv->drop_policies[0] = OWR_BUS_DROP_POLICY_NEVER; /* ERROR */
+    priv->drop_policies[1] = OWR_BUS_DROP_POLICY_DROP_OLDEST; /* STATS */
+    priv->drop_policies[2] = OWR_BUS_DROP_POLICY_DROP_NEWEST; /* EVENT */
+    memset(priv->dropped_messages, 0, sizeof(priv->dropped_messages));
 
     priv->callback_func = NULL;
+    priv->data_callback_func = NULL;
+    priv->batch_callback_func = NULL;
+    priv->data_batch_callback_func = NULL;
     priv->callback_user_data = NULL;
     priv->callback_destroy_data = NULL;
     g_mutex_init(&priv->callback_mutex);
+
+    priv->thread = g_thread_new("owr-bus-thread", (GThreadFunc) bus_thread_func, bus);
 }
 
 static void owr_bus_finalize(GObject *object)
@@ -117,24 +163,34 @@ static void owr_bus_finalize(GObject *object)
     OwrBus *bus = OWR_BUS(object);
     OwrBusPrivate *priv = bus->priv;
 
-    GST_LOG_OBJECT(bus, "pushing last message");
-    g_async_queue_push(priv->queue, &last_message);
+    GST_LOG_OBJECT(bus, "stopping bus thread");
+    g_mutex_lock(&priv->queue_mutex);
+    priv->stopping = TRUE;
+    g_cond_signal(&priv->queue_cond);
+    g_mutex_unlock(&priv->queue_mutex);
     g_thread_join(priv->thread);
     GST_LOG_OBJECT(bus, "joined bus thread");
     g_thread_unref(priv->thread);
     priv->thread = NULL;
 
-    g_async_queue_unref(priv->queue);
-    priv->queue = NULL;
+    g_queue_foreach(&priv->queue, (GFunc) _owr_message_unref, NULL);
+    g_queue_clear(&priv->queue);
+    g_cond_clear(&priv->queue_cond);
+    g_mutex_clear(&priv->queue_mutex);
 
     if (priv->callback_destroy_data) {
         priv->callback_destroy_data(priv->callback_user_data);
     }
     priv->callback_func = NULL;
+    priv->data_callback_func = NULL;
+    priv->batch_callback_func = NULL;
+    priv->data_batch_callback_func = NULL;
     priv->callback_user_data = NULL;
     priv->callback_destroy_data = NULL;
     g_mutex_clear(&priv->callback_mutex);
 
+    owr_message_origin_bus_set_invalidate_all();
+
     G_OBJECT_CLASS(owr_bus_parent_class)->finalize(object);
 }
 
@@ -149,6 +205,17 @@ static void owr_bus_set_property(GObject *object, guint property_id,
     switch (property_id) {
     case PROP_MESSAGE_TYPE_MASK:
         priv->message_type_mask = g_value_get_flags(value);
+        owr_message_origin_bus_set_invalidate_all();
+        break;
+    case PROP_MAX_QUEUE_LENGTH:
+        g_mutex_lock(&priv->queue_mutex);
+        priv->max_queue_length = g_value_get_uint(value);
+        g_mutex_unlock(&priv->queue_mutex);
+        break;
+    case PROP_MAX_BATCH_SIZE:
+        g_mutex_lock(&priv->queue_mutex);
+        priv->max_batch_size = g_value_get_uint(value);
+        g_mutex_unlock(&priv->queue_mutex);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -168,12 +235,23 @@ static void owr_bus_get_property(GObject *object, guint property_id,
     case PROP_MESSAGE_TYPE_MASK:
         g_value_set_flags(value, priv->message_type_mask);
         break;
+    case PROP_MAX_QUEUE_LENGTH:
+        g_value_set_uint(value, priv->max_queue_length);
+        break;
+    case PROP_MAX_BATCH_SIZE:
+        g_value_set_uint(value, priv->max_batch_size);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
     }
 }
 
+static inline guint message_type_index(OwrMessageType type)
+{
+    return g_bit_nth_lsf(type, -1);
+}
+
 /**
  * owr_bus_new:
  * Returns: (transfer full): a new #OwrBus
@@ -188,8 +266,11 @@ OwrBus *owr_bus_new()
  * @origin: (transfer none): the origin of the message, an #OwrMessageOrigin
  * @type: the #OwrMessageType of the message
  * @sub_type: the #OwrMessageSubType of the message
- * @data: (element-type utf8 GValue) (nullable) (transfer none): the data passed to owr_bus_set_message_callback
+ * @data: (element-type utf8 GValue) (nullable) (transfer none): the data of the message
  * @user_data: (nullable): the data passed to owr_bus_set_message_callback
+ *
+ * The table is built from the #OwrMessageData of the message, use
+ * owr_bus_set_message_data_callback() to avoid that cost.
  */
 
 /**
@@ -214,12 +295,202 @@ void owr_bus_set_message_callback(OwrBus *bus, OwrBusMessageCallback callback,
         priv->callback_destroy_data(priv->callback_user_data);
     }
     priv->callback_func = callback;
+    priv->data_callback_func = NULL;
+    priv->batch_callback_func = NULL;
+    priv->data_batch_callback_func = NULL;
+    priv->callback_user_data = user_data;
+    priv->callback_destroy_data = destroy_data;
+
+    g_mutex_unlock(&priv->callback_mutex);
+}
+
+/**
+ * OwrBusMessageDataCallback:
+ * @origin: (transfer none): the origin of the message, an #OwrMessageOrigin
+ * @type: the #OwrMessageType of the message
+ * @sub_type: the #OwrMessageSubType of the message
+ * @data: (nullable) (transfer none): the data of the message
+ * @user_data: (nullable): the data passed to owr_bus_set_message_data_callback
+ */
+
+/**
+ * owr_bus_set_message_data_callback:
+ * @bus: an #OwrBus
+ * @callback: (scope notified)
+ * @user_data: (nullable): user data for @callback
+ * @destroy_data: (nullable): a #GDestroyNotify for @user_data
+ *
+ * Like owr_bus_set_message_callback(), but the message data is passed as an
+ * #OwrMessageData instead of a #GHashTable. Replaces any other callback.
+ */
+void owr_bus_set_message_data_callback(OwrBus *bus, OwrBusMessageDataCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data)
+{
+    OwrBusPrivate *priv;
+
+    g_return_if_fail(OWR_IS_BUS(bus));
+    g_return_if_fail(callback);
+    priv = OWR_BUS_GET_PRIVATE(bus);
+
+    g_mutex_lock(&priv->callback_mutex);
+
+    if (priv->callback_destroy_data) {
+        priv->callback_destroy_data(priv->callback_user_data);
+    }
+    priv->callback_func = NULL;
+    priv->data_callback_func = callback;
+    priv->batch_callback_func = NULL;
+    priv->data_batch_callback_func = NULL;
+    priv->callback_user_data = user_data;
+    priv->callback_destroy_data = destroy_data;
+
+    g_mutex_unlock(&priv->callback_mutex);
+}
+
+/**
+ * OwrBusMessageBatchCallback:
+ * @n_messages: the number of messages in the batch
+ * @origins: (array length=n_messages) (transfer none): the origins of the messages
+ * @types: (array length=n_messages): the #OwrMessageType of each message
+ * @sub_types: (array length=n_messages): the #OwrMessageSubType of each message
+ * @data: (array length=n_messages) (transfer none): the data of each message, entries may be %NULL
+ * @user_data: (nullable): the data passed to owr_bus_set_message_batch_callback
+ *
+ * The tables are built from the #OwrMessageData of the messages, use
+ * owr_bus_set_message_data_batch_callback() to avoid that cost.
+ */
+
+/**
+ * owr_bus_set_message_batch_callback:
+ * @bus: an #OwrBus
+ * @callback: (scope notified)
+ * @user_data: (nullable): user data for @callback
+ * @destroy_data: (nullable): a #GDestroyNotify for @user_data
+ *
+ * Sets a callback that receives up to #OwrBus:max-batch-size queued messages per call.
+ * Replaces any other callback.
+ */
+void owr_bus_set_message_batch_callback(OwrBus *bus, OwrBusMessageBatchCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data)
+{
+    OwrBusPrivate *priv;
+
+    g_return_if_fail(OWR_IS_BUS(bus));
+    g_return_if_fail(callback);
+    priv = OWR_BUS_GET_PRIVATE(bus);
+
+    g_mutex_lock(&priv->callback_mutex);
+
+    if (priv->callback_destroy_data) {
+        priv->callback_destroy_data(priv->callback_user_data);
+    }
+    priv->callback_func = NULL;
+    priv->data_callback_func = NULL;
+    priv->batch_callback_func = callback;
+    priv->data_batch_callback_func = NULL;
     priv->callback_user_data = user_data;
     priv->callback_destroy_data = destroy_data;
 
     g_mutex_unlock(&priv->callback_mutex);
 }
 
+/**
+ * OwrBusMessageDataBatchCallback:
+ * @n_messages: the number of messages in the batch
+ * @origins: (array length=n_messages) (transfer none): the origins of the messages
+ * @types: (array length=n_messages): the #OwrMessageType of each message
+ * @sub_types: (array length=n_messages): the #OwrMessageSubType of each message
+ * @data: (array length=n_messages) (transfer none): the data of each message, entries may be %NULL
+ * @user_data: (nullable): the data passed to owr_bus_set_message_data_batch_callback
+ */
+
+/**
+ * owr_bus_set_message_data_batch_callback:
+ * @bus: an #OwrBus
+ * @callback: (scope notified)
+ * @user_data: (nullable): user data for @callback
+ * @destroy_data: (nullable): a #GDestroyNotify for @user_data
+ *
+ * Like owr_bus_set_message_batch_callback(), but the message data is passed as
+ * #OwrMessageData instead of #GHashTable. Replaces any other callback.
+ */
+void owr_bus_set_message_data_batch_callback(OwrBus *bus, OwrBusMessageDataBatchCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data)
+{
+    OwrBusPrivate *priv;
+
+    g_return_if_fail(OWR_IS_BUS(bus));
+    g_return_if_fail(callback);
+    priv = OWR_BUS_GET_PRIVATE(bus);
+
+    g_mutex_lock(&priv->callback_mutex);
+
+    if (priv->callback_destroy_data) {
+        priv->callback_destroy_data(priv->callback_user_data);
+    }
+    priv->callback_func = NULL;
+    priv->data_callback_func = NULL;
+    priv->batch_callback_func = NULL;
+    priv->data_batch_callback_func = callback;
+    priv->callback_user_data = user_data;
+    priv->callback_destroy_data = destroy_data;
+
+    g_mutex_unlock(&priv->callback_mutex);
+}
+
+/**
+ * owr_bus_set_drop_policy:
+ * @bus: an #OwrBus
+ * @message_types: the message types that the policy applies to
+ * @policy: what to do with messages of @message_types when the queue is full
+ *
+ * Sets what happens to messages of @message_types when #OwrBus:max-queue-length is reached.
+ * By default errors are never dropped, the oldest queued stats are dropped, and new events
+ * are dropped. Messages with the %OWR_BUS_DROP_POLICY_NEVER policy evict the oldest message
+ * that has the %OWR_BUS_DROP_POLICY_DROP_OLDEST policy, if there is one.
+ */
+void owr_bus_set_drop_policy(OwrBus *bus, OwrMessageType message_types, OwrBusDropPolicy policy)
+{
+    OwrBusPrivate *priv;
+    guint i;
+
+    g_return_if_fail(OWR_IS_BUS(bus));
+    priv = OWR_BUS_GET_PRIVATE(bus);
+
+    g_mutex_lock(&priv->queue_mutex);
+    for (i = 0; i < N_MESSAGE_TYPES; i++) {
+        if (message_types & (1 << i))
+            priv->drop_policies[i] = policy;
+    }
+    g_mutex_unlock(&priv->queue_mutex);
+}
+
+/**
+ * owr_bus_get_dropped_message_count:
+ * @bus: an #OwrBus
+ * @message_types: the message types to count
+ *
+ * Returns: the number of messages of @message_types that were dropped because the queue was full
+ */
+guint64 owr_bus_get_dropped_message_count(OwrBus *bus, OwrMessageType message_types)
+{
+    OwrBusPrivate *priv;
+    guint64 count = 0;
+    guint i;
+
+    g_return_val_if_fail(OWR_IS_BUS(bus), 0);
+    priv = OWR_BUS_GET_PRIVATE(bus);
+
+    g_mutex_lock(&priv->queue_mutex);
+    for (i = 0; i < N_MESSAGE_TYPES; i++) {
+        if (message_types & (1 << i))
+            count += priv->dropped_messages[i];
+    }
+    g_mutex_unlock(&priv->queue_mutex);
+
+    return count;
+}
+
 
 /**
  * owr_bus_add_message_origin:
@@ -247,6 +518,8 @@ void owr_bus_add_message_origin(OwrBus *bus, OwrMessageOrigin *origin)
     g_mutex_lock(&bus_set->mutex);
     g_hash_table_insert(bus_set->table, bus, ref);
     g_mutex_unlock(&bus_set->mutex);
+
+    owr_message_origin_bus_set_invalidate_all();
 }
 
 /**
@@ -271,6 +544,38 @@ void owr_bus_remove_message_origin(OwrBus *bus, OwrMessageOrigin *origin)
         GST_DEBUG_OBJECT(bus, "removed message origin %p", origin);
     }
     g_mutex_unlock(&bus_set->mutex);
+
+    owr_message_origin_bus_set_invalidate_all();
+}
+
+OwrMessageType _owr_bus_get_message_type_mask(OwrBus *bus)
+{
+    g_return_val_if_fail(OWR_IS_BUS(bus), 0);
+
+    return OWR_BUS_GET_PRIVATE(bus)->message_type_mask;
+}
+
+/* Must be called with the queue mutex held, returns TRUE if a message was evicted */
+static gboolean drop_oldest_message(OwrBusPrivate *priv, OwrMessageType type, gboolean any_droppable)
+{
+    GList *link;
+    OwrMessage *queued;
+    guint index;
+
+    for (link = priv->queue.head; link; link = link->next) {
+        queued = link->data;
+        index = message_type_index(queued->type);
+
+        if (any_droppable ? priv->drop_policies[index] == OWR_BUS_DROP_POLICY_DROP_OLDEST
+            : queued->type == type) {
+            g_queue_delete_link(&priv->queue, link);
+            priv->dropped_messages[index]++;
+            _owr_message_unref(queued);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
 
 /**
@@ -281,43 +586,134 @@ void owr_bus_remove_message_origin(OwrBus *bus, OwrMessageOrigin *origin)
 void _owr_bus_post_message(OwrBus *bus, OwrMessage *message)
 {
     OwrBusPrivate *priv;
+    guint index;
 
     g_return_if_fail(OWR_IS_BUS(bus));
     g_return_if_fail(message);
     priv = OWR_BUS_GET_PRIVATE(bus);
 
-    if (message->type & priv->message_type_mask) {
-        _owr_message_ref(message);
-        g_async_queue_push(priv->queue, message);
+    if (!(message->type & priv->message_type_mask))
+        return;
+
+    index = message_type_index(message->type);
+
+    g_mutex_lock(&priv->queue_mutex);
+
+    if (priv->max_queue_length && priv->queue.length >= priv->max_queue_length) {
+        switch (priv->drop_policies[index]) {
+        case OWR_BUS_DROP_POLICY_NEVER:
+            drop_oldest_message(priv, message->type, TRUE);
+            break;
+        case OWR_BUS_DROP_POLICY_DROP_OLDEST:
+            if (drop_oldest_message(priv, message->type, FALSE))
+                break;
+            /* fallthru */
+        case OWR_BUS_DROP_POLICY_DROP_NEWEST:
+            priv->dropped_messages[index]++;
+            g_mutex_unlock(&priv->queue_mutex);
+            GST_TRACE_OBJECT(bus, "queue full, dropping message %p", message);
+            return;
+        }
     }
+
+    _owr_message_ref(message);
+    g_queue_push_tail(&priv->queue, message);
+    g_cond_signal(&priv->queue_cond);
+
+    g_mutex_unlock(&priv->queue_mutex);
+}
+
+static void deliver_messages(OwrBusPrivate *priv, OwrMessage **batch, guint n_messages)
+{
+    guint i;
+
+    g_mutex_lock(&priv->callback_mutex);
+
+    if (priv->batch_callback_func || priv->data_batch_callback_func) {
+        OwrMessageOrigin **origins = g_newa(OwrMessageOrigin *, n_messages);
+        OwrMessageType *types = g_newa(OwrMessageType, n_messages);
+        OwrMessageSubType *sub_types = g_newa(OwrMessageSubType, n_messages);
+        gpointer *data = g_newa(gpointer, n_messages);
+
+        for (i = 0; i < n_messages; i++) {
+            origins[i] = batch[i]->origin;
+            types[i] = batch[i]->type;
+            sub_types[i] = batch[i]->sub_type;
+            if (priv->batch_callback_func)
+                data[i] = _owr_message_get_data(batch[i]);
+            else
+                data[i] = _owr_message_get_payload(batch[i]);
+        }
+        if (priv->batch_callback_func) {
+            priv->batch_callback_func(n_messages, origins, types, sub_types,
+                (GHashTable **)data, priv->callback_user_data);
+        } else {
+            priv->data_batch_callback_func(n_messages, origins, types, sub_types,
+                (OwrMessageData **)data, priv->callback_user_data);
+        }
+    } else if (priv->data_callback_func) {
+        for (i = 0; i < n_messages; i++) {
+            priv->data_callback_func(batch[i]->origin, batch[i]->type, batch[i]->sub_type,
+                _owr_message_get_payload(batch[i]), priv->callback_user_data);
+        }
+    } else if (priv->callback_func) {
+        for (i = 0; i < n_messages; i++) {
+            priv->callback_func(batch[i]->origin, batch[i]->type, batch[i]->sub_type,
+                _owr_message_get_data(batch[i]), priv->callback_user_data);
+        }
+    }
+
+    g_mutex_unlock(&priv->callback_mutex);
 }
 
 static gpointer bus_thread_func(OwrBus *bus)
 {
     OwrBusPrivate *priv;
-    OwrMessage *msg;
+    OwrMessage *batch[MAX_BATCH_SIZE_MAX];
+    guint n_messages, i;
 
     g_return_val_if_fail(OWR_IS_BUS(bus), NULL);
     priv = OWR_BUS_GET_PRIVATE(bus);
 
     GST_DEBUG("bus thread started");
 
-    while ((msg = g_async_queue_pop(priv->queue)) != &last_message) {
-        g_mutex_lock(&priv->callback_mutex);
-        if (priv->callback_func) {
-            priv->callback_func(msg->origin, msg->type, msg->sub_type, msg->data, priv->callback_user_data);
-        }
-        g_mutex_unlock(&priv->callback_mutex);
+    g_mutex_lock(&priv->queue_mutex);
+    for (;;) {
+        while (!priv->queue.length && !priv->stopping)
+            g_cond_wait(&priv->queue_cond, &priv->queue_mutex);
+
+        /* Messages posted before the bus was finalized are still delivered */
+        if (!priv->queue.length)
+            break;
+
+        for (n_messages = 0; n_messages < priv->max_batch_size && priv->queue.length; n_messages++)
+            batch[n_messages] = g_queue_pop_head(&priv->queue);
+        g_mutex_unlock(&priv->queue_mutex);
+
+        deliver_messages(priv, batch, n_messages);
 
-        _owr_message_unref(msg);
+        for (i = 0; i < n_messages; i++)
+            _owr_message_unref(batch[i]);
+
+        g_mutex_lock(&priv->queue_mutex);
     }
+    g_mutex_unlock(&priv->queue_mutex);
 
     GST_DEBUG("exiting bus thread");
 
     return NULL;
 }
 
-OwrMessage *_owr_message_new(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data)
+/**
+ * _owr_message_new:
+ * @origin: (transfer none): the origin of the message
+ * @type: the #OwrMessageType of the message
+ * @sub_type: the #OwrMessageSubType of the message
+ * @payload: (transfer full) (nullable): the data of the message
+ * @data: (transfer full) (nullable): the data of the message in table form
+ */
+OwrMessage *_owr_message_new(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type,
+    OwrMessageData *payload, GHashTable *data)
 {
     OwrMessage *message;
 
@@ -325,12 +721,57 @@ OwrMessage *_owr_message_new(OwrMessageOrigin *origin, OwrMessageType type, OwrM
     message->origin = g_object_ref(origin);
     message->type = type;
     message->sub_type = sub_type;
+    message->payload = payload;
     message->data = data;
     message->ref_count = 1;
 
     return message;
 }
 
+/* A message can be delivered by several bus threads at once, so the missing
+ * form of the data is built without a lock and the first one stored wins */
+OwrMessageData *_owr_message_get_payload(OwrMessage *message)
+{
+    OwrMessageData *payload;
+    GHashTable *data;
+
+    g_return_val_if_fail(message, NULL);
+
+    payload = g_atomic_pointer_get(&message->payload);
+    data = g_atomic_pointer_get(&message->data);
+    if (payload || !data)
+        return payload;
+
+    payload = _owr_message_data_new_from_hash_table(data);
+    if (!g_atomic_pointer_compare_and_exchange(&message->payload, NULL, payload)) {
+        owr_message_data_unref(payload);
+        payload = g_atomic_pointer_get(&message->payload);
+    }
+
+    return payload;
+}
+
+GHashTable *_owr_message_get_data(OwrMessage *message)
+{
+    OwrMessageData *payload;
+    GHashTable *data;
+
+    g_return_val_if_fail(message, NULL);
+
+    payload = g_atomic_pointer_get(&message->payload);
+    data = g_atomic_pointer_get(&message->data);
+    if (data || !payload)
+        return data;
+
+    data = owr_message_data_to_hash_table(payload);
+    if (!g_atomic_pointer_compare_and_exchange(&message->data, NULL, data)) {
+        g_hash_table_unref(data);
+        data = g_atomic_pointer_get(&message->data);
+    }
+
+    return data;
+}
+
 void _owr_message_unref(OwrMessage *message)
 {
     g_return_if_fail(message);
@@ -338,6 +779,8 @@ void _owr_message_unref(OwrMessage *message)
 
     if (g_atomic_int_dec_and_test(&message->ref_count)) {
         GST_TRACE("freeing message: %p", message);
+        if (message->payload)
+            owr_message_data_unref(message->payload);
         if (message->data)
             g_hash_table_unref(message->data);
         g_slice_free(OwrMessage, message);
@@ -369,6 +812,24 @@ GType owr_message_type_get_type(void)
     return id;
 }
 
+GType owr_bus_drop_policy_get_type(void)
+{
+    static const GEnumValue types[] = {
+        {OWR_BUS_DROP_POLICY_NEVER, "Never drop", "never"},
+        {OWR_BUS_DROP_POLICY_DROP_NEWEST, "Drop the newest message", "drop-newest"},
+        {OWR_BUS_DROP_POLICY_DROP_OLDEST, "Drop the oldest message", "drop-oldest"},
+        {0, NULL, NULL}
+    };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *)&id)) {
+        GType _id = g_enum_register_static("OwrBusDropPolicies", types);
+        g_once_init_leave((gsize *)&id, _id);
+    }
+
+    return id;
+}
+
 GType owr_message_sub_type_get_type(void)
 {
     static const GEnumValue types[] = {
@@ -378,11 +839,13 @@ GType owr_message_sub_type_get_type(void)
         {OWR_STATS_TYPE_SCHEDULE, "Schedule", "schedule"},
         {OWR_STATS_TYPE_SEND_PIPELINE_ADDED, "Send pipeline added", "send-pipeline-added"},
         {OWR_STATS_TYPE_SEND_PIPELINE_REMOVED, "Send pipeline removed", "send-pipeline-removed"},
+        {OWR_STATS_TYPE_SOURCE_LINK, "Source link", "source-link"},
         {OWR_EVENT_TYPE_TEST, "Event Test", "event-test"},
         {OWR_EVENT_TYPE_RENDERER_STARTED, "Renderer started", "renderer-started"},
         {OWR_EVENT_TYPE_RENDERER_STOPPED, "Renderer stopped", "renderer-stopped"},
         {OWR_EVENT_TYPE_LOCAL_SOURCE_STARTED, "Local source started", "local-source-started"},
         {OWR_EVENT_TYPE_LOCAL_SOURCE_STOPPED, "Local source stopped", "local-source-stopped"},
+        {OWR_EVENT_TYPE_VOICE_ACTIVITY, "Voice activity", "voice-activity"},
         {0, NULL, NULL}
     };
     static volatile GType id = 0;
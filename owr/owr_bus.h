@@ -30,6 +30,7 @@
 #ifndef __OWR_BUS_H__
 #define __OWR_BUS_H__
 
+#include "owr_message_data.h"
 #include "owr_message_origin.h"
 #include "owr_types.h"
 
@@ -63,6 +64,14 @@ typedef enum {
  * - @start_time: #gint64 monotonic time when the pipeline teardown began
  * - @end_time: #gint64 monotonic time when the pipeline teardown was completed
  *
+ * @OWR_STATS_TYPE_SOURCE_LINK: counters of the link between a media source and a consumer,
+ * posted when the consumer releases the source
+ * - @policy: #utf8 nick of the #OwrLinkPolicy of the link
+ * - @max_depth: #guint64 buffers the consumer may queue, 0 if the queue defaults are used
+ * - @pushed: #guint64 buffers handed to the consumer
+ * - @dropped: #guint64 buffers leaked by the policy or refused by the consumer
+ * - @max_latency: #gint64 longest time in microseconds a buffer was queued for the consumer
+ *
  * @OWR_EVENT_TYPE_RENDERER_STARTED: a renderer was started
  *
  * @OWR_EVENT_TYPE_RENDERER_STOPPED: a renderer was stopped
@@ -74,6 +83,12 @@ typedef enum {
  * @OWR_EVENT_TYPE_LOCAL_SOURCE_STOPPED: a local media source was stopped
  * - @start_time: #gint64 monotonic time when the pipeline teardown began
  * - @end_time: #gint64 monotonic time when the pipeline teardown was completed
+ *
+ * @OWR_EVENT_TYPE_VOICE_ACTIVITY: the voice activity flag of the RFC 6464 audio level
+ * received in a media session changed, see #OwrMediaSession:audio-level-extension-id
+ * - @ssrc: #guint64 ssrc of the RTP stream
+ * - @level: #guint64 audio level in -dBov, 127 for silence
+ * - @voice: #gboolean whether the sender detected voice
  */
 typedef enum {
     OWR_ERROR_TYPE_TEST = 0x1000,
@@ -82,14 +97,25 @@ typedef enum {
     OWR_STATS_TYPE_SCHEDULE,
     OWR_STATS_TYPE_SEND_PIPELINE_ADDED,
     OWR_STATS_TYPE_SEND_PIPELINE_REMOVED,
+    OWR_STATS_TYPE_SOURCE_LINK,
     OWR_EVENT_TYPE_TEST = 0x3000,
     OWR_EVENT_TYPE_RENDERER_STARTED,
     OWR_EVENT_TYPE_RENDERER_STOPPED,
     OWR_EVENT_TYPE_LOCAL_SOURCE_STARTED,
     OWR_EVENT_TYPE_LOCAL_SOURCE_STOPPED,
+    OWR_EVENT_TYPE_VOICE_ACTIVITY,
 } OwrMessageSubType;
 
+typedef enum {
+    OWR_BUS_DROP_POLICY_NEVER,
+    OWR_BUS_DROP_POLICY_DROP_NEWEST,
+    OWR_BUS_DROP_POLICY_DROP_OLDEST
+} OwrBusDropPolicy;
+
 typedef void (*OwrBusMessageCallback) (OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data, gpointer user_data);
+typedef void (*OwrBusMessageDataCallback) (OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, OwrMessageData *data, gpointer user_data);
+typedef void (*OwrBusMessageBatchCallback) (guint n_messages, OwrMessageOrigin **origins, OwrMessageType *types, OwrMessageSubType *sub_types, GHashTable **data, gpointer user_data);
+typedef void (*OwrBusMessageDataBatchCallback) (guint n_messages, OwrMessageOrigin **origins, OwrMessageType *types, OwrMessageSubType *sub_types, OwrMessageData **data, gpointer user_data);
 
 #define OWR_TYPE_MESSAGE_TYPE (owr_message_type_get_type())
 GType owr_message_type_get_type(void);
@@ -97,6 +123,9 @@ GType owr_message_type_get_type(void);
 #define OWR_TYPE_MESSAGE_SUB_TYPE (owr_message_sub_type_get_type())
 GType owr_message_sub_type_get_type(void);
 
+#define OWR_TYPE_BUS_DROP_POLICY (owr_bus_drop_policy_get_type())
+GType owr_bus_drop_policy_get_type(void);
+
 #define OWR_TYPE_BUS            (owr_bus_get_type())
 #define OWR_BUS(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), OWR_TYPE_BUS, OwrBus))
 #define OWR_BUS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), OWR_TYPE_BUS, OwrBusClass))
@@ -126,8 +155,16 @@ GType owr_bus_get_type(void) G_GNUC_CONST;
 OwrBus *owr_bus_new();
 void owr_bus_set_message_callback(OwrBus *bus, OwrBusMessageCallback callback,
     gpointer user_data, GDestroyNotify destroy_data);
+void owr_bus_set_message_data_callback(OwrBus *bus, OwrBusMessageDataCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data);
+void owr_bus_set_message_batch_callback(OwrBus *bus, OwrBusMessageBatchCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data);
+void owr_bus_set_message_data_batch_callback(OwrBus *bus, OwrBusMessageDataBatchCallback callback,
+    gpointer user_data, GDestroyNotify destroy_data);
 void owr_bus_add_message_origin(OwrBus *bus, OwrMessageOrigin *origin);
 void owr_bus_remove_message_origin(OwrBus *bus, OwrMessageOrigin *origin);
+void owr_bus_set_drop_policy(OwrBus *bus, OwrMessageType message_types, OwrBusDropPolicy policy);
+guint64 owr_bus_get_dropped_message_count(OwrBus *bus, OwrMessageType message_types);
 
 G_END_DECLS
 
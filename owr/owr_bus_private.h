@@ -31,6 +31,7 @@
 #define __OWR_BUS_PRIVATE_H__
 
 #include "owr_bus.h"
+#include "owr_message_data.h"
 
 #ifndef __GTK_DOC_IGNORE__
 
@@ -40,12 +41,19 @@ typedef struct {
     OwrMessageOrigin *origin;
     OwrMessageType type;
     OwrMessageSubType sub_type;
+    /* At least one of these is set when the message has data, the other
+     * one is built on first use by _owr_message_get_data/_get_payload */
+    OwrMessageData *payload;
     GHashTable *data;
     volatile guint ref_count;
 } OwrMessage;
 
 void _owr_bus_post_message(OwrBus *bus, OwrMessage *message);
-OwrMessage *_owr_message_new(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data);
+OwrMessageType _owr_bus_get_message_type_mask(OwrBus *bus);
+OwrMessage *_owr_message_new(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type,
+    OwrMessageData *payload, GHashTable *data);
+OwrMessageData *_owr_message_get_payload(OwrMessage *message);
+GHashTable *_owr_message_get_data(OwrMessage *message);
 void _owr_message_ref(OwrMessage *message);
 void _owr_message_unref(OwrMessage *message);
 
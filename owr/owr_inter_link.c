@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2015 Centricular Ltd.
+ *     Author: Sebastian Dröge <sebastian@centricular.com>
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_inter_link.h"
+
+static void peer_set_pad(OwrInterPeer *peer, GstPad *pad)
+{
+    GstPad *old_pad;
+
+    if (pad)
+        gst_object_ref(pad);
+
+    do {
+        old_pad = g_atomic_pointer_get(&peer->pad);
+    } while (!g_atomic_pointer_compare_and_exchange(&peer->pad, old_pad, pad));
+
+    if (!old_pad)
+        return;
+
+    /* A reader that loaded old_pad before the swap may not have taken its
+     * ref yet, that window is a few instructions long */
+    while (g_atomic_int_get(&peer->readers))
+        g_thread_yield();
+
+    gst_object_unref(old_pad);
+}
+
+/**
+ * _owr_inter_peer_get_pad:
+ * @peer: one direction of an #OwrInterLink
+ *
+ * Takes no lock, so it is cheap enough to call for every buffer.
+ *
+ * Returns: (transfer full) (nullable): the pad at the other end, or %NULL if unlinked
+ */
+GstPad *_owr_inter_peer_get_pad(OwrInterPeer *peer)
+{
+    GstPad *pad;
+
+    g_atomic_int_inc(&peer->readers);
+    pad = g_atomic_pointer_get(&peer->pad);
+    if (pad)
+        gst_object_ref(pad);
+    g_atomic_int_add(&peer->readers, -1);
+
+    return pad;
+}
+
+OwrInterLink *_owr_inter_link_new(GstPad *src_srcpad, GstPad *sink_sinkpad)
+{
+    OwrInterLink *link;
+
+    g_return_val_if_fail(GST_IS_PAD(src_srcpad), NULL);
+    g_return_val_if_fail(GST_IS_PAD(sink_sinkpad), NULL);
+
+    link = g_slice_new0(OwrInterLink);
+    link->ref_count = 1;
+    peer_set_pad(&link->src_srcpad, src_srcpad);
+    peer_set_pad(&link->sink_sinkpad, sink_sinkpad);
+
+    return link;
+}
+
+OwrInterLink *_owr_inter_link_ref(OwrInterLink *link)
+{
+    g_return_val_if_fail(link, NULL);
+
+    g_atomic_int_inc(&link->ref_count);
+
+    return link;
+}
+
+void _owr_inter_link_unref(OwrInterLink *link)
+{
+    g_return_if_fail(link);
+
+    if (!g_atomic_int_dec_and_test(&link->ref_count))
+        return;
+
+    _owr_inter_link_clear(link);
+    g_slice_free(OwrInterLink, link);
+}
+
+void _owr_inter_link_clear(OwrInterLink *link)
+{
+    g_return_if_fail(link);
+
+    peer_set_pad(&link->src_srcpad, NULL);
+    peer_set_pad(&link->sink_sinkpad, NULL);
+}
+
+/* Called from the sink streaming thread before a buffer is pushed into the
+ * src queue */
+void _owr_inter_link_buffer_entered(OwrInterLink *link, GstBuffer *buffer)
+{
+    OwrInterLinkEntry *entry;
+    guint head, tail;
+
+    g_atomic_int_inc(&link->pushed);
+
+    head = g_atomic_int_get(&link->entries_head);
+    tail = link->entries_tail;
+
+    /* Untracked buffers are still counted, they just don't add to latency */
+    if (tail - head >= OWR_INTER_LINK_TRACKED_BUFFERS)
+        return;
+
+    entry = &link->entries[tail % OWR_INTER_LINK_TRACKED_BUFFERS];
+    entry->buffer = buffer;
+    entry->pts = GST_BUFFER_PTS(buffer);
+    entry->time = g_get_monotonic_time();
+    g_atomic_int_set(&link->entries_tail, tail + 1);
+}
+
+/* Called from the src queue thread when a buffer leaves the queue. Entries
+ * in front of the matching one belong to buffers that were leaked */
+void _owr_inter_link_buffer_left(OwrInterLink *link, GstBuffer *buffer)
+{
+    OwrInterLinkEntry *entry;
+    guint head, tail, i;
+    gint latency, max_latency;
+
+    head = link->entries_head;
+    tail = g_atomic_int_get(&link->entries_tail);
+
+    for (i = head; i != tail; i++) {
+        entry = &link->entries[i % OWR_INTER_LINK_TRACKED_BUFFERS];
+        if (entry->buffer != buffer || entry->pts != GST_BUFFER_PTS(buffer))
+            continue;
+
+        latency = (gint) MIN(g_get_monotonic_time() - entry->time, G_MAXINT);
+        do {
+            max_latency = g_atomic_int_get(&link->max_latency);
+        } while (latency > max_latency
+            && !g_atomic_int_compare_and_exchange(&link->max_latency, max_latency, latency));
+
+        g_atomic_int_set(&link->entries_head, i + 1);
+        return;
+    }
+
+    /* Not tracked, make room in case the ring is full of leaked entries */
+    if (tail - head >= OWR_INTER_LINK_TRACKED_BUFFERS)
+        g_atomic_int_set(&link->entries_head, head + 1);
+}
+
+void _owr_inter_link_buffers_dropped(OwrInterLink *link, guint n_buffers)
+{
+    g_atomic_int_add(&link->dropped, n_buffers);
+}
+
+/**
+ * _owr_inter_link_get_counters:
+ * @link:
+ * @pushed: (out): buffers handed to the src side
+ * @dropped: (out): buffers leaked by the policy or refused by the src side
+ * @max_latency: (out): longest time in microseconds a buffer spent queued
+ */
+void _owr_inter_link_get_counters(OwrInterLink *link, guint *pushed, guint *dropped, gint64 *max_latency)
+{
+    g_return_if_fail(link);
+
+    if (pushed)
+        *pushed = g_atomic_int_get(&link->pushed);
+    if (dropped)
+        *dropped = g_atomic_int_get(&link->dropped);
+    if (max_latency)
+        *max_latency = g_atomic_int_get(&link->max_latency);
+}
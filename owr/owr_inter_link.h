@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 Centricular Ltd.
+ *     Author: Sebastian Dröge <sebastian@centricular.com>
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __OWR_INTER_LINK_H__
+#define __OWR_INTER_LINK_H__
+
+#include "owr_types.h"
+
+#include <gst/gst.h>
+
+#ifndef __GTK_DOC_IGNORE__
+
+G_BEGIN_DECLS
+
+/* One direction of the link: a strong pad reference that is swapped
+ * atomically, readers only hold it long enough to take their own ref */
+typedef struct {
+    GstPad *pad;
+    volatile gint readers;
+} OwrInterPeer;
+
+#define OWR_INTER_LINK_TRACKED_BUFFERS 64
+
+typedef struct {
+    gconstpointer buffer;
+    GstClockTime pts;
+    gint64 time;
+} OwrInterLinkEntry;
+
+/* Shared by an OwrInterSink and its OwrInterSrc. Either side clears it when
+ * it is disposed, so the pads are only dropped on unlink */
+typedef struct {
+    volatile gint ref_count;
+    OwrInterPeer src_srcpad;
+    OwrInterPeer sink_sinkpad;
+
+    OwrLinkPolicy policy;
+    guint max_depth;
+
+    volatile gint pushed;
+    volatile gint dropped;
+    volatile gint max_latency;
+
+    /* Entry times of queued buffers. Only the sink streaming thread appends
+     * and only the src queue thread consumes, so no lock is needed */
+    OwrInterLinkEntry entries[OWR_INTER_LINK_TRACKED_BUFFERS];
+    volatile guint entries_head;
+    volatile guint entries_tail;
+} OwrInterLink;
+
+OwrInterLink *_owr_inter_link_new(GstPad *src_srcpad, GstPad *sink_sinkpad);
+OwrInterLink *_owr_inter_link_ref(OwrInterLink *link);
+void _owr_inter_link_unref(OwrInterLink *link);
+void _owr_inter_link_clear(OwrInterLink *link);
+GstPad *_owr_inter_peer_get_pad(OwrInterPeer *peer);
+
+void _owr_inter_link_buffer_entered(OwrInterLink *link, GstBuffer *buffer);
+void _owr_inter_link_buffer_left(OwrInterLink *link, GstBuffer *buffer);
+void _owr_inter_link_buffers_dropped(OwrInterLink *link, guint n_buffers);
+void _owr_inter_link_get_counters(OwrInterLink *link, guint *pushed, guint *dropped, gint64 *max_latency);
+
+G_END_DECLS
+
+#endif /* __GTK_DOC_IGNORE__ */
+
+#endif /* __OWR_INTER_LINK_H__ */
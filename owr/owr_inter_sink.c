@@ -29,6 +29,13 @@
 #endif
 #include "owr_inter_sink.h"
 
+#include <gst/video/video.h>
+#include <gst/video/gstvideopool.h>
+
+/* Planes and strides are aligned to 32 bytes for SIMD code and encoders */
+#define VIDEO_ALIGN 31
+#define POOL_MIN_BUFFERS 2
+
 #define GST_CAT_DEFAULT owr_inter_sink_debug
 GST_DEBUG_CATEGORY_STATIC(GST_CAT_DEFAULT);
 
@@ -54,16 +61,21 @@ static gboolean owr_inter_sink_sink_event(GstPad *pad, GstObject *parent,
     GstEvent *event);
 
 static GstStateChangeReturn owr_inter_sink_change_state(GstElement *element, GstStateChange transition);
+static void owr_inter_sink_dispose(GObject *object);
 
 static void owr_inter_sink_class_init(OwrInterSinkClass *klass)
 {
+    GObjectClass *gobject_class;
     GstElementClass *gstelement_class;
 
     GST_DEBUG_CATEGORY_INIT(owr_inter_sink_debug, "owr_inter_sink", 0,
         "Owr Inter Sink");
 
+    gobject_class = (GObjectClass *) klass;
     gstelement_class = (GstElementClass *) klass;
 
+    gobject_class->dispose = owr_inter_sink_dispose;
+
     gstelement_class->change_state = owr_inter_sink_change_state;
 
     gst_element_class_add_pad_template(gstelement_class,
@@ -82,6 +94,32 @@ static void owr_inter_sink_init(OwrInterSink *self)
     gst_pad_set_query_function(self->sinkpad,
         GST_DEBUG_FUNCPTR(owr_inter_sink_sink_query));
     gst_element_add_pad(GST_ELEMENT(self), self->sinkpad);
+
+    self->link = NULL;
+    self->pool = NULL;
+}
+
+static void owr_inter_sink_dispose(GObject *object)
+{
+    OwrInterSink *self = OWR_INTER_SINK(object);
+
+    if (self->link) {
+        _owr_inter_link_clear(self->link);
+        _owr_inter_link_unref(self->link);
+        self->link = NULL;
+    }
+
+    if (self->pool) {
+        gst_object_unref(self->pool);
+        self->pool = NULL;
+    }
+
+    G_OBJECT_CLASS(owr_inter_sink_parent_class)->dispose(object);
+}
+
+static inline GstPad *get_src_srcpad(OwrInterSink *self)
+{
+    return self->link ? _owr_inter_peer_get_pad(&self->link->src_srcpad) : NULL;
 }
 
 static GstStateChangeReturn owr_inter_sink_change_state(GstElement *element, GstStateChange transition)
@@ -102,6 +140,81 @@ static GstStateChangeReturn owr_inter_sink_change_state(GstElement *element, Gst
     return ret;
 }
 
+/* Fills in what the consumer side left out of an allocation query for raw
+ * video in system memory: video meta, so strided frames can be passed
+ * through, and an aligned pool that is kept across renegotiations.
+ * Only the converters of the branch in front of this sink allocate from the
+ * pool. The capture element sits upstream of the source tee and the branch
+ * queues and keeps allocating its own buffers */
+static gboolean propose_allocation(OwrInterSink *self, GstQuery *query)
+{
+    GstCaps *caps, *pool_caps = NULL;
+    GstCapsFeatures *features;
+    GstStructure *config;
+    GstVideoInfo info;
+    GstVideoAlignment align;
+    GstAllocationParams params;
+    gboolean need_pool;
+    guint i;
+
+    gst_query_parse_allocation(query, &caps, &need_pool);
+    if (!caps || gst_caps_is_empty(caps))
+        return FALSE;
+
+    features = gst_caps_get_features(caps, 0);
+    if (features && !gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY))
+        return FALSE;
+    if (!gst_video_info_from_caps(&info, caps))
+        return FALSE;
+
+    if (!gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL))
+        gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+
+    if (!need_pool || gst_query_get_n_allocation_pools(query))
+        return TRUE;
+
+    gst_video_alignment_reset(&align);
+    for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+        align.stride_align[i] = VIDEO_ALIGN;
+    gst_video_info_align(&info, &align);
+
+    gst_allocation_params_init(&params);
+    params.align = VIDEO_ALIGN;
+
+    if (self->pool) {
+        config = gst_buffer_pool_get_config(self->pool);
+        gst_buffer_pool_config_get_params(config, &pool_caps, NULL, NULL, NULL);
+        if (!pool_caps || !gst_caps_is_equal(pool_caps, caps)) {
+            gst_object_unref(self->pool);
+            self->pool = NULL;
+        }
+        gst_structure_free(config);
+    }
+
+    if (!self->pool) {
+        GST_DEBUG_OBJECT(self, "Proposing a new pool for %" GST_PTR_FORMAT, caps);
+
+        self->pool = gst_video_buffer_pool_new();
+        config = gst_buffer_pool_get_config(self->pool);
+        gst_buffer_pool_config_set_params(config, caps, info.size, POOL_MIN_BUFFERS, 0);
+        gst_buffer_pool_config_set_allocator(config, NULL, &params);
+        gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+        gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+        gst_buffer_pool_config_set_video_alignment(config, &align);
+        if (!gst_buffer_pool_set_config(self->pool, config)) {
+            GST_WARNING_OBJECT(self, "Failed to configure pool");
+            gst_object_unref(self->pool);
+            self->pool = NULL;
+            return TRUE;
+        }
+    }
+
+    gst_query_add_allocation_pool(query, self->pool, info.size, POOL_MIN_BUFFERS, 0);
+    gst_query_add_allocation_param(query, NULL, &params);
+
+    return TRUE;
+}
+
 static gboolean owr_inter_sink_sink_query(GstPad *pad, GstObject *parent,
     GstQuery *query)
 {
@@ -112,12 +225,17 @@ static gboolean owr_inter_sink_sink_query(GstPad *pad, GstObject *parent,
     GST_LOG_OBJECT(pad, "Handling query of type '%s'",
         gst_query_type_get_name(GST_QUERY_TYPE(query)));
 
-    otherpad = g_weak_ref_get(&self->src_srcpad);
+    otherpad = get_src_srcpad(self);
     if (otherpad) {
         ret = gst_pad_peer_query(otherpad, query);
         gst_object_unref(otherpad);
     }
 
+    /* The consumer pipeline may not be able to answer, e.g. before it is
+     * started, the source should still get a pool that fits */
+    if (GST_QUERY_TYPE(query) == GST_QUERY_ALLOCATION && propose_allocation(self, query))
+        ret = TRUE;
+
     return ret;
 }
 
@@ -148,7 +266,7 @@ static gboolean owr_inter_sink_sink_event(GstPad *pad, GstObject *parent,
     if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
         self->pending_sticky_events = FALSE;
 
-    otherpad = g_weak_ref_get(&self->src_srcpad);
+    otherpad = get_src_srcpad(self);
     if (otherpad) {
         if (sticky && self->pending_sticky_events) {
             CopyStickyEventsData data = { otherpad, GST_FLOW_OK };
@@ -170,6 +288,23 @@ static gboolean owr_inter_sink_sink_event(GstPad *pad, GstObject *parent,
     return ret;
 }
 
+/* Failures on the consumer side are counted as drops but not returned
+ * upstream, that would stop the source and all its other consumers */
+static GstFlowReturn handle_consumer_flow(OwrInterSink *self, GstPad *pad, GstFlowReturn ret,
+    guint n_buffers)
+{
+    if (ret == GST_FLOW_OK)
+        return ret;
+
+    if (self->link)
+        _owr_inter_link_buffers_dropped(self->link, n_buffers);
+
+    if (ret < GST_FLOW_EOS)
+        GST_WARNING_OBJECT(pad, "Consumer failed to handle data: %s", gst_flow_get_name(ret));
+
+    return GST_FLOW_OK;
+}
+
 static GstFlowReturn owr_inter_sink_sink_chain(GstPad *pad, GstObject *parent,
     GstBuffer *buffer)
 {
@@ -179,7 +314,7 @@ static GstFlowReturn owr_inter_sink_sink_chain(GstPad *pad, GstObject *parent,
 
     GST_LOG_OBJECT(pad, "Chaining buffer %p", buffer);
 
-    otherpad = g_weak_ref_get(&self->src_srcpad);
+    otherpad = get_src_srcpad(self);
     if (otherpad) {
         if (self->pending_sticky_events) {
             CopyStickyEventsData data = { otherpad, GST_FLOW_OK };
@@ -188,14 +323,17 @@ static GstFlowReturn owr_inter_sink_sink_chain(GstPad *pad, GstObject *parent,
             self->pending_sticky_events = data.ret != GST_FLOW_OK;
         }
 
+        _owr_inter_link_buffer_entered(self->link, buffer);
         ret = gst_pad_push(otherpad, buffer);
         gst_object_unref(otherpad);
-    } else
+    } else {
         gst_buffer_unref(buffer);
+        ret = GST_FLOW_NOT_LINKED;
+    }
 
     GST_LOG_OBJECT(pad, "Chained buffer %p: %s", buffer, gst_flow_get_name(ret));
 
-    return GST_FLOW_OK;
+    return handle_consumer_flow(self, pad, ret, 1);
 }
 
 static GstFlowReturn owr_inter_sink_sink_chain_list(GstPad *pad, GstObject *parent,
@@ -204,10 +342,11 @@ static GstFlowReturn owr_inter_sink_sink_chain_list(GstPad *pad, GstObject *pare
     OwrInterSink *self = OWR_INTER_SINK(parent);
     GstPad *otherpad;
     GstFlowReturn ret = GST_FLOW_OK;
+    guint i, n_buffers = gst_buffer_list_length(list);
 
     GST_LOG_OBJECT(pad, "Chaining buffer list %p", list);
 
-    otherpad = g_weak_ref_get(&self->src_srcpad);
+    otherpad = get_src_srcpad(self);
     if (otherpad) {
         if (self->pending_sticky_events) {
             CopyStickyEventsData data = { otherpad, GST_FLOW_OK };
@@ -216,12 +355,16 @@ static GstFlowReturn owr_inter_sink_sink_chain_list(GstPad *pad, GstObject *pare
             self->pending_sticky_events = data.ret != GST_FLOW_OK;
         }
 
+        for (i = 0; i < n_buffers; i++)
+            _owr_inter_link_buffer_entered(self->link, gst_buffer_list_get(list, i));
         ret = gst_pad_push_list(otherpad, list);
         gst_object_unref(otherpad);
-    } else
+    } else {
         gst_buffer_list_unref(list);
+        ret = GST_FLOW_NOT_LINKED;
+    }
 
     GST_LOG_OBJECT(pad, "Chained buffer list %p: %s", list, gst_flow_get_name(ret));
 
-    return GST_FLOW_OK;
+    return handle_consumer_flow(self, pad, ret, n_buffers);
 }
@@ -27,6 +27,8 @@
 #ifndef __OWR_INTER_SINK_H__
 #define __OWR_INTER_SINK_H__
 
+#include "owr_inter_link.h"
+
 #include <gst/gst.h>
 
 #ifndef __GTK_DOC_IGNORE__
@@ -47,8 +49,11 @@ struct _OwrInterSink {
     GstElement parent;
 
     GstPad *sinkpad;
-    GWeakRef src_srcpad;
+    OwrInterLink *link;
     gboolean pending_sticky_events;
+
+    /* Proposed upstream when the consumer side doesn't provide a pool */
+    GstBufferPool *pool;
 };
 
 struct _OwrInterSinkClass {
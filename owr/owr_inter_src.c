@@ -51,6 +51,9 @@ static gboolean owr_inter_src_internal_src_event(GstPad *pad, GstObject *parent,
 static GstStateChangeReturn owr_inter_src_change_state(GstElement *element, GstStateChange transition);
 static void owr_inter_src_dispose(GObject *object);
 
+static GstPadProbeReturn queue_src_probe(GstPad *pad, GstPadProbeInfo *info, OwrInterSrc *self);
+static void on_queue_overrun(GstElement *queue, OwrInterSrc *self);
+
 static void owr_inter_src_class_init(OwrInterSrcClass *klass)
 {
     GObjectClass *gobject_class;
@@ -77,8 +80,11 @@ static void owr_inter_src_init(OwrInterSrc *self)
 
     self->queue = gst_element_factory_make("queue", NULL);
     gst_bin_add(GST_BIN(self), self->queue);
+    g_signal_connect(self->queue, "overrun", G_CALLBACK(on_queue_overrun), self);
 
     srcpad = gst_element_get_static_pad(self->queue, "src");
+    gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback) queue_src_probe, self, NULL);
     self->srcpad = gst_ghost_pad_new_from_template("src", srcpad, gst_static_pad_template_get(&src_template));
     gst_object_unref(srcpad);
 
@@ -96,12 +102,21 @@ static void owr_inter_src_init(OwrInterSrc *self)
     sinkpad = gst_element_get_static_pad(self->queue, "sink");
     gst_pad_link(self->internal_srcpad, sinkpad);
     gst_object_unref(sinkpad);
+
+    self->link = NULL;
 }
 
 static void owr_inter_src_dispose(GObject *object)
 {
     OwrInterSrc *self = OWR_INTER_SRC(object);
 
+    /* The link holds a ref to internal_srcpad, drop it before unparenting */
+    if (self->link) {
+        _owr_inter_link_clear(self->link);
+        _owr_inter_link_unref(self->link);
+        self->link = NULL;
+    }
+
     gst_object_unparent(GST_OBJECT(self->dummy_sinkpad));
     self->dummy_sinkpad = NULL;
 
@@ -148,7 +163,7 @@ static gboolean owr_inter_src_internal_src_query(GstPad *pad, GstObject *parent,
     GST_LOG_OBJECT(pad, "Handling query of type '%s'",
         gst_query_type_get_name(GST_QUERY_TYPE(query)));
 
-    otherpad = g_weak_ref_get(&self->sink_sinkpad);
+    otherpad = self->link ? _owr_inter_peer_get_pad(&self->link->sink_sinkpad) : NULL;
     if (otherpad) {
         ret = gst_pad_peer_query(otherpad, query);
         gst_object_unref(otherpad);
@@ -171,7 +186,7 @@ static gboolean owr_inter_src_internal_src_event(GstPad *pad, GstObject *parent,
 
     GST_LOG_OBJECT(pad, "Got %s event", GST_EVENT_TYPE_NAME(event));
 
-    otherpad = g_weak_ref_get(&self->sink_sinkpad);
+    otherpad = self->link ? _owr_inter_peer_get_pad(&self->link->sink_sinkpad) : NULL;
     if (otherpad) {
         ret = gst_pad_push_event(otherpad, event);
         gst_object_unref(otherpad);
@@ -183,3 +198,61 @@ static gboolean owr_inter_src_internal_src_event(GstPad *pad, GstObject *parent,
 
     return ret;
 }
+
+static GstPadProbeReturn queue_src_probe(G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info, OwrInterSrc *self)
+{
+    GstBufferList *list;
+    guint i, n_buffers;
+
+    if (!self->link)
+        return GST_PAD_PROBE_OK;
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        _owr_inter_link_buffer_left(self->link, GST_PAD_PROBE_INFO_BUFFER(info));
+    } else {
+        list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        n_buffers = gst_buffer_list_length(list);
+        for (i = 0; i < n_buffers; i++)
+            _owr_inter_link_buffer_left(self->link, gst_buffer_list_get(list, i));
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+/* The queue signals an overrun right before it leaks an item */
+static void on_queue_overrun(G_GNUC_UNUSED GstElement *queue, OwrInterSrc *self)
+{
+    if (self->link && self->link->policy != OWR_LINK_POLICY_BLOCK)
+        _owr_inter_link_buffers_dropped(self->link, 1);
+}
+
+/**
+ * _owr_inter_src_set_link_policy:
+ * @self:
+ * @policy: what to do when the consumer side has @max_depth buffers queued
+ * @max_depth: number of buffers to queue, 0 keeps the queue defaults
+ *
+ * Must be called after the link is set and before data flows.
+ */
+void _owr_inter_src_set_link_policy(OwrInterSrc *self, OwrLinkPolicy policy, guint max_depth)
+{
+    /* Values of the queue's GstQueueLeaky enum */
+    static const gint leaky[] = {
+        [OWR_LINK_POLICY_BLOCK] = 0,
+        [OWR_LINK_POLICY_LEAK_OLDEST] = 2,
+        [OWR_LINK_POLICY_LEAK_NEWEST] = 1
+    };
+
+    g_return_if_fail(OWR_IS_INTER_SRC(self));
+    g_return_if_fail(self->link);
+    g_return_if_fail(policy <= OWR_LINK_POLICY_LEAK_NEWEST);
+
+    self->link->policy = policy;
+    self->link->max_depth = max_depth;
+
+    g_object_set(self->queue, "leaky", leaky[policy], NULL);
+    if (max_depth) {
+        g_object_set(self->queue, "max-size-buffers", max_depth,
+            "max-size-bytes", 0, "max-size-time", (guint64) 0, NULL);
+    }
+}
@@ -27,6 +27,8 @@
 #ifndef __OWR_INTER_SRC_H__
 #define __OWR_INTER_SRC_H__
 
+#include "owr_inter_link.h"
+
 #include <gst/gst.h>
 
 #ifndef __GTK_DOC_IGNORE__
@@ -49,7 +51,7 @@ struct _OwrInterSrc {
     GstElement *queue;
     GstPad *internal_srcpad, *dummy_sinkpad;
     GstPad *srcpad;
-    GWeakRef sink_sinkpad;
+    OwrInterLink *link;
 };
 
 struct _OwrInterSrcClass {
@@ -58,6 +60,8 @@ struct _OwrInterSrcClass {
 
 GType _owr_inter_src_get_type(void);
 
+void _owr_inter_src_set_link_policy(OwrInterSrc *self, OwrLinkPolicy policy, guint max_depth);
+
 G_END_DECLS
 
 #endif /* __GTK_DOC_IGNORE__ */
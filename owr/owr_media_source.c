@@ -37,6 +37,7 @@
 #include "owr_inter_sink.h"
 #include "owr_inter_src.h"
 #include "owr_media_source_private.h"
+#include "owr_message_data_private.h"
 #include "owr_private.h"
 #include "owr_types.h"
 #include "owr_utils.h"
@@ -105,11 +106,21 @@ static GParamSpec *obj_properties[N_PROPERTIES] = {NULL, };
     g_free(temp_str); \
 }
 
+/* Level 0 is the source tee itself, every further level halves the size */
+#define PYRAMID_LEVELS 4
+
 #define OWR_MEDIA_SOURCE_GET_PRIVATE(obj) \
         (G_TYPE_INSTANCE_GET_PRIVATE((obj), OWR_TYPE_MEDIA_SOURCE, OwrMediaSourcePrivate))
 
 G_DEFINE_TYPE(OwrMediaSource, owr_media_source, G_TYPE_OBJECT)
 
+typedef struct {
+    GstElement *bin;
+    GstElement *tee;
+    /* Conversion branches and the next level that are fed by this one */
+    guint users;
+} PyramidLevel;
+
 struct _OwrMediaSourcePrivate {
     gchar *name;
     OwrMediaType media_type;
@@ -121,6 +132,15 @@ struct _OwrMediaSourcePrivate {
     GstElement *source_bin;
     /* Tee element from which we can tap the source for multiple consumers */
     GstElement *source_tee;
+
+    /* Conversion branches shared by consumers with identical caps, by caps
+     * string, and the branch used by each source id */
+    GHashTable *conversions;
+    GHashTable *consumers;
+
+    /* Downscaled copies of the source video that conversion branches can
+     * start from, created when first needed. Level 0 is unused */
+    PyramidLevel pyramid[PYRAMID_LEVELS];
 };
 
 static void owr_media_source_set_property(GObject *object, guint property_id,
@@ -130,6 +150,7 @@ static void owr_media_source_get_property(GObject *object, guint property_id,
 
 static GstElement *owr_media_source_request_source_default(OwrMediaSource *media_source, GstCaps *caps);
 static void owr_media_source_release_source_default(OwrMediaSource *media_source, GstElement *source);
+static void clear_conversion_branches(OwrMediaSource *media_source);
 
 static void owr_media_source_finalize(GObject *object)
 {
@@ -139,6 +160,10 @@ static void owr_media_source_finalize(GObject *object)
     g_free(priv->name);
     priv->name = NULL;
 
+    clear_conversion_branches(source);
+    g_hash_table_destroy(priv->conversions);
+    g_hash_table_destroy(priv->consumers);
+
     if (priv->source_bin) {
         GstElement *source_bin = priv->source_bin;
         priv->source_bin = NULL;
@@ -198,6 +223,9 @@ static void owr_media_source_init(OwrMediaSource *source)
     priv->source_bin = NULL;
     priv->source_tee = NULL;
 
+    priv->conversions = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->consumers = g_hash_table_new(NULL, NULL);
+
     g_mutex_init(&source->lock);
 }
 
@@ -251,45 +279,237 @@ static void owr_media_source_get_property(GObject *object, guint property_id,
 }
 
 /*
- * The following chain is created after the tee for each output from the
- * source:
+ * The following chains are created after the tee for each output from the
+ * source. Consumers with identical system memory caps share one conversion
+ * branch in the source pipeline:
+ *
+ *       +--------------------------------------------+   +------+   +-------------+
+ * tee --+ queue/converters/capsfilter (convert-bin) +---+ tee  +---+ inter*sink  |
+ *       +--------------------------------------------+   +------+   +-------------+
+ *
+ * +-----------+   +-------+   +----------+
+ * | inter*src +---+ queue +---+ ghostpad |
+ * +-----------+   +-------+   +----------+
  *
- * +-----------+   +-------------------------------+   +----------+
- * | inter*src +---+ converters/queues/capsfilters +---+ ghostpad |
- * +-----------+   +-------------------------------+   +----------+
+ * GL memory caps need the GL context of the consumer pipeline, so for those
+ * the converters are instead placed per consumer after the inter*src.
  *
+ * Video conversion branches that ask for a size of half the source or less
+ * are fed from a pyramid of downscaled copies instead of the source tee, so
+ * each halving is only done once however many consumers need it. Each
+ * level is nested in the bin of the level above:
+ *
+ *       +----------------------------------------+
+ * tee --+ queue -> videoscale -> capsfilter -> tee +--- convert-bin / next level
+ *       +----------------------------------------+
  */
-static GstElement *owr_media_source_request_source_default(OwrMediaSource *media_source, GstCaps *caps)
+
+typedef struct {
+    guint ref_count;
+    gchar *caps_key;
+    guint level;
+    GstElement *bin;
+    GstElement *tee;
+} ConversionBranch;
+
+static void conversion_branch_free(ConversionBranch *branch)
 {
-    OwrMediaType media_type;
-    GstElement *source_pipeline, *tee;
-    GstElement *source_bin, *source = NULL, *queue_pre, *queue_post;
-    GstElement *capsfilter;
-    GstElement *sink, *sink_queue, *sink_bin;
-    GstPad *bin_pad = NULL, *srcpad, *sinkpad;
-    gchar *bin_name;
-    guint source_id;
-    gchar *sink_name, *source_name;
+    g_free(branch->caps_key);
+    gst_object_unref(branch->tee);
+    gst_object_unref(branch->bin);
+    g_slice_free(ConversionBranch, branch);
+}
 
-    g_return_val_if_fail(media_source->priv->source_bin, NULL);
-    g_return_val_if_fail(media_source->priv->source_tee, NULL);
+static void pyramid_level_clear(PyramidLevel *level)
+{
+    if (level->bin) {
+        gst_object_unref(level->tee);
+        gst_object_unref(level->bin);
+    }
+    level->bin = NULL;
+    level->tee = NULL;
+    level->users = 0;
+}
 
-    source_pipeline = gst_object_ref(media_source->priv->source_bin);
-    tee = gst_object_ref(media_source->priv->source_tee);
+/* call with the media_source lock */
+static void clear_conversion_branches(OwrMediaSource *media_source)
+{
+    OwrMediaSourcePrivate *priv = media_source->priv;
+    GHashTableIter iter;
+    ConversionBranch *branch;
+    guint i;
 
-    source_id = g_atomic_int_add(&unique_bin_id, 1);
+    g_hash_table_remove_all(priv->consumers);
 
-    bin_name = g_strdup_printf("source-bin-%u", source_id);
-    source_bin = gst_bin_new(bin_name);
-    g_free(bin_name);
+    g_hash_table_iter_init(&iter, priv->conversions);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &branch)) {
+        g_hash_table_iter_remove(&iter);
+        conversion_branch_free(branch);
+    }
 
-    CREATE_ELEMENT_WITH_ID(queue_pre, "queue", "source-queue", source_id);
-    CREATE_ELEMENT_WITH_ID(capsfilter, "capsfilter", "source-output-capsfilter", source_id);
-    CREATE_ELEMENT_WITH_ID(queue_post, "queue", "source-output-queue", source_id);
+    for (i = 1; i < PYRAMID_LEVELS; i++)
+        pyramid_level_clear(&priv->pyramid[i]);
+}
 
-    CREATE_ELEMENT_WITH_ID(sink_queue, "queue", "sink-queue", source_id);
+/* Makes the capsfilter of a pyramid level ask for half of its input size */
+static GstPadProbeReturn pyramid_caps_probe(G_GNUC_UNUSED GstPad *pad, GstPadProbeInfo *info,
+    GstElement *capsfilter)
+{
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    GstStructure *s;
+    GstCaps *caps, *half_caps;
+    const GValue *par;
+    gint width, height;
+
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS)
+        return GST_PAD_PROBE_OK;
+
+    gst_event_parse_caps(event, &caps);
+    s = gst_caps_get_structure(caps, 0);
+    if (!gst_structure_get_int(s, "width", &width) || !gst_structure_get_int(s, "height", &height))
+        return GST_PAD_PROBE_OK;
+
+    half_caps = gst_caps_new_simple("video/x-raw",
+        "width", G_TYPE_INT, MAX(width / 2, 1),
+        "height", G_TYPE_INT, MAX(height / 2, 1), NULL);
+    par = gst_structure_get_value(s, "pixel-aspect-ratio");
+    if (par)
+        gst_structure_set_value(gst_caps_get_structure(half_caps, 0), "pixel-aspect-ratio", par);
+
+    g_object_set(capsfilter, "caps", half_caps, NULL);
+    gst_caps_unref(half_caps);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void pyramid_level_init(PyramidLevel *level, guint index)
+{
+    GstElement *queue, *videoscale, *capsfilter;
+    GstPad *sinkpad, *bin_pad;
+    gchar *name;
+    guint id;
+
+    id = g_atomic_int_add(&unique_bin_id, 1);
+
+    name = g_strdup_printf("pyramid-bin-%u-%u", index, id);
+    level->bin = gst_object_ref(gst_bin_new(name));
+    g_free(name);
+
+    CREATE_ELEMENT_WITH_ID(queue, "queue", "pyramid-queue", id);
+    CREATE_ELEMENT_WITH_ID(videoscale, "videoscale", "pyramid-scale", id);
+    CREATE_ELEMENT_WITH_ID(capsfilter, "capsfilter", "pyramid-capsfilter", id);
+    CREATE_ELEMENT_WITH_ID(level->tee, "tee", "pyramid-tee", id);
+    gst_object_ref(level->tee);
+
+    gst_bin_add_many(GST_BIN(level->bin), queue, videoscale, capsfilter, level->tee, NULL);
+    LINK_ELEMENTS(queue, videoscale);
+    LINK_ELEMENTS(videoscale, capsfilter);
+    LINK_ELEMENTS(capsfilter, level->tee);
+
+    sinkpad = gst_element_get_static_pad(queue, "sink");
+    gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback) pyramid_caps_probe, gst_object_ref(capsfilter), gst_object_unref);
+    bin_pad = gst_ghost_pad_new("sink", sinkpad);
+    gst_object_unref(sinkpad);
+    gst_pad_set_active(bin_pad, TRUE);
+    gst_element_add_pad(level->bin, bin_pad);
+
+    level->users = 0;
+}
+
+/* call with the media_source lock */
+static guint pick_pyramid_level(OwrMediaSource *media_source, GstCaps *caps)
+{
+    GstCapsFeatures *features;
+    GstStructure *s;
+    GstCaps *source_caps;
+    GstPad *sinkpad;
+    gint width, height, source_width, source_height;
+    guint level = 0;
+
+    if (gst_caps_is_empty(caps) || gst_caps_is_any(caps))
+        return 0;
+
+    s = gst_caps_get_structure(caps, 0);
+    if (!gst_structure_get_int(s, "width", &width) || !gst_structure_get_int(s, "height", &height))
+        return 0;
+
+    sinkpad = gst_element_get_static_pad(media_source->priv->source_tee, "sink");
+    source_caps = gst_pad_get_current_caps(sinkpad);
+    gst_object_unref(sinkpad);
+    if (!source_caps)
+        return 0;
+
+    s = gst_caps_get_structure(source_caps, 0);
+    features = gst_caps_get_features(source_caps, 0);
+    if (gst_structure_has_name(s, "video/x-raw")
+        && (!features || gst_caps_features_is_equal(features, GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY))
+        && gst_structure_get_int(s, "width", &source_width)
+        && gst_structure_get_int(s, "height", &source_height)) {
+        while (level + 1 < PYRAMID_LEVELS
+            && (source_width >> (level + 1)) >= width
+            && (source_height >> (level + 1)) >= height)
+            level++;
+    }
+    gst_caps_unref(source_caps);
+
+    return level;
+}
+
+/* call with the media_source lock. Links element, which must have a sink
+ * pad, to the tee of the given pyramid level, creating missing levels */
+static void attach_to_pyramid(OwrMediaSource *media_source, GstElement *source_pipeline,
+    guint level, GstElement *element)
+{
+    PyramidLevel *pyramid = media_source->priv->pyramid;
+    GstElement *parent_bin, *parent_tee;
+
+    while (level > 0 && !pyramid[level].bin) {
+        pyramid_level_init(&pyramid[level], level);
+        gst_bin_add(GST_BIN(pyramid[level].bin), element);
+        LINK_ELEMENTS(pyramid[level].tee, element);
+        pyramid[level].users++;
+        element = pyramid[level].bin;
+        level--;
+    }
+
+    if (level > 0) {
+        parent_bin = pyramid[level].bin;
+        parent_tee = pyramid[level].tee;
+        pyramid[level].users++;
+    } else {
+        parent_bin = source_pipeline;
+        parent_tee = media_source->priv->source_tee;
+    }
+
+    gst_bin_add(GST_BIN(parent_bin), element);
+    gst_element_sync_state_with_parent(element);
+    LINK_ELEMENTS(parent_tee, element);
+}
+
+static gboolean caps_need_gl_context(GstCaps *caps)
+{
+    GstCapsFeatures *features;
+
+    if (gst_caps_is_empty(caps) || gst_caps_is_any(caps))
+        return FALSE;
+
+    features = gst_caps_get_features(caps, 0);
+    return features && gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_GL_MEMORY);
+}
+
+/* Adds queue -> converters -> capsfilter for caps to bin */
+static void add_converters(GstBin *bin, OwrMediaType media_type, GstCaps *caps, guint id,
+    GstElement **first, GstElement **last)
+{
+    GstElement *queue_pre, *capsfilter;
+
+    CREATE_ELEMENT_WITH_ID(queue_pre, "queue", "source-queue", id);
+    CREATE_ELEMENT_WITH_ID(capsfilter, "capsfilter", "source-output-capsfilter", id);
+
+    /* The framerate is removed below, don't touch the caller's caps */
+    caps = gst_caps_copy(caps);
 
-    g_object_get(media_source, "media-type", &media_type, NULL);
     switch (media_type) {
     case OWR_MEDIA_TYPE_AUDIO:
         {
@@ -297,12 +517,10 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
 
         g_object_set(capsfilter, "caps", caps, NULL);
 
-        CREATE_ELEMENT_WITH_ID(audioresample, "audioresample", "source-audio-resample", source_id);
-        CREATE_ELEMENT_WITH_ID(audioconvert, "audioconvert", "source-audio-convert", source_id);
+        CREATE_ELEMENT_WITH_ID(audioresample, "audioresample", "source-audio-resample", id);
+        CREATE_ELEMENT_WITH_ID(audioconvert, "audioconvert", "source-audio-convert", id);
 
-        gst_bin_add_many(GST_BIN(source_bin),
-            queue_pre, audioconvert, audioresample, capsfilter, queue_post, NULL);
-        LINK_ELEMENTS(capsfilter, queue_post);
+        gst_bin_add_many(bin, queue_pre, audioconvert, audioresample, capsfilter, NULL);
         LINK_ELEMENTS(audioresample, capsfilter);
         LINK_ELEMENTS(audioconvert, audioresample);
         LINK_ELEMENTS(queue_pre, audioconvert);
@@ -313,7 +531,6 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
         {
         GstElement *videorate = NULL, *videoscale = NULL, *videoconvert;
         GstStructure *s;
-        GstCapsFeatures *features;
 
         s = gst_caps_get_structure(caps, 0);
         if (gst_structure_has_field(s, "framerate")) {
@@ -322,22 +539,20 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
             gst_structure_get_fraction(s, "framerate", &fps_n, &fps_d);
             g_assert(fps_d);
 
-            CREATE_ELEMENT_WITH_ID(videorate, "videorate", "source-video-rate", source_id);
+            CREATE_ELEMENT_WITH_ID(videorate, "videorate", "source-video-rate", id);
             g_object_set(videorate, "drop-only", TRUE, "max-rate", fps_n / fps_d, NULL);
 
             gst_structure_remove_field(s, "framerate");
-            gst_bin_add(GST_BIN(source_bin), videorate);
+            gst_bin_add(bin, videorate);
         }
         g_object_set(capsfilter, "caps", caps, NULL);
 
-        features = gst_caps_get_features(caps, 0);
-        if (gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_GL_MEMORY)) {
+        if (caps_need_gl_context(caps)) {
             GstElement *glupload;
 
-            CREATE_ELEMENT_WITH_ID(glupload, "glupload", "source-glupload", source_id);
-            CREATE_ELEMENT_WITH_ID(videoconvert, "glcolorconvert", "source-glcolorconvert", source_id);
-            gst_bin_add_many(GST_BIN(source_bin),
-                    queue_pre, glupload, videoconvert, capsfilter, queue_post, NULL);
+            CREATE_ELEMENT_WITH_ID(glupload, "glupload", "source-glupload", id);
+            CREATE_ELEMENT_WITH_ID(videoconvert, "glcolorconvert", "source-glcolorconvert", id);
+            gst_bin_add_many(bin, queue_pre, glupload, videoconvert, capsfilter, NULL);
 
             if (videorate) {
                 LINK_ELEMENTS(queue_pre, videorate);
@@ -349,11 +564,10 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
         } else {
             GstElement *gldownload;
 
-            CREATE_ELEMENT_WITH_ID(gldownload, "gldownload", "source-gldownload", source_id);
-            CREATE_ELEMENT_WITH_ID(videoscale,  "videoscale", "source-video-scale", source_id);
-            CREATE_ELEMENT_WITH_ID(videoconvert, VIDEO_CONVERT, "source-video-convert", source_id);
-            gst_bin_add_many(GST_BIN(source_bin),
-                    queue_pre, gldownload, videoscale, videoconvert, capsfilter, queue_post, NULL);
+            CREATE_ELEMENT_WITH_ID(gldownload, "gldownload", "source-gldownload", id);
+            CREATE_ELEMENT_WITH_ID(videoscale,  "videoscale", "source-video-scale", id);
+            CREATE_ELEMENT_WITH_ID(videoconvert, VIDEO_CONVERT, "source-video-convert", id);
+            gst_bin_add_many(bin, queue_pre, gldownload, videoscale, videoconvert, capsfilter, NULL);
             if (videorate) {
                 LINK_ELEMENTS(queue_pre, videorate);
                 LINK_ELEMENTS(videorate, gldownload);
@@ -364,16 +578,84 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
             LINK_ELEMENTS(videoscale, videoconvert);
         }
         LINK_ELEMENTS(videoconvert, capsfilter);
-        LINK_ELEMENTS(capsfilter, queue_post);
 
         break;
         }
     case OWR_MEDIA_TYPE_UNKNOWN:
     default:
         g_assert_not_reached();
-        goto done;
+        break;
     }
 
+    gst_caps_unref(caps);
+
+    *first = queue_pre;
+    *last = capsfilter;
+}
+
+static ConversionBranch *conversion_branch_new(OwrMediaType media_type, GstCaps *caps, gchar *caps_key)
+{
+    ConversionBranch *branch;
+    GstElement *first, *last;
+    GstPad *sinkpad, *bin_pad;
+    gchar *name;
+    guint branch_id;
+
+    branch_id = g_atomic_int_add(&unique_bin_id, 1);
+
+    branch = g_slice_new0(ConversionBranch);
+    branch->caps_key = caps_key;
+
+    name = g_strdup_printf("convert-bin-%u", branch_id);
+    branch->bin = gst_object_ref(gst_bin_new(name));
+    g_free(name);
+
+    CREATE_ELEMENT_WITH_ID(branch->tee, "tee", "convert-tee", branch_id);
+    gst_object_ref(branch->tee);
+
+    add_converters(GST_BIN(branch->bin), media_type, caps, branch_id, &first, &last);
+    gst_bin_add(GST_BIN(branch->bin), branch->tee);
+    LINK_ELEMENTS(last, branch->tee);
+
+    sinkpad = gst_element_get_static_pad(first, "sink");
+    bin_pad = gst_ghost_pad_new("sink", sinkpad);
+    gst_object_unref(sinkpad);
+    gst_pad_set_active(bin_pad, TRUE);
+    gst_element_add_pad(branch->bin, bin_pad);
+
+    return branch;
+}
+
+static GstElement *owr_media_source_request_source_default(OwrMediaSource *media_source, GstCaps *caps)
+{
+    OwrMediaSourcePrivate *priv = media_source->priv;
+    OwrMediaType media_type;
+    GstElement *source_pipeline, *tee;
+    GstElement *source_bin, *source = NULL, *queue_post;
+    GstElement *sink, *sink_queue, *sink_bin;
+    GstPad *bin_pad = NULL, *srcpad, *sinkpad;
+    gchar *bin_name;
+    guint source_id;
+    gchar *sink_name, *source_name;
+
+    g_return_val_if_fail(priv->source_bin, NULL);
+    g_return_val_if_fail(priv->source_tee, NULL);
+
+    g_object_get(media_source, "media-type", &media_type, NULL);
+    g_return_val_if_fail(media_type == OWR_MEDIA_TYPE_AUDIO || media_type == OWR_MEDIA_TYPE_VIDEO, NULL);
+
+    source_pipeline = gst_object_ref(priv->source_bin);
+    tee = gst_object_ref(priv->source_tee);
+
+    source_id = g_atomic_int_add(&unique_bin_id, 1);
+
+    bin_name = g_strdup_printf("source-bin-%u", source_id);
+    source_bin = gst_bin_new(bin_name);
+    g_free(bin_name);
+
+    CREATE_ELEMENT_WITH_ID(queue_post, "queue", "source-output-queue", source_id);
+    CREATE_ELEMENT_WITH_ID(sink_queue, "queue", "sink-queue", source_id);
+
     source_name = g_strdup_printf("source-%u", source_id);
     source = g_object_new(OWR_TYPE_INTER_SRC, "name", source_name, NULL);
     g_free(source_name);
@@ -382,10 +664,11 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
     sink = g_object_new(OWR_TYPE_INTER_SINK, "name", sink_name, NULL);
     g_free(sink_name);
 
-    g_weak_ref_set(&OWR_INTER_SRC(source)->sink_sinkpad, OWR_INTER_SINK(sink)->sinkpad);
-    g_weak_ref_set(&OWR_INTER_SINK(sink)->src_srcpad, OWR_INTER_SRC(source)->internal_srcpad);
+    OWR_INTER_SRC(source)->link = _owr_inter_link_new(OWR_INTER_SRC(source)->internal_srcpad,
+        OWR_INTER_SINK(sink)->sinkpad);
+    OWR_INTER_SINK(sink)->link = _owr_inter_link_ref(OWR_INTER_SRC(source)->link);
 
-    /* Add and link the inter*sink to the actual source pipeline */
+    /* The inter*sink side that goes into the actual source pipeline */
     bin_name = g_strdup_printf("source-sink-bin-%u", source_id);
     sink_bin = gst_bin_new(bin_name);
     g_free(bin_name);
@@ -399,9 +682,50 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
     gst_pad_set_active(bin_pad, TRUE);
     gst_element_add_pad(sink_bin, bin_pad);
     bin_pad = NULL;
-    gst_bin_add(GST_BIN(source_pipeline), sink_bin);
-    gst_element_sync_state_with_parent(sink_bin);
-    LINK_ELEMENTS(tee, sink_bin);
+
+    if (caps_need_gl_context(caps)) {
+        GstElement *first, *last;
+
+        add_converters(GST_BIN(source_bin), media_type, caps, source_id, &first, &last);
+        gst_bin_add_many(GST_BIN(source_bin), source, queue_post, NULL);
+        LINK_ELEMENTS(last, queue_post);
+        LINK_ELEMENTS(source, first);
+
+        gst_bin_add(GST_BIN(source_pipeline), sink_bin);
+        gst_element_sync_state_with_parent(sink_bin);
+        LINK_ELEMENTS(tee, sink_bin);
+    } else {
+        ConversionBranch *branch;
+        gchar *caps_key;
+
+        caps_key = gst_caps_to_string(caps);
+        branch = g_hash_table_lookup(priv->conversions, caps_key);
+        if (branch) {
+            g_free(caps_key);
+
+            gst_bin_add(GST_BIN(branch->bin), sink_bin);
+            gst_element_sync_state_with_parent(sink_bin);
+            LINK_ELEMENTS(branch->tee, sink_bin);
+        } else {
+            branch = conversion_branch_new(media_type, caps, caps_key);
+            if (media_type == OWR_MEDIA_TYPE_VIDEO)
+                branch->level = pick_pyramid_level(media_source, caps);
+            g_hash_table_insert(priv->conversions, branch->caps_key, branch);
+
+            /* Attach the first consumer before any data can reach the tee */
+            gst_bin_add(GST_BIN(branch->bin), sink_bin);
+            LINK_ELEMENTS(branch->tee, sink_bin);
+            attach_to_pyramid(media_source, source_pipeline, branch->level, branch->bin);
+        }
+        branch->ref_count++;
+        g_hash_table_insert(priv->consumers, GUINT_TO_POINTER(source_id), branch);
+
+        GST_DEBUG_OBJECT(media_source, "Source %u uses %s at pyramid level %u, shared by %u consumers",
+            source_id, GST_OBJECT_NAME(branch->bin), branch->level, branch->ref_count);
+
+        gst_bin_add_many(GST_BIN(source_bin), source, queue_post, NULL);
+        LINK_ELEMENTS(source, queue_post);
+    }
 
     /* Start up our new bin and link it all */
     srcpad = gst_element_get_static_pad(queue_post, "src");
@@ -412,11 +736,6 @@ static GstElement *owr_media_source_request_source_default(OwrMediaSource *media
     gst_pad_set_active(bin_pad, TRUE);
     gst_element_add_pad(source_bin, bin_pad);
 
-    gst_bin_add(GST_BIN(source_bin), source);
-    LINK_ELEMENTS(source, queue_pre);
-
-done:
-
     gst_object_unref(source_pipeline);
     gst_object_unref(tee);
 
@@ -463,6 +782,9 @@ static void owr_media_source_release_source_default(OwrMediaSource *media_source
     gchar *bin_name, *source_name;
     guint source_id = -1;
     GstElement *sink_bin, *source_pipeline;
+    ConversionBranch *branch;
+    PyramidLevel *pyramid = media_source->priv->pyramid;
+    guint level;
 
     g_return_if_fail(media_source->priv->source_bin);
     g_return_if_fail(media_source->priv->source_tee);
@@ -494,6 +816,30 @@ static void owr_media_source_release_source_default(OwrMediaSource *media_source
     g_free(bin_name);
     gst_object_unref(source_pipeline);
 
+    branch = g_hash_table_lookup(media_source->priv->consumers, GUINT_TO_POINTER(source_id));
+    if (branch) {
+        g_hash_table_remove(media_source->priv->consumers, GUINT_TO_POINTER(source_id));
+        if (!--branch->ref_count) {
+            GST_DEBUG_OBJECT(media_source, "Removing %s, last consumer is gone",
+                GST_OBJECT_NAME(branch->bin));
+            g_hash_table_remove(media_source->priv->conversions, branch->caps_key);
+
+            /* Take out the whole branch, the sink bin goes with it */
+            gst_object_unref(sink_bin);
+            sink_bin = gst_object_ref(branch->bin);
+            level = branch->level;
+            conversion_branch_free(branch);
+
+            /* And so do the pyramid levels that only fed this branch */
+            while (level > 0 && !--pyramid[level].users) {
+                gst_object_unref(sink_bin);
+                sink_bin = gst_object_ref(pyramid[level].bin);
+                pyramid_level_clear(&pyramid[level]);
+                level--;
+            }
+        }
+    }
+
     sinkpad = gst_element_get_static_pad(sink_bin, "sink");
     /* The pad on the tee */
     srcpad = gst_pad_get_peer(sinkpad);
@@ -504,6 +850,37 @@ static void owr_media_source_release_source_default(OwrMediaSource *media_source
     gst_object_unref(sink_bin);
 }
 
+/* call with the media_source lock */
+/**
+ * _owr_media_source_get_pyramid_level:
+ * @media_source:
+ * @source: (transfer none): a source returned by _owr_media_source_request_source()
+ *
+ * Returns: the pyramid level that feeds @source, 0 for the source tee itself.
+ * The level is picked when the conversion branch is created and stays fixed,
+ * so it only delivers the requested size while the source is at least
+ * 2^level times as large.
+ */
+guint _owr_media_source_get_pyramid_level(OwrMediaSource *media_source, GstElement *source)
+{
+    ConversionBranch *branch;
+    gchar *source_name;
+    guint source_id;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SOURCE(media_source), 0);
+    g_return_val_if_fail(GST_IS_ELEMENT(source), 0);
+
+    source_name = gst_object_get_name(GST_OBJECT(source));
+    if (!source_name || sscanf(source_name, "source-bin-%u", &source_id) != 1) {
+        g_free(source_name);
+        return 0;
+    }
+    g_free(source_name);
+
+    branch = g_hash_table_lookup(media_source->priv->consumers, GUINT_TO_POINTER(source_id));
+    return branch ? branch->level : 0;
+}
+
 /* call with the media_source lock */
 /**
  * _owr_media_source_get_source_bin:
@@ -536,6 +913,9 @@ void _owr_media_source_set_source_bin(OwrMediaSource *media_source, GstElement *
         gst_object_unref(media_source->priv->source_bin);
     }
     media_source->priv->source_bin = bin ? gst_object_ref(bin) : NULL;
+
+    /* Conversion branches live in the old pipeline */
+    clear_conversion_branches(media_source);
 }
 
 /* call with the media_source lock */
@@ -608,6 +988,98 @@ void _owr_media_source_release_source(OwrMediaSource *media_source, GstElement *
     g_mutex_unlock(&media_source->lock);
 }
 
+/* Returns the OwrInterSrc of a source bin created by request_source_default */
+static OwrInterSrc *get_inter_src(GstElement *source)
+{
+    GstElement *inter_src;
+    gchar *name;
+    guint source_id;
+
+    name = gst_object_get_name(GST_OBJECT(source));
+    if (!name || sscanf(name, "source-bin-%u", &source_id) != 1) {
+        g_free(name);
+        return NULL;
+    }
+    g_free(name);
+
+    name = g_strdup_printf("source-%u", source_id);
+    inter_src = gst_bin_get_by_name(GST_BIN(source), name);
+    g_free(name);
+
+    if (inter_src && !OWR_IS_INTER_SRC(inter_src)) {
+        gst_object_unref(inter_src);
+        inter_src = NULL;
+    }
+
+    return inter_src ? OWR_INTER_SRC(inter_src) : NULL;
+}
+
+/**
+ * _owr_media_source_set_link_policy:
+ * @source: (transfer none): an element returned by _owr_media_source_request_source()
+ * @policy:
+ * @max_depth: number of buffers the consumer may queue, 0 for the defaults
+ *
+ * Call before the consumer starts. Sources that are not linked through an
+ * inter src/sink pair are left alone.
+ */
+void _owr_media_source_set_link_policy(GstElement *source, OwrLinkPolicy policy, guint max_depth)
+{
+    OwrInterSrc *inter_src;
+
+    g_return_if_fail(GST_IS_BIN(source));
+
+    inter_src = get_inter_src(source);
+    if (!inter_src) {
+        GST_DEBUG("%s has no inter link, not setting a policy", GST_OBJECT_NAME(source));
+        return;
+    }
+
+    _owr_inter_src_set_link_policy(inter_src, policy, max_depth);
+    gst_object_unref(inter_src);
+}
+
+/**
+ * _owr_media_source_get_link_stats:
+ * @source: (transfer none): an element returned by _owr_media_source_request_source()
+ *
+ * Returns: (transfer full) (nullable): data for an #OWR_STATS_TYPE_SOURCE_LINK message
+ */
+OwrMessageData *_owr_media_source_get_link_stats(GstElement *source)
+{
+    OwrInterSrc *inter_src;
+    OwrMessageData *data = NULL;
+    GEnumClass *enum_class;
+    GEnumValue *policy;
+    guint pushed, dropped;
+    gint64 max_latency;
+
+    g_return_val_if_fail(GST_IS_BIN(source), NULL);
+
+    inter_src = get_inter_src(source);
+    if (!inter_src)
+        return NULL;
+
+    if (inter_src->link) {
+        _owr_inter_link_get_counters(inter_src->link, &pushed, &dropped, &max_latency);
+
+        enum_class = G_ENUM_CLASS(g_type_class_ref(OWR_TYPE_LINK_POLICY));
+        policy = g_enum_get_value(enum_class, inter_src->link->policy);
+
+        data = _owr_message_data_new(5);
+        _owr_message_data_add_static_string(data, "policy", policy ? policy->value_nick : NULL);
+        _owr_message_data_add_uint64(data, "max_depth", inter_src->link->max_depth);
+        _owr_message_data_add_uint64(data, "pushed", pushed);
+        _owr_message_data_add_uint64(data, "dropped", dropped);
+        _owr_message_data_add_int64(data, "max_latency", max_latency);
+
+        g_type_class_unref(enum_class);
+    }
+    gst_object_unref(inter_src);
+
+    return data;
+}
+
 void _owr_media_source_set_type(OwrMediaSource *media_source, OwrSourceType type)
 {
     g_return_if_fail(OWR_IS_MEDIA_SOURCE(media_source));
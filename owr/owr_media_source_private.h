@@ -34,6 +34,7 @@
 
 #include "owr_media_source.h"
 
+#include "owr_message_data.h"
 #include "owr_types.h"
 
 #include <glib-object.h>
@@ -51,6 +52,10 @@ void _owr_media_source_set_source_tee(OwrMediaSource *media_source, GstElement *
 
 GstElement *_owr_media_source_request_source(OwrMediaSource *media_source, GstCaps *caps);
 void _owr_media_source_release_source(OwrMediaSource *media_source, GstElement *source);
+guint _owr_media_source_get_pyramid_level(OwrMediaSource *media_source, GstElement *source);
+
+void _owr_media_source_set_link_policy(GstElement *source, OwrLinkPolicy policy, guint max_depth);
+OwrMessageData *_owr_media_source_get_link_stats(GstElement *source);
 
 void _owr_media_source_set_type(OwrMediaSource *source, OwrSourceType type);
 
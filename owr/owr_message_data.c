@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrMessageData
+/*/
+
+/**
+ * SECTION:owr_message_data
+ * @short_description: Compact payload of bus messages
+ *
+ * The data of a bus message is stored as a flat array of typed fields with
+ * interned keys in a single allocation. Integer, floating point, boolean and
+ * string values are stored inline; other types are kept as a copied #GValue.
+ * owr_message_data_to_hash_table() builds the #GHashTable form that
+ * #OwrBusMessageCallback receives.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_message_data.h"
+
+#include "owr_message_data_private.h"
+
+#include "owr_utils.h"
+
+typedef enum {
+    FIELD_STORAGE_INT64,
+    FIELD_STORAGE_UINT64,
+    FIELD_STORAGE_DOUBLE,
+    FIELD_STORAGE_BOOLEAN,
+    FIELD_STORAGE_STATIC_STRING,
+    FIELD_STORAGE_STRING,
+    FIELD_STORAGE_VALUE
+} FieldStorage;
+
+typedef struct {
+    GQuark key;
+    GType type;
+    FieldStorage storage;
+    union {
+        gint64 v_int64;
+        guint64 v_uint64;
+        gdouble v_double;
+        gboolean v_boolean;
+        const gchar *v_static_string;
+        gchar *v_string;
+        GValue *v_value;
+    } value;
+} OwrMessageField;
+
+struct _OwrMessageData {
+    volatile gint ref_count;
+    guint n_fields;
+    guint max_fields;
+    OwrMessageField fields[1];
+};
+
+G_DEFINE_BOXED_TYPE(OwrMessageData, owr_message_data, owr_message_data_ref, owr_message_data_unref)
+
+static inline gsize message_data_size(guint max_fields)
+{
+    return G_STRUCT_OFFSET(OwrMessageData, fields) + MAX(max_fields, 1) * sizeof(OwrMessageField);
+}
+
+static void field_clear(OwrMessageField *field)
+{
+    if (field->storage == FIELD_STORAGE_STRING)
+        g_free(field->value.v_string);
+    else if (field->storage == FIELD_STORAGE_VALUE) {
+        g_value_unset(field->value.v_value);
+        g_slice_free(GValue, field->value.v_value);
+    }
+}
+
+static const OwrMessageField *lookup_field(const OwrMessageData *data, const gchar *key)
+{
+    GQuark quark;
+    guint i;
+
+    g_return_val_if_fail(data, NULL);
+    g_return_val_if_fail(key, NULL);
+
+    /* A key that was never interned can't be in any message */
+    quark = g_quark_try_string(key);
+    if (!quark)
+        return NULL;
+
+    for (i = 0; i < data->n_fields; i++) {
+        if (data->fields[i].key == quark)
+            return &data->fields[i];
+    }
+
+    return NULL;
+}
+
+/* Returns the slot for @quark, replacing an existing field with the same key */
+static OwrMessageField *add_field(OwrMessageData *data, GQuark quark, GType type, FieldStorage storage)
+{
+    OwrMessageField *field = NULL;
+    guint i;
+
+    for (i = 0; i < data->n_fields; i++) {
+        if (data->fields[i].key == quark) {
+            field = &data->fields[i];
+            field_clear(field);
+            break;
+        }
+    }
+
+    if (!field) {
+        g_return_val_if_fail(data->n_fields < data->max_fields, NULL);
+        field = &data->fields[data->n_fields++];
+    }
+
+    field->key = quark;
+    field->type = type;
+    field->storage = storage;
+
+    return field;
+}
+
+/**
+ * _owr_message_data_new:
+ * @max_fields: the number of fields that will be added
+ *
+ * Returns: (transfer full): an empty #OwrMessageData with room for @max_fields fields
+ */
+OwrMessageData *_owr_message_data_new(guint max_fields)
+{
+    OwrMessageData *data;
+
+    data = g_slice_alloc(message_data_size(max_fields));
+    data->ref_count = 1;
+    data->n_fields = 0;
+    data->max_fields = MAX(max_fields, 1);
+
+    return data;
+}
+
+/**
+ * _owr_message_data_new_from_hash_table:
+ * @table: (element-type utf8 GValue) (transfer none): a table created with _owr_value_table_new()
+ *
+ * Returns: (transfer full): an #OwrMessageData holding copies of the values in @table
+ */
+OwrMessageData *_owr_message_data_new_from_hash_table(GHashTable *table)
+{
+    OwrMessageData *data;
+    GHashTableIter iter;
+    const gchar *key;
+    const GValue *value;
+
+    g_return_val_if_fail(table, NULL);
+
+    data = _owr_message_data_new(g_hash_table_size(table));
+
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &key, (gpointer *) &value))
+        _owr_message_data_add_value(data, key, value);
+
+    return data;
+}
+
+void _owr_message_data_add_int64(OwrMessageData *data, const gchar *key, gint64 value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_INT64, FIELD_STORAGE_INT64);
+    if (field)
+        field->value.v_int64 = value;
+}
+
+void _owr_message_data_add_uint64(OwrMessageData *data, const gchar *key, guint64 value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_UINT64, FIELD_STORAGE_UINT64);
+    if (field)
+        field->value.v_uint64 = value;
+}
+
+void _owr_message_data_add_double(OwrMessageData *data, const gchar *key, gdouble value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_DOUBLE, FIELD_STORAGE_DOUBLE);
+    if (field)
+        field->value.v_double = value;
+}
+
+void _owr_message_data_add_boolean(OwrMessageData *data, const gchar *key, gboolean value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_BOOLEAN, FIELD_STORAGE_BOOLEAN);
+    if (field)
+        field->value.v_boolean = value;
+}
+
+void _owr_message_data_add_static_string(OwrMessageData *data, const gchar *key, const gchar *value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_STRING, FIELD_STORAGE_STATIC_STRING);
+    if (field)
+        field->value.v_static_string = value;
+}
+
+void _owr_message_data_add_string(OwrMessageData *data, const gchar *key, const gchar *value)
+{
+    OwrMessageField *field;
+
+    g_return_if_fail(data);
+
+    field = add_field(data, g_quark_from_static_string(key), G_TYPE_STRING, FIELD_STORAGE_STRING);
+    if (field)
+        field->value.v_string = g_strdup(value);
+}
+
+/**
+ * _owr_message_data_add_value:
+ * @data: an #OwrMessageData
+ * @key: the key, does not have to be a static string
+ * @value: (transfer none): the value to copy
+ */
+void _owr_message_data_add_value(OwrMessageData *data, const gchar *key, const GValue *value)
+{
+    OwrMessageField *field;
+    GType type;
+    FieldStorage storage;
+
+    g_return_if_fail(data);
+    g_return_if_fail(G_IS_VALUE(value));
+
+    type = G_VALUE_TYPE(value);
+
+    switch (type) {
+    case G_TYPE_INT:
+    case G_TYPE_LONG:
+    case G_TYPE_INT64:
+        storage = FIELD_STORAGE_INT64;
+        break;
+    case G_TYPE_UINT:
+    case G_TYPE_ULONG:
+    case G_TYPE_UINT64:
+        storage = FIELD_STORAGE_UINT64;
+        break;
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+        storage = FIELD_STORAGE_DOUBLE;
+        break;
+    case G_TYPE_BOOLEAN:
+        storage = FIELD_STORAGE_BOOLEAN;
+        break;
+    case G_TYPE_STRING:
+        storage = FIELD_STORAGE_STRING;
+        break;
+    default:
+        storage = FIELD_STORAGE_VALUE;
+        break;
+    }
+
+    field = add_field(data, g_quark_from_string(key), type, storage);
+    if (!field)
+        return;
+
+    switch (type) {
+    case G_TYPE_INT:
+        field->value.v_int64 = g_value_get_int(value);
+        break;
+    case G_TYPE_LONG:
+        field->value.v_int64 = g_value_get_long(value);
+        break;
+    case G_TYPE_INT64:
+        field->value.v_int64 = g_value_get_int64(value);
+        break;
+    case G_TYPE_UINT:
+        field->value.v_uint64 = g_value_get_uint(value);
+        break;
+    case G_TYPE_ULONG:
+        field->value.v_uint64 = g_value_get_ulong(value);
+        break;
+    case G_TYPE_UINT64:
+        field->value.v_uint64 = g_value_get_uint64(value);
+        break;
+    case G_TYPE_FLOAT:
+        field->value.v_double = g_value_get_float(value);
+        break;
+    case G_TYPE_DOUBLE:
+        field->value.v_double = g_value_get_double(value);
+        break;
+    case G_TYPE_BOOLEAN:
+        field->value.v_boolean = g_value_get_boolean(value);
+        break;
+    case G_TYPE_STRING:
+        field->value.v_string = g_value_dup_string(value);
+        break;
+    default:
+        field->value.v_value = g_slice_new0(GValue);
+        g_value_init(field->value.v_value, type);
+        g_value_copy(value, field->value.v_value);
+        break;
+    }
+}
+
+/**
+ * owr_message_data_ref:
+ * @data: an #OwrMessageData
+ *
+ * Returns: (transfer full): @data
+ */
+OwrMessageData *owr_message_data_ref(OwrMessageData *data)
+{
+    g_return_val_if_fail(data, NULL);
+
+    g_atomic_int_inc(&data->ref_count);
+
+    return data;
+}
+
+/**
+ * owr_message_data_unref:
+ * @data: (transfer full): an #OwrMessageData
+ */
+void owr_message_data_unref(OwrMessageData *data)
+{
+    guint i;
+
+    g_return_if_fail(data);
+
+    if (!g_atomic_int_dec_and_test(&data->ref_count))
+        return;
+
+    for (i = 0; i < data->n_fields; i++)
+        field_clear(&data->fields[i]);
+
+    g_slice_free1(message_data_size(data->max_fields), data);
+}
+
+/**
+ * owr_message_data_get_size:
+ * @data: an #OwrMessageData
+ *
+ * Returns: the number of fields in @data
+ */
+guint owr_message_data_get_size(const OwrMessageData *data)
+{
+    g_return_val_if_fail(data, 0);
+
+    return data->n_fields;
+}
+
+/**
+ * owr_message_data_get_key:
+ * @data: an #OwrMessageData
+ * @index: the index of the field, less than owr_message_data_get_size()
+ *
+ * Returns: (transfer none): the key of the field at @index
+ */
+const gchar *owr_message_data_get_key(const OwrMessageData *data, guint index)
+{
+    g_return_val_if_fail(data, NULL);
+    g_return_val_if_fail(index < data->n_fields, NULL);
+
+    return g_quark_to_string(data->fields[index].key);
+}
+
+/**
+ * owr_message_data_get_value_type:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ *
+ * Returns: the #GType of the value stored for @key, or %G_TYPE_INVALID if there is none
+ */
+GType owr_message_data_get_value_type(const OwrMessageData *data, const gchar *key)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    return field ? field->type : G_TYPE_INVALID;
+}
+
+/**
+ * owr_message_data_get_int64:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ * @value: (out): the value
+ *
+ * Returns: %TRUE if @data has a signed integer value for @key
+ */
+gboolean owr_message_data_get_int64(const OwrMessageData *data, const gchar *key, gint64 *value)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    if (!field || field->storage != FIELD_STORAGE_INT64)
+        return FALSE;
+
+    if (value)
+        *value = field->value.v_int64;
+    return TRUE;
+}
+
+/**
+ * owr_message_data_get_uint64:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ * @value: (out): the value
+ *
+ * Returns: %TRUE if @data has an unsigned integer value for @key
+ */
+gboolean owr_message_data_get_uint64(const OwrMessageData *data, const gchar *key, guint64 *value)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    if (!field || field->storage != FIELD_STORAGE_UINT64)
+        return FALSE;
+
+    if (value)
+        *value = field->value.v_uint64;
+    return TRUE;
+}
+
+/**
+ * owr_message_data_get_double:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ * @value: (out): the value
+ *
+ * Returns: %TRUE if @data has a floating point value for @key
+ */
+gboolean owr_message_data_get_double(const OwrMessageData *data, const gchar *key, gdouble *value)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    if (!field || field->storage != FIELD_STORAGE_DOUBLE)
+        return FALSE;
+
+    if (value)
+        *value = field->value.v_double;
+    return TRUE;
+}
+
+/**
+ * owr_message_data_get_boolean:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ * @value: (out): the value
+ *
+ * Returns: %TRUE if @data has a boolean value for @key
+ */
+gboolean owr_message_data_get_boolean(const OwrMessageData *data, const gchar *key, gboolean *value)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    if (!field || field->storage != FIELD_STORAGE_BOOLEAN)
+        return FALSE;
+
+    if (value)
+        *value = field->value.v_boolean;
+    return TRUE;
+}
+
+/**
+ * owr_message_data_get_string:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ *
+ * Returns: (transfer none) (nullable): the string stored for @key, or %NULL if there is none
+ */
+const gchar *owr_message_data_get_string(const OwrMessageData *data, const gchar *key)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    if (!field)
+        return NULL;
+    if (field->storage == FIELD_STORAGE_STATIC_STRING)
+        return field->value.v_static_string;
+    if (field->storage == FIELD_STORAGE_STRING)
+        return field->value.v_string;
+    return NULL;
+}
+
+static void field_to_value(const OwrMessageField *field, GValue *value)
+{
+    g_value_init(value, field->type);
+
+    switch (field->type) {
+    case G_TYPE_INT:
+        g_value_set_int(value, (gint) field->value.v_int64);
+        break;
+    case G_TYPE_LONG:
+        g_value_set_long(value, (glong) field->value.v_int64);
+        break;
+    case G_TYPE_INT64:
+        g_value_set_int64(value, field->value.v_int64);
+        break;
+    case G_TYPE_UINT:
+        g_value_set_uint(value, (guint) field->value.v_uint64);
+        break;
+    case G_TYPE_ULONG:
+        g_value_set_ulong(value, (gulong) field->value.v_uint64);
+        break;
+    case G_TYPE_UINT64:
+        g_value_set_uint64(value, field->value.v_uint64);
+        break;
+    case G_TYPE_FLOAT:
+        g_value_set_float(value, (gfloat) field->value.v_double);
+        break;
+    case G_TYPE_DOUBLE:
+        g_value_set_double(value, field->value.v_double);
+        break;
+    case G_TYPE_BOOLEAN:
+        g_value_set_boolean(value, field->value.v_boolean);
+        break;
+    case G_TYPE_STRING:
+        if (field->storage == FIELD_STORAGE_STATIC_STRING)
+            g_value_set_static_string(value, field->value.v_static_string);
+        else
+            g_value_set_string(value, field->value.v_string);
+        break;
+    default:
+        g_value_copy(field->value.v_value, value);
+        break;
+    }
+}
+
+/**
+ * owr_message_data_get_value:
+ * @data: an #OwrMessageData
+ * @key: the key of the field
+ * @value: (out caller-allocates): an uninitialized #GValue
+ *
+ * Copies the value stored for @key into @value, which must be unset by the caller.
+ *
+ * Returns: %TRUE if @data has a value for @key, otherwise @value is left uninitialized
+ */
+gboolean owr_message_data_get_value(const OwrMessageData *data, const gchar *key, GValue *value)
+{
+    const OwrMessageField *field = lookup_field(data, key);
+
+    g_return_val_if_fail(value, FALSE);
+
+    if (!field)
+        return FALSE;
+
+    field_to_value(field, value);
+    return TRUE;
+}
+
+/**
+ * owr_message_data_to_hash_table:
+ * @data: an #OwrMessageData
+ *
+ * Builds the table form of @data, for callers that expect the data of
+ * #OwrBusMessageCallback. This allocates every key and value, so prefer the
+ * typed getters where the table is not needed.
+ *
+ * Returns: (element-type utf8 GValue) (transfer full): a new #GHashTable
+ */
+GHashTable *owr_message_data_to_hash_table(const OwrMessageData *data)
+{
+    GHashTable *table;
+    const OwrMessageField *field;
+    GValue *value;
+    guint i;
+
+    g_return_val_if_fail(data, NULL);
+
+    table = _owr_value_table_new();
+
+    for (i = 0; i < data->n_fields; i++) {
+        field = &data->fields[i];
+        value = g_slice_new0(GValue);
+        field_to_value(field, value);
+        g_hash_table_insert(table, g_strdup(g_quark_to_string(field->key)), value);
+    }
+
+    return table;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrMessageData
+/*/
+
+#ifndef __OWR_MESSAGE_DATA_H__
+#define __OWR_MESSAGE_DATA_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _OwrMessageData OwrMessageData;
+
+#define OWR_TYPE_MESSAGE_DATA (owr_message_data_get_type())
+GType owr_message_data_get_type(void) G_GNUC_CONST;
+
+OwrMessageData *owr_message_data_ref(OwrMessageData *data);
+void owr_message_data_unref(OwrMessageData *data);
+
+guint owr_message_data_get_size(const OwrMessageData *data);
+const gchar *owr_message_data_get_key(const OwrMessageData *data, guint index);
+GType owr_message_data_get_value_type(const OwrMessageData *data, const gchar *key);
+
+gboolean owr_message_data_get_int64(const OwrMessageData *data, const gchar *key, gint64 *value);
+gboolean owr_message_data_get_uint64(const OwrMessageData *data, const gchar *key, guint64 *value);
+gboolean owr_message_data_get_double(const OwrMessageData *data, const gchar *key, gdouble *value);
+gboolean owr_message_data_get_boolean(const OwrMessageData *data, const gchar *key, gboolean *value);
+const gchar *owr_message_data_get_string(const OwrMessageData *data, const gchar *key);
+gboolean owr_message_data_get_value(const OwrMessageData *data, const gchar *key, GValue *value);
+
+GHashTable *owr_message_data_to_hash_table(const OwrMessageData *data);
+
+G_END_DECLS
+
+#endif /* __OWR_MESSAGE_DATA_H__ */
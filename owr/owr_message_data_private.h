@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrMessageData private
+/*/
+
+#ifndef __OWR_MESSAGE_DATA_PRIVATE_H__
+#define __OWR_MESSAGE_DATA_PRIVATE_H__
+
+#include "owr_message_data.h"
+
+#ifndef __GTK_DOC_IGNORE__
+
+G_BEGIN_DECLS
+
+/* Keys passed to the typed adders must be static strings */
+OwrMessageData *_owr_message_data_new(guint max_fields);
+OwrMessageData *_owr_message_data_new_from_hash_table(GHashTable *table);
+void _owr_message_data_add_int64(OwrMessageData *data, const gchar *key, gint64 value);
+void _owr_message_data_add_uint64(OwrMessageData *data, const gchar *key, guint64 value);
+void _owr_message_data_add_double(OwrMessageData *data, const gchar *key, gdouble value);
+void _owr_message_data_add_boolean(OwrMessageData *data, const gchar *key, gboolean value);
+void _owr_message_data_add_static_string(OwrMessageData *data, const gchar *key, const gchar *value);
+void _owr_message_data_add_string(OwrMessageData *data, const gchar *key, const gchar *value);
+void _owr_message_data_add_value(OwrMessageData *data, const gchar *key, const GValue *value);
+
+G_END_DECLS
+
+#endif /* __GTK_DOC_IGNORE__ */
+
+#endif /* __OWR_MESSAGE_DATA_PRIVATE_H__ */
@@ -39,6 +39,10 @@
 
 G_DEFINE_INTERFACE(OwrMessageOrigin, owr_message_origin, 0)
 
+/* Bumped whenever any bus subscription or bus message type mask changes,
+ * bus sets recompute their cached mask lazily when they see a new value */
+static volatile gint subscription_generation = 1;
+
 void owr_message_origin_default_init(OwrMessageOriginInterface *interface)
 {
     interface->get_bus_set = NULL;
@@ -58,6 +62,8 @@ OwrMessageOriginBusSet *owr_message_origin_bus_set_new()
     bus_set->table =  g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
         (GDestroyNotify) bus_set_value_destroy_func);
     g_mutex_init(&bus_set->mutex);
+    bus_set->message_type_mask = 0;
+    bus_set->mask_generation = 0;
 
     return bus_set;
 }
@@ -70,6 +76,11 @@ void owr_message_origin_bus_set_free(OwrMessageOriginBusSet *bus_set)
     g_slice_free(OwrMessageOriginBusSet, bus_set);
 }
 
+void owr_message_origin_bus_set_invalidate_all(void)
+{
+    g_atomic_int_inc(&subscription_generation);
+}
+
 OwrMessageOriginBusSet *owr_message_origin_get_bus_set(OwrMessageOrigin *origin)
 {
     OwrMessageOriginInterface *interface;
@@ -86,16 +97,67 @@ OwrMessageOriginBusSet *owr_message_origin_get_bus_set(OwrMessageOrigin *origin)
     return result;
 }
 
+static OwrMessageType update_message_type_mask(OwrMessageOriginBusSet *bus_set, gint generation)
+{
+    GHashTableIter iter;
+    GWeakRef *ref;
+    OwrBus *bus;
+    OwrMessageType mask = 0;
+
+    g_mutex_lock(&bus_set->mutex);
+
+    g_hash_table_iter_init(&iter, bus_set->table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &ref)) {
+        bus = g_weak_ref_get(ref);
+        if (bus) {
+            mask |= _owr_bus_get_message_type_mask(bus);
+            g_object_unref(bus);
+        } else {
+            GST_DEBUG("message bus finalized, removing weak ref: %p", ref);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    /* The mask has to be visible before the generation that validates it */
+    g_atomic_int_set(&bus_set->message_type_mask, mask);
+    g_atomic_int_set(&bus_set->mask_generation, generation);
+
+    g_mutex_unlock(&bus_set->mutex);
+
+    return mask;
+}
+
 /**
- * owr_message_origin_post_message:
- * @origin: (transfer none): the origin that is posting the message
+ * owr_message_origin_has_subscribers:
+ * @origin: (transfer none): the origin that would post the message
  * @type: the #OwrMessageType of the message
- * @sub_type: the #OwrMessageSubType of the message
- * @data: (element-type utf8 GValue) (nullable) (transfer full): extra data
  *
- * Post a new message to all buses that are subscribed to @origin
+ * Checks whether any bus would forward a message of @type from @origin, so that
+ * callers can avoid building message data that would be thrown away. This is
+ * two atomic reads unless a subscription changed since the last call.
+ *
+ * Returns: %TRUE if at least one bus is subscribed to @type from @origin
  */
-void owr_message_origin_post_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data)
+gboolean owr_message_origin_has_subscribers(OwrMessageOrigin *origin, OwrMessageType type)
+{
+    OwrMessageOriginBusSet *bus_set;
+    OwrMessageType mask;
+    gint generation;
+
+    bus_set = owr_message_origin_get_bus_set(origin);
+    g_return_val_if_fail(bus_set, FALSE);
+
+    generation = g_atomic_int_get(&subscription_generation);
+    if (G_LIKELY(g_atomic_int_get(&bus_set->mask_generation) == generation))
+        mask = g_atomic_int_get(&bus_set->message_type_mask);
+    else
+        mask = update_message_type_mask(bus_set, generation);
+
+    return (mask & type) != 0;
+}
+
+static void post_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type,
+    OwrMessageData *payload, GHashTable *data)
 {
     OwrMessage *message;
     OwrMessageOriginBusSet *bus_set;
@@ -103,9 +165,15 @@ void owr_message_origin_post_message(OwrMessageOrigin *origin, OwrMessageType ty
     GWeakRef *ref;
     OwrBus *bus;
 
-    g_return_if_fail(OWR_IS_MESSAGE_ORIGIN(origin));
+    if (!owr_message_origin_has_subscribers(origin, type)) {
+        if (payload)
+            owr_message_data_unref(payload);
+        if (data)
+            g_hash_table_unref(data);
+        return;
+    }
 
-    message = _owr_message_new(origin, type, sub_type, data);
+    message = _owr_message_new(origin, type, sub_type, payload, data);
     GST_TRACE_OBJECT(origin, "posting message %p", message);
 
     bus_set = owr_message_origin_get_bus_set(origin);
@@ -130,3 +198,34 @@ void owr_message_origin_post_message(OwrMessageOrigin *origin, OwrMessageType ty
     g_mutex_unlock(&bus_set->mutex);
 }
 
+/**
+ * owr_message_origin_post_message:
+ * @origin: (transfer none): the origin that is posting the message
+ * @type: the #OwrMessageType of the message
+ * @sub_type: the #OwrMessageSubType of the message
+ * @data: (element-type utf8 GValue) (nullable) (transfer full): extra data
+ *
+ * Post a new message to all buses that are subscribed to @origin
+ */
+void owr_message_origin_post_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data)
+{
+    g_return_if_fail(OWR_IS_MESSAGE_ORIGIN(origin));
+
+    post_message(origin, type, sub_type, NULL, data);
+}
+
+/**
+ * owr_message_origin_post_message_data:
+ * @origin: (transfer none): the origin that is posting the message
+ * @type: the #OwrMessageType of the message
+ * @sub_type: the #OwrMessageSubType of the message
+ * @data: (nullable) (transfer full): extra data
+ *
+ * Like owr_message_origin_post_message(), but with the data in compact form
+ */
+void owr_message_origin_post_message_data(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, OwrMessageData *data)
+{
+    g_return_if_fail(OWR_IS_MESSAGE_ORIGIN(origin));
+
+    post_message(origin, type, sub_type, data, NULL);
+}
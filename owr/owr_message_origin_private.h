@@ -33,6 +33,7 @@
 #include "owr_message_origin.h"
 
 #include "owr_bus.h"
+#include "owr_message_data.h"
 
 #ifndef __GTK_DOC_IGNORE__
 
@@ -41,20 +42,36 @@ G_BEGIN_DECLS
 typedef struct {
     GHashTable *table;
     GMutex mutex;
+
+    /* OR of the message type masks of all buses in the table, valid as
+     * long as mask_generation matches the global subscription generation */
+    volatile gint message_type_mask;
+    volatile gint mask_generation;
 } OwrMessageOriginBusSet;
 
 OwrMessageOriginBusSet *owr_message_origin_bus_set_new();
 void owr_message_origin_bus_set_free(OwrMessageOriginBusSet *bus_set);
+void owr_message_origin_bus_set_invalidate_all(void);
 OwrMessageOriginBusSet *owr_message_origin_get_bus_set(OwrMessageOrigin *origin);
+gboolean owr_message_origin_has_subscribers(OwrMessageOrigin *origin, OwrMessageType type);
 void owr_message_origin_post_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data);
+void owr_message_origin_post_message_data(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, OwrMessageData *data);
 
-#define OWR_POST_MESSAGE(origin, type, sub_type, data) owr_message_origin_post_message\
+/* The data of these is an OwrMessageData built with the _owr_message_data_add functions */
+#define OWR_POST_MESSAGE(origin, type, sub_type, data) owr_message_origin_post_message_data\
     (OWR_MESSAGE_ORIGIN(origin), G_PASTE(OWR_MESSAGE_TYPE_, type)\
         , G_PASTE(G_PASTE(OWR_, type), G_PASTE(_TYPE_, sub_type)), data)
 #define OWR_POST_ERROR(origin, sub_type, data) OWR_POST_MESSAGE(origin, ERROR, sub_type, data)
 #define OWR_POST_STATS(origin, sub_type, data) OWR_POST_MESSAGE(origin, STATS, sub_type, data)
 #define OWR_POST_EVENT(origin, sub_type, data) OWR_POST_MESSAGE(origin, EVENT, sub_type, data)
 
+/* Use these to skip building message data that no bus would forward */
+#define OWR_HAS_SUBSCRIBERS(origin, type) owr_message_origin_has_subscribers\
+    (OWR_MESSAGE_ORIGIN(origin), G_PASTE(OWR_MESSAGE_TYPE_, type))
+#define OWR_WANTS_ERROR(origin) OWR_HAS_SUBSCRIBERS(origin, ERROR)
+#define OWR_WANTS_STATS(origin) OWR_HAS_SUBSCRIBERS(origin, STATS)
+#define OWR_WANTS_EVENT(origin) OWR_HAS_SUBSCRIBERS(origin, EVENT)
+
 G_END_DECLS
 
 #endif /* __GTK_DOC_IGNORE__ */
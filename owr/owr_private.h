@@ -43,8 +43,12 @@ G_BEGIN_DECLS
 /*< private >*/
 gboolean _owr_is_initialized(void);
 GMainContext * _owr_get_main_context(void);
+GMainContext * _owr_get_shard_main_context(gint *shard);
+void _owr_set_main_context_for_object(gpointer object, GMainContext *context);
+GMainContext * _owr_get_main_context_for_object(gpointer object);
 GstClockTime _owr_get_base_time(void);
 void _owr_schedule_with_user_data(GSourceFunc func, gpointer user_data);
+void _owr_schedule_with_user_data_on_context(GMainContext *context, GSourceFunc func, gpointer user_data);
 void _owr_schedule_with_hash_table(GSourceFunc func, GHashTable *hash_table);
 GHashTable *_owr_create_schedule_table_func(OwrMessageOrigin *origin, const gchar *function_name);
 
@@ -107,3 +107,56 @@ if (g_once_init_enter((gsize *)&id)) {
 
 return id;
 }
+
+GType owr_link_policy_get_type(void)
+{
+    static const GEnumValue types[] = {
+        {OWR_LINK_POLICY_BLOCK, "Block the source when the consumer is full", "block"},
+        {OWR_LINK_POLICY_LEAK_OLDEST, "Drop the oldest queued buffer when the consumer is full", "leak-oldest"},
+        {OWR_LINK_POLICY_LEAK_NEWEST, "Drop the incoming buffer when the consumer is full", "leak-newest"},
+        {0, NULL, NULL}
+    };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *)&id)) {
+        GType _id = g_enum_register_static("OwrLinkPolicies", types);
+        g_once_init_leave((gsize *)&id, _id);
+    }
+
+    return id;
+}
+
+GType owr_frame_format_get_type(void)
+{
+    static const GEnumValue types[] = {
+        {OWR_FRAME_FORMAT_I420, "Planar YUV 4:2:0", "i420"},
+        {OWR_FRAME_FORMAT_NV12, "Semi-planar YUV 4:2:0", "nv12"},
+        {OWR_FRAME_FORMAT_BGRA, "Packed 32 bit BGRA", "bgra"},
+        {0, NULL, NULL}
+    };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *)&id)) {
+        GType _id = g_enum_register_static("OwrFrameFormats", types);
+        g_once_init_leave((gsize *)&id, _id);
+    }
+
+    return id;
+}
+
+GType owr_replay_pacing_get_type(void)
+{
+    static const GEnumValue types[] = {
+        {OWR_REPLAY_PACING_ORIGINAL, "Replay packets with their recorded timing", "original"},
+        {OWR_REPLAY_PACING_FAST, "Replay packets as fast as they are consumed", "fast"},
+        {0, NULL, NULL}
+    };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *)&id)) {
+        GType _id = g_enum_register_static("OwrReplayPacings", types);
+        g_once_init_leave((gsize *)&id, _id);
+    }
+
+    return id;
+}
@@ -62,6 +62,23 @@ typedef enum _OwrAdaptationType {
     OWR_ADAPTATION_TYPE_SCREAM
 } OwrAdaptationType;
 
+typedef enum _OwrLinkPolicy {
+    OWR_LINK_POLICY_BLOCK,
+    OWR_LINK_POLICY_LEAK_OLDEST,
+    OWR_LINK_POLICY_LEAK_NEWEST
+} OwrLinkPolicy;
+
+typedef enum _OwrFrameFormat {
+    OWR_FRAME_FORMAT_I420,
+    OWR_FRAME_FORMAT_NV12,
+    OWR_FRAME_FORMAT_BGRA
+} OwrFrameFormat;
+
+typedef enum _OwrReplayPacing {
+    OWR_REPLAY_PACING_ORIGINAL,
+    OWR_REPLAY_PACING_FAST
+} OwrReplayPacing;
+
 #define OWR_TYPE_CODEC_TYPE (owr_codec_type_get_type())
 GType owr_codec_type_get_type(void);
 
@@ -74,6 +91,15 @@ GType owr_media_type_get_type(void);
 #define OWR_TYPE_ADAPTATION_TYPE (owr_adaptation_type_get_type())
 GType owr_adaptation_type_get_type(void);
 
+#define OWR_TYPE_LINK_POLICY (owr_link_policy_get_type())
+GType owr_link_policy_get_type(void);
+
+#define OWR_TYPE_FRAME_FORMAT (owr_frame_format_get_type())
+GType owr_frame_format_get_type(void);
+
+#define OWR_TYPE_REPLAY_PACING (owr_replay_pacing_get_type())
+GType owr_replay_pacing_get_type(void);
+
 
 G_END_DECLS
 
@@ -220,6 +220,108 @@ int _owr_rotation_and_mirror_to_video_flip_method(guint rotation, gboolean mirro
     }
 }
 
+/* Every videoflip method is a clockwise rotation followed by an optional
+ * horizontal flip, like the GStreamer image orientations. The CVO byte of the
+ * 3GPP video orientation header extension has the flip in bit 2 and the
+ * rotation in bits 0-1. */
+static const guint8 flip_method_to_cvo[] = {0, 1, 2, 3, 4, 6, 5, 7};
+static const gint cvo_to_flip_method[] = {0, 1, 2, 3, 4, 6, 5, 7};
+
+/* Returns the videoflip method doing @first and then @second */
+gint _owr_video_flip_method_compose(gint first, gint second)
+{
+    guint8 a, b, rotation;
+
+    g_return_val_if_fail(first >= 0 && first < 8, second);
+    g_return_val_if_fail(second >= 0 && second < 8, first);
+
+    a = flip_method_to_cvo[first];
+    b = flip_method_to_cvo[second];
+    /* A flip reverses the direction of the rotations done after it */
+    rotation = ((a & 3) + ((a & 4) ? 4 - (b & 3) : (b & 3))) & 3;
+
+    return cvo_to_flip_method[((a ^ b) & 4) | rotation];
+}
+
+guint8 _owr_video_flip_method_to_cvo(gint flip_method)
+{
+    g_return_val_if_fail(flip_method >= 0 && flip_method < 8, 0);
+
+    return flip_method_to_cvo[flip_method];
+}
+
+gint _owr_cvo_to_video_flip_method(guint8 cvo)
+{
+    /* The camera bit (3) does not change how the frames are rendered */
+    return cvo_to_flip_method[cvo & 7];
+}
+
+#define VIDEO_ORIENTATION_EVENT_NAME "OwrVideoOrientation"
+
+/* Sticky event carrying the orientation signalled by the sender of a
+ * received video stream, to be applied at render time */
+GstEvent *_owr_video_orientation_event_new(gint flip_method)
+{
+    return gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM_STICKY,
+        gst_structure_new(VIDEO_ORIENTATION_EVENT_NAME, "method", G_TYPE_INT, flip_method, NULL));
+}
+
+gboolean _owr_video_orientation_event_parse(GstEvent *event, gint *flip_method)
+{
+    const GstStructure *structure;
+
+    g_return_val_if_fail(GST_IS_EVENT(event), FALSE);
+
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_DOWNSTREAM_STICKY)
+        return FALSE;
+
+    structure = gst_event_get_structure(event);
+    if (!gst_structure_has_name(structure, VIDEO_ORIENTATION_EVENT_NAME))
+        return FALSE;
+
+    return gst_structure_get_int(structure, "method", flip_method)
+        && *flip_method >= 0 && *flip_method < 8;
+}
+
+static GstPadProbeReturn apply_video_orientation(GstPad *pad, GstPadProbeInfo *info,
+    GstElement *flip)
+{
+    gint flip_method;
+
+    OWR_UNUSED(pad);
+
+    if (_owr_video_orientation_event_parse(GST_PAD_PROBE_INFO_EVENT(info), &flip_method))
+        g_object_set(flip, "method", flip_method, NULL);
+
+    return GST_PAD_PROBE_OK;
+}
+
+/**
+ * _owr_video_orientation_flip_new:
+ * @name: (allow-none): the name of the element
+ *
+ * For renderers without a rotation of their own: a videoflip that applies the
+ * orientation carried by the events from _owr_video_orientation_event_new().
+ *
+ * Returns: (transfer floating): the videoflip, or %NULL if it isn't available
+ */
+GstElement *_owr_video_orientation_flip_new(const gchar *name)
+{
+    GstElement *flip;
+    GstPad *sinkpad;
+
+    flip = gst_element_factory_make("videoflip", name);
+    if (!flip)
+        return NULL;
+
+    sinkpad = gst_element_get_static_pad(flip, "sink");
+    gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback)apply_video_orientation, flip, NULL);
+    gst_object_unref(sinkpad);
+
+    return flip;
+}
+
 static void value_slice_free(gpointer value)
 {
     g_value_unset(value);
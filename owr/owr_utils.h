@@ -60,6 +60,12 @@ void _owr_deep_notify(GObject *object, GstObject *orig,
     GParamSpec *pspec, gpointer user_data);
 
 int _owr_rotation_and_mirror_to_video_flip_method(guint rotation, gboolean mirror);
+gint _owr_video_flip_method_compose(gint first, gint second);
+guint8 _owr_video_flip_method_to_cvo(gint flip_method);
+gint _owr_cvo_to_video_flip_method(guint8 cvo);
+GstEvent *_owr_video_orientation_event_new(gint flip_method);
+gboolean _owr_video_orientation_event_parse(GstEvent *event, gint *flip_method);
+GstElement *_owr_video_orientation_flip_new(const gchar *name);
 
 GHashTable *_owr_value_table_new();
 GValue *_owr_value_table_add(GHashTable *table, const gchar *key, GType type);
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "bench_utils.h"
+
+#include <gst/video/video.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/* 32 bits of value followed by 8 check bits */
+#define STAMP_BITS 40
+#define STAMP_HEIGHT 32
+#define STAMP_BLACK 16
+#define STAMP_WHITE 235
+
+static guint8 stamp_check(guint32 value)
+{
+    /* The constant keeps an all black row from reading as a stamp of 0 */
+    return (value ^ (value >> 8) ^ (value >> 16) ^ (value >> 24) ^ 0x5a) & 0xff;
+}
+
+static gboolean map_frame(GstVideoFrame *frame, GstBuffer *buffer, GstCaps *caps,
+    GstMapFlags flags)
+{
+    GstVideoInfo info;
+
+    if (!gst_video_info_from_caps(&info, caps)
+        || GST_VIDEO_INFO_FORMAT(&info) != GST_VIDEO_FORMAT_I420
+        || GST_VIDEO_INFO_WIDTH(&info) < STAMP_BITS || GST_VIDEO_INFO_HEIGHT(&info) < STAMP_HEIGHT)
+        return FALSE;
+
+    return gst_video_frame_map(frame, &info, buffer, flags);
+}
+
+/* @buffer must be writable and hold an I420 frame */
+void bench_write_stamp(GstBuffer *buffer, GstCaps *caps, guint32 value)
+{
+    GstVideoFrame frame;
+    guint64 bits;
+    guint8 *row;
+    gint block_width, stride, x, y, plane;
+
+    if (!map_frame(&frame, buffer, caps, GST_MAP_WRITE))
+        return;
+
+    bits = ((guint64)value << 8) | stamp_check(value);
+    block_width = GST_VIDEO_FRAME_WIDTH(&frame) / STAMP_BITS;
+    stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+
+    for (y = 0; y < STAMP_HEIGHT; y++) {
+        row = (guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, 0) + y * stride;
+        for (x = 0; x < STAMP_BITS * block_width; x++)
+            row[x] = (bits >> (STAMP_BITS - 1 - x / block_width)) & 1 ? STAMP_WHITE : STAMP_BLACK;
+    }
+
+    /* Grey chroma keeps the blocks sharp after subsampling */
+    for (plane = 1; plane < 3; plane++) {
+        stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, plane);
+        for (y = 0; y < STAMP_HEIGHT / 2; y++) {
+            row = (guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, plane) + y * stride;
+            for (x = 0; x < STAMP_BITS * block_width / 2; x++)
+                row[x] = 128;
+        }
+    }
+
+    gst_video_frame_unmap(&frame);
+}
+
+/* Returns FALSE if the frame doesn't carry a readable stamp */
+gboolean bench_read_stamp(GstBuffer *buffer, GstCaps *caps, guint32 *value)
+{
+    GstVideoFrame frame;
+    guint64 bits = 0;
+    const guint8 *data;
+    guint sum, count;
+    gint block_width, stride, bit, x, y;
+
+    if (!map_frame(&frame, buffer, caps, GST_MAP_READ))
+        return FALSE;
+
+    block_width = GST_VIDEO_FRAME_WIDTH(&frame) / STAMP_BITS;
+    stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+    data = GST_VIDEO_FRAME_PLANE_DATA(&frame, 0);
+
+    /* Only the middle of each block is read, its edges blur */
+    for (bit = 0; bit < STAMP_BITS; bit++) {
+        sum = count = 0;
+        for (y = STAMP_HEIGHT / 4; y < STAMP_HEIGHT * 3 / 4; y++) {
+            for (x = bit * block_width + block_width / 4; x < (bit + 1) * block_width - block_width / 4; x++) {
+                sum += data[y * stride + x];
+                count++;
+            }
+        }
+        bits = (bits << 1) | (count && sum / count > (STAMP_BLACK + STAMP_WHITE) / 2);
+    }
+
+    gst_video_frame_unmap(&frame);
+
+    *value = bits >> 8;
+    return (bits & 0xff) == stamp_check(*value);
+}
+
+/* Reads an integer value of an on-new-stats table */
+gboolean bench_get_stat(GHashTable *stats, const gchar *key, guint64 *value)
+{
+    GValue *stat, uint64_value = G_VALUE_INIT;
+    gboolean ok;
+
+    stat = g_hash_table_lookup(stats, key);
+    if (!stat)
+        return FALSE;
+
+    g_value_init(&uint64_value, G_TYPE_UINT64);
+    ok = g_value_transform(stat, &uint64_value);
+    if (ok)
+        *value = g_value_get_uint64(&uint64_value);
+    g_value_unset(&uint64_value);
+
+    return ok;
+}
+
+/* @sorted_values holds gint64 in ascending order */
+gint64 bench_percentile(GArray *sorted_values, gdouble fraction)
+{
+    guint index;
+
+    if (!sorted_values->len)
+        return 0;
+
+    index = MIN((guint)(fraction * sorted_values->len), sorted_values->len - 1);
+    return g_array_index(sorted_values, gint64, index);
+}
+
+/* User and system CPU time of the process, in microseconds */
+gint64 bench_get_cpu_time(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+
+    return (gint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/* Thread count and resident set size in kB, from /proc where available */
+gboolean bench_get_process_status(guint *n_threads, guint64 *rss_kb)
+{
+    gchar *contents, **lines, **line;
+    gboolean have_threads = FALSE, have_rss = FALSE;
+
+    if (!g_file_get_contents("/proc/self/status", &contents, NULL, NULL))
+        return FALSE;
+
+    lines = g_strsplit(contents, "\n", -1);
+    for (line = lines; *line; line++) {
+        if (g_str_has_prefix(*line, "Threads:")) {
+            *n_threads = (guint)g_ascii_strtoull(*line + strlen("Threads:"), NULL, 10);
+            have_threads = TRUE;
+        } else if (g_str_has_prefix(*line, "VmRSS:")) {
+            *rss_kb = g_ascii_strtoull(*line + strlen("VmRSS:"), NULL, 10);
+            have_rss = TRUE;
+        }
+    }
+    g_strfreev(lines);
+    g_free(contents);
+
+    return have_threads && have_rss;
+}
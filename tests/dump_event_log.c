@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+
+/* Prints an event log written by owr_transport_agent_start_event_log() as
+ * one line of space separated key=value fields per record. */
+
+#include <stdio.h>
+#include <string.h>
+
+#define OWR_EVENT_LOG_FORMAT_ONLY
+#include "owr_event_log.h"
+
+static const gchar *type_names[] = {
+    NULL, "rtp-in", "rtp-out", "rtcp-in", "rtcp-out", "scream-feedback", "bitrate",
+    "ice-state", "dtls-state", "dropped"
+};
+
+static guint32 read_uint32(const guint8 *data)
+{
+    guint32 value;
+
+    memcpy(&value, data, sizeof(value));
+    return GUINT32_FROM_LE(value);
+}
+
+static guint64 read_uint64(const guint8 *data)
+{
+    guint64 value;
+
+    memcpy(&value, data, sizeof(value));
+    return GUINT64_FROM_LE(value);
+}
+
+static void print_record(const guint8 *data)
+{
+    guint64 time = read_uint64(data);
+    guint type = data[8], a = data[9], b = data[10] | data[11] << 8;
+    guint32 session_id = read_uint32(data + 12), c = read_uint32(data + 16),
+        d = read_uint32(data + 20), e = read_uint32(data + 24), f = read_uint32(data + 28);
+
+    g_print("%" G_GUINT64_FORMAT ".%06u %s session=%u", time / G_USEC_PER_SEC,
+        (guint)(time % G_USEC_PER_SEC),
+        type < G_N_ELEMENTS(type_names) && type_names[type] ? type_names[type] : "unknown",
+        session_id);
+
+    switch (type) {
+    case OWR_EVENT_LOG_TYPE_RTP_IN:
+    case OWR_EVENT_LOG_TYPE_RTP_OUT:
+        g_print(" pt=%u marker=%u seq=%u ssrc=%u timestamp=%u size=%u", a & 0x7f, a >> 7, b,
+            c, d, e);
+        if (type == OWR_EVENT_LOG_TYPE_RTP_IN)
+            g_print(" arrival=%u", f);
+        break;
+    case OWR_EVENT_LOG_TYPE_RTCP_IN:
+    case OWR_EVENT_LOG_TYPE_RTCP_OUT:
+        g_print(" type=%u count=%u ssrc=%u media-ssrc=%u size=%u", a, b, c, d, e);
+        break;
+    case OWR_EVENT_LOG_TYPE_SCREAM_FEEDBACK:
+        g_print(" media-ssrc=%u highest-seq=%u timestamp=%u n-loss=%u n-ecn=%u", c, b, d, e, f);
+        break;
+    case OWR_EVENT_LOG_TYPE_BITRATE:
+        g_print(" pt=%u ssrc=%u bitrate=%u", a, c, d);
+        break;
+    case OWR_EVENT_LOG_TYPE_ICE_STATE:
+    case OWR_EVENT_LOG_TYPE_DTLS_STATE:
+        g_print(" component=%u state=%u", a, b);
+        break;
+    case OWR_EVENT_LOG_TYPE_DROPPED:
+        g_print(" count=%u", e);
+        break;
+    default:
+        break;
+    }
+    g_print("\n");
+}
+
+int main(int argc, char **argv)
+{
+    guint8 header[OWR_EVENT_LOG_HEADER_SIZE], *record;
+    guint32 record_size;
+    FILE *file;
+
+    if (argc != 2) {
+        g_printerr("Usage: %s <event log>\n", argv[0]);
+        return 1;
+    }
+
+    file = fopen(argv[1], "rb");
+    if (!file) {
+        g_printerr("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fread(header, sizeof(header), 1, file) != 1
+        || memcmp(header, OWR_EVENT_LOG_MAGIC, 8)
+        || read_uint32(header + 8) != OWR_EVENT_LOG_VERSION) {
+        g_printerr("%s is not a version %u event log\n", argv[1], OWR_EVENT_LOG_VERSION);
+        fclose(file);
+        return 1;
+    }
+
+    /* Records may grow in later versions, unknown fields are skipped */
+    record_size = read_uint32(header + 12);
+    if (record_size < OWR_EVENT_LOG_RECORD_SIZE) {
+        g_printerr("Invalid record size %u\n", record_size);
+        fclose(file);
+        return 1;
+    }
+
+    g_print("# start=%" G_GINT64_FORMAT "\n", (gint64)read_uint64(header + 16));
+
+    record = g_malloc(record_size);
+    while (fread(record, record_size, 1, file) == 1)
+        print_record(record);
+    g_free(record);
+
+    fclose(file);
+    return 0;
+}
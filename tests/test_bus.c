@@ -288,6 +288,44 @@ static void test_message_type_mask()
     g_object_unref(bus);
 }
 
+static void test_has_subscribers()
+{
+    OwrBus *bus;
+    OwrBus *bus2;
+    OwrMessageOrigin *origin;
+
+    origin = mock_origin_new();
+    g_assert(!OWR_WANTS_ERROR(origin));
+    g_assert(!OWR_WANTS_STATS(origin));
+    g_assert(!OWR_WANTS_EVENT(origin));
+
+    bus = owr_bus_new();
+    g_object_set(bus, "message-type-mask", OWR_MESSAGE_TYPE_EVENT, NULL);
+    owr_bus_add_message_origin(bus, origin);
+    g_assert(!OWR_WANTS_STATS(origin));
+    g_assert(OWR_WANTS_EVENT(origin));
+
+    bus2 = owr_bus_new();
+    owr_bus_add_message_origin(bus2, origin);
+    g_assert(OWR_WANTS_ERROR(origin));
+    g_assert(OWR_WANTS_STATS(origin));
+
+    g_object_set(bus2, "message-type-mask", OWR_MESSAGE_TYPE_ERROR, NULL);
+    g_assert(OWR_WANTS_ERROR(origin));
+    g_assert(!OWR_WANTS_STATS(origin));
+    g_assert(OWR_WANTS_EVENT(origin));
+
+    owr_bus_remove_message_origin(bus, origin);
+    g_assert(!OWR_WANTS_EVENT(origin));
+
+    g_object_unref(bus2);
+    g_assert(!OWR_WANTS_ERROR(origin));
+    mock_origin_assert_bus_table_size(origin, 0);
+
+    g_object_unref(bus);
+    g_object_unref(origin);
+}
+
 static GPtrArray *create_buses(guint count)
 {
     GPtrArray *buses;
@@ -530,6 +568,246 @@ static void test_refcounting()
     g_weak_ref_clear(&weak_ref);
 }
 
+typedef struct {
+    GAsyncQueue *queue;
+    GAsyncQueue *entered;
+    GMutex gate;
+} GatedCallbackData;
+
+static void on_gated_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, GHashTable *data, gpointer user_data)
+{
+    GatedCallbackData *gated = user_data;
+    OWR_UNUSED(origin);
+    OWR_UNUSED(type);
+    OWR_UNUSED(data);
+
+    g_async_queue_push(gated->entered, GINT_TO_POINTER(1));
+    g_mutex_lock(&gated->gate);
+    g_mutex_unlock(&gated->gate);
+    g_async_queue_push(gated->queue, GINT_TO_POINTER(sub_type + 1));
+}
+
+static void on_gated_message_batch(guint n_messages, OwrMessageOrigin **origins, OwrMessageType *types, OwrMessageSubType *sub_types, GHashTable **data, gpointer user_data)
+{
+    GatedCallbackData *gated = user_data;
+    OWR_UNUSED(origins);
+    OWR_UNUSED(types);
+    OWR_UNUSED(sub_types);
+    OWR_UNUSED(data);
+
+    g_async_queue_push(gated->entered, GINT_TO_POINTER(1));
+    g_mutex_lock(&gated->gate);
+    g_mutex_unlock(&gated->gate);
+    g_async_queue_push(gated->queue, GUINT_TO_POINTER(n_messages));
+}
+
+static void on_gated_message_data_batch(guint n_messages, OwrMessageOrigin **origins, OwrMessageType *types, OwrMessageSubType *sub_types, OwrMessageData **data, gpointer user_data)
+{
+    GatedCallbackData *gated = user_data;
+    OWR_UNUSED(origins);
+    OWR_UNUSED(types);
+    OWR_UNUSED(sub_types);
+    OWR_UNUSED(data);
+
+    g_async_queue_push(gated->entered, GINT_TO_POINTER(1));
+    g_mutex_lock(&gated->gate);
+    g_mutex_unlock(&gated->gate);
+    g_async_queue_push(gated->queue, GUINT_TO_POINTER(n_messages));
+}
+
+static void assert_dropped_count(OwrBus *bus, OwrMessageType type, guint64 expected_count)
+{
+    guint64 count = owr_bus_get_dropped_message_count(bus, type);
+
+    if (count != expected_count) {
+        g_print("** ERROR ** dropped message count assertion failed:\n");
+        g_print("expected %" G_GUINT64_FORMAT " dropped messages of type %d\n", expected_count, type);
+        g_print("but got: %" G_GUINT64_FORMAT "\n", count);
+        exit(-1);
+    }
+}
+
+static void expect_batch_received(GAsyncQueue *queue, guint expected_size)
+{
+    guint size = GPOINTER_TO_UINT(g_async_queue_pop(queue));
+
+    if (size != expected_size) {
+        g_print("** ERROR ** batch assertion failed:\n");
+        g_print("expected batch size: %u\n", expected_size);
+        g_print("but got: %u\n", size);
+        exit(-1);
+    }
+}
+
+static void test_drop_policies()
+{
+    OwrBus *bus;
+    OwrMessageOrigin *origin;
+    GatedCallbackData gated;
+
+    gated.queue = g_async_queue_new();
+    gated.entered = g_async_queue_new();
+    g_mutex_init(&gated.gate);
+
+    bus = owr_bus_new();
+    g_object_set(bus, "max-queue-length", 2, "max-batch-size", 1, NULL);
+    owr_bus_set_message_callback(bus, on_gated_message, &gated, NULL);
+    origin = mock_origin_new();
+    owr_bus_add_message_origin(bus, origin);
+
+    /* block the bus thread in the callback so that the queue fills up */
+    g_mutex_lock(&gated.gate);
+    OWR_POST_EVENT(origin, TEST, NULL);
+    g_async_queue_pop(gated.entered);
+
+    OWR_POST_STATS(origin, TEST, NULL);
+    OWR_POST_STATS(origin, TEST, NULL);
+    OWR_POST_STATS(origin, TEST, NULL); /* evicts the oldest stats message */
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_STATS, 1);
+
+    OWR_POST_EVENT(origin, TEST, NULL); /* events are dropped when the queue is full */
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_EVENT, 1);
+
+    OWR_POST_ERROR(origin, TEST, NULL); /* errors are never dropped, but evict stats */
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_STATS, 2);
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_ERROR, 0);
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_STATS | OWR_MESSAGE_TYPE_EVENT, 3);
+
+    g_mutex_unlock(&gated.gate);
+    expect_message_received(gated.queue, OWR_EVENT_TYPE_TEST);
+    expect_message_received(gated.queue, OWR_STATS_TYPE_TEST);
+    expect_message_received(gated.queue, OWR_ERROR_TYPE_TEST);
+
+    g_object_unref(origin);
+    g_object_unref(bus);
+    g_mutex_clear(&gated.gate);
+    g_async_queue_unref(gated.entered);
+    g_async_queue_unref(gated.queue);
+}
+
+static void test_batching(gboolean with_data)
+{
+    OwrBus *bus;
+    OwrMessageOrigin *origin;
+    GatedCallbackData gated;
+    guint i;
+
+    gated.queue = g_async_queue_new();
+    gated.entered = g_async_queue_new();
+    g_mutex_init(&gated.gate);
+
+    bus = owr_bus_new();
+    g_object_set(bus, "max-batch-size", 4, NULL);
+    if (with_data)
+        owr_bus_set_message_data_batch_callback(bus, on_gated_message_data_batch, &gated, NULL);
+    else
+        owr_bus_set_message_batch_callback(bus, on_gated_message_batch, &gated, NULL);
+    origin = mock_origin_new();
+    owr_bus_add_message_origin(bus, origin);
+
+    g_mutex_lock(&gated.gate);
+    OWR_POST_STATS(origin, TEST, NULL);
+    g_async_queue_pop(gated.entered);
+
+    for (i = 0; i < 6; i++)
+        OWR_POST_STATS(origin, TEST, NULL);
+    g_mutex_unlock(&gated.gate);
+
+    expect_batch_received(gated.queue, 1);
+    expect_batch_received(gated.queue, 4);
+    expect_batch_received(gated.queue, 2);
+    assert_dropped_count(bus, OWR_MESSAGE_TYPE_STATS, 0);
+
+    g_object_unref(origin);
+    g_object_unref(bus);
+    g_mutex_clear(&gated.gate);
+    g_async_queue_unref(gated.entered);
+    g_async_queue_unref(gated.queue);
+}
+
+static void on_data_message(OwrMessageOrigin *origin, OwrMessageType type, OwrMessageSubType sub_type, OwrMessageData *data, gpointer user_data)
+{
+    OWR_UNUSED(origin);
+    OWR_UNUSED(type);
+    OWR_UNUSED(sub_type);
+
+    g_assert(data);
+    g_async_queue_push(user_data, owr_message_data_ref(data));
+}
+
+static void value_free(GValue *value)
+{
+    g_value_unset(value);
+    g_free(value);
+}
+
+static GValue *value_table_add(GHashTable *table, const gchar *key, GType type)
+{
+    GValue *value = g_new0(GValue, 1);
+
+    g_value_init(value, type);
+    g_hash_table_insert(table, g_strdup(key), value);
+    return value;
+}
+
+static void test_message_data()
+{
+    OwrBus *bus;
+    OwrMessageOrigin *origin;
+    GAsyncQueue *queue;
+    OwrMessageData *data;
+    GHashTable *table;
+    GValue *value, copy = G_VALUE_INIT;
+    gint64 int_value = 0;
+    guint64 uint_value = 0;
+
+    queue = g_async_queue_new();
+    bus = owr_bus_new();
+    owr_bus_set_message_data_callback(bus, on_data_message, queue, NULL);
+    origin = mock_origin_new();
+    owr_bus_add_message_origin(bus, origin);
+
+    table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) value_free);
+    value = value_table_add(table, "start_time", G_TYPE_INT64);
+    g_value_set_int64(value, -42);
+    value = value_table_add(table, "count", G_TYPE_UINT);
+    g_value_set_uint(value, 7);
+    value = value_table_add(table, "function_name", G_TYPE_STRING);
+    g_value_set_string(value, "test_message_data");
+    value = value_table_add(table, "message_type", OWR_TYPE_MESSAGE_TYPE);
+    g_value_set_flags(value, OWR_MESSAGE_TYPE_STATS);
+    owr_message_origin_post_message(origin, OWR_MESSAGE_TYPE_STATS, OWR_STATS_TYPE_TEST, table);
+
+    data = g_async_queue_pop(queue);
+    g_assert(owr_message_data_get_size(data) == 4);
+    g_assert(owr_message_data_get_int64(data, "start_time", &int_value));
+    g_assert(int_value == -42);
+    g_assert(owr_message_data_get_uint64(data, "count", &uint_value));
+    g_assert(uint_value == 7);
+    g_assert(!owr_message_data_get_int64(data, "count", &int_value));
+    g_assert(!g_strcmp0(owr_message_data_get_string(data, "function_name"), "test_message_data"));
+    g_assert(owr_message_data_get_value_type(data, "count") == G_TYPE_UINT);
+    g_assert(owr_message_data_get_value_type(data, "no-such-key") == G_TYPE_INVALID);
+    g_assert(!owr_message_data_get_value(data, "no-such-key", &copy));
+    g_assert(owr_message_data_get_value(data, "message_type", &copy));
+    g_assert(g_value_get_flags(&copy) == OWR_MESSAGE_TYPE_STATS);
+    g_value_unset(&copy);
+
+    table = owr_message_data_to_hash_table(data);
+    g_assert(g_hash_table_size(table) == 4);
+    value = g_hash_table_lookup(table, "count");
+    g_assert(G_VALUE_HOLDS_UINT(value));
+    g_assert(g_value_get_uint(value) == 7);
+    value = g_hash_table_lookup(table, "function_name");
+    g_assert(!g_strcmp0(g_value_get_string(value), "test_message_data"));
+    g_hash_table_unref(table);
+    owr_message_data_unref(data);
+
+    g_object_unref(origin);
+    g_object_unref(bus);
+    g_async_queue_unref(queue);
+}
+
 int main()
 {
     guint64 start_time;
@@ -546,9 +824,14 @@ int main()
 
     test_illegal_argument_warnings();
     test_message_type_mask();
+    test_has_subscribers();
     test_destruction();
     test_mass_messaging();
     test_refcounting();
+    test_drop_policies();
+    test_batching(FALSE);
+    test_batching(TRUE);
+    test_message_data();
 
     end_time = g_get_monotonic_time();
 
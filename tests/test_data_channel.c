@@ -30,13 +30,25 @@
 #include "owr_transport_agent.h"
 #include "test_utils.h"
 
+#include <gio/gio.h>
 #include <string.h>
 
+#define THROUGHPUT_CHUNK_SIZE 16384
+#define THROUGHPUT_MAX_BUFFERED_AMOUNT (4 * 1024 * 1024)
+#define LINK_MAX_PACKET_SIZE 65536
+#define LINK_TICK_MS 1
+
 static gboolean wait_for_dtls;
 static guint channel_id = 1;
+static gint throughput_seconds = 0;
+static gint link_delay = 0;
+static gdouble link_loss = 0.0;
 
 static GOptionEntry entries[] = {
     { "wait-dtls", 0, 0, G_OPTION_ARG_NONE, &wait_for_dtls, "Wait for DTLS handshake to complete", NULL },
+    { "throughput", 't', 0, G_OPTION_ARG_INT, &throughput_seconds, "Run a throughput test for the given number of seconds", "SECONDS" },
+    { "link-delay", 0, 0, G_OPTION_ARG_INT, &link_delay, "Relay all traffic over an emulated link with this one-way delay", "MS" },
+    { "link-loss", 0, 0, G_OPTION_ARG_DOUBLE, &link_loss, "Percentage of packets dropped by the emulated link", "PERCENT" },
     { NULL, }
 };
 
@@ -205,10 +217,343 @@ static gboolean run_prenegotiated_channel_test(gboolean wait_until_ready)
     return run_datachannel_test("prenegotiated", left, right);
 }
 
+typedef struct {
+    GMutex mutex;
+    guint64 bytes;
+    /* Monotonic time of the last received chunk */
+    gint64 last_time;
+} ThroughputCounter;
+
+static void on_throughput_data(OwrDataChannel *data_channel, const gchar *data, guint length, ThroughputCounter *received)
+{
+    (void) data_channel;
+    (void) data;
+    g_mutex_lock(&received->mutex);
+    received->bytes += length;
+    received->last_time = g_get_monotonic_time();
+    g_mutex_unlock(&received->mutex);
+}
+
+static gboolean run_throughput_test(gint duration)
+{
+    OwrDataChannel *left;
+    OwrDataChannel *right;
+    GAsyncQueue *msg_queue = g_async_queue_new();
+    guint8 *chunk;
+    guint id = channel_id++ * 2;
+    guint buffered_amount;
+    guint64 bytes_sent = 0;
+    guint64 bytes_received;
+    ThroughputCounter received;
+    gint64 start_time, stop_time, elapsed;
+    gboolean data_channels_ready;
+
+    g_print("\n >>> Running throughput test for %d seconds\n\n", duration);
+
+    g_mutex_init(&received.mutex);
+    received.bytes = 0;
+    received.last_time = 0;
+
+    left = owr_data_channel_new(TRUE, -1, -1, "throughput", TRUE, id, "throughput");
+    right = owr_data_channel_new(TRUE, -1, -1, "throughput", TRUE, id, "throughput");
+
+    g_signal_connect(left, "notify::ready-state", G_CALLBACK(on_ready_state), msg_queue);
+    g_signal_connect(right, "notify::ready-state", G_CALLBACK(on_ready_state), msg_queue);
+    g_signal_connect(right, "on-binary-data", G_CALLBACK(on_throughput_data), &received);
+
+    owr_data_session_add_data_channel(left_session, left);
+    owr_data_session_add_data_channel(right_session, right);
+
+    data_channels_ready = !!g_async_queue_timeout_pop(msg_queue, 5000000);
+    data_channels_ready &= !!g_async_queue_timeout_pop(msg_queue, 5000000);
+    g_signal_handlers_disconnect_by_data(left, msg_queue);
+    g_signal_handlers_disconnect_by_data(right, msg_queue);
+    g_async_queue_unref(msg_queue);
+
+    if (!data_channels_ready) {
+        g_print("[throughput] data channel setup timed out\n");
+        return FALSE;
+    }
+
+    chunk = g_malloc0(THROUGHPUT_CHUNK_SIZE);
+    start_time = g_get_monotonic_time();
+    stop_time = start_time + (gint64) duration * G_USEC_PER_SEC;
+
+    while (g_get_monotonic_time() < stop_time) {
+        g_object_get(left, "buffered-amount", &buffered_amount, NULL);
+        if (buffered_amount > THROUGHPUT_MAX_BUFFERED_AMOUNT) {
+            g_usleep(1000);
+            continue;
+        }
+        owr_data_channel_send_binary(left, chunk, THROUGHPUT_CHUNK_SIZE);
+        bytes_sent += THROUGHPUT_CHUNK_SIZE;
+    }
+
+    /* Let whatever is in flight drain, the clock stops at the last received byte */
+    do {
+        g_usleep(10000);
+        g_mutex_lock(&received.mutex);
+        bytes_received = received.bytes;
+        g_mutex_unlock(&received.mutex);
+    } while (bytes_received < bytes_sent && g_get_monotonic_time() < stop_time + 5 * G_USEC_PER_SEC);
+
+    g_free(chunk);
+    g_signal_handlers_disconnect_by_data(right, &received);
+
+    g_mutex_lock(&received.mutex);
+    bytes_received = received.bytes;
+    elapsed = MAX(received.last_time - start_time, 1);
+    g_mutex_unlock(&received.mutex);
+    g_mutex_clear(&received.mutex);
+
+    g_print("[throughput] sent %" G_GUINT64_FORMAT " bytes, received %" G_GUINT64_FORMAT
+        " bytes in %.2f s: %.2f Mbit/s\n", bytes_sent, bytes_received,
+        (gdouble) elapsed / G_USEC_PER_SEC, bytes_received * 8.0 / elapsed);
+
+    return bytes_received > 0 && bytes_received == bytes_sent;
+}
+
+/*
+ * Emulated link: when --link-delay or --link-loss is given, every UDP candidate
+ * is replaced by a relay on the loopback address of the candidate's family,
+ * IPv4 or IPv6, that forwards datagrams to the real candidate after the
+ * configured delay, dropping the configured share of them. All relay
+ * sockets are serviced from a single link thread, so the packet queue needs no
+ * locking.
+ */
+
+typedef struct {
+    GSocket *relay_socket;
+    GSocketAddress *target;
+    GHashTable *peers;
+} LinkRelay;
+
+typedef struct {
+    LinkRelay *relay;
+    GSocket *socket;
+    GSocketAddress *address;
+} LinkPeer;
+
+typedef struct {
+    GSocket *socket;
+    GSocketAddress *destination;
+    GBytes *data;
+    gint64 due_time;
+} LinkPacket;
+
+static GMainContext *link_context = NULL;
+static GQueue link_packets = G_QUEUE_INIT;
+
+static void link_send_later(GSocket *socket, GSocketAddress *destination, const gchar *data, gssize size)
+{
+    LinkPacket *packet;
+
+    if (link_loss > 0 && g_random_double_range(0, 100) < link_loss)
+        return;
+
+    packet = g_slice_new(LinkPacket);
+    packet->socket = g_object_ref(socket);
+    packet->destination = g_object_ref(destination);
+    packet->data = g_bytes_new(data, size);
+    packet->due_time = g_get_monotonic_time() + (gint64) link_delay * 1000;
+    g_queue_push_tail(&link_packets, packet);
+}
+
+static gboolean link_deliver(gpointer user_data)
+{
+    LinkPacket *packet;
+    gint64 now = g_get_monotonic_time();
+    gconstpointer data;
+    gsize size;
+
+    (void) user_data;
+
+    while ((packet = g_queue_peek_head(&link_packets)) && packet->due_time <= now) {
+        g_queue_pop_head(&link_packets);
+        data = g_bytes_get_data(packet->data, &size);
+        g_socket_send_to(packet->socket, packet->destination, data, size, NULL, NULL);
+        g_bytes_unref(packet->data);
+        g_object_unref(packet->destination);
+        g_object_unref(packet->socket);
+        g_slice_free(LinkPacket, packet);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSocket *link_socket_new(GSocketFamily family, GSourceFunc callback, gpointer user_data)
+{
+    GSocket *socket;
+    GInetAddress *inet_address;
+    GSocketAddress *address;
+    GSource *source;
+
+    socket = g_socket_new(family, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, NULL);
+    g_assert(socket);
+    g_socket_set_blocking(socket, FALSE);
+
+    inet_address = g_inet_address_new_loopback(family);
+    address = g_inet_socket_address_new(inet_address, 0);
+    g_object_unref(inet_address);
+    if (!g_socket_bind(socket, address, FALSE, NULL))
+        g_assert_not_reached();
+    g_object_unref(address);
+
+    source = g_socket_create_source(socket, G_IO_IN, NULL);
+    g_source_set_callback(source, callback, user_data, NULL);
+    g_source_attach(source, link_context);
+    g_source_unref(source);
+
+    return socket;
+}
+
+static gboolean on_link_peer_socket(GSocket *socket, GIOCondition condition, LinkPeer *peer)
+{
+    gchar buffer[LINK_MAX_PACKET_SIZE];
+    gssize size;
+
+    (void) condition;
+
+    /* Replies from the target go back to the peer through the relay socket */
+    while ((size = g_socket_receive_from(socket, NULL, buffer, sizeof(buffer), NULL, NULL)) > 0)
+        link_send_later(peer->relay->relay_socket, peer->address, buffer, size);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_link_relay_socket(GSocket *socket, GIOCondition condition, LinkRelay *relay)
+{
+    gchar buffer[LINK_MAX_PACKET_SIZE];
+    GSocketAddress *from = NULL;
+    GInetAddress *inet_address;
+    LinkPeer *peer;
+    gchar *address, *key;
+    gssize size;
+
+    (void) condition;
+
+    while ((size = g_socket_receive_from(socket, &from, buffer, sizeof(buffer), NULL, NULL)) > 0) {
+        inet_address = g_inet_socket_address_get_address(G_INET_SOCKET_ADDRESS(from));
+        address = g_inet_address_to_string(inet_address);
+        key = g_strdup_printf("%s:%u", address,
+            g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(from)));
+        g_free(address);
+
+        /* Each peer gets its own socket towards the target so replies can be told apart */
+        peer = g_hash_table_lookup(relay->peers, key);
+        if (!peer) {
+            peer = g_new0(LinkPeer, 1);
+            peer->relay = relay;
+            peer->address = g_object_ref(from);
+            peer->socket = link_socket_new(g_socket_address_get_family(relay->target),
+                (GSourceFunc) on_link_peer_socket, peer);
+            g_hash_table_insert(relay->peers, key, peer);
+        } else
+            g_free(key);
+
+        link_send_later(peer->socket, relay->target, buffer, size);
+        g_clear_object(&from);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* The relay listens on the loopback address of the same family as the target */
+static GInetSocketAddress *link_relay_new(const gchar *address, guint port)
+{
+    LinkRelay *relay;
+
+    relay = g_new0(LinkRelay, 1);
+    relay->target = g_inet_socket_address_new_from_string(address, port);
+    g_assert(relay->target);
+    relay->peers = g_hash_table_new(g_str_hash, g_str_equal);
+    relay->relay_socket = link_socket_new(g_socket_address_get_family(relay->target),
+        (GSourceFunc) on_link_relay_socket, relay);
+
+    return G_INET_SOCKET_ADDRESS(g_socket_get_local_address(relay->relay_socket, NULL));
+}
+
+static gpointer link_thread_func(GMainLoop *loop)
+{
+    g_main_context_push_thread_default(link_context);
+    g_main_loop_run(loop);
+    g_main_context_pop_thread_default(link_context);
+
+    return NULL;
+}
+
+static void setup_link_emulation(void)
+{
+    GMainLoop *loop;
+    GSource *source;
+
+    g_print("Emulating link with %d ms delay and %.2f %% loss\n", link_delay, link_loss);
+
+    link_context = g_main_context_new();
+    loop = g_main_loop_new(link_context, FALSE);
+
+    source = g_timeout_source_new(LINK_TICK_MS);
+    g_source_set_callback(source, link_deliver, NULL, NULL);
+    g_source_attach(source, link_context);
+    g_source_unref(source);
+
+    g_thread_new("link", (GThreadFunc) link_thread_func, loop);
+}
+
+static OwrCandidate *relay_candidate(OwrCandidate *candidate)
+{
+    OwrCandidate *relayed;
+    OwrCandidateType type;
+    OwrComponentType component_type;
+    OwrTransportType transport_type;
+    GInetSocketAddress *relay_address;
+    gchar *address, *base_address, *foundation, *ufrag, *password, *relay_host;
+    guint port, base_port, priority;
+
+    g_object_get(candidate, "type", &type, "component-type", &component_type,
+        "transport-type", &transport_type, "address", &address, "port", &port,
+        "base-address", &base_address, "base-port", &base_port, "priority", &priority,
+        "foundation", &foundation, "ufrag", &ufrag, "password", &password, NULL);
+
+    relayed = NULL;
+    if (transport_type == OWR_TRANSPORT_TYPE_UDP) {
+        relay_address = link_relay_new(address, port);
+        relay_host = g_inet_address_to_string(g_inet_socket_address_get_address(relay_address));
+
+        relayed = owr_candidate_new(type, component_type);
+        g_object_set(relayed, "transport-type", transport_type,
+            "address", relay_host, "port", (guint) g_inet_socket_address_get_port(relay_address),
+            "base-address", base_address, "base-port", base_port, "priority", priority,
+            "foundation", foundation, "ufrag", ufrag, "password", password, NULL);
+
+        g_free(relay_host);
+        g_object_unref(relay_address);
+    }
+
+    g_free(address);
+    g_free(base_address);
+    g_free(foundation);
+    g_free(ufrag);
+    g_free(password);
+
+    return relayed;
+}
+
 static void got_candidate(OwrSession *ignored, OwrCandidate *candidate, OwrSession *session)
 {
     (void) ignored;
-    owr_session_add_remote_candidate(OWR_SESSION(session), candidate);
+
+    if (!link_context) {
+        owr_session_add_remote_candidate(OWR_SESSION(session), candidate);
+        return;
+    }
+
+    /* Only UDP is relayed, so TCP candidates would bypass the emulated link */
+    candidate = relay_candidate(candidate);
+    if (candidate) {
+        owr_session_add_remote_candidate(OWR_SESSION(session), candidate);
+        g_object_unref(candidate);
+    }
 }
 
 static void on_dtls_peer_certificate(OwrDataSession *session, GParamSpec *pspec, GAsyncQueue *msg_queue)
@@ -291,11 +636,17 @@ int main(int argc, char **argv)
     owr_init(NULL);
     owr_run_in_background();
 
+    if (link_delay > 0 || link_loss > 0)
+        setup_link_emulation();
+
     if (setup_transport_agents()) {
         success_count += run_prenegotiated_channel_test(TRUE); test_count++;
         success_count += run_requested_channel_test(TRUE); test_count++;
         success_count += run_requested_channel_test(FALSE); test_count++;
         success_count += run_prenegotiated_channel_test(FALSE); test_count++;
+        if (throughput_seconds > 0) {
+            success_count += run_throughput_test(throughput_seconds); test_count++;
+        }
 
         g_print("\n%d / %d test were successful\n", success_count, test_count);
 
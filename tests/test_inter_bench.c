@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/* Measures buffers/s pushed through many concurrent OwrInterSink/OwrInterSrc
+ * pairs, each pair joining a fakesrc pipeline to a fakesink pipeline */
+
+#include "owr_inter_sink.h"
+#include "owr_inter_src.h"
+
+#include <gst/gst.h>
+#include <string.h>
+
+static gint n_pairs = 32;
+static gint n_buffers = 100000;
+static gchar *policy_name = NULL;
+static gint depth = 0;
+static gint consumer_delay = 0;
+
+static GOptionEntry entries[] = {
+    { "pairs", 'p', 0, G_OPTION_ARG_INT, &n_pairs, "Number of concurrent inter sink/src pairs", NULL },
+    { "buffers", 'n', 0, G_OPTION_ARG_INT, &n_buffers, "Number of buffers pushed through each pair", NULL },
+    { "policy", 'l', 0, G_OPTION_ARG_STRING, &policy_name, "Link policy: block, leak-oldest or leak-newest", NULL },
+    { "depth", 'd', 0, G_OPTION_ARG_INT, &depth, "Buffers queued per link before the policy applies", NULL },
+    { "consumer-delay", 'c', 0, G_OPTION_ARG_INT, &consumer_delay, "Microseconds the consumer spends on each buffer", NULL },
+    { NULL, }
+};
+
+static OwrLinkPolicy policy = OWR_LINK_POLICY_BLOCK;
+
+typedef struct {
+    GstElement *source_pipeline;
+    GstElement *sink_pipeline;
+    OwrInterLink *link;
+} InterPair;
+
+static void inter_pair_init(InterPair *pair)
+{
+    GstElement *fakesrc, *fakesink, *identity, *inter_sink, *inter_src;
+
+    pair->source_pipeline = gst_pipeline_new(NULL);
+    fakesrc = gst_element_factory_make("fakesrc", NULL);
+    g_object_set(fakesrc, "num-buffers", n_buffers, NULL);
+    inter_sink = g_object_new(OWR_TYPE_INTER_SINK, NULL);
+    gst_bin_add_many(GST_BIN(pair->source_pipeline), fakesrc, inter_sink, NULL);
+    gst_element_link(fakesrc, inter_sink);
+
+    pair->sink_pipeline = gst_pipeline_new(NULL);
+    inter_src = g_object_new(OWR_TYPE_INTER_SRC, NULL);
+    fakesink = gst_element_factory_make("fakesink", NULL);
+    g_object_set(fakesink, "sync", FALSE, NULL);
+    identity = gst_element_factory_make("identity", NULL);
+    g_object_set(identity, "sleep-time", consumer_delay, NULL);
+    gst_bin_add_many(GST_BIN(pair->sink_pipeline), inter_src, identity, fakesink, NULL);
+    gst_element_link_many(inter_src, identity, fakesink, NULL);
+
+    OWR_INTER_SRC(inter_src)->link = _owr_inter_link_new(OWR_INTER_SRC(inter_src)->internal_srcpad,
+        OWR_INTER_SINK(inter_sink)->sinkpad);
+    OWR_INTER_SINK(inter_sink)->link = _owr_inter_link_ref(OWR_INTER_SRC(inter_src)->link);
+    _owr_inter_src_set_link_policy(OWR_INTER_SRC(inter_src), policy, depth);
+    pair->link = _owr_inter_link_ref(OWR_INTER_SRC(inter_src)->link);
+}
+
+static gboolean inter_pair_wait_eos(InterPair *pair)
+{
+    GstBus *bus;
+    GstMessage *message;
+    gboolean eos;
+
+    bus = gst_element_get_bus(pair->sink_pipeline);
+    message = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    gst_object_unref(bus);
+
+    eos = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+    gst_message_unref(message);
+    return eos;
+}
+
+static void inter_pair_clear(InterPair *pair)
+{
+    gst_element_set_state(pair->source_pipeline, GST_STATE_NULL);
+    gst_element_set_state(pair->sink_pipeline, GST_STATE_NULL);
+    gst_object_unref(pair->source_pipeline);
+    gst_object_unref(pair->sink_pipeline);
+    _owr_inter_link_unref(pair->link);
+}
+
+int main(int argc, char **argv)
+{
+    GOptionContext *options;
+    GError *error = NULL;
+    InterPair *pairs;
+    gint64 start_time, elapsed, max_latency, pair_max_latency;
+    guint pushed, dropped, pair_pushed, pair_dropped;
+    gboolean ok = TRUE;
+    gint i;
+
+    options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, entries, NULL);
+    g_option_context_add_group(options, gst_init_get_option_group());
+    if (!g_option_context_parse(options, &argc, &argv, &error)) {
+        g_print("Failed to parse options: %s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(options);
+
+    if (n_pairs < 1 || n_buffers < 1 || depth < 0 || consumer_delay < 0) {
+        g_print("Need at least one pair and one buffer, and no negative values\n");
+        return 1;
+    }
+
+    if (!policy_name || !strcmp(policy_name, "block"))
+        policy = OWR_LINK_POLICY_BLOCK;
+    else if (!strcmp(policy_name, "leak-oldest"))
+        policy = OWR_LINK_POLICY_LEAK_OLDEST;
+    else if (!strcmp(policy_name, "leak-newest"))
+        policy = OWR_LINK_POLICY_LEAK_NEWEST;
+    else {
+        g_print("Unknown link policy: %s\n", policy_name);
+        return 1;
+    }
+
+    pairs = g_new0(InterPair, n_pairs);
+    for (i = 0; i < n_pairs; i++) {
+        inter_pair_init(&pairs[i]);
+        gst_element_set_state(pairs[i].sink_pipeline, GST_STATE_PLAYING);
+    }
+
+    start_time = g_get_monotonic_time();
+    for (i = 0; i < n_pairs; i++)
+        gst_element_set_state(pairs[i].source_pipeline, GST_STATE_PLAYING);
+
+    for (i = 0; i < n_pairs; i++)
+        ok &= inter_pair_wait_eos(&pairs[i]);
+    elapsed = g_get_monotonic_time() - start_time;
+
+    pushed = dropped = 0;
+    max_latency = 0;
+    for (i = 0; i < n_pairs; i++) {
+        _owr_inter_link_get_counters(pairs[i].link, &pair_pushed, &pair_dropped, &pair_max_latency);
+        pushed += pair_pushed;
+        dropped += pair_dropped;
+        max_latency = MAX(max_latency, pair_max_latency);
+        inter_pair_clear(&pairs[i]);
+    }
+    g_free(pairs);
+
+    if (!ok) {
+        g_print("A pipeline posted an error before EOS\n");
+        return 1;
+    }
+
+    g_print("%d pairs, %d buffers each: %.3f s, %.0f buffers/s\n", n_pairs, n_buffers,
+        elapsed / (gdouble) G_USEC_PER_SEC,
+        (gdouble) n_pairs * n_buffers * G_USEC_PER_SEC / MAX(elapsed, 1));
+    g_print("pushed %u, dropped %u, max latency %" G_GINT64_FORMAT " us\n", pushed, dropped, max_latency);
+
+    return 0;
+}
@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include "owr.h"
+#include "owr_audio_payload.h"
+#include "owr_data_channel.h"
+#include "owr_data_session.h"
+#include "owr_frame_renderer.h"
+#include "owr_gst_audio_renderer.h"
+#include "owr_gst_media_source.h"
+#include "owr_media_renderer.h"
+#include "owr_media_session.h"
+#include "owr_transport_agent.h"
+#include "owr_video_payload.h"
+#include "bench_utils.h"
+
+/* Streams media and data between pairs of transport agents over loopback,
+ * with host candidates only, and measures what arrives during a fixed time:
+ * rate and bitrate per stream, glass-to-glass latency of video frames, read
+ * from the capture time stamped into every frame, data channel throughput,
+ * and the CPU time spent by the process */
+
+#include <string.h>
+
+#define MAX_BUFFERED_AMOUNT (4 * 1024 * 1024)
+
+static gint n_pairs = 1;
+static gint duration = 10;
+static gint setup_timeout = 20;
+static gboolean disable_video = FALSE, disable_audio = FALSE, enable_data = FALSE;
+static gchar *codec_name = NULL;
+static gint width = 640, height = 480, framerate = 30;
+static gint message_size = 1024;
+static gboolean json = FALSE;
+
+static GOptionEntry entries[] = {
+    { "pairs", 'p', 0, G_OPTION_ARG_INT, &n_pairs, "Number of transport agent pairs", NULL },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Seconds to measure for", "SECONDS" },
+    { "setup-timeout", 0, 0, G_OPTION_ARG_INT, &setup_timeout, "Seconds to wait for all streams to flow", "SECONDS" },
+    { "disable-video", 0, 0, G_OPTION_ARG_NONE, &disable_video, "Disable video", NULL },
+    { "disable-audio", 0, 0, G_OPTION_ARG_NONE, &disable_audio, "Disable audio", NULL },
+    { "data", 0, 0, G_OPTION_ARG_NONE, &enable_data, "Add a data channel sending as fast as possible", NULL },
+    { "codec", 'c', 0, G_OPTION_ARG_STRING, &codec_name, "Video codec: vp8 or h264", NULL },
+    { "width", 0, 0, G_OPTION_ARG_INT, &width, "Video width", NULL },
+    { "height", 0, 0, G_OPTION_ARG_INT, &height, "Video height", NULL },
+    { "framerate", 0, 0, G_OPTION_ARG_INT, &framerate, "Video frames per second", NULL },
+    { "message-size", 0, 0, G_OPTION_ARG_INT, &message_size, "Size of the data channel messages", "BYTES" },
+    { "json", 'j', 0, G_OPTION_ARG_NONE, &json, "Print the results as JSON", NULL },
+    { NULL, }
+};
+
+static OwrCodecType video_codec = OWR_CODEC_TYPE_VP8;
+
+typedef struct {
+    OwrMediaType media_type;
+    gint pair;
+    OwrMediaSession *send_session;
+    OwrMediaSession *receive_session;
+    OwrMediaRenderer *renderer;
+
+    GMutex lock;
+    gboolean measuring;
+    guint32 ssrc;
+    guint64 packets, octets;
+    guint frames, unreadable_frames;
+    GArray *latencies;
+    /* First and last stats received while measuring */
+    gint64 first_stats_time, last_stats_time;
+    guint64 first_packets, last_packets;
+    guint64 first_octets, last_octets;
+} MediaStream;
+
+typedef struct {
+    gint pair;
+    OwrDataSession *left_session, *right_session;
+    OwrDataChannel *left_channel, *right_channel;
+    GThread *send_thread;
+
+    GMutex lock;
+    gboolean measuring;
+    guint64 messages, bytes;
+} DataStream;
+
+static GPtrArray *media_streams;
+static GPtrArray *data_streams;
+static volatile gint stop_sending = FALSE;
+
+static GstPadProbeReturn stamp_frame(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    GstBuffer *buffer;
+    GstCaps *caps;
+
+    (void) user_data;
+
+    caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+        return GST_PAD_PROBE_OK;
+
+    buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    bench_write_stamp(buffer, caps, (guint32)g_get_monotonic_time());
+    gst_caps_unref(caps);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static OwrMediaSource * create_source(OwrMediaType media_type)
+{
+    GstElement *bin, *stamp;
+    GstPad *pad;
+    gchar *description;
+    GError *error = NULL;
+
+    if (media_type == OWR_MEDIA_TYPE_VIDEO) {
+        description = g_strdup_printf("videotestsrc is-live=true pattern=ball"
+            " ! video/x-raw,format=I420,width=%d,height=%d,framerate=%d/1"
+            " ! identity name=stamp", width, height, framerate);
+    } else
+        description = g_strdup("audiotestsrc is-live=true wave=ticks");
+
+    bin = gst_parse_bin_from_description(description, TRUE, &error);
+    g_free(description);
+    if (!bin) {
+        g_print("Failed to create source: %s\n", error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    if (media_type == OWR_MEDIA_TYPE_VIDEO) {
+        stamp = gst_bin_get_by_name(GST_BIN(bin), "stamp");
+        pad = gst_element_get_static_pad(stamp, "src");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, stamp_frame, NULL, NULL);
+        gst_object_unref(pad);
+        gst_object_unref(stamp);
+    }
+
+    return OWR_MEDIA_SOURCE(owr_gst_media_source_new(media_type, OWR_SOURCE_TYPE_TEST, bin));
+}
+
+static void on_frame(OwrGstSample *sample, MediaStream *stream)
+{
+    guint32 stamp;
+    gint64 latency;
+    gboolean readable;
+
+    readable = bench_read_stamp(gst_sample_get_buffer(sample), gst_sample_get_caps(sample), &stamp);
+    latency = (guint32)((guint32)g_get_monotonic_time() - stamp);
+
+    g_mutex_lock(&stream->lock);
+    stream->frames++;
+    if (stream->measuring) {
+        if (readable)
+            g_array_append_val(stream->latencies, latency);
+        else
+            stream->unreadable_frames++;
+    }
+    g_mutex_unlock(&stream->lock);
+}
+
+static void on_incoming_source(OwrMediaSession *session, OwrMediaSource *source, MediaStream *stream)
+{
+    OwrFrameRenderer *frame_renderer;
+    GstElement *sink;
+
+    (void) session;
+
+    /* The frame renderer is the glass at the receiving end */
+    if (stream->media_type == OWR_MEDIA_TYPE_VIDEO) {
+        frame_renderer = owr_frame_renderer_new(OWR_FRAME_FORMAT_I420);
+        owr_frame_renderer_set_frame_callback(frame_renderer,
+            (OwrFrameRendererFrameCallback)on_frame, stream, NULL);
+        stream->renderer = OWR_MEDIA_RENDERER(frame_renderer);
+    } else {
+        sink = gst_element_factory_make("fakesink", NULL);
+        g_object_set(sink, "sync", FALSE, NULL);
+        stream->renderer = OWR_MEDIA_RENDERER(owr_gst_audio_renderer_new(sink));
+    }
+    owr_media_renderer_set_source(stream->renderer, source);
+}
+
+static void on_new_stats(OwrMediaSession *session, GHashTable *stats, MediaStream *stream)
+{
+    guint64 internal = TRUE, ssrc, packets, octets;
+    gint64 now = g_get_monotonic_time();
+
+    (void) session;
+
+    /* Only the remote source of the receiving session counts */
+    if (!bench_get_stat(stats, "internal", &internal) || internal
+        || !bench_get_stat(stats, "ssrc", &ssrc)
+        || !bench_get_stat(stats, "packets-received", &packets)
+        || !bench_get_stat(stats, "octets-received", &octets))
+        return;
+
+    g_mutex_lock(&stream->lock);
+    if (!stream->ssrc)
+        stream->ssrc = ssrc;
+    if (stream->ssrc == ssrc) {
+        stream->packets = packets;
+        stream->octets = octets;
+        if (stream->measuring) {
+            if (!stream->first_stats_time) {
+                stream->first_stats_time = now;
+                stream->first_packets = packets;
+                stream->first_octets = octets;
+            }
+            stream->last_stats_time = now;
+            stream->last_packets = packets;
+            stream->last_octets = octets;
+        }
+    }
+    g_mutex_unlock(&stream->lock);
+}
+
+static void on_data(OwrDataChannel *channel, const gchar *data, guint length, DataStream *stream)
+{
+    (void) channel;
+    (void) data;
+
+    g_mutex_lock(&stream->lock);
+    if (stream->measuring) {
+        stream->messages++;
+        stream->bytes += length;
+    }
+    g_mutex_unlock(&stream->lock);
+}
+
+static void got_candidate(OwrSession *session, OwrCandidate *candidate, OwrSession *peer_session)
+{
+    (void) session;
+    owr_session_add_remote_candidate(peer_session, candidate);
+}
+
+static void connect_sessions(OwrSession *left, OwrSession *right)
+{
+    g_signal_connect(left, "on-new-candidate", G_CALLBACK(got_candidate), right);
+    g_signal_connect(right, "on-new-candidate", G_CALLBACK(got_candidate), left);
+}
+
+static OwrPayload * create_payload(OwrMediaType media_type)
+{
+    OwrPayload *payload;
+
+    if (media_type == OWR_MEDIA_TYPE_AUDIO)
+        return owr_audio_payload_new(OWR_CODEC_TYPE_OPUS, 100, 48000, 1);
+
+    payload = owr_video_payload_new(video_codec, 103, 90000, TRUE, FALSE);
+    g_object_set(payload, "width", width, "height", height, "framerate", (gdouble)framerate, NULL);
+    return payload;
+}
+
+static void add_media_stream(gint pair, OwrMediaType media_type, OwrMediaSource *source,
+    OwrTransportAgent *left, OwrTransportAgent *right)
+{
+    MediaStream *stream;
+
+    stream = g_new0(MediaStream, 1);
+    stream->media_type = media_type;
+    stream->pair = pair;
+    stream->latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+    g_mutex_init(&stream->lock);
+
+    stream->send_session = owr_media_session_new(TRUE);
+    stream->receive_session = owr_media_session_new(FALSE);
+    connect_sessions(OWR_SESSION(stream->send_session), OWR_SESSION(stream->receive_session));
+
+    g_signal_connect(stream->receive_session, "on-incoming-source", G_CALLBACK(on_incoming_source), stream);
+    g_signal_connect(stream->receive_session, "on-new-stats", G_CALLBACK(on_new_stats), stream);
+    owr_media_session_add_receive_payload(stream->receive_session, create_payload(media_type));
+
+    owr_media_session_set_send_payload(stream->send_session, create_payload(media_type));
+    owr_media_session_set_send_source(stream->send_session, source);
+
+    owr_transport_agent_add_session(right, OWR_SESSION(stream->receive_session));
+    owr_transport_agent_add_session(left, OWR_SESSION(stream->send_session));
+
+    g_ptr_array_add(media_streams, stream);
+}
+
+static void add_data_stream(gint pair, OwrTransportAgent *left, OwrTransportAgent *right)
+{
+    DataStream *stream;
+
+    stream = g_new0(DataStream, 1);
+    stream->pair = pair;
+    g_mutex_init(&stream->lock);
+
+    stream->left_session = owr_data_session_new(TRUE);
+    stream->right_session = owr_data_session_new(FALSE);
+    g_object_set(stream->left_session, "sctp-local-port", 5000, "sctp-remote-port", 5000, NULL);
+    g_object_set(stream->right_session, "sctp-local-port", 5000, "sctp-remote-port", 5000, NULL);
+    connect_sessions(OWR_SESSION(stream->left_session), OWR_SESSION(stream->right_session));
+
+    owr_transport_agent_add_session(left, OWR_SESSION(stream->left_session));
+    owr_transport_agent_add_session(right, OWR_SESSION(stream->right_session));
+
+    /* ordered, max_packet_life_time, max_retransmits, protocol, negotiated, id, label */
+    stream->left_channel = owr_data_channel_new(TRUE, -1, -1, "bench", TRUE, 1, "bench");
+    stream->right_channel = owr_data_channel_new(TRUE, -1, -1, "bench", TRUE, 1, "bench");
+    g_signal_connect(stream->right_channel, "on-binary-data", G_CALLBACK(on_data), stream);
+    owr_data_session_add_data_channel(stream->left_session, stream->left_channel);
+    owr_data_session_add_data_channel(stream->right_session, stream->right_channel);
+
+    g_ptr_array_add(data_streams, stream);
+}
+
+static gboolean is_flowing(void)
+{
+    MediaStream *media_stream;
+    DataStream *data_stream;
+    gint ready_state;
+    gboolean flowing;
+    guint i;
+
+    for (i = 0; i < media_streams->len; i++) {
+        media_stream = g_ptr_array_index(media_streams, i);
+        g_mutex_lock(&media_stream->lock);
+        if (media_stream->media_type == OWR_MEDIA_TYPE_VIDEO)
+            flowing = media_stream->frames > 0;
+        else
+            flowing = media_stream->packets > 0;
+        g_mutex_unlock(&media_stream->lock);
+        if (!flowing)
+            return FALSE;
+    }
+
+    for (i = 0; i < data_streams->len; i++) {
+        data_stream = g_ptr_array_index(data_streams, i);
+        g_object_get(data_stream->right_channel, "ready-state", &ready_state, NULL);
+        if (ready_state != OWR_DATA_CHANNEL_READY_STATE_OPEN)
+            return FALSE;
+        g_object_get(data_stream->left_channel, "ready-state", &ready_state, NULL);
+        if (ready_state != OWR_DATA_CHANNEL_READY_STATE_OPEN)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gpointer send_data(DataStream *stream)
+{
+    guint8 *message;
+    guint buffered_amount;
+
+    message = g_malloc0(message_size);
+    while (!g_atomic_int_get(&stop_sending)) {
+        g_object_get(stream->left_channel, "buffered-amount", &buffered_amount, NULL);
+        if (buffered_amount > MAX_BUFFERED_AMOUNT) {
+            g_usleep(1000);
+            continue;
+        }
+        owr_data_channel_send_binary(stream->left_channel, message, message_size);
+    }
+    g_free(message);
+
+    return NULL;
+}
+
+static void set_measuring(gboolean measuring)
+{
+    MediaStream *media_stream;
+    DataStream *data_stream;
+    guint i;
+
+    for (i = 0; i < media_streams->len; i++) {
+        media_stream = g_ptr_array_index(media_streams, i);
+        g_mutex_lock(&media_stream->lock);
+        media_stream->measuring = measuring;
+        if (measuring)
+            media_stream->frames = 0;
+        g_mutex_unlock(&media_stream->lock);
+    }
+
+    for (i = 0; i < data_streams->len; i++) {
+        data_stream = g_ptr_array_index(data_streams, i);
+        g_mutex_lock(&data_stream->lock);
+        data_stream->measuring = measuring;
+        g_mutex_unlock(&data_stream->lock);
+    }
+}
+
+static gint compare_int64(const gint64 *a, const gint64 *b)
+{
+    return *a < *b ? -1 : *a > *b;
+}
+
+static gboolean print_media_stream(MediaStream *stream, gdouble seconds, gboolean last)
+{
+    const gchar *type = stream->media_type == OWR_MEDIA_TYPE_VIDEO ? "video" : "audio";
+    gdouble stats_seconds, packet_rate = 0.0, kbps = 0.0, frame_rate;
+
+    stats_seconds = (stream->last_stats_time - stream->first_stats_time) / (gdouble)G_USEC_PER_SEC;
+    if (stats_seconds > 0.0) {
+        packet_rate = (stream->last_packets - stream->first_packets) / stats_seconds;
+        kbps = (stream->last_octets - stream->first_octets) * 8.0 / 1000.0 / stats_seconds;
+    }
+    frame_rate = stream->frames / seconds;
+    g_array_sort(stream->latencies, (GCompareFunc)compare_int64);
+
+    if (json) {
+        g_print("    {\"type\": \"%s\", \"pair\": %d, \"packets_per_second\": %.1f, \"kbps\": %.1f",
+            type, stream->pair, packet_rate, kbps);
+        if (stream->media_type == OWR_MEDIA_TYPE_VIDEO) {
+            g_print(", \"frames_per_second\": %.1f, \"unreadable_frames\": %u, \"latency_ms\": "
+                "{\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}", frame_rate,
+                stream->unreadable_frames, bench_percentile(stream->latencies, 0.5) / 1000.0,
+                bench_percentile(stream->latencies, 0.9) / 1000.0,
+                bench_percentile(stream->latencies, 0.99) / 1000.0,
+                bench_percentile(stream->latencies, 1.0) / 1000.0);
+        }
+        g_print("}%s\n", last ? "" : ",");
+    } else {
+        g_print("%s %d: %.1f packets/s, %.1f kbit/s", type, stream->pair, packet_rate, kbps);
+        if (stream->media_type == OWR_MEDIA_TYPE_VIDEO) {
+            g_print(", %.1f frames/s, latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms"
+                " (%u unreadable frames)", frame_rate,
+                bench_percentile(stream->latencies, 0.5) / 1000.0,
+                bench_percentile(stream->latencies, 0.9) / 1000.0,
+                bench_percentile(stream->latencies, 0.99) / 1000.0,
+                bench_percentile(stream->latencies, 1.0) / 1000.0, stream->unreadable_frames);
+        }
+        g_print("\n");
+    }
+
+    return packet_rate > 0.0;
+}
+
+static gboolean print_data_stream(DataStream *stream, gdouble seconds, gboolean last)
+{
+    gdouble message_rate, megabytes_per_second;
+
+    message_rate = stream->messages / seconds;
+    megabytes_per_second = stream->bytes / seconds / (1024 * 1024);
+
+    if (json) {
+        g_print("    {\"type\": \"data\", \"pair\": %d, \"messages_per_second\": %.1f,"
+            " \"megabytes_per_second\": %.3f}%s\n", stream->pair, message_rate,
+            megabytes_per_second, last ? "" : ",");
+    } else {
+        g_print("data %d: %.1f messages/s, %.3f MB/s\n", stream->pair, message_rate,
+            megabytes_per_second);
+    }
+
+    return stream->messages > 0;
+}
+
+int main(int argc, char **argv)
+{
+    GOptionContext *options;
+    GError *error = NULL;
+    OwrMediaSource *video_source = NULL, *audio_source = NULL;
+    OwrTransportAgent *left, *right;
+    DataStream *data_stream;
+    gint64 setup_start, start_time, elapsed, cpu_start, cpu_time;
+    guint n_streams, i;
+    gdouble seconds, cpu_percent;
+    gboolean ok = TRUE;
+    gint pair;
+
+    options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error)) {
+        g_print("Failed to parse options: %s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(options);
+
+    if (n_pairs < 1 || duration < 1 || message_size < 1 || message_size > G_MAXUINT16 || width < 1 || height < 1 || framerate < 1) {
+        g_print("Need at least one pair, one second and sizes within range\n");
+        return 1;
+    }
+    if (disable_video && disable_audio && !enable_data) {
+        g_print("Audio, video and data disabled. Nothing to do.\n");
+        return 1;
+    }
+
+    if (!codec_name || !strcmp(codec_name, "vp8"))
+        video_codec = OWR_CODEC_TYPE_VP8;
+    else if (!strcmp(codec_name, "h264"))
+        video_codec = OWR_CODEC_TYPE_H264;
+    else {
+        g_print("Unknown video codec: %s\n", codec_name);
+        return 1;
+    }
+
+    owr_init(NULL);
+    owr_run_in_background();
+
+    /* All pairs share the sources, like calls sharing a camera */
+    if (!disable_video && !(video_source = create_source(OWR_MEDIA_TYPE_VIDEO)))
+        return 1;
+    if (!disable_audio && !(audio_source = create_source(OWR_MEDIA_TYPE_AUDIO)))
+        return 1;
+
+    media_streams = g_ptr_array_new();
+    data_streams = g_ptr_array_new();
+
+    setup_start = g_get_monotonic_time();
+    for (pair = 0; pair < n_pairs; pair++) {
+        left = owr_transport_agent_new(TRUE);
+        right = owr_transport_agent_new(FALSE);
+        owr_transport_agent_add_local_address(left, "127.0.0.1");
+        owr_transport_agent_add_local_address(right, "127.0.0.1");
+
+        if (video_source)
+            add_media_stream(pair, OWR_MEDIA_TYPE_VIDEO, video_source, left, right);
+        if (audio_source)
+            add_media_stream(pair, OWR_MEDIA_TYPE_AUDIO, audio_source, left, right);
+        if (enable_data)
+            add_data_stream(pair, left, right);
+    }
+    n_streams = media_streams->len + data_streams->len;
+
+    while (!is_flowing()) {
+        if (g_get_monotonic_time() - setup_start > (gint64)setup_timeout * G_USEC_PER_SEC) {
+            g_print("Not all streams were flowing after %d s\n", setup_timeout);
+            return 1;
+        }
+        g_usleep(10000);
+    }
+    if (!json) {
+        g_print("%u streams flowing after %.2f s, measuring for %d s\n", n_streams,
+            (g_get_monotonic_time() - setup_start) / (gdouble)G_USEC_PER_SEC, duration);
+    }
+
+    set_measuring(TRUE);
+    start_time = g_get_monotonic_time();
+    cpu_start = bench_get_cpu_time();
+    for (i = 0; i < data_streams->len; i++) {
+        data_stream = g_ptr_array_index(data_streams, i);
+        data_stream->send_thread = g_thread_new("bench-send", (GThreadFunc)send_data, data_stream);
+    }
+
+    g_usleep((gulong)duration * G_USEC_PER_SEC);
+
+    set_measuring(FALSE);
+    elapsed = g_get_monotonic_time() - start_time;
+    cpu_time = bench_get_cpu_time() - cpu_start;
+    g_atomic_int_set(&stop_sending, TRUE);
+    for (i = 0; i < data_streams->len; i++) {
+        data_stream = g_ptr_array_index(data_streams, i);
+        g_thread_join(data_stream->send_thread);
+    }
+
+    seconds = elapsed / (gdouble)G_USEC_PER_SEC;
+    cpu_percent = 100.0 * cpu_time / elapsed;
+
+    if (json) {
+        g_print("{\n  \"pairs\": %d, \"duration\": %.3f, \"cpu_percent\": %.1f,\n"
+            "  \"streams\": [\n", n_pairs, seconds, cpu_percent);
+    }
+    for (i = 0; i < media_streams->len; i++) {
+        ok &= print_media_stream(g_ptr_array_index(media_streams, i), seconds,
+            !data_streams->len && i == media_streams->len - 1);
+    }
+    for (i = 0; i < data_streams->len; i++)
+        ok &= print_data_stream(g_ptr_array_index(data_streams, i), seconds, i == data_streams->len - 1);
+    if (json)
+        g_print("  ]\n}\n");
+    else
+        g_print("cpu: %.1f %% in total\n", cpu_percent);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include "owr.h"
+#include "owr_audio_payload.h"
+#include "owr_data_channel.h"
+#include "owr_data_session.h"
+#include "owr_frame_renderer.h"
+#include "owr_gst_audio_renderer.h"
+#include "owr_gst_media_source.h"
+#include "owr_media_renderer.h"
+#include "owr_media_session.h"
+#include "owr_transport_agent.h"
+#include "owr_video_payload.h"
+#include "bench_utils.h"
+
+#include <string.h>
+
+/* Ramps up the number of concurrent loopback calls in one process, each call
+ * being two transport agents with an audio, a video and a data session, and
+ * measures after every step how long the new calls took to connect and to
+ * render their first frame, how many threads and how much memory the process
+ * uses, and how long the main-loop takes to dispatch a source. The knee is the
+ * last step before calls fail to connect, setup time doubles or the main-loop
+ * latency exceeds its budget */
+
+#define PROBE_INTERVAL_MS 20
+
+static gint max_calls = 32;
+static gint step_size = 4;
+static gint settle_time = 3;
+static gint step_timeout = 30;
+static gint n_shards = 1;
+static gint latency_budget = 50;
+static gboolean disable_video = FALSE, disable_audio = FALSE, disable_data = FALSE;
+static gboolean json = FALSE;
+
+static GOptionEntry entries[] = {
+    { "max-calls", 'n', 0, G_OPTION_ARG_INT, &max_calls, "Number of calls to ramp up to", NULL },
+    { "step", 's', 0, G_OPTION_ARG_INT, &step_size, "Number of calls added per step", NULL },
+    { "settle", 0, 0, G_OPTION_ARG_INT, &settle_time, "Seconds to measure after each step", "SECONDS" },
+    { "step-timeout", 0, 0, G_OPTION_ARG_INT, &step_timeout, "Seconds to wait for the calls of a step", "SECONDS" },
+    { "shards", 0, 0, G_OPTION_ARG_INT, &n_shards, "Number of main-loops to spread the agents over", NULL },
+    { "latency-budget", 0, 0, G_OPTION_ARG_INT, &latency_budget, "Acceptable p99 main-loop latency", "MS" },
+    { "disable-video", 0, 0, G_OPTION_ARG_NONE, &disable_video, "Disable video", NULL },
+    { "disable-audio", 0, 0, G_OPTION_ARG_NONE, &disable_audio, "Disable audio", NULL },
+    { "disable-data", 0, 0, G_OPTION_ARG_NONE, &disable_data, "Disable the data channel", NULL },
+    { "json", 'j', 0, G_OPTION_ARG_NONE, &json, "Print the results as JSON", NULL },
+    { NULL, }
+};
+
+typedef struct {
+    OwrTransportAgent *left, *right;
+    GPtrArray *sessions;
+    OwrDataChannel *left_channel, *right_channel;
+    OwrMediaRenderer *video_renderer, *audio_renderer;
+
+    gint64 start_time;
+    gint64 connected_time;
+    gint64 first_frame_time;
+} Call;
+
+typedef struct {
+    guint n_calls;
+    guint n_connected;
+    gint64 connect_p50, connect_max;
+    gint64 first_frame_p50, first_frame_max;
+    guint n_threads;
+    guint64 rss_kb;
+    gint64 loop_p50, loop_p99, loop_max;
+    gdouble cpu_percent;
+} Step;
+
+static GMainContext *main_context;
+static OwrMediaSource *video_source, *audio_source;
+static GPtrArray *calls;
+
+/* Protects the times of the calls and the main-loop latencies */
+static GMutex lock;
+static GArray *loop_latencies;
+static volatile gint probing = TRUE;
+
+static gboolean probe_dispatched(gint64 *attach_time)
+{
+    gint64 latency = g_get_monotonic_time() - *attach_time;
+
+    g_mutex_lock(&lock);
+    g_array_append_val(loop_latencies, latency);
+    g_mutex_unlock(&lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Measures how long the main-loop takes to get to a newly attached source */
+static gpointer probe_main_loop(gpointer user_data)
+{
+    GSource *source;
+    gint64 *attach_time;
+
+    (void) user_data;
+
+    while (g_atomic_int_get(&probing)) {
+        attach_time = g_new(gint64, 1);
+        source = g_idle_source_new();
+        g_source_set_priority(source, G_PRIORITY_DEFAULT);
+        g_source_set_callback(source, (GSourceFunc)probe_dispatched, attach_time, g_free);
+        *attach_time = g_get_monotonic_time();
+        g_source_attach(source, main_context);
+        g_source_unref(source);
+        g_usleep(PROBE_INTERVAL_MS * 1000);
+    }
+
+    return NULL;
+}
+
+static OwrMediaSource * create_source(OwrMediaType media_type)
+{
+    GstElement *bin;
+    GError *error = NULL;
+
+    if (media_type == OWR_MEDIA_TYPE_VIDEO) {
+        bin = gst_parse_bin_from_description("videotestsrc is-live=true pattern=ball"
+            " ! video/x-raw,format=I420,width=320,height=240,framerate=30/1", TRUE, &error);
+    } else
+        bin = gst_parse_bin_from_description("audiotestsrc is-live=true wave=ticks", TRUE, &error);
+
+    if (!bin) {
+        g_print("Failed to create source: %s\n", error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    return OWR_MEDIA_SOURCE(owr_gst_media_source_new(media_type, OWR_SOURCE_TYPE_TEST, bin));
+}
+
+static void check_connected(GObject *object, GParamSpec *pspec, Call *call)
+{
+    OwrIceState ice_state;
+    OwrDataChannelReadyState ready_state;
+    guint i;
+
+    (void) object;
+    (void) pspec;
+
+    for (i = 0; i < call->sessions->len; i++) {
+        g_object_get(g_ptr_array_index(call->sessions, i), "ice-connection-state", &ice_state, NULL);
+        if (ice_state != OWR_ICE_STATE_CONNECTED && ice_state != OWR_ICE_STATE_READY)
+            return;
+    }
+    if (call->left_channel) {
+        g_object_get(call->left_channel, "ready-state", &ready_state, NULL);
+        if (ready_state != OWR_DATA_CHANNEL_READY_STATE_OPEN)
+            return;
+        g_object_get(call->right_channel, "ready-state", &ready_state, NULL);
+        if (ready_state != OWR_DATA_CHANNEL_READY_STATE_OPEN)
+            return;
+    }
+
+    g_mutex_lock(&lock);
+    if (!call->connected_time)
+        call->connected_time = g_get_monotonic_time();
+    g_mutex_unlock(&lock);
+}
+
+static void on_frame(OwrGstSample *sample, Call *call)
+{
+    (void) sample;
+
+    g_mutex_lock(&lock);
+    if (!call->first_frame_time)
+        call->first_frame_time = g_get_monotonic_time();
+    g_mutex_unlock(&lock);
+}
+
+static void on_incoming_source(OwrMediaSession *session, OwrMediaSource *source, Call *call)
+{
+    OwrFrameRenderer *frame_renderer;
+    GstElement *sink;
+    OwrMediaType media_type;
+
+    (void) session;
+
+    g_object_get(source, "media-type", &media_type, NULL);
+    if (media_type == OWR_MEDIA_TYPE_VIDEO) {
+        frame_renderer = owr_frame_renderer_new(OWR_FRAME_FORMAT_I420);
+        owr_frame_renderer_set_frame_callback(frame_renderer,
+            (OwrFrameRendererFrameCallback)on_frame, call, NULL);
+        call->video_renderer = OWR_MEDIA_RENDERER(frame_renderer);
+        owr_media_renderer_set_source(call->video_renderer, source);
+    } else {
+        sink = gst_element_factory_make("fakesink", NULL);
+        g_object_set(sink, "sync", FALSE, NULL);
+        call->audio_renderer = OWR_MEDIA_RENDERER(owr_gst_audio_renderer_new(sink));
+        owr_media_renderer_set_source(call->audio_renderer, source);
+    }
+}
+
+static void got_candidate(OwrSession *session, OwrCandidate *candidate, OwrSession *peer_session)
+{
+    (void) session;
+    owr_session_add_remote_candidate(peer_session, candidate);
+}
+
+static void add_session_pair(Call *call, OwrSession *left, OwrSession *right)
+{
+    g_signal_connect(left, "on-new-candidate", G_CALLBACK(got_candidate), right);
+    g_signal_connect(right, "on-new-candidate", G_CALLBACK(got_candidate), left);
+    g_signal_connect(left, "notify::ice-connection-state", G_CALLBACK(check_connected), call);
+    g_signal_connect(right, "notify::ice-connection-state", G_CALLBACK(check_connected), call);
+    g_ptr_array_add(call->sessions, left);
+    g_ptr_array_add(call->sessions, right);
+}
+
+static void add_media(Call *call, OwrMediaType media_type, OwrMediaSource *source)
+{
+    OwrMediaSession *send_session, *receive_session;
+    OwrPayload *send_payload, *receive_payload;
+
+    send_session = owr_media_session_new(TRUE);
+    receive_session = owr_media_session_new(FALSE);
+    add_session_pair(call, OWR_SESSION(send_session), OWR_SESSION(receive_session));
+    g_signal_connect(receive_session, "on-incoming-source", G_CALLBACK(on_incoming_source), call);
+
+    if (media_type == OWR_MEDIA_TYPE_VIDEO) {
+        send_payload = owr_video_payload_new(OWR_CODEC_TYPE_VP8, 103, 90000, TRUE, FALSE);
+        receive_payload = owr_video_payload_new(OWR_CODEC_TYPE_VP8, 103, 90000, TRUE, FALSE);
+        g_object_set(send_payload, "width", 320, "height", 240, "framerate", 30.0, NULL);
+    } else {
+        send_payload = owr_audio_payload_new(OWR_CODEC_TYPE_OPUS, 100, 48000, 1);
+        receive_payload = owr_audio_payload_new(OWR_CODEC_TYPE_OPUS, 100, 48000, 1);
+    }
+
+    owr_media_session_add_receive_payload(receive_session, receive_payload);
+    owr_media_session_set_send_payload(send_session, send_payload);
+    owr_media_session_set_send_source(send_session, source);
+
+    owr_transport_agent_add_session(call->right, OWR_SESSION(receive_session));
+    owr_transport_agent_add_session(call->left, OWR_SESSION(send_session));
+}
+
+static void add_data(Call *call)
+{
+    OwrDataSession *left_session, *right_session;
+
+    left_session = owr_data_session_new(TRUE);
+    right_session = owr_data_session_new(FALSE);
+    g_object_set(left_session, "sctp-local-port", 5000, "sctp-remote-port", 5000, NULL);
+    g_object_set(right_session, "sctp-local-port", 5000, "sctp-remote-port", 5000, NULL);
+    add_session_pair(call, OWR_SESSION(left_session), OWR_SESSION(right_session));
+
+    owr_transport_agent_add_session(call->left, OWR_SESSION(left_session));
+    owr_transport_agent_add_session(call->right, OWR_SESSION(right_session));
+
+    call->left_channel = owr_data_channel_new(TRUE, -1, -1, "bench", TRUE, 1, "bench");
+    call->right_channel = owr_data_channel_new(TRUE, -1, -1, "bench", TRUE, 1, "bench");
+    g_signal_connect(call->left_channel, "notify::ready-state", G_CALLBACK(check_connected), call);
+    g_signal_connect(call->right_channel, "notify::ready-state", G_CALLBACK(check_connected), call);
+    owr_data_session_add_data_channel(left_session, call->left_channel);
+    owr_data_session_add_data_channel(right_session, call->right_channel);
+}
+
+static void start_call(void)
+{
+    Call *call;
+
+    call = g_new0(Call, 1);
+    call->sessions = g_ptr_array_new();
+    call->start_time = g_get_monotonic_time();
+    g_ptr_array_add(calls, call);
+
+    call->left = owr_transport_agent_new(TRUE);
+    call->right = owr_transport_agent_new(FALSE);
+    owr_transport_agent_add_local_address(call->left, "127.0.0.1");
+    owr_transport_agent_add_local_address(call->right, "127.0.0.1");
+
+    if (video_source)
+        add_media(call, OWR_MEDIA_TYPE_VIDEO, video_source);
+    if (audio_source)
+        add_media(call, OWR_MEDIA_TYPE_AUDIO, audio_source);
+    if (!disable_data)
+        add_data(call);
+}
+
+static gboolean is_call_up(Call *call)
+{
+    return call->connected_time && (!video_source || call->first_frame_time);
+}
+
+static gint compare_int64(const gint64 *a, const gint64 *b)
+{
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Waits for the calls from @first on and summarizes their setup times */
+static void wait_for_calls(guint first, Step *step)
+{
+    GArray *connect_times, *first_frame_times;
+    gint64 deadline, duration;
+    gboolean all_up;
+    Call *call;
+    guint i;
+
+    deadline = g_get_monotonic_time() + (gint64)step_timeout * G_USEC_PER_SEC;
+    do {
+        g_usleep(10000);
+        all_up = TRUE;
+        g_mutex_lock(&lock);
+        for (i = first; i < calls->len && all_up; i++)
+            all_up = is_call_up(g_ptr_array_index(calls, i));
+        g_mutex_unlock(&lock);
+    } while (!all_up && g_get_monotonic_time() < deadline);
+
+    connect_times = g_array_new(FALSE, FALSE, sizeof(gint64));
+    first_frame_times = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    g_mutex_lock(&lock);
+    for (i = 0; i < calls->len; i++) {
+        call = g_ptr_array_index(calls, i);
+        if (is_call_up(call))
+            step->n_connected++;
+        if (i < first)
+            continue;
+        if (call->connected_time) {
+            duration = call->connected_time - call->start_time;
+            g_array_append_val(connect_times, duration);
+        }
+        if (call->first_frame_time) {
+            duration = call->first_frame_time - call->start_time;
+            g_array_append_val(first_frame_times, duration);
+        }
+    }
+    g_mutex_unlock(&lock);
+
+    g_array_sort(connect_times, (GCompareFunc)compare_int64);
+    g_array_sort(first_frame_times, (GCompareFunc)compare_int64);
+    step->connect_p50 = bench_percentile(connect_times, 0.5);
+    step->connect_max = bench_percentile(connect_times, 1.0);
+    step->first_frame_p50 = bench_percentile(first_frame_times, 0.5);
+    step->first_frame_max = bench_percentile(first_frame_times, 1.0);
+
+    g_array_free(connect_times, TRUE);
+    g_array_free(first_frame_times, TRUE);
+}
+
+/* Measures the steady state with all calls of the step running */
+static void measure_steady_state(Step *step)
+{
+    gint64 start_time, cpu_start;
+
+    g_mutex_lock(&lock);
+    g_array_set_size(loop_latencies, 0);
+    g_mutex_unlock(&lock);
+
+    start_time = g_get_monotonic_time();
+    cpu_start = bench_get_cpu_time();
+    g_usleep((gulong)settle_time * G_USEC_PER_SEC);
+    step->cpu_percent = 100.0 * (bench_get_cpu_time() - cpu_start)
+        / (g_get_monotonic_time() - start_time);
+
+    g_mutex_lock(&lock);
+    g_array_sort(loop_latencies, (GCompareFunc)compare_int64);
+    step->loop_p50 = bench_percentile(loop_latencies, 0.5);
+    step->loop_p99 = bench_percentile(loop_latencies, 0.99);
+    step->loop_max = bench_percentile(loop_latencies, 1.0);
+    g_mutex_unlock(&lock);
+
+    if (!bench_get_process_status(&step->n_threads, &step->rss_kb)) {
+        step->n_threads = 0;
+        step->rss_kb = 0;
+    }
+}
+
+/* Index of the first step that does not scale, or -1 if all of them did.
+ * Setup times are compared to the first step with calls, step 0 being the
+ * baseline without any */
+static gint find_knee(GArray *steps)
+{
+    Step *first, *step;
+    guint i;
+
+    first = steps->len > 1 ? &g_array_index(steps, Step, 1) : NULL;
+    for (i = 0; i < steps->len; i++) {
+        step = &g_array_index(steps, Step, i);
+        if (step->n_connected < step->n_calls
+            || step->loop_p99 > (gint64)latency_budget * 1000
+            || (i > 1 && step->connect_p50 > 2 * first->connect_p50))
+            return i;
+    }
+
+    return -1;
+}
+
+static void print_steps(GArray *steps)
+{
+    Step *step, *first, *last;
+    gint knee;
+    guint knee_calls, i;
+    gdouble rss_per_call = 0.0, threads_per_call = 0.0;
+
+    knee = find_knee(steps);
+    knee_calls = knee < 0 ? g_array_index(steps, Step, steps->len - 1).n_calls
+        : knee > 0 ? g_array_index(steps, Step, knee - 1).n_calls : 0;
+
+    first = &g_array_index(steps, Step, 0);
+    last = &g_array_index(steps, Step, steps->len - 1);
+    if (last->n_calls > first->n_calls) {
+        rss_per_call = (gdouble)((gint64)last->rss_kb - (gint64)first->rss_kb) / 1024.0
+            / (last->n_calls - first->n_calls);
+        threads_per_call = (gdouble)((gint)last->n_threads - (gint)first->n_threads)
+            / (last->n_calls - first->n_calls);
+    }
+
+    if (json)
+        g_print("{\n  \"steps\": [\n");
+    else {
+        g_print("%6s %9s %12s %12s %8s %9s %10s %10s %10s %6s\n", "calls", "connected",
+            "connect ms", "1st frame ms", "threads", "rss MB", "loop p50", "loop p99",
+            "loop max", "cpu %");
+    }
+
+    for (i = 0; i < steps->len; i++) {
+        step = &g_array_index(steps, Step, i);
+        if (json) {
+            g_print("    {\"calls\": %u, \"connected\": %u,"
+                " \"connect_ms\": {\"p50\": %.1f, \"max\": %.1f},"
+                " \"first_frame_ms\": {\"p50\": %.1f, \"max\": %.1f},"
+                " \"threads\": %u, \"rss_mb\": %.1f,"
+                " \"loop_latency_ms\": {\"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f},"
+                " \"cpu_percent\": %.1f}%s\n", step->n_calls, step->n_connected,
+                step->connect_p50 / 1000.0, step->connect_max / 1000.0,
+                step->first_frame_p50 / 1000.0, step->first_frame_max / 1000.0,
+                step->n_threads, step->rss_kb / 1024.0, step->loop_p50 / 1000.0,
+                step->loop_p99 / 1000.0, step->loop_max / 1000.0, step->cpu_percent,
+                i == steps->len - 1 ? "" : ",");
+        } else {
+            g_print("%6u %9u %12.1f %12.1f %8u %9.1f %10.2f %10.2f %10.2f %6.1f\n",
+                step->n_calls, step->n_connected, step->connect_p50 / 1000.0,
+                step->first_frame_p50 / 1000.0, step->n_threads, step->rss_kb / 1024.0,
+                step->loop_p50 / 1000.0, step->loop_p99 / 1000.0, step->loop_max / 1000.0,
+                step->cpu_percent);
+        }
+    }
+
+    if (json) {
+        g_print("  ],\n  \"knee_calls\": %u, \"knee_reached\": %s,"
+            " \"rss_mb_per_call\": %.2f, \"threads_per_call\": %.2f\n}\n", knee_calls,
+            knee < 0 ? "false" : "true", rss_per_call, threads_per_call);
+    } else {
+        if (knee < 0)
+            g_print("No knee up to %u calls", knee_calls);
+        else
+            g_print("Knee at %u calls", knee_calls);
+        g_print(", %.2f MB and %.2f threads per call\n", rss_per_call, threads_per_call);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    GOptionContext *options;
+    GError *error = NULL;
+    GThread *probe_thread;
+    GArray *steps;
+    Step step;
+    guint first;
+    gint i;
+
+    options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (!g_option_context_parse(options, &argc, &argv, &error)) {
+        g_print("Failed to parse options: %s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(options);
+
+    if (max_calls < 1 || step_size < 1 || settle_time < 1 || step_timeout < 1 || n_shards < 1) {
+        g_print("Calls, step, settle time, timeout and shards must be positive\n");
+        return 1;
+    }
+    if (disable_video && disable_audio && disable_data) {
+        g_print("Audio, video and data disabled. Nothing to do.\n");
+        return 1;
+    }
+
+    /* Our own context, so that the latency of the main-loop can be probed */
+    main_context = g_main_context_new();
+    owr_init(main_context);
+    owr_run_in_background();
+    owr_run_shards_in_background(n_shards);
+
+    if (!disable_video && !(video_source = create_source(OWR_MEDIA_TYPE_VIDEO)))
+        return 1;
+    if (!disable_audio && !(audio_source = create_source(OWR_MEDIA_TYPE_AUDIO)))
+        return 1;
+
+    calls = g_ptr_array_new();
+    loop_latencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+    steps = g_array_new(FALSE, FALSE, sizeof(Step));
+    probe_thread = g_thread_new("bench-probe", probe_main_loop, NULL);
+
+    /* A baseline with no calls shows the fixed cost of the process */
+    memset(&step, 0, sizeof(step));
+    measure_steady_state(&step);
+    g_array_append_val(steps, step);
+
+    while ((gint)calls->len < max_calls) {
+        memset(&step, 0, sizeof(step));
+        first = calls->len;
+        for (i = 0; i < step_size && (gint)calls->len < max_calls; i++)
+            start_call();
+        step.n_calls = calls->len;
+
+        wait_for_calls(first, &step);
+        measure_steady_state(&step);
+        g_array_append_val(steps, step);
+
+        if (!json) {
+            g_print("%u calls, %u up, %.1f ms median setup, %.2f ms p99 main-loop latency\n",
+                step.n_calls, step.n_connected, step.connect_p50 / 1000.0, step.loop_p99 / 1000.0);
+        }
+
+        /* Calls that do not come up make the following steps meaningless */
+        if (step.n_connected < step.n_calls)
+            break;
+    }
+
+    g_atomic_int_set(&probing, FALSE);
+    g_thread_join(probe_thread);
+
+    print_steps(steps);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include "owr.h"
+#include "owr_transport_agent.h"
+
+#include <stdlib.h>
+
+#define N_SHARDS 4
+#define N_AGENTS 16
+#define TIMEOUT_SECONDS 10
+
+static volatile gint creating = 1;
+
+static gpointer timeout_thread_func(gpointer user_data)
+{
+    (void) user_data;
+
+    g_usleep(TIMEOUT_SECONDS * G_USEC_PER_SEC);
+    g_print("** ERROR ** test timed out, owr_quit() did not return\n");
+    exit(-1);
+
+    return NULL;
+}
+
+/* Keeps picking shards while owr_quit() tears them down */
+static gpointer create_agents_thread_func(GPtrArray *agents)
+{
+    while (g_atomic_int_get(&creating)) {
+        g_ptr_array_add(agents, owr_transport_agent_new(FALSE));
+        g_usleep(1000);
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    GPtrArray *live_agents, *racing_agents;
+    GThread *thread;
+    guint i;
+
+    owr_init(NULL);
+    owr_run_in_background();
+    owr_run_shards_in_background(N_SHARDS);
+
+    if (owr_get_n_shards() != N_SHARDS) {
+        g_print("** ERROR ** expected %u shards but got %u\n", N_SHARDS, owr_get_n_shards());
+        return -1;
+    }
+
+    g_thread_unref(g_thread_new("timeout", timeout_thread_func, NULL));
+
+    live_agents = g_ptr_array_new_with_free_func(g_object_unref);
+    for (i = 0; i < N_AGENTS; i++)
+        g_ptr_array_add(live_agents, owr_transport_agent_new(FALSE));
+
+    racing_agents = g_ptr_array_new_with_free_func(g_object_unref);
+    thread = g_thread_new("create-agents", (GThreadFunc) create_agents_thread_func, racing_agents);
+
+    g_usleep(G_USEC_PER_SEC / 10);
+    g_print("quitting with %u live sharded agents\n", live_agents->len);
+    owr_quit();
+
+    if (owr_get_n_shards() != 1) {
+        g_print("** ERROR ** shards left running after owr_quit\n");
+        return -1;
+    }
+
+    g_atomic_int_set(&creating, 0);
+    g_thread_join(thread);
+
+    g_print("releasing %u agents\n", live_agents->len + racing_agents->len);
+    g_ptr_array_unref(racing_agents);
+    g_ptr_array_unref(live_agents);
+
+    g_print("\n *** Test successful! *** \n\n");
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrAudioLevel
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_audio_level.h"
+
+#include <math.h>
+
+/* A frame is voice when it is this many dB above the noise level... */
+#define VOICE_MARGIN 10
+/* ...and at least this loud */
+#define VOICE_MAX_LEVEL 60
+/* Frames that stay flagged as voice after the level drops, 200 ms of 20 ms
+ * frames, so that short pauses between words don't toggle the flag */
+#define VOICE_HANGOVER 10
+/* The noise level follows louder backgrounds by 1 dB every this many frames */
+#define NOISE_RISE_FRAMES 25
+
+/*
+ * Returns the RMS level of the frame in -dBov, or OWR_AUDIO_LEVEL_SILENCE for
+ * formats other than native endian S16 and F32.
+ */
+guint8 _owr_audio_level_compute(GstBuffer *buffer, const GstAudioInfo *info)
+{
+    GstMapInfo map;
+    gdouble power = 0.0;
+    gsize n_samples = 0, i;
+    gint level;
+
+    g_return_val_if_fail(GST_IS_BUFFER(buffer), OWR_AUDIO_LEVEL_SILENCE);
+    g_return_val_if_fail(info, OWR_AUDIO_LEVEL_SILENCE);
+
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return OWR_AUDIO_LEVEL_SILENCE;
+
+    switch (GST_AUDIO_INFO_FORMAT(info)) {
+    case GST_AUDIO_FORMAT_S16: {
+        const gint16 *samples = (const gint16 *)map.data;
+        gint64 sum = 0;
+
+        n_samples = map.size / sizeof(gint16);
+        for (i = 0; i < n_samples; i++)
+            sum += (gint32)samples[i] * samples[i];
+        power = (gdouble)sum / (32768.0 * 32768.0);
+        break;
+    }
+    case GST_AUDIO_FORMAT_F32: {
+        const gfloat *samples = (const gfloat *)map.data;
+
+        n_samples = map.size / sizeof(gfloat);
+        for (i = 0; i < n_samples; i++)
+            power += samples[i] * samples[i];
+        break;
+    }
+    default:
+        break;
+    }
+
+    gst_buffer_unmap(buffer, &map);
+
+    if (!n_samples || power <= 0.0)
+        return OWR_AUDIO_LEVEL_SILENCE;
+
+    /* 10 * log10 of the mean power is 20 * log10 of the RMS */
+    level = (gint)floor(-10.0 * log10(power / n_samples) + 0.5);
+
+    return CLAMP(level, 0, OWR_AUDIO_LEVEL_SILENCE);
+}
+
+void _owr_voice_activity_init(OwrVoiceActivity *vad)
+{
+    vad->voice = FALSE;
+    vad->noise_level = 0;
+    vad->n_frames = 0;
+    vad->hangover = 0;
+}
+
+/*
+ * Energy based voice activity detection against an adaptive noise level.
+ * Returns whether the frame with the given level is voice.
+ */
+gboolean _owr_voice_activity_update(OwrVoiceActivity *vad, guint8 level)
+{
+    /* Follow quieter backgrounds at once and louder ones slowly, so that
+     * speech itself doesn't become the noise level */
+    if (level > vad->noise_level)
+        vad->noise_level = level;
+    else if (++vad->n_frames % NOISE_RISE_FRAMES == 0 && vad->noise_level > 0)
+        vad->noise_level--;
+
+    if (level <= VOICE_MAX_LEVEL && level + VOICE_MARGIN <= vad->noise_level) {
+        vad->voice = TRUE;
+        vad->hangover = VOICE_HANGOVER;
+    } else if (vad->voice && vad->hangover > 0 && --vad->hangover == 0)
+        vad->voice = FALSE;
+
+    return vad->voice;
+}
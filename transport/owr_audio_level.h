@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrAudioLevel
+/*/
+
+#ifndef __OWR_AUDIO_LEVEL_H__
+#define __OWR_AUDIO_LEVEL_H__
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+G_BEGIN_DECLS
+
+/* Levels are in -dBov, 127 is the quietest level that can be signalled */
+#define OWR_AUDIO_LEVEL_SILENCE 127
+
+typedef struct {
+    gboolean voice;
+
+    /* Quietest recent level, taken as the background noise */
+    guint8 noise_level;
+    guint n_frames;
+    guint hangover;
+} OwrVoiceActivity;
+
+guint8 _owr_audio_level_compute(GstBuffer *buffer, const GstAudioInfo *info);
+
+void _owr_voice_activity_init(OwrVoiceActivity *vad);
+gboolean _owr_voice_activity_update(OwrVoiceActivity *vad, guint8 level);
+
+G_END_DECLS
+
+#endif /* __OWR_AUDIO_LEVEL_H__ */
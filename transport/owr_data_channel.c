@@ -364,6 +364,7 @@ void owr_data_channel_send(OwrDataChannel *data_channel, const gchar *data)
     memcpy(data_out, data, length);
     args = g_hash_table_new(g_str_hash, g_str_equal);
     g_hash_table_insert(args, "data_channel", data_channel);
+    g_hash_table_insert(args, "__context", _owr_get_main_context_for_object(data_channel));
     g_hash_table_insert(args, "data", data_out);
     g_hash_table_insert(args, "length", GUINT_TO_POINTER(length));
     g_hash_table_insert(args, "is_binary", GUINT_TO_POINTER(FALSE));
@@ -392,6 +393,7 @@ void owr_data_channel_send_binary(OwrDataChannel *data_channel, const guint8 *da
     memcpy(data_out, data, length);
     args = g_hash_table_new(g_str_hash, g_str_equal);
     g_hash_table_insert(args, "data_channel", data_channel);
+    g_hash_table_insert(args, "__context", _owr_get_main_context_for_object(data_channel));
     g_hash_table_insert(args, "data", data_out);
     g_hash_table_insert(args, "length", GUINT_TO_POINTER(length));
     g_hash_table_insert(args, "is_binary", GUINT_TO_POINTER(TRUE));
@@ -407,6 +409,7 @@ void owr_data_channel_close(OwrDataChannel *data_channel)
 
     args = g_hash_table_new(g_str_hash, g_str_equal);
     g_hash_table_insert(args, "data_channel", data_channel);
+    g_hash_table_insert(args, "__context", _owr_get_main_context_for_object(data_channel));
     g_object_ref(data_channel);
     _owr_schedule_with_hash_table((GSourceFunc)data_channel_close, args);
 }
@@ -633,6 +636,7 @@ void _owr_data_channel_set_ready_state(OwrDataChannel *data_channel, OwrDataChan
 
     args = g_hash_table_new(g_str_hash, g_str_equal);
     g_hash_table_insert(args, "data_channel", data_channel);
+    g_hash_table_insert(args, "__context", _owr_get_main_context_for_object(data_channel));
     g_hash_table_insert(args, "state", GUINT_TO_POINTER(state));
 
     _owr_schedule_with_hash_table((GSourceFunc)set_ready_state, args);
@@ -224,6 +224,8 @@ void owr_data_session_add_data_channel(OwrDataSession *data_session, OwrDataChan
     g_return_if_fail(OWR_IS_DATA_SESSION(data_session));
     g_return_if_fail(OWR_IS_DATA_CHANNEL(data_channel));
 
+    _owr_set_main_context_for_object(data_channel, _owr_get_main_context_for_object(data_session));
+
     args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(data_session));
     g_hash_table_insert(args, "data_session", data_session);
     g_hash_table_insert(args, "data_channel", data_channel);
@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrEventLog
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_event_log.h"
+
+#include "owr_arrival_time_meta.h"
+
+#include <gio/gio.h>
+#include <gst/rtp/gstrtcpbuffer.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN(_owrtransportagent_debug);
+#define GST_CAT_DEFAULT _owrtransportagent_debug
+
+/* 1 MiB of records, a few seconds of packets for a busy agent */
+#define RING_SIZE 32768
+#define RING_MASK (RING_SIZE - 1)
+/* Records written to the file with each write */
+#define CHUNK_RECORDS 2048
+#define FLUSH_INTERVAL (200 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+    gint64 time;
+    guint8 type;
+    guint8 a;
+    guint16 b;
+    guint32 session_id;
+    guint32 c;
+    guint32 d;
+    guint32 e;
+    guint32 f;
+} Record;
+
+typedef struct {
+    /* Equal to the position when the slot is free for it, and to the
+     * position + 1 when the record at the position has been written */
+    volatile gint sequence;
+    Record record;
+} Slot;
+
+struct _OwrEventLog {
+    volatile gint active;
+    gint64 start_time;
+
+    /* Running time, in ns, that corresponds to start_time. Taken from the
+     * first RTP_IN arrival time after the start. */
+    volatile gint arrival_base_set;
+    guint64 arrival_base;
+
+    /* Bounded multi-producer ring. Streaming threads reserve slots with a
+     * compare-and-swap on head and never wait; records are dropped and
+     * counted when the writer thread falls behind. */
+    Slot *slots;
+    volatile gint head;
+    guint tail;
+    volatile gint dropped;
+
+    GMutex lock;
+    GCond cond;
+    GThread *thread;
+    GOutputStream *stream;
+    gboolean stopping;
+};
+
+OwrEventLog * _owr_event_log_new(void)
+{
+    OwrEventLog *log = g_slice_new0(OwrEventLog);
+
+    g_mutex_init(&log->lock);
+    g_cond_init(&log->cond);
+
+    return log;
+}
+
+void _owr_event_log_free(OwrEventLog *log)
+{
+    g_return_if_fail(log);
+
+    _owr_event_log_stop(log);
+
+    g_free(log->slots);
+    g_mutex_clear(&log->lock);
+    g_cond_clear(&log->cond);
+    g_slice_free(OwrEventLog, log);
+}
+
+static void append(OwrEventLog *log, Record *record)
+{
+    Slot *slot;
+    guint pos;
+    gint diff;
+
+    record->time = g_get_monotonic_time() - log->start_time;
+
+    pos = (guint)g_atomic_int_get(&log->head);
+    for (;;) {
+        slot = &log->slots[pos & RING_MASK];
+        diff = (gint)((guint)g_atomic_int_get(&slot->sequence) - pos);
+        if (!diff) {
+            if (g_atomic_int_compare_and_exchange(&log->head, (gint)pos, (gint)(pos + 1)))
+                break;
+        } else if (diff < 0) {
+            g_atomic_int_inc(&log->dropped);
+            return;
+        }
+        pos = (guint)g_atomic_int_get(&log->head);
+    }
+
+    slot->record = *record;
+    g_atomic_int_set(&slot->sequence, (gint)(pos + 1));
+}
+
+static guint8 *write_record(guint8 *data, const Record *record)
+{
+    GST_WRITE_UINT64_LE(data, record->time);
+    GST_WRITE_UINT8(data + 8, record->type);
+    GST_WRITE_UINT8(data + 9, record->a);
+    GST_WRITE_UINT16_LE(data + 10, record->b);
+    GST_WRITE_UINT32_LE(data + 12, record->session_id);
+    GST_WRITE_UINT32_LE(data + 16, record->c);
+    GST_WRITE_UINT32_LE(data + 20, record->d);
+    GST_WRITE_UINT32_LE(data + 24, record->e);
+    GST_WRITE_UINT32_LE(data + 28, record->f);
+
+    return data + OWR_EVENT_LOG_RECORD_SIZE;
+}
+
+static gboolean write_chunk(OwrEventLog *log, const guint8 *chunk, gsize size)
+{
+    GError *error = NULL;
+
+    if (!size || g_output_stream_write_all(log->stream, chunk, size, NULL, NULL, &error))
+        return TRUE;
+
+    GST_WARNING("Failed to write the event log: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+}
+
+/* Moves all published records from the ring to the file */
+static void flush(OwrEventLog *log, guint8 *chunk)
+{
+    Record record = {0, OWR_EVENT_LOG_TYPE_DROPPED, 0, 0, 0, 0, 0, 0, 0};
+    guint8 *data = chunk;
+    Slot *slot;
+    gint dropped;
+
+    do {
+        dropped = g_atomic_int_get(&log->dropped);
+    } while (!g_atomic_int_compare_and_exchange(&log->dropped, dropped, 0));
+    if (dropped) {
+        record.time = g_get_monotonic_time() - log->start_time;
+        record.e = dropped;
+        data = write_record(data, &record);
+    }
+
+    for (;;) {
+        slot = &log->slots[log->tail & RING_MASK];
+        if ((gint)((guint)g_atomic_int_get(&slot->sequence) - (log->tail + 1)) < 0)
+            break;
+
+        data = write_record(data, &slot->record);
+        g_atomic_int_set(&slot->sequence, (gint)(log->tail + RING_SIZE));
+        log->tail++;
+
+        if (data == chunk + CHUNK_RECORDS * OWR_EVENT_LOG_RECORD_SIZE) {
+            write_chunk(log, chunk, data - chunk);
+            data = chunk;
+        }
+    }
+
+    write_chunk(log, chunk, data - chunk);
+}
+
+/* Throws away records left in the ring by a previous log. Appenders that
+ * passed the active check before the stop may still be publishing their
+ * slot, so the reserved ones are waited for rather than reset. */
+static void discard(OwrEventLog *log)
+{
+    Slot *slot;
+
+    while (log->tail != (guint)g_atomic_int_get(&log->head)) {
+        slot = &log->slots[log->tail & RING_MASK];
+        if ((guint)g_atomic_int_get(&slot->sequence) != log->tail + 1) {
+            g_thread_yield();
+            continue;
+        }
+        g_atomic_int_set(&slot->sequence, (gint)(log->tail + RING_SIZE));
+        log->tail++;
+    }
+    g_atomic_int_set(&log->dropped, 0);
+}
+
+static gpointer run_writer(OwrEventLog *log)
+{
+    guint8 *chunk = g_malloc(CHUNK_RECORDS * OWR_EVENT_LOG_RECORD_SIZE);
+    gboolean stopping;
+
+    do {
+        g_mutex_lock(&log->lock);
+        if (!log->stopping)
+            g_cond_wait_until(&log->cond, &log->lock, g_get_monotonic_time() + FLUSH_INTERVAL);
+        stopping = log->stopping;
+        g_mutex_unlock(&log->lock);
+
+        flush(log, chunk);
+    } while (!stopping);
+
+    g_free(chunk);
+    return NULL;
+}
+
+/*
+ * Starts logging to a new file at @path, replacing an existing one. Returns
+ * FALSE if the file can't be created or a log is already running.
+ */
+gboolean _owr_event_log_start(OwrEventLog *log, const gchar *path)
+{
+    guint8 header[OWR_EVENT_LOG_HEADER_SIZE];
+    GError *error = NULL;
+    GFile *file;
+    guint i;
+
+    g_return_val_if_fail(log, FALSE);
+    g_return_val_if_fail(path, FALSE);
+
+    g_mutex_lock(&log->lock);
+
+    if (log->thread) {
+        g_mutex_unlock(&log->lock);
+        GST_WARNING("An event log is already running");
+        return FALSE;
+    }
+
+    file = g_file_new_for_path(path);
+    log->stream = G_OUTPUT_STREAM(g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+    g_object_unref(file);
+    if (!log->stream) {
+        g_mutex_unlock(&log->lock);
+        GST_WARNING("Failed to create the event log %s: %s", path, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    /* The ring is kept when the log is stopped, since streaming threads may
+     * still be appending to it */
+    if (!log->slots) {
+        log->slots = g_new0(Slot, RING_SIZE);
+        for (i = 0; i < RING_SIZE; i++)
+            log->slots[i].sequence = i;
+    } else
+        discard(log);
+    g_atomic_int_set(&log->arrival_base_set, FALSE);
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, OWR_EVENT_LOG_MAGIC, 8);
+    GST_WRITE_UINT32_LE(header + 8, OWR_EVENT_LOG_VERSION);
+    GST_WRITE_UINT32_LE(header + 12, OWR_EVENT_LOG_RECORD_SIZE);
+    GST_WRITE_UINT64_LE(header + 16, g_get_real_time());
+    log->start_time = g_get_monotonic_time();
+    write_chunk(log, header, sizeof(header));
+
+    log->stopping = FALSE;
+    log->thread = g_thread_new("owr-event-log", (GThreadFunc)run_writer, log);
+    g_atomic_int_set(&log->active, TRUE);
+
+    g_mutex_unlock(&log->lock);
+
+    return TRUE;
+}
+
+void _owr_event_log_stop(OwrEventLog *log)
+{
+    GThread *thread;
+
+    g_return_if_fail(log);
+
+    g_mutex_lock(&log->lock);
+    g_atomic_int_set(&log->active, FALSE);
+    thread = log->thread;
+    log->thread = NULL;
+    log->stopping = TRUE;
+    g_cond_signal(&log->cond);
+    g_mutex_unlock(&log->lock);
+
+    if (!thread)
+        return;
+
+    g_thread_join(thread);
+    g_output_stream_close(log->stream, NULL, NULL);
+    g_object_unref(log->stream);
+    log->stream = NULL;
+}
+
+/* Maps a running time to us since the start of the log, so that it only
+ * wraps 2^32 us (about 71 minutes) after the start */
+static guint32 arrival_time(OwrEventLog *log, GstClockTime running_time)
+{
+    guint64 elapsed;
+
+    if (!g_atomic_int_get(&log->arrival_base_set)) {
+        g_mutex_lock(&log->lock);
+        if (!log->arrival_base_set) {
+            elapsed = (g_get_monotonic_time() - log->start_time) * GST_USECOND;
+            log->arrival_base = running_time > elapsed ? running_time - elapsed : 0;
+            g_atomic_int_set(&log->arrival_base_set, TRUE);
+        }
+        g_mutex_unlock(&log->lock);
+    }
+
+    if (running_time < log->arrival_base)
+        return 0;
+    return (guint32)((running_time - log->arrival_base) / GST_USECOND);
+}
+
+void _owr_event_log_rtp(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    GstBuffer *buffer)
+{
+    Record record = {0, type, 0, 0, session_id, 0, 0, 0, 0};
+    OwrArrivalTimeMeta *meta;
+    guint8 header[12];
+
+    if (!g_atomic_int_get(&log->active))
+        return;
+
+    /* Only the fixed header is needed, which is also readable in SRTP */
+    if (gst_buffer_extract(buffer, 0, header, sizeof(header)) < sizeof(header))
+        return;
+
+    /* Marker bit and payload type */
+    record.a = header[1];
+    record.b = GST_READ_UINT16_BE(header + 2);
+    record.d = GST_READ_UINT32_BE(header + 4);
+    record.c = GST_READ_UINT32_BE(header + 8);
+    record.e = gst_buffer_get_size(buffer);
+    if (type == OWR_EVENT_LOG_TYPE_RTP_IN && (meta = _owr_buffer_get_arrival_time_meta(buffer))
+        && GST_CLOCK_TIME_IS_VALID(meta->arrival_time))
+        record.f = arrival_time(log, meta->arrival_time);
+
+    append(log, &record);
+}
+
+void _owr_event_log_rtcp(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    GstBuffer *buffer)
+{
+    Record record = {0, type, 0, 0, session_id, 0, 0, 0, 0};
+    GstMapInfo info;
+    gsize offset, size;
+
+    if (!g_atomic_int_get(&log->active) || !gst_buffer_map(buffer, &info, GST_MAP_READ))
+        return;
+
+    /* Walks the headers of the compound packet without validating it */
+    for (offset = 0; offset + 8 <= info.size; offset += size) {
+        size = (GST_READ_UINT16_BE(info.data + offset + 2) + 1) * 4;
+        record.a = info.data[offset + 1];
+        record.b = info.data[offset] & 0x1f;
+        record.c = GST_READ_UINT32_BE(info.data + offset + 4);
+        record.d = (record.a == GST_RTCP_TYPE_RTPFB || record.a == GST_RTCP_TYPE_PSFB)
+            && offset + 12 <= info.size
+            ? GST_READ_UINT32_BE(info.data + offset + 8) : 0;
+        record.e = size;
+        append(log, &record);
+    }
+
+    gst_buffer_unmap(buffer, &info);
+}
+
+void _owr_event_log_scream_feedback(OwrEventLog *log, guint session_id, guint32 media_ssrc,
+    guint16 highest_seq, guint8 n_loss, guint8 n_ecn, guint32 timestamp)
+{
+    Record record = {0, OWR_EVENT_LOG_TYPE_SCREAM_FEEDBACK, 0, highest_seq, session_id,
+        media_ssrc, timestamp, n_loss, n_ecn};
+
+    if (g_atomic_int_get(&log->active))
+        append(log, &record);
+}
+
+void _owr_event_log_bitrate(OwrEventLog *log, guint session_id, guint32 ssrc, guint8 pt,
+    guint bitrate)
+{
+    Record record = {0, OWR_EVENT_LOG_TYPE_BITRATE, pt, 0, session_id, ssrc, bitrate, 0, 0};
+
+    if (g_atomic_int_get(&log->active))
+        append(log, &record);
+}
+
+void _owr_event_log_state(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    guint component, guint state)
+{
+    Record record = {0, type, component, state, session_id, 0, 0, 0, 0};
+
+    if (g_atomic_int_get(&log->active))
+        append(log, &record);
+}
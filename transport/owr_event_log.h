@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrEventLog
+/*/
+
+#ifndef __OWR_EVENT_LOG_H__
+#define __OWR_EVENT_LOG_H__
+
+#include <glib.h>
+#ifndef OWR_EVENT_LOG_FORMAT_ONLY
+#include <gst/gst.h>
+#endif
+
+G_BEGIN_DECLS
+
+/*
+ * File format, all integers little endian:
+ *
+ * Header (32 bytes)
+ *   0  magic "OWREVLOG"
+ *   8  guint32 version
+ *  12  guint32 record size
+ *  16  gint64 wall clock time of the start of the log, in us since the epoch
+ *  24  8 bytes reserved
+ *
+ * Records (OWR_EVENT_LOG_RECORD_SIZE bytes)
+ *   0  guint64 time since the start of the log, in us
+ *   8  guint8 type, an OwrEventLogType
+ *   9  guint8 a
+ *  10  guint16 b
+ *  12  guint32 session id
+ *  16  guint32 c
+ *  20  guint32 d
+ *  24  guint32 e
+ *  28  guint32 f
+ *
+ * The meaning of a-f depends on the type:
+ *   RTP_IN/RTP_OUT    a: payload type | marker << 7, b: sequence number,
+ *                     c: ssrc, d: rtp timestamp, e: size,
+ *                     f: arrival time in us since the start of the log,
+ *                     wrapping after about 71 minutes (RTP_IN only)
+ *   RTCP_IN/RTCP_OUT  one record per packet of the compound packet,
+ *                     a: packet type, b: count or feedback type,
+ *                     c: sender ssrc, d: media ssrc (feedback only), e: size
+ *   SCREAM_FEEDBACK   b: highest sequence number, c: media ssrc,
+ *                     d: timestamp, e: lost packets, f: ECN marked packets
+ *   BITRATE           a: payload type, c: ssrc, d: bitrate in bps
+ *   ICE_STATE         a: component, b: OwrIceState
+ *   DTLS_STATE        a: component, b: 1 when the SRTP keys have been set
+ *   DROPPED           e: records dropped because the ring was full
+ */
+
+#define OWR_EVENT_LOG_MAGIC "OWREVLOG"
+#define OWR_EVENT_LOG_VERSION 1
+#define OWR_EVENT_LOG_HEADER_SIZE 32
+#define OWR_EVENT_LOG_RECORD_SIZE 32
+
+typedef enum {
+    OWR_EVENT_LOG_TYPE_RTP_IN = 1,
+    OWR_EVENT_LOG_TYPE_RTP_OUT,
+    OWR_EVENT_LOG_TYPE_RTCP_IN,
+    OWR_EVENT_LOG_TYPE_RTCP_OUT,
+    OWR_EVENT_LOG_TYPE_SCREAM_FEEDBACK,
+    OWR_EVENT_LOG_TYPE_BITRATE,
+    OWR_EVENT_LOG_TYPE_ICE_STATE,
+    OWR_EVENT_LOG_TYPE_DTLS_STATE,
+    OWR_EVENT_LOG_TYPE_DROPPED
+} OwrEventLogType;
+
+#ifndef OWR_EVENT_LOG_FORMAT_ONLY
+
+typedef struct _OwrEventLog OwrEventLog;
+
+OwrEventLog * _owr_event_log_new(void);
+void _owr_event_log_free(OwrEventLog *log);
+gboolean _owr_event_log_start(OwrEventLog *log, const gchar *path);
+void _owr_event_log_stop(OwrEventLog *log);
+
+void _owr_event_log_rtp(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    GstBuffer *buffer);
+void _owr_event_log_rtcp(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    GstBuffer *buffer);
+void _owr_event_log_scream_feedback(OwrEventLog *log, guint session_id, guint32 media_ssrc,
+    guint16 highest_seq, guint8 n_loss, guint8 n_ecn, guint32 timestamp);
+void _owr_event_log_bitrate(OwrEventLog *log, guint session_id, guint32 ssrc, guint8 pt,
+    guint bitrate);
+void _owr_event_log_state(OwrEventLog *log, OwrEventLogType type, guint session_id,
+    guint component, guint state);
+
+#endif /* OWR_EVENT_LOG_FORMAT_ONLY */
+
+G_END_DECLS
+
+#endif /* __OWR_EVENT_LOG_H__ */
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrMediaRecorder
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_media_recorder.h"
+
+#include "owr_utils.h"
+
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN(_owrmediasession_debug);
+#define GST_CAT_DEFAULT _owrmediasession_debug
+
+/* Frames are dropped rather than queued beyond this */
+#define MAX_QUEUED_BYTES (8 * 1024 * 1024)
+/* Duration of the MP4 fragments, in ms */
+#define FRAGMENT_DURATION 1000
+/* Maximum time to wait for the muxer to finish the file */
+#define STOP_TIMEOUT (5 * GST_SECOND)
+
+static const struct {
+    const gchar *extension;
+    const gchar *muxer;
+} muxers[] = {
+    { ".mp4", "mp4mux" },
+    { ".webm", "webmmux" },
+    { ".mkv", "matroskamux" },
+};
+
+struct _OwrMediaRecorder {
+    volatile gint ref_count;
+    gchar *path;
+    const gchar *muxer_name;
+    GstElement *pipeline;
+
+    /* Used from the streaming thread of the recorded stream, and when
+     * stopping */
+    GMutex lock;
+    GstElement *appsrc;
+    gboolean stopped;
+    gboolean failed;
+    gboolean need_keyframe;
+    gboolean keyframe_requested;
+    GstClockTime base_time;
+    guint64 frames;
+    guint64 dropped;
+};
+
+static GstBusSyncReply on_bus_message(GstBus *bus, GstMessage *message, OwrMediaRecorder *recorder)
+{
+    GError *error = NULL;
+
+    OWR_UNUSED(bus);
+
+    switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_ERROR:
+        gst_message_parse_error(message, &error, NULL);
+        GST_WARNING("Recording to %s failed: %s", recorder->path, error->message);
+        g_error_free(error);
+
+        g_mutex_lock(&recorder->lock);
+        recorder->failed = TRUE;
+        g_mutex_unlock(&recorder->lock);
+        return GST_BUS_PASS;
+    case GST_MESSAGE_EOS:
+        return GST_BUS_PASS;
+    default:
+        return GST_BUS_DROP;
+    }
+}
+
+/*
+ * Creates a recorder writing one encoded stream to @path. The container is
+ * chosen from the extension of the path: .mp4, .webm or .mkv.
+ */
+OwrMediaRecorder * _owr_media_recorder_new(const gchar *path)
+{
+    OwrMediaRecorder *recorder;
+    const gchar *muxer_name = NULL;
+    GstBus *bus;
+    guint i;
+
+    g_return_val_if_fail(path, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS(muxers); i++) {
+        if (g_str_has_suffix(path, muxers[i].extension))
+            muxer_name = muxers[i].muxer;
+    }
+    if (!muxer_name) {
+        GST_WARNING("Unknown container for %s, use .mp4, .webm or .mkv", path);
+        return NULL;
+    }
+
+    recorder = g_slice_new0(OwrMediaRecorder);
+    recorder->ref_count = 1;
+    recorder->path = g_strdup(path);
+    recorder->muxer_name = muxer_name;
+    recorder->base_time = GST_CLOCK_TIME_NONE;
+    g_mutex_init(&recorder->lock);
+
+    recorder->pipeline = gst_pipeline_new("media-recorder");
+    bus = gst_pipeline_get_bus(GST_PIPELINE(recorder->pipeline));
+    gst_bus_set_sync_handler(bus, (GstBusSyncHandler)on_bus_message, recorder, NULL);
+    gst_object_unref(bus);
+
+    return recorder;
+}
+
+OwrMediaRecorder * _owr_media_recorder_ref(OwrMediaRecorder *recorder)
+{
+    g_return_val_if_fail(recorder, NULL);
+
+    g_atomic_int_inc(&recorder->ref_count);
+    return recorder;
+}
+
+void _owr_media_recorder_unref(OwrMediaRecorder *recorder)
+{
+    g_return_if_fail(recorder);
+
+    if (!g_atomic_int_dec_and_test(&recorder->ref_count))
+        return;
+
+    gst_element_set_state(recorder->pipeline, GST_STATE_NULL);
+    gst_object_unref(recorder->pipeline);
+    if (recorder->appsrc)
+        gst_object_unref(recorder->appsrc);
+    g_free(recorder->path);
+    g_mutex_clear(&recorder->lock);
+    g_slice_free(OwrMediaRecorder, recorder);
+}
+
+/* Sends end-of-stream through the muxer, so that the file is complete, and
+ * waits for it to be written */
+void _owr_media_recorder_stop(OwrMediaRecorder *recorder)
+{
+    GstElement *appsrc;
+    GstMessage *message;
+    GstBus *bus;
+
+    g_return_if_fail(recorder);
+
+    g_mutex_lock(&recorder->lock);
+    recorder->stopped = TRUE;
+    appsrc = recorder->appsrc && !recorder->failed ? gst_object_ref(recorder->appsrc) : NULL;
+    g_mutex_unlock(&recorder->lock);
+
+    if (appsrc) {
+        gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+        gst_object_unref(appsrc);
+
+        bus = gst_pipeline_get_bus(GST_PIPELINE(recorder->pipeline));
+        message = gst_bus_timed_pop_filtered(bus, STOP_TIMEOUT, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+        gst_object_unref(bus);
+        if (message)
+            gst_message_unref(message);
+        else
+            GST_WARNING("Timed out finishing the recording %s", recorder->path);
+    }
+
+    gst_element_set_state(recorder->pipeline, GST_STATE_NULL);
+
+    GST_INFO("Recorded %" G_GUINT64_FORMAT " frames to %s, %" G_GUINT64_FORMAT " dropped",
+        recorder->frames, recorder->path, recorder->dropped);
+}
+
+/* Builds appsrc ! [parser] ! muxer ! filesink once the caps of the recorded
+ * stream are known */
+static gboolean setup_pipeline(OwrMediaRecorder *recorder, GstCaps *caps)
+{
+    GstElement *parser = NULL, *muxer, *sink;
+    gboolean link_ok;
+
+    /* Lets the muxer get H.264 in the stream format it wants */
+    if (gst_structure_has_name(gst_caps_get_structure(caps, 0), "video/x-h264"))
+        parser = gst_element_factory_make("h264parse", "recorder-parser");
+
+    recorder->appsrc = gst_element_factory_make("appsrc", "recorder-source");
+    muxer = gst_element_factory_make(recorder->muxer_name, "recorder-muxer");
+    sink = gst_element_factory_make("filesink", "recorder-sink");
+    if (!recorder->appsrc || !muxer || !sink) {
+        GST_WARNING("Missing elements for recording to %s", recorder->path);
+        if (recorder->appsrc)
+            gst_object_unref(recorder->appsrc);
+        recorder->appsrc = NULL;
+        if (muxer)
+            gst_object_unref(muxer);
+        if (sink)
+            gst_object_unref(sink);
+        if (parser)
+            gst_object_unref(parser);
+        return FALSE;
+    }
+    gst_object_ref(recorder->appsrc);
+
+    g_object_set(recorder->appsrc, "caps", caps, "format", GST_FORMAT_TIME,
+        "max-bytes", (guint64)MAX_QUEUED_BYTES, NULL);
+    /* Fragmented and streamable files stay readable if the application dies
+     * before the recording is stopped */
+    if (!strcmp(recorder->muxer_name, "mp4mux"))
+        g_object_set(muxer, "fragment-duration", FRAGMENT_DURATION, NULL);
+    else
+        g_object_set(muxer, "streamable", TRUE, NULL);
+    /* Every buffer the muxer pushes is written straight away, so a complete
+     * fragment never sits in a stdio buffer. This runs on the recorder's own
+     * streaming thread, not on the media pipeline's. */
+    g_object_set(sink, "location", recorder->path, "buffer-mode", 2 /* unbuffered */, NULL);
+
+    gst_bin_add_many(GST_BIN(recorder->pipeline), recorder->appsrc, muxer, sink, NULL);
+    if (parser) {
+        gst_bin_add(GST_BIN(recorder->pipeline), parser);
+        link_ok = gst_element_link_many(recorder->appsrc, parser, muxer, sink, NULL);
+    } else
+        link_ok = gst_element_link_many(recorder->appsrc, muxer, sink, NULL);
+
+    if (!link_ok) {
+        GST_WARNING("Can't record %" GST_PTR_FORMAT " with %s", caps, recorder->muxer_name);
+        return FALSE;
+    }
+
+    return gst_element_set_state(recorder->pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+}
+
+static GstClockTime rebase(GstClockTime time, GstClockTime base_time)
+{
+    if (!GST_CLOCK_TIME_IS_VALID(time))
+        return time;
+    return time > base_time ? time - base_time : 0;
+}
+
+/* Returns TRUE if an upstream key frame request should be sent */
+static gboolean record_buffer(OwrMediaRecorder *recorder, GstPad *pad, GstBuffer *buffer)
+{
+    gboolean is_delta = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    gboolean request_keyframe = FALSE;
+    GstCaps *caps;
+
+    if (!recorder->appsrc) {
+        caps = gst_pad_get_current_caps(pad);
+        if (!caps)
+            return FALSE;
+        recorder->failed = !setup_pipeline(recorder, caps);
+        gst_caps_unref(caps);
+        if (recorder->failed)
+            return FALSE;
+        recorder->need_keyframe = TRUE;
+    }
+
+    if (recorder->need_keyframe) {
+        if (is_delta) {
+            recorder->dropped++;
+            /* Ask once per gap, the encoder is already busy with the first */
+            request_keyframe = !recorder->keyframe_requested;
+            recorder->keyframe_requested = TRUE;
+            return request_keyframe;
+        }
+        recorder->need_keyframe = FALSE;
+        recorder->keyframe_requested = FALSE;
+    }
+
+    if (gst_app_src_get_current_level_bytes(GST_APP_SRC(recorder->appsrc)) >= MAX_QUEUED_BYTES) {
+        /* Everything up to the next key frame depends on the dropped frame */
+        recorder->dropped++;
+        recorder->need_keyframe = TRUE;
+        return FALSE;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID(recorder->base_time))
+        recorder->base_time = GST_BUFFER_DTS_IS_VALID(buffer) ? GST_BUFFER_DTS(buffer)
+            : GST_BUFFER_PTS(buffer);
+
+    /* Shallow copy, the memory is shared with the media pipeline */
+    buffer = gst_buffer_copy(buffer);
+    GST_BUFFER_PTS(buffer) = rebase(GST_BUFFER_PTS(buffer), recorder->base_time);
+    GST_BUFFER_DTS(buffer) = rebase(GST_BUFFER_DTS(buffer), recorder->base_time);
+    gst_app_src_push_buffer(GST_APP_SRC(recorder->appsrc), buffer);
+
+    recorder->frames++;
+
+    return FALSE;
+}
+
+/*
+ * Handles a buffer or event probe on the pad carrying the encoded stream.
+ * Never waits: when the muxer or the disk can't keep up, frames are dropped
+ * and counted.
+ */
+void _owr_media_recorder_handle_probe(OwrMediaRecorder *recorder, GstPad *pad,
+    GstPadProbeInfo *info)
+{
+    gboolean request_keyframe = FALSE;
+    GstEvent *event;
+    GstCaps *caps;
+
+    g_mutex_lock(&recorder->lock);
+
+    if (recorder->stopped || recorder->failed) {
+        g_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+        request_keyframe = record_buffer(recorder, pad, GST_PAD_PROBE_INFO_BUFFER(info));
+    else if (recorder->appsrc) {
+        event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            gst_event_parse_caps(event, &caps);
+            gst_app_src_set_caps(GST_APP_SRC(recorder->appsrc), caps);
+        }
+    }
+
+    g_mutex_unlock(&recorder->lock);
+
+    if (request_keyframe) {
+        gst_pad_push_event(pad, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE,
+            TRUE, 0));
+    }
+}
+
+void _owr_media_recorder_get_counters(OwrMediaRecorder *recorder, guint64 *frames,
+    guint64 *dropped)
+{
+    g_return_if_fail(recorder);
+
+    g_mutex_lock(&recorder->lock);
+    if (frames)
+        *frames = recorder->frames;
+    if (dropped)
+        *dropped = recorder->dropped;
+    g_mutex_unlock(&recorder->lock);
+}
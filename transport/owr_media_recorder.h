@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrMediaRecorder
+/*/
+
+#ifndef __OWR_MEDIA_RECORDER_H__
+#define __OWR_MEDIA_RECORDER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _OwrMediaRecorder OwrMediaRecorder;
+
+OwrMediaRecorder * _owr_media_recorder_new(const gchar *path);
+OwrMediaRecorder * _owr_media_recorder_ref(OwrMediaRecorder *recorder);
+void _owr_media_recorder_unref(OwrMediaRecorder *recorder);
+void _owr_media_recorder_stop(OwrMediaRecorder *recorder);
+
+void _owr_media_recorder_handle_probe(OwrMediaRecorder *recorder, GstPad *pad,
+    GstPadProbeInfo *info);
+void _owr_media_recorder_get_counters(OwrMediaRecorder *recorder, guint64 *frames,
+    guint64 *dropped);
+
+G_END_DECLS
+
+#endif /* __OWR_MEDIA_RECORDER_H__ */
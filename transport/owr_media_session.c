@@ -45,11 +45,13 @@
 #endif
 #include "owr_media_session.h"
 
+#include "owr_media_recorder.h"
 #include "owr_media_session_private.h"
 #include "owr_media_source.h"
 #include "owr_private.h"
 #include "owr_remote_media_source.h"
 #include "owr_session_private.h"
+#include "owr_utils.h"
 
 #include <string.h>
 
@@ -76,6 +78,20 @@ struct _OwrMediaSessionPrivate {
     GSList *remote_sources;
     GMutex remote_source_lock;
     gint jitter_buffer_latency;
+    /* Negotiated id of each header extension, 0 if it is not used */
+    guint header_extension_ids[OWR_N_HEADER_EXTENSION_TYPES];
+    /* Last received value of each header extension, -1 before the first one */
+    volatile gint received_extension_values[OWR_N_HEADER_EXTENSION_TYPES];
+    /* Send and receive recorders, NULL when not recording */
+    OwrMediaRecorder *recorders[2];
+    GMutex recorder_lock;
+};
+
+static const gchar *header_extension_uris[OWR_N_HEADER_EXTENSION_TYPES] = {
+    OWR_HEADER_EXTENSION_AUDIO_LEVEL,
+    OWR_HEADER_EXTENSION_ABS_SEND_TIME,
+    OWR_HEADER_EXTENSION_TRANSPORT_CC,
+    OWR_HEADER_EXTENSION_VIDEO_ORIENTATION,
 };
 
 enum {
@@ -96,6 +112,7 @@ enum {
     PROP_SEND_SSRC,
     PROP_CNAME,
     PROP_JITTER_BUFFER_LATENCY,
+    PROP_AUDIO_LEVEL_EXTENSION_ID,
 
     N_PROPERTIES
 };
@@ -146,6 +163,11 @@ static void owr_media_session_set_property(GObject *object, guint property_id, c
         priv->jitter_buffer_latency = g_value_get_uint(value);
         break;
 
+    case PROP_AUDIO_LEVEL_EXTENSION_ID:
+        owr_media_session_set_header_extension_id(OWR_MEDIA_SESSION(object),
+            OWR_HEADER_EXTENSION_AUDIO_LEVEL, g_value_get_uint(value));
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -181,6 +203,11 @@ static void owr_media_session_get_property(GObject *object, guint property_id, G
         g_value_set_uint(value, priv->jitter_buffer_latency);
         break;
 
+    case PROP_AUDIO_LEVEL_EXTENSION_ID:
+        g_value_set_uint(value, _owr_media_session_get_header_extension(OWR_MEDIA_SESSION(object),
+            OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL));
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -211,6 +238,9 @@ static void owr_media_session_finalize(GObject *object)
 
     _owr_media_session_clear_closures(media_session);
 
+    owr_media_session_stop_recording(media_session);
+    g_mutex_clear(&priv->recorder_lock);
+
     if (priv->incoming_srtp_key)
         g_free(priv->incoming_srtp_key);
     if (priv->outgoing_srtp_key)
@@ -304,6 +334,14 @@ static void owr_media_session_class_init(OwrMediaSessionClass *klass)
         0, G_MAXUINT, 50,
         G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE);
 
+    obj_properties[PROP_AUDIO_LEVEL_EXTENSION_ID] = g_param_spec_uint("audio-level-extension-id",
+        "Audio level extension id",
+        "The negotiated RTP header extension id of " OWR_HEADER_EXTENSION_AUDIO_LEVEL
+        " (RFC 6464) in audio sessions, 0 to neither send nor parse audio levels. "
+        "Set before the send payload and receive payloads",
+        0, 14, 0,
+        G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE);
+
     g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
 
 }
@@ -311,6 +349,7 @@ static void owr_media_session_class_init(OwrMediaSessionClass *klass)
 static void owr_media_session_init(OwrMediaSession *media_session)
 {
     OwrMediaSessionPrivate *priv;
+    guint i;
 
     media_session->priv = priv = OWR_MEDIA_SESSION_GET_PRIVATE(media_session);
     priv->rtcp_mux = DEFAULT_RTCP_MUX;
@@ -325,6 +364,12 @@ static void owr_media_session_init(OwrMediaSession *media_session)
     priv->on_send_source = NULL;
     priv->remote_sources = NULL;
     priv->jitter_buffer_latency = 50;
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        priv->header_extension_ids[i] = 0;
+        priv->received_extension_values[i] = -1;
+    }
+    priv->recorders[0] = priv->recorders[1] = NULL;
+    g_mutex_init(&priv->recorder_lock);
     g_mutex_init(&priv->remote_source_lock);
     g_rw_lock_init(&priv->rw_lock);
 }
@@ -784,3 +829,306 @@ GstBuffer * _owr_media_session_get_srtp_key_buffer(OwrMediaSession *media_sessio
     g_warn_if_fail(key_len == 30);
     return gst_buffer_new_wrapped(key, key_len);
 }
+
+/**
+ * owr_media_session_set_header_extension_id:
+ * @media_session: the media session
+ * @uri: the URI of the extension, one of the OWR_HEADER_EXTENSION_ defines
+ * @id: the id negotiated for the extension (extmap), from 1 to 14, or 0 to
+ * stop using the extension
+ *
+ * Maps an RTP header extension to its negotiated id. Extensions are added to
+ * all sent packets and parsed from all received packets of the session.
+ * Mappings take effect for send and receive chains set up afterwards, so they
+ * should be set before the payloads. %OWR_HEADER_EXTENSION_ABS_SEND_TIME and
+ * %OWR_HEADER_EXTENSION_TRANSPORT_CC are instead stamped on every packet as
+ * it is sent on the transport, retransmissions included, and follow changes
+ * immediately.
+ *
+ * When %OWR_HEADER_EXTENSION_VIDEO_ORIENTATION is mapped, the rotation and
+ * mirroring of the #OwrVideoPayload are signalled to the receiver instead of
+ * being applied to the sent frames, and the orientation signalled by the
+ * remote side is applied by the #OwrVideoRenderer, #OwrImageRenderer and
+ * #OwrFrameRenderer.
+ *
+ * Returns: %FALSE if the extension is not supported
+ */
+gboolean owr_media_session_set_header_extension_id(OwrMediaSession *media_session, const gchar *uri, guint id)
+{
+    OwrMediaSessionPrivate *priv;
+    guint i;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), FALSE);
+    g_return_val_if_fail(uri, FALSE);
+    /* One-byte headers, 15 is reserved */
+    g_return_val_if_fail(id < 15, FALSE);
+
+    priv = media_session->priv;
+
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        if (!g_strcmp0(uri, header_extension_uris[i]))
+            break;
+    }
+    if (i == OWR_N_HEADER_EXTENSION_TYPES) {
+        GST_WARNING_OBJECT(media_session, "Unsupported header extension %s", uri);
+        return FALSE;
+    }
+
+    g_rw_lock_writer_lock(&priv->rw_lock);
+    priv->header_extension_ids[i] = id;
+    g_rw_lock_writer_unlock(&priv->rw_lock);
+
+    return TRUE;
+}
+
+/**
+ * owr_media_session_get_header_extension_id:
+ * @media_session: the media session
+ * @uri: the URI of the extension
+ *
+ * Returns: the id mapped to the extension, or 0 if it is not used
+ */
+guint owr_media_session_get_header_extension_id(OwrMediaSession *media_session, const gchar *uri)
+{
+    guint i;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), 0);
+
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        if (!g_strcmp0(uri, header_extension_uris[i]))
+            return _owr_media_session_get_header_extension(media_session, i);
+    }
+
+    return 0;
+}
+
+const gchar * _owr_media_session_get_header_extension_uri(OwrHeaderExtensionType type)
+{
+    g_return_val_if_fail(type < OWR_N_HEADER_EXTENSION_TYPES, NULL);
+
+    return header_extension_uris[type];
+}
+
+guint _owr_media_session_get_header_extension(OwrMediaSession *media_session, OwrHeaderExtensionType type)
+{
+    guint id;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), 0);
+    g_return_val_if_fail(type < OWR_N_HEADER_EXTENSION_TYPES, 0);
+
+    g_rw_lock_reader_lock(&media_session->priv->rw_lock);
+    id = media_session->priv->header_extension_ids[type];
+    g_rw_lock_reader_unlock(&media_session->priv->rw_lock);
+
+    return id;
+}
+
+/*
+ * Called from the receive streaming thread for every packet that carries the
+ * extension. Returns the previous value, -1 if there was none.
+ */
+gint _owr_media_session_swap_received_extension_value(OwrMediaSession *media_session,
+    OwrHeaderExtensionType type, gint value)
+{
+    volatile gint *received;
+    gint old_value;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), -1);
+    g_return_val_if_fail(type < OWR_N_HEADER_EXTENSION_TYPES, -1);
+
+    received = &media_session->priv->received_extension_values[type];
+    do {
+        old_value = g_atomic_int_get(received);
+    } while (!g_atomic_int_compare_and_exchange(received, old_value, value));
+
+    return old_value;
+}
+
+gboolean _owr_media_session_get_received_extension_value(OwrMediaSession *media_session,
+    OwrHeaderExtensionType type, guint *value)
+{
+    gint received;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), FALSE);
+    g_return_val_if_fail(type < OWR_N_HEADER_EXTENSION_TYPES, FALSE);
+
+    received = g_atomic_int_get(&media_session->priv->received_extension_values[type]);
+    if (received < 0)
+        return FALSE;
+
+    *value = received;
+    return TRUE;
+}
+
+/**
+ * owr_media_session_start_recording:
+ * @media_session: the media session
+ * @send_path: (allow-none): file to record the sent stream to, or %NULL
+ * @receive_path: (allow-none): file to record the received stream to, or %NULL
+ *
+ * Writes the encoded streams of the session to disk, without decoding or
+ * re-encoding them. The container is chosen from the file extension: .mp4
+ * (fragmented), .webm or .mkv. The files are complete once
+ * owr_media_session_stop_recording() returns, and stay playable up to the
+ * last written fragment if it is never called.
+ *
+ * Recording never slows down the call: if the disk can't keep up, frames are
+ * dropped up to the next key frame and counted in the stats.
+ *
+ * Returns: %FALSE if the session is already recording or a container is not
+ * supported
+ */
+gboolean owr_media_session_start_recording(OwrMediaSession *media_session,
+    const gchar *send_path, const gchar *receive_path)
+{
+    OwrMediaSessionPrivate *priv;
+    OwrMediaRecorder *recorders[2] = { NULL, NULL };
+    const gchar *paths[2];
+    guint i;
+
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), FALSE);
+    g_return_val_if_fail(send_path || receive_path, FALSE);
+
+    priv = media_session->priv;
+    paths[0] = send_path;
+    paths[1] = receive_path;
+
+    for (i = 0; i < 2; i++) {
+        if (paths[i] && !(recorders[i] = _owr_media_recorder_new(paths[i]))) {
+            if (i)
+                _owr_media_recorder_unref(recorders[0]);
+            return FALSE;
+        }
+    }
+
+    g_mutex_lock(&priv->recorder_lock);
+    if (priv->recorders[0] || priv->recorders[1]) {
+        g_mutex_unlock(&priv->recorder_lock);
+        GST_WARNING_OBJECT(media_session, "Already recording");
+        for (i = 0; i < 2; i++) {
+            if (recorders[i])
+                _owr_media_recorder_unref(recorders[i]);
+        }
+        return FALSE;
+    }
+    for (i = 0; i < 2; i++)
+        g_atomic_pointer_set(&priv->recorders[i], recorders[i]);
+    g_mutex_unlock(&priv->recorder_lock);
+
+    return TRUE;
+}
+
+/**
+ * owr_media_session_stop_recording:
+ * @media_session: the media session
+ *
+ * Stops recording and finishes the files. Blocks until they are written.
+ */
+void owr_media_session_stop_recording(OwrMediaSession *media_session)
+{
+    OwrMediaSessionPrivate *priv;
+    OwrMediaRecorder *recorders[2];
+    guint i;
+
+    g_return_if_fail(OWR_IS_MEDIA_SESSION(media_session));
+
+    priv = media_session->priv;
+
+    g_mutex_lock(&priv->recorder_lock);
+    for (i = 0; i < 2; i++) {
+        recorders[i] = priv->recorders[i];
+        g_atomic_pointer_set(&priv->recorders[i], NULL);
+    }
+    g_mutex_unlock(&priv->recorder_lock);
+
+    for (i = 0; i < 2; i++) {
+        if (recorders[i]) {
+            _owr_media_recorder_stop(recorders[i]);
+            _owr_media_recorder_unref(recorders[i]);
+        }
+    }
+}
+
+static OwrMediaRecorder * get_recorder(OwrMediaSession *media_session, gboolean send)
+{
+    OwrMediaSessionPrivate *priv = media_session->priv;
+    OwrMediaRecorder *recorder;
+
+    /* Avoids taking the lock for every frame when not recording */
+    if (!g_atomic_pointer_get(&priv->recorders[send ? 0 : 1]))
+        return NULL;
+
+    g_mutex_lock(&priv->recorder_lock);
+    recorder = priv->recorders[send ? 0 : 1];
+    if (recorder)
+        _owr_media_recorder_ref(recorder);
+    g_mutex_unlock(&priv->recorder_lock);
+
+    return recorder;
+}
+
+typedef struct {
+    OwrMediaSession *media_session;
+    gboolean send;
+} RecordingTap;
+
+static void recording_tap_free(RecordingTap *tap)
+{
+    g_object_unref(tap->media_session);
+    g_slice_free(RecordingTap, tap);
+}
+
+static GstPadProbeReturn probe_record(GstPad *pad, GstPadProbeInfo *info, RecordingTap *tap)
+{
+    OwrMediaRecorder *recorder;
+
+    recorder = get_recorder(tap->media_session, tap->send);
+    if (recorder) {
+        _owr_media_recorder_handle_probe(recorder, pad, info);
+        _owr_media_recorder_unref(recorder);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+/*
+ * Taps the encoded stream flowing through @pad for recording. @pad should be
+ * the sink pad of the payloader for the sent stream and the sink pad of the
+ * decoder for the received one.
+ */
+void _owr_media_session_add_recording_tap(OwrMediaSession *media_session, GstPad *pad, gboolean send)
+{
+    RecordingTap *tap;
+
+    g_return_if_fail(OWR_IS_MEDIA_SESSION(media_session));
+    g_return_if_fail(GST_IS_PAD(pad));
+
+    tap = g_slice_new(RecordingTap);
+    tap->media_session = g_object_ref(media_session);
+    tap->send = send;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        (GstPadProbeCallback)probe_record, tap, (GDestroyNotify)recording_tap_free);
+}
+
+void _owr_media_session_add_recording_stats(OwrMediaSession *media_session, gboolean send,
+    GHashTable *stats)
+{
+    OwrMediaRecorder *recorder;
+    guint64 frames, dropped;
+    GValue *value;
+
+    g_return_if_fail(OWR_IS_MEDIA_SESSION(media_session));
+    g_return_if_fail(stats);
+
+    recorder = get_recorder(media_session, send);
+    if (!recorder)
+        return;
+
+    _owr_media_recorder_get_counters(recorder, &frames, &dropped);
+    _owr_media_recorder_unref(recorder);
+
+    value = _owr_value_table_add(stats, "recorded-frames", G_TYPE_UINT64);
+    g_value_set_uint64(value, frames);
+    value = _owr_value_table_add(stats, "recording-dropped-frames", G_TYPE_UINT64);
+    g_value_set_uint64(value, dropped);
+}
@@ -75,6 +75,12 @@ struct _OwrMediaSessionClass {
     void (*on_incoming_source)(OwrMediaSession *media_session, OwrRemoteMediaSource *source);
 };
 
+/* RTP header extensions that can be mapped with owr_media_session_set_header_extension_id() */
+#define OWR_HEADER_EXTENSION_AUDIO_LEVEL "urn:ietf:params:rtp-hdrext:ssrc-audio-level"
+#define OWR_HEADER_EXTENSION_ABS_SEND_TIME "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time"
+#define OWR_HEADER_EXTENSION_TRANSPORT_CC "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"
+#define OWR_HEADER_EXTENSION_VIDEO_ORIENTATION "urn:3gpp:video-orientation"
+
 GType owr_media_session_get_type(void) G_GNUC_CONST;
 
 
@@ -82,6 +88,10 @@ OwrMediaSession * owr_media_session_new(gboolean dtls_client_mode);
 void owr_media_session_add_receive_payload(OwrMediaSession *media_session, OwrPayload *payload);
 void owr_media_session_set_send_payload(OwrMediaSession *media_session, OwrPayload *payload);
 void owr_media_session_set_send_source(OwrMediaSession *media_session, OwrMediaSource *source);
+gboolean owr_media_session_set_header_extension_id(OwrMediaSession *media_session, const gchar *uri, guint id);
+guint owr_media_session_get_header_extension_id(OwrMediaSession *media_session, const gchar *uri);
+gboolean owr_media_session_start_recording(OwrMediaSession *media_session, const gchar *send_path, const gchar *receive_path);
+void owr_media_session_stop_recording(OwrMediaSession *media_session);
 
 G_END_DECLS
 
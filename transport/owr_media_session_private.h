@@ -38,6 +38,16 @@
 
 G_BEGIN_DECLS
 
+/* The header extensions with built-in support, in the order of their URIs
+ * in owr_media_session.c */
+typedef enum {
+    OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL,
+    OWR_HEADER_EXTENSION_TYPE_ABS_SEND_TIME,
+    OWR_HEADER_EXTENSION_TYPE_TRANSPORT_CC,
+    OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION,
+    OWR_N_HEADER_EXTENSION_TYPES
+} OwrHeaderExtensionType;
+
 OwrPayload * _owr_media_session_get_receive_payload(OwrMediaSession *media_session, guint32 payload_type);
 OwrPayload * _owr_media_session_get_send_payload(OwrMediaSession *media_session);
 OwrMediaSource * _owr_media_session_get_send_source(OwrMediaSession *media_session);
@@ -51,6 +61,14 @@ void _owr_media_session_clear_closures(OwrMediaSession *media_session);
 
 GstBuffer * _owr_media_session_get_srtp_key_buffer(OwrMediaSession *media_session, const gchar *keyname);
 
+const gchar * _owr_media_session_get_header_extension_uri(OwrHeaderExtensionType type);
+guint _owr_media_session_get_header_extension(OwrMediaSession *media_session, OwrHeaderExtensionType type);
+gint _owr_media_session_swap_received_extension_value(OwrMediaSession *media_session, OwrHeaderExtensionType type, gint value);
+gboolean _owr_media_session_get_received_extension_value(OwrMediaSession *media_session, OwrHeaderExtensionType type, guint *value);
+
+void _owr_media_session_add_recording_tap(OwrMediaSession *media_session, GstPad *pad, gboolean send);
+void _owr_media_session_add_recording_stats(OwrMediaSession *media_session, gboolean send, GHashTable *stats);
+
 G_END_DECLS
 
 #endif /* __GTK_DOC_IGNORE__ */
@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/*/
+\*\ OwrRtpReplay
+/*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "owr_rtp_replay.h"
+
+#include "owr_utils.h"
+
+#include <gst/app/gstappsrc.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN(_owrtransportagent_debug);
+#define GST_CAT_DEFAULT _owrtransportagent_debug
+
+/* When replaying as fast as possible, the replay thread waits when this much
+ * is queued in front of rtpbin */
+#define MAX_QUEUED_BYTES (1024 * 1024)
+
+/* rtpdump, as written by rtptools and Wireshark: a text line followed by a
+ * 16 byte header, then an 8 byte header in front of every packet */
+#define RTPDUMP_MAGIC "#!rtpplay1.0 "
+#define RTPDUMP_FILE_HEADER_SIZE 16
+#define RTPDUMP_PACKET_HEADER_SIZE 8
+
+/* Classic pcap, pcapng isn't supported */
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_MAGIC_NANOSECONDS 0xa1b23c4d
+#define PCAP_FILE_HEADER_SIZE 24
+#define PCAP_PACKET_HEADER_SIZE 16
+
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+
+typedef enum {
+    FORMAT_RTPDUMP,
+    FORMAT_PCAP
+} Format;
+
+struct _OwrRtpReplay {
+    gchar *path;
+    GMappedFile *file;
+    const guint8 *data;
+    gsize size;
+    gsize position;
+    Format format;
+    gboolean big_endian;
+    gboolean nanoseconds;
+    guint32 link_type;
+    OwrReplayPacing pacing;
+
+    GstElement *appsrc;
+    GstBin *bin;
+    GstPad *sink_pad;
+    /* The pad normally linked to sink_pad, its packets are dropped while
+     * replaying */
+    GstPad *network_pad;
+    gulong network_probe;
+
+    GThread *thread;
+    GMutex lock;
+    GCond cond;
+    gboolean stopped;
+    guint64 packets;
+};
+
+static guint32 read_uint32(OwrRtpReplay *replay, const guint8 *data)
+{
+    return replay->big_endian ? GST_READ_UINT32_BE(data) : GST_READ_UINT32_LE(data);
+}
+
+static gboolean parse_file_header(OwrRtpReplay *replay)
+{
+    const guint8 *line_end;
+    guint32 magic;
+
+    if (replay->size > strlen(RTPDUMP_MAGIC)
+        && !memcmp(replay->data, RTPDUMP_MAGIC, strlen(RTPDUMP_MAGIC))) {
+        line_end = memchr(replay->data, '\n', replay->size);
+        if (!line_end)
+            return FALSE;
+        replay->format = FORMAT_RTPDUMP;
+        replay->position = line_end + 1 - replay->data + RTPDUMP_FILE_HEADER_SIZE;
+        return replay->position <= replay->size;
+    }
+
+    if (replay->size < PCAP_FILE_HEADER_SIZE)
+        return FALSE;
+
+    magic = GST_READ_UINT32_LE(replay->data);
+    if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NANOSECONDS) {
+        magic = GST_READ_UINT32_BE(replay->data);
+        if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NANOSECONDS)
+            return FALSE;
+        replay->big_endian = TRUE;
+    }
+    replay->format = FORMAT_PCAP;
+    replay->nanoseconds = magic == PCAP_MAGIC_NANOSECONDS;
+    /* The upper bits may carry FCS information */
+    replay->link_type = read_uint32(replay, replay->data + 20) & 0xffff;
+    replay->position = PCAP_FILE_HEADER_SIZE;
+
+    switch (replay->link_type) {
+    case LINKTYPE_NULL:
+    case LINKTYPE_ETHERNET:
+    case LINKTYPE_RAW:
+    case LINKTYPE_LINUX_SLL:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+        return TRUE;
+    default:
+        GST_WARNING("Unsupported pcap link type %u", replay->link_type);
+        return FALSE;
+    }
+}
+
+/* Returns the payload of a captured UDP datagram, NULL for anything else */
+static const guint8 * get_udp_payload(OwrRtpReplay *replay, const guint8 *frame, guint size,
+    guint *payload_size)
+{
+    guint header_size = 0, udp_size;
+
+    switch (replay->link_type) {
+    case LINKTYPE_NULL:
+        header_size = 4;
+        break;
+    case LINKTYPE_ETHERNET:
+        header_size = 14;
+        /* 802.1Q tag */
+        if (size >= 18 && GST_READ_UINT16_BE(frame + 12) == 0x8100)
+            header_size = 18;
+        break;
+    case LINKTYPE_LINUX_SLL:
+        header_size = 16;
+        break;
+    }
+    if (size <= header_size)
+        return NULL;
+    frame += header_size;
+    size -= header_size;
+
+    switch (frame[0] >> 4) {
+    case 4:
+        header_size = (frame[0] & 0x0f) * 4;
+        if (header_size < 20 || size < header_size || frame[9] != 17)
+            return NULL;
+        /* Fragments aren't reassembled */
+        if (GST_READ_UINT16_BE(frame + 6) & 0x3fff)
+            return NULL;
+        break;
+    case 6:
+        /* Extension headers aren't followed */
+        header_size = 40;
+        if (size < header_size || frame[6] != 17)
+            return NULL;
+        break;
+    default:
+        return NULL;
+    }
+    frame += header_size;
+    size -= header_size;
+
+    /* Datagrams cut by the capture length are skipped too */
+    if (size < 8)
+        return NULL;
+    udp_size = GST_READ_UINT16_BE(frame + 4);
+    if (udp_size < 8 || udp_size > size)
+        return NULL;
+
+    *payload_size = udp_size - 8;
+    return frame + 8;
+}
+
+/* RTCP is told apart from RTP by its packet type, as in RFC 5761 */
+static gboolean is_rtp(const guint8 *data, guint size)
+{
+    return size >= 12 && (data[0] >> 6) == 2 && (data[1] < 192 || data[1] > 223);
+}
+
+/* Finds the next RTP packet in the file and the time it was captured, in
+ * microseconds */
+static gboolean next_packet(OwrRtpReplay *replay, const guint8 **packet, guint *size,
+    gint64 *time)
+{
+    const guint8 *header;
+    guint length, packet_length;
+
+    while (TRUE) {
+        header = replay->data + replay->position;
+
+        if (replay->format == FORMAT_RTPDUMP) {
+            if (replay->size - replay->position < RTPDUMP_PACKET_HEADER_SIZE)
+                return FALSE;
+            length = GST_READ_UINT16_BE(header);
+            if (length < RTPDUMP_PACKET_HEADER_SIZE || length > replay->size - replay->position)
+                return FALSE;
+            replay->position += length;
+
+            /* The packet length is 0 for RTCP, and larger than the stored
+             * data if only headers were dumped */
+            packet_length = GST_READ_UINT16_BE(header + 2);
+            if (!packet_length || packet_length > length - RTPDUMP_PACKET_HEADER_SIZE)
+                continue;
+            *packet = header + RTPDUMP_PACKET_HEADER_SIZE;
+            *size = packet_length;
+            *time = (gint64)GST_READ_UINT32_BE(header + 4) * 1000;
+        } else {
+            if (replay->size - replay->position < PCAP_PACKET_HEADER_SIZE)
+                return FALSE;
+            length = read_uint32(replay, header + 8);
+            if (length > replay->size - replay->position - PCAP_PACKET_HEADER_SIZE)
+                return FALSE;
+            replay->position += PCAP_PACKET_HEADER_SIZE + length;
+
+            *packet = get_udp_payload(replay, header + PCAP_PACKET_HEADER_SIZE, length, size);
+            if (!*packet)
+                continue;
+            *time = (gint64)read_uint32(replay, header) * G_USEC_PER_SEC;
+            if (replay->nanoseconds)
+                *time += read_uint32(replay, header + 4) / 1000;
+            else
+                *time += read_uint32(replay, header + 4);
+        }
+
+        if (is_rtp(*packet, *size))
+            return TRUE;
+    }
+}
+
+static gpointer run_replay(OwrRtpReplay *replay)
+{
+    const guint8 *packet;
+    guint size;
+    gint64 time, first_time = -1, start_time = 0;
+    GstFlowReturn flow_ret = GST_FLOW_OK;
+    GstBuffer *buffer;
+    gboolean stopped;
+
+    while (flow_ret == GST_FLOW_OK && next_packet(replay, &packet, &size, &time)) {
+        if (first_time < 0) {
+            first_time = time;
+            start_time = g_get_monotonic_time();
+        }
+
+        g_mutex_lock(&replay->lock);
+        if (replay->pacing == OWR_REPLAY_PACING_ORIGINAL) {
+            while (!replay->stopped
+                && g_cond_wait_until(&replay->cond, &replay->lock, start_time + time - first_time))
+                ;
+        }
+        stopped = replay->stopped;
+        g_mutex_unlock(&replay->lock);
+        if (stopped)
+            break;
+
+        /* The packets aren't copied, the buffers keep the file mapped */
+        buffer = gst_buffer_new();
+        gst_buffer_append_memory(buffer, gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY,
+            (gpointer)packet, size, 0, size, g_mapped_file_ref(replay->file),
+            (GDestroyNotify)g_mapped_file_unref));
+        flow_ret = gst_app_src_push_buffer(GST_APP_SRC(replay->appsrc), buffer);
+        replay->packets++;
+    }
+
+    GST_INFO("Replayed %" G_GUINT64_FORMAT " RTP packets from %s", replay->packets, replay->path);
+
+    return NULL;
+}
+
+/*
+ * Opens an rtpdump or pcap file for replay. Only the RTP packets are
+ * replayed, RTCP and other traffic in the file is skipped.
+ */
+OwrRtpReplay * _owr_rtp_replay_new(const gchar *path, OwrReplayPacing pacing)
+{
+    OwrRtpReplay *replay;
+    GMappedFile *file;
+    GError *error = NULL;
+    GstCaps *caps;
+
+    g_return_val_if_fail(path, NULL);
+
+    file = g_mapped_file_new(path, FALSE, &error);
+    if (!file) {
+        GST_WARNING("Failed to open %s: %s", path, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    replay = g_slice_new0(OwrRtpReplay);
+    replay->path = g_strdup(path);
+    replay->file = file;
+    replay->data = (const guint8 *)g_mapped_file_get_contents(file);
+    replay->size = g_mapped_file_get_length(file);
+    replay->pacing = pacing;
+    g_mutex_init(&replay->lock);
+    g_cond_init(&replay->cond);
+
+    if (!parse_file_header(replay)) {
+        GST_WARNING("%s is not an rtpdump or pcap file", path);
+        _owr_rtp_replay_free(replay);
+        return NULL;
+    }
+
+    replay->appsrc = gst_object_ref_sink(gst_element_factory_make("appsrc", NULL));
+    caps = gst_caps_new_empty_simple("application/x-rtp");
+    /* Timestamped on arrival in rtpbin, like packets from the network */
+    g_object_set(replay->appsrc, "caps", caps, "format", GST_FORMAT_TIME, "is-live", TRUE,
+        "do-timestamp", TRUE, "block", pacing == OWR_REPLAY_PACING_FAST,
+        "max-bytes", (guint64)MAX_QUEUED_BYTES, NULL);
+    gst_caps_unref(caps);
+
+    return replay;
+}
+
+static GstPadProbeReturn drop_network_packets(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    OWR_UNUSED(pad);
+    OWR_UNUSED(info);
+    OWR_UNUSED(user_data);
+
+    return GST_PAD_PROBE_DROP;
+}
+
+/*
+ * Feeds the packets to @sink_pad in place of what is linked to it, and
+ * starts replaying. The appsrc is added to @bin, which must contain the
+ * element of @sink_pad.
+ */
+gboolean _owr_rtp_replay_attach(OwrRtpReplay *replay, GstBin *bin, GstPad *sink_pad)
+{
+    GstPad *src_pad;
+    gboolean link_ok;
+
+    g_return_val_if_fail(replay, FALSE);
+    g_return_val_if_fail(GST_IS_BIN(bin), FALSE);
+    g_return_val_if_fail(GST_IS_PAD(sink_pad), FALSE);
+    g_return_val_if_fail(!replay->bin, FALSE);
+
+    replay->network_pad = gst_pad_get_peer(sink_pad);
+    if (replay->network_pad) {
+        replay->network_probe = gst_pad_add_probe(replay->network_pad,
+            GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+            drop_network_packets, NULL, NULL);
+        gst_pad_unlink(replay->network_pad, sink_pad);
+    }
+
+    replay->bin = gst_object_ref(bin);
+    replay->sink_pad = gst_object_ref(sink_pad);
+    gst_bin_add(bin, replay->appsrc);
+
+    src_pad = gst_element_get_static_pad(replay->appsrc, "src");
+    link_ok = gst_pad_link(src_pad, sink_pad) == GST_PAD_LINK_OK;
+    gst_object_unref(src_pad);
+    if (!link_ok || !gst_element_sync_state_with_parent(replay->appsrc)) {
+        GST_WARNING("Failed to link the replay of %s", replay->path);
+        return FALSE;
+    }
+
+    replay->thread = g_thread_new("owr-rtp-replay", (GThreadFunc)run_replay, replay);
+
+    return TRUE;
+}
+
+/*
+ * Stops the replay, if it was started, and links back what was linked to
+ * the sink pad before.
+ */
+void _owr_rtp_replay_free(OwrRtpReplay *replay)
+{
+    GstPad *src_pad;
+
+    g_return_if_fail(replay);
+
+    if (replay->thread) {
+        g_mutex_lock(&replay->lock);
+        replay->stopped = TRUE;
+        g_cond_signal(&replay->cond);
+        g_mutex_unlock(&replay->lock);
+        /* Also wakes the thread up if it waits for room in the queue */
+        gst_element_set_state(replay->appsrc, GST_STATE_NULL);
+        g_thread_join(replay->thread);
+    }
+
+    if (replay->bin) {
+        gst_element_set_state(replay->appsrc, GST_STATE_NULL);
+        src_pad = gst_element_get_static_pad(replay->appsrc, "src");
+        gst_pad_unlink(src_pad, replay->sink_pad);
+        gst_object_unref(src_pad);
+        gst_bin_remove(replay->bin, replay->appsrc);
+
+        if (replay->network_pad) {
+            gst_pad_link(replay->network_pad, replay->sink_pad);
+            gst_pad_remove_probe(replay->network_pad, replay->network_probe);
+            gst_object_unref(replay->network_pad);
+        }
+        gst_object_unref(replay->sink_pad);
+        gst_object_unref(replay->bin);
+    }
+
+    if (replay->appsrc)
+        gst_object_unref(replay->appsrc);
+    g_mapped_file_unref(replay->file);
+    g_mutex_clear(&replay->lock);
+    g_cond_clear(&replay->cond);
+    g_free(replay->path);
+    g_slice_free(OwrRtpReplay, replay);
+}
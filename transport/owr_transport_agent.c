@@ -37,6 +37,7 @@
 #include "owr_transport_agent.h"
 
 #include "owr_arrival_time_meta.h"
+#include "owr_audio_level.h"
 #include "owr_audio_payload.h"
 #include "owr_candidate_private.h"
 #include "owr_data_channel.h"
@@ -44,15 +45,18 @@
 #include "owr_data_channel_protocol.h"
 #include "owr_data_session.h"
 #include "owr_data_session_private.h"
+#include "owr_event_log.h"
 #include "owr_media_session.h"
 #include "owr_media_session_private.h"
 #include "owr_media_source.h"
 #include "owr_media_source_private.h"
+#include "owr_message_data_private.h"
 #include "owr_message_origin_private.h"
 #include "owr_payload_private.h"
 #include "owr_private.h"
 #include "owr_remote_media_source.h"
 #include "owr_remote_media_source_private.h"
+#include "owr_rtp_replay.h"
 #include "owr_session.h"
 #include "owr_session_private.h"
 #include "owr_types.h"
@@ -63,6 +67,7 @@
 #include <interfaces.h>
 #include <gst/app/gstappsink.h>
 #include <gst/app/gstappsrc.h>
+#include <gst/audio/audio.h>
 #include <gst/gst.h>
 #include <gst/rtp/gstrtcpbuffer.h>
 #include <gst/rtp/gstrtpbuffer.h>
@@ -79,11 +84,13 @@ GST_DEBUG_CATEGORY_EXTERN(_owrsession_debug);
 #define GST_CAT_DEFAULT _owrtransportagent_debug
 
 #define DEFAULT_ICE_CONTROLLING_MODE TRUE
+#define DEFAULT_SHARD -1
 #define GST_RTCP_RTPFB_TYPE_SCREAM 18
 
 enum {
     PROP_0,
     PROP_ICE_CONTROLLING_MODE,
+    PROP_SHARD,
     N_PROPERTIES
 };
 
@@ -136,6 +143,10 @@ struct _OwrTransportAgentPrivate {
     NiceAgent *nice_agent;
     gboolean ice_controlling_mode;
 
+    /* All control work of the agent and its sessions runs on this context */
+    gint shard;
+    GMainContext *main_context;
+
     GMutex sessions_lock;
     GHashTable *sessions;
     GHashTable *pending_sessions;
@@ -163,6 +174,11 @@ struct _OwrTransportAgentPrivate {
     GRWLock data_channels_rw_mutex;
     gboolean data_session_added, data_session_established;
     OwrMessageOriginBusSet *message_origin_bus_set;
+
+    OwrEventLog *event_log;
+
+    /* session_id -> OwrRtpReplay, only used on the agent's main context */
+    GHashTable *replays;
 };
 
 typedef struct {
@@ -185,12 +201,46 @@ typedef struct {
     guint32 last_feedback_wallclock;
 } ScreamRx;
 
+typedef struct {
+    volatile gint ref_count;
+    guint8 ids[OWR_N_HEADER_EXTENSION_TYPES];
+
+    /* Only used from the encoder streaming thread */
+    GstAudioInfo info;
+    OwrVoiceActivity vad;
+
+    /* RFC 6464 extension byte for the last raw frame */
+    volatile gint audio_level;
+
+    /* CVO byte for the rotation and mirroring of the payload */
+    volatile gint video_orientation;
+} SendHeaderExtensions;
+
+typedef struct {
+    OwrMediaSession *media_session;
+
+    /* Transport-wide sequence number, only used from the SCReAM queue streaming thread */
+    guint16 transport_seq;
+} TransportHeaderExtensions;
+
+typedef struct {
+    OwrMediaSession *media_session;
+    guint8 ids[OWR_N_HEADER_EXTENSION_TYPES];
+} ReceiveHeaderExtensions;
+
+typedef struct {
+    OwrMediaSession *media_session;
+    /* Last flip method sent downstream, -1 before the first one */
+    gint flip_method;
+} ReceiveVideoOrientation;
+
 #define GEN_HASH_KEY(seq, ssrc) (seq ^ ssrc)
 
 static void owr_transport_agent_set_property(GObject *object, guint property_id,
     const GValue *value, GParamSpec *pspec);
 static void owr_transport_agent_get_property(GObject *object, guint property_id,
     GValue *value, GParamSpec *pspec);
+static void owr_transport_agent_constructed(GObject *object);
 
 
 static void add_helper_server_info(GResolver *resolver, GAsyncResult *result, GHashTable *info);
@@ -216,6 +266,9 @@ static void on_transport_bin_pad_added(GstElement *transport_bin, GstPad *new_pa
 static void on_rtpbin_pad_added(GstElement *rtpbin, GstPad *new_pad, OwrTransportAgent *agent);
 static void setup_video_receive_elements(GstPad *new_pad, guint32 session_id, OwrPayload *payload, OwrTransportAgent *transport_agent);
 static void setup_audio_receive_elements(GstPad *new_pad, guint32 session_id, OwrPayload *payload, OwrTransportAgent *transport_agent);
+static void add_receive_header_extensions(OwrTransportAgent *transport_agent, guint session_id,
+    OwrMediaType media_type, GstPad *pad);
+static void add_transport_header_extensions(OwrMediaSession *media_session, GstElement *scream_queue);
 static GstCaps * on_rtpbin_request_pt_map(GstElement *rtpbin, guint session_id, guint pt, OwrTransportAgent *agent);
 static GstElement * on_rtpbin_request_aux_sender(GstElement *rtpbin, guint session_id, OwrTransportAgent *transport_agent);
 static GstElement * on_rtpbin_request_aux_receiver(GstElement *rtpbin, guint session_id, OwrTransportAgent *transport_agent);
@@ -289,6 +342,8 @@ static void owr_transport_agent_finalize(GObject *object)
     transport_agent = OWR_TRANSPORT_AGENT(object);
     priv = transport_agent->priv;
 
+    g_hash_table_destroy(priv->replays);
+
     gst_element_set_state(priv->pipeline, GST_STATE_NULL);
     gst_object_unref(priv->pipeline);
 
@@ -310,6 +365,9 @@ static void owr_transport_agent_finalize(GObject *object)
     g_rw_lock_clear(&priv->data_channels_rw_mutex);
 
     g_object_unref(priv->nice_agent);
+    g_main_context_unref(priv->main_context);
+
+    _owr_event_log_free(priv->event_log);
 
     g_free(priv->transport_bin_name);
 
@@ -342,8 +400,15 @@ static void owr_transport_agent_class_init(OwrTransportAgentClass *klass)
         "Ice controlling mode", "Whether the ice agent is in controlling mode",
         DEFAULT_ICE_CONTROLLING_MODE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    obj_properties[PROP_SHARD] = g_param_spec_int("shard", "Shard",
+        "The main-loop shard that runs the agent, see owr_run_shards_in_background()"
+        " (-1 = pick one round-robin, the picked shard is returned when read)",
+        -1, G_MAXINT, DEFAULT_SHARD,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
     gobject_class->set_property = owr_transport_agent_set_property;
     gobject_class->get_property = owr_transport_agent_get_property;
+    gobject_class->constructed = owr_transport_agent_constructed;
     gobject_class->finalize = owr_transport_agent_finalize;
 
     g_object_class_install_properties(gobject_class, N_PROPERTIES, obj_properties);
@@ -427,8 +492,6 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer user_data)
 static void owr_transport_agent_init(OwrTransportAgent *transport_agent)
 {
     OwrTransportAgentPrivate *priv;
-    GstBus *bus;
-    GSource *bus_source;
     gchar *pipeline_name;
 
     transport_agent->priv = priv = OWR_TRANSPORT_AGENT_GET_PRIVATE(transport_agent);
@@ -436,6 +499,8 @@ static void owr_transport_agent_init(OwrTransportAgent *transport_agent)
     priv->ice_controlling_mode = DEFAULT_ICE_CONTROLLING_MODE;
     priv->agent_id = next_transport_agent_id++;
     priv->nice_agent = NULL;
+    priv->shard = DEFAULT_SHARD;
+    priv->main_context = NULL;
 
     priv->sessions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
     priv->pending_sessions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
@@ -444,19 +509,11 @@ static void owr_transport_agent_init(OwrTransportAgent *transport_agent)
     priv->rtcp_list = NULL;
     g_mutex_init(&transport_agent->priv->rtcp_lock);
 
-    g_return_if_fail(_owr_is_initialized());
+    priv->event_log = _owr_event_log_new();
+    priv->replays = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+        (GDestroyNotify)_owr_rtp_replay_free);
 
-    priv->nice_agent = nice_agent_new(_owr_get_main_context(), NICE_COMPATIBILITY_RFC5245);
-    g_object_bind_property(transport_agent, "ice-controlling-mode", priv->nice_agent,
-        "controlling-mode", G_BINDING_SYNC_CREATE);
-    g_signal_connect(G_OBJECT(priv->nice_agent), "new-candidate-full",
-        G_CALLBACK(on_new_candidate), transport_agent);
-    g_signal_connect(G_OBJECT(priv->nice_agent), "candidate-gathering-done",
-        G_CALLBACK(on_candidate_gathering_done), transport_agent);
-    g_signal_connect(G_OBJECT(priv->nice_agent), "component-state-changed",
-        G_CALLBACK(on_component_state_changed), transport_agent);
-    g_signal_connect(G_OBJECT(priv->nice_agent), "new-selected-pair-full",
-        G_CALLBACK(on_new_selected_pair), transport_agent);
+    g_return_if_fail(_owr_is_initialized());
 
     pipeline_name = g_strdup_printf("transport-agent-%u", priv->agent_id);
     priv->pipeline = gst_pipeline_new(pipeline_name);
@@ -469,12 +526,6 @@ static void owr_transport_agent_init(OwrTransportAgent *transport_agent)
     g_signal_connect(priv->pipeline, "deep-notify", G_CALLBACK(_owr_deep_notify), NULL);
 #endif
 
-    bus = gst_pipeline_get_bus(GST_PIPELINE(priv->pipeline));
-    bus_source = gst_bus_create_watch(bus);
-    g_source_set_callback(bus_source, (GSourceFunc) bus_call, transport_agent, NULL);
-    g_source_attach(bus_source, _owr_get_main_context());
-    g_source_unref(bus_source);
-
     priv->transport_bin_name = g_strdup_printf("transport_bin_%u", priv->agent_id);
     priv->transport_bin = gst_bin_new(priv->transport_bin_name);
     priv->rtpbin = gst_element_factory_make("rtpbin", "rtpbin");
@@ -512,6 +563,40 @@ static void owr_transport_agent_init(OwrTransportAgent *transport_agent)
     priv->message_origin_bus_set = owr_message_origin_bus_set_new();
 }
 
+static void owr_transport_agent_constructed(GObject *object)
+{
+    OwrTransportAgent *transport_agent = OWR_TRANSPORT_AGENT(object);
+    OwrTransportAgentPrivate *priv = transport_agent->priv;
+    GstBus *bus;
+    GSource *bus_source;
+
+    G_OBJECT_CLASS(owr_transport_agent_parent_class)->constructed(object);
+
+    g_return_if_fail(_owr_is_initialized());
+
+    priv->main_context = _owr_get_shard_main_context(&priv->shard);
+    _owr_set_main_context_for_object(transport_agent, priv->main_context);
+    GST_DEBUG_OBJECT(transport_agent, "running on shard %d", priv->shard);
+
+    priv->nice_agent = nice_agent_new(priv->main_context, NICE_COMPATIBILITY_RFC5245);
+    g_object_bind_property(transport_agent, "ice-controlling-mode", priv->nice_agent,
+        "controlling-mode", G_BINDING_SYNC_CREATE);
+    g_signal_connect(G_OBJECT(priv->nice_agent), "new-candidate-full",
+        G_CALLBACK(on_new_candidate), transport_agent);
+    g_signal_connect(G_OBJECT(priv->nice_agent), "candidate-gathering-done",
+        G_CALLBACK(on_candidate_gathering_done), transport_agent);
+    g_signal_connect(G_OBJECT(priv->nice_agent), "component-state-changed",
+        G_CALLBACK(on_component_state_changed), transport_agent);
+    g_signal_connect(G_OBJECT(priv->nice_agent), "new-selected-pair-full",
+        G_CALLBACK(on_new_selected_pair), transport_agent);
+
+    bus = gst_pipeline_get_bus(GST_PIPELINE(priv->pipeline));
+    bus_source = gst_bus_create_watch(bus);
+    g_source_set_callback(bus_source, (GSourceFunc) bus_call, transport_agent, NULL);
+    g_source_attach(bus_source, priv->main_context);
+    g_source_unref(bus_source);
+}
+
 
 static void owr_transport_agent_set_property(GObject *object, guint property_id,
     const GValue *value, GParamSpec *pspec)
@@ -527,6 +612,9 @@ static void owr_transport_agent_set_property(GObject *object, guint property_id,
     case PROP_ICE_CONTROLLING_MODE:
         priv->ice_controlling_mode = g_value_get_boolean(value);
         break;
+    case PROP_SHARD:
+        priv->shard = g_value_get_int(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -548,6 +636,9 @@ static void owr_transport_agent_get_property(GObject *object, guint property_id,
     case PROP_ICE_CONTROLLING_MODE:
         g_value_set_boolean(value, priv->ice_controlling_mode);
         break;
+    case PROP_SHARD:
+        g_value_set_int(value, priv->shard);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
         break;
@@ -592,10 +683,10 @@ void owr_transport_agent_add_helper_server(OwrTransportAgent *transport_agent,
 
     g_object_ref(transport_agent);
     resolver = g_resolver_get_default();
-    g_main_context_push_thread_default(_owr_get_main_context());
+    g_main_context_push_thread_default(transport_agent->priv->main_context);
     g_resolver_lookup_by_name_async(resolver, address, NULL,
         (GAsyncReadyCallback)add_helper_server_info, helper_server_info);
-    g_main_context_pop_thread_default(_owr_get_main_context());
+    g_main_context_pop_thread_default(transport_agent->priv->main_context);
     g_object_unref(resolver);
 }
 
@@ -636,6 +727,9 @@ void owr_transport_agent_add_session(OwrTransportAgent *agent, OwrSession *sessi
     g_return_if_fail(agent);
     g_return_if_fail(OWR_IS_MEDIA_SESSION(session) || OWR_IS_DATA_SESSION(session));
 
+    /* Everything scheduled for the session from now on runs on the agent's shard */
+    _owr_set_main_context_for_object(session, agent->priv->main_context);
+
     args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(agent));
     g_hash_table_insert(args, "transport_agent", agent);
     g_hash_table_insert(args, "session", session);
@@ -654,9 +748,8 @@ static void add_helper_server_info(GResolver *resolver, GAsyncResult *result, GH
     OwrTransportAgent *transport_agent;
     OwrTransportAgentPrivate *priv;
     GList *stream_ids, *item, *address_list;
-    GHashTable *stats_table;
+    OwrMessageData *stats_data;
     OwrMessageOrigin *message_origin;
-    GValue *value;
     guint stream_id;
     GError *error = NULL;
 
@@ -664,16 +757,14 @@ static void add_helper_server_info(GResolver *resolver, GAsyncResult *result, GH
     g_return_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent));
     g_hash_table_remove(info, "transport_agent");
 
-    stats_table = g_hash_table_lookup(info, "__data");
-    g_warn_if_fail(stats_table);
+    /* Only present if a bus was subscribed to stats when the call was scheduled */
+    stats_data = g_hash_table_lookup(info, "__data");
     g_hash_table_remove(info, "__data");
-    message_origin = OWR_MESSAGE_ORIGIN(g_hash_table_lookup(info, "__origin"));
-    g_warn_if_fail(message_origin);
+    message_origin = g_hash_table_lookup(info, "__origin");
     g_hash_table_remove(info, "__origin");
-    if (stats_table && message_origin) {
-        value = _owr_value_table_add(stats_table, "call_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
-    } else if (message_origin) {
+    if (stats_data && message_origin)
+        _owr_message_data_add_int64(stats_data, "call_time", g_get_monotonic_time());
+    else if (message_origin) {
         g_object_unref(message_origin);
     }
 
@@ -711,10 +802,9 @@ static void add_helper_server_info(GResolver *resolver, GAsyncResult *result, GH
 
     g_object_unref(transport_agent);
 
-    if (stats_table && message_origin) {
-        value = _owr_value_table_add(stats_table, "end_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
-        OWR_POST_STATS(message_origin, SCHEDULE, stats_table);
+    if (stats_data && message_origin) {
+        _owr_message_data_add_int64(stats_data, "end_time", g_get_monotonic_time());
+        OWR_POST_STATS(message_origin, SCHEDULE, stats_data);
         g_object_unref(message_origin);
     }
 }
@@ -854,8 +944,7 @@ static void maybe_handle_new_send_source_with_payload(OwrTransportAgent *transpo
 {
     OwrPayload *payload = NULL;
     OwrMediaSource *media_source = NULL;
-    GHashTable *event_data;
-    GValue *value;
+    OwrMessageData *event_data;
     guint stream_id;
     gboolean pending;
 
@@ -873,16 +962,17 @@ static void maybe_handle_new_send_source_with_payload(OwrTransportAgent *transpo
         (payload = _owr_media_session_get_send_payload(media_session)) &&
         (media_source = _owr_media_session_get_send_source(media_session))) {
 
-        event_data = _owr_value_table_new();
-        value = _owr_value_table_add(event_data, "start_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
+        event_data = OWR_WANTS_STATS(media_session) ? _owr_message_data_new(2) : NULL;
+        if (event_data)
+            _owr_message_data_add_int64(event_data, "start_time", g_get_monotonic_time());
 
         handle_new_send_payload(transport_agent, media_session, payload);
         handle_new_send_source(transport_agent, media_session, media_source, payload);
 
-        value = _owr_value_table_add(event_data, "end_time", G_TYPE_INT64);
-        g_value_set_int64(value, g_get_monotonic_time());
-        OWR_POST_STATS(media_session, SEND_PIPELINE_ADDED, event_data);
+        if (event_data) {
+            _owr_message_data_add_int64(event_data, "end_time", g_get_monotonic_time());
+            OWR_POST_STATS(media_session, SEND_PIPELINE_ADDED, event_data);
+        }
     }
 
     if (payload)
@@ -899,14 +989,13 @@ static void remove_existing_send_source_and_payload(OwrTransportAgent *transport
     GstPad *bin_src_pad, *sinkpad;
     GstElement *send_input_bin, *source_bin;
     OwrMediaType media_type = OWR_MEDIA_TYPE_UNKNOWN;
-    GHashTable *event_data;
-    GValue *value;
+    OwrMessageData *event_data, *link_data;
 
     g_assert(media_source);
 
-    event_data = _owr_value_table_new();
-    value = _owr_value_table_add(event_data, "start_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
+    event_data = OWR_WANTS_STATS(media_session) ? _owr_message_data_new(2) : NULL;
+    if (event_data)
+        _owr_message_data_add_int64(event_data, "start_time", g_get_monotonic_time());
 
     /* Setting a new, different source but have one already */
 
@@ -928,6 +1017,10 @@ static void remove_existing_send_source_and_payload(OwrTransportAgent *transport
     source_bin = GST_ELEMENT(gst_pad_get_parent(bin_src_pad));
     g_assert(source_bin);
 
+    link_data = OWR_WANTS_STATS(media_session) ? _owr_media_source_get_link_stats(source_bin) : NULL;
+    if (link_data)
+        OWR_POST_STATS(media_session, SOURCE_LINK, link_data);
+
     /* Shutting down will flush immediately */
     _owr_media_source_release_source(media_source, source_bin);
     gst_element_set_state(source_bin, GST_STATE_NULL);
@@ -949,9 +1042,10 @@ static void remove_existing_send_source_and_payload(OwrTransportAgent *transport
     gst_element_remove_pad(transport_agent->priv->transport_bin, sinkpad);
     gst_object_unref(sinkpad);
 
-    value = _owr_value_table_add(event_data, "end_time", G_TYPE_INT64);
-    g_value_set_int64(value, g_get_monotonic_time());
-    OWR_POST_STATS(media_session, SEND_PIPELINE_REMOVED, event_data);
+    if (event_data) {
+        _owr_message_data_add_int64(event_data, "end_time", g_get_monotonic_time());
+        OWR_POST_STATS(media_session, SEND_PIPELINE_REMOVED, event_data);
+    }
 }
 
 static void on_new_send_payload(OwrTransportAgent *transport_agent,
@@ -1117,7 +1211,7 @@ static gboolean add_session(GHashTable *args)
         g_object_set_data(rtp_session, "session_id", GUINT_TO_POINTER(stream_id));
         g_signal_connect_after(rtp_session, "on-sending-rtcp", G_CALLBACK(on_sending_rtcp), transport_agent);
         g_signal_connect(rtp_session, "on-feedback-rtcp", G_CALLBACK(on_feedback_rtcp), transport_agent);
-        g_signal_connect_after(rtp_session, "on-receiving-rtcp", G_CALLBACK(on_receiving_rtcp), NULL);
+        g_signal_connect_after(rtp_session, "on-receiving-rtcp", G_CALLBACK(on_receiving_rtcp), transport_agent);
         g_object_unref(rtp_session);
 
         maybe_handle_new_send_source_with_payload(transport_agent, OWR_MEDIA_SESSION(session));
@@ -1386,6 +1480,39 @@ static void on_bitrate_change(GstElement *scream_queue, guint bitrate, guint ssr
     _owr_schedule_with_hash_table((GSourceFunc)emit_bitrate_change, args);
 }
 
+static void log_bitrate_change(GstElement *scream_queue, guint bitrate, guint ssrc, guint pt,
+    AgentAndSessionIdPair *data)
+{
+    OWR_UNUSED(scream_queue);
+
+    _owr_event_log_bitrate(data->transport_agent->priv->event_log, data->session_id, ssrc, pt,
+        bitrate);
+}
+
+/* Sent packets are logged as they leave the SCReAM queue and received ones as
+ * they enter rtpbin, both without SRTP */
+static GstPadProbeReturn probe_log_rtp(GstPad *pad, GstPadProbeInfo *info,
+    AgentAndSessionIdPair *data)
+{
+    _owr_event_log_rtp(data->transport_agent->priv->event_log,
+        GST_PAD_DIRECTION(pad) == GST_PAD_SRC ? OWR_EVENT_LOG_TYPE_RTP_OUT : OWR_EVENT_LOG_TYPE_RTP_IN,
+        data->session_id, GST_PAD_PROBE_INFO_BUFFER(info));
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void add_rtp_log_probe(OwrTransportAgent *transport_agent, guint session_id,
+    GstPad *pad)
+{
+    AgentAndSessionIdPair *data;
+
+    data = g_new0(AgentAndSessionIdPair, 1);
+    data->transport_agent = transport_agent;
+    data->session_id = session_id;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)probe_log_rtp,
+        data, g_free);
+}
+
 static void link_rtpbin_to_send_output_bin(OwrTransportAgent *transport_agent, guint stream_id, gboolean rtp, gboolean rtcp)
 {
     gchar *rtpbin_pad_name, *dtls_srtp_pad_name;
@@ -1399,6 +1526,7 @@ static void link_rtpbin_to_send_output_bin(OwrTransportAgent *transport_agent, g
     OwrMediaSession *media_session;
     SendBinInfo *send_bin_info;
     GstElement *scream_queue;
+    AgentAndSessionIdPair *agent_and_session_id_pair;
 
     g_return_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent));
 
@@ -1419,6 +1547,11 @@ static void link_rtpbin_to_send_output_bin(OwrTransportAgent *transport_agent, g
     g_signal_connect_object(scream_queue, "on-bitrate-change", G_CALLBACK(on_bitrate_change),
         media_session, 0);
         /* TODO: Move connect to prepare_transport_bin_send_elements */
+    agent_and_session_id_pair = g_new0(AgentAndSessionIdPair, 1);
+    agent_and_session_id_pair->transport_agent = transport_agent;
+    agent_and_session_id_pair->session_id = stream_id;
+    g_signal_connect_data(scream_queue, "on-bitrate-change", G_CALLBACK(log_bitrate_change),
+        agent_and_session_id_pair, (GClosureNotify) g_free, 0);
 
     /* RTP */
     if (rtp) {
@@ -1430,6 +1563,10 @@ static void link_rtpbin_to_send_output_bin(OwrTransportAgent *transport_agent, g
         ghost_pad_and_add_to_bin(sink_pad, send_output_bin, dtls_srtp_pad_name);
         gst_object_unref(sink_pad);
 
+        src_pad = gst_element_get_static_pad(scream_queue, "src");
+        add_rtp_log_probe(transport_agent, stream_id, src_pad);
+        gst_object_unref(src_pad);
+
         linked_ok = gst_element_link_pads(transport_agent->priv->rtpbin, rtpbin_pad_name,
             send_output_bin, dtls_srtp_pad_name);
         g_warn_if_fail(linked_ok);
@@ -1529,6 +1666,7 @@ static void prepare_transport_bin_send_elements(OwrTransportAgent *transport_age
     g_signal_connect(scream_queue, "on-payload-adaptation-request",
         (GCallback)on_payload_adaptation_request, media_session);
     gst_bin_add(GST_BIN(send_output_bin), scream_queue);
+    add_transport_header_extensions(media_session, scream_queue);
 
     pending_session_info->nice_sink_rtp = nice_element = add_nice_element(transport_agent, stream_id, TRUE, FALSE, send_output_bin);
     pending_session_info->dtls_enc_rtp = dtls_srtp_bin_rtp = add_dtls_srtp_bin(transport_agent, stream_id, TRUE, FALSE, send_output_bin);
@@ -1701,6 +1839,7 @@ static void prepare_transport_bin_receive_elements(OwrTransportAgent *transport_
     scream_rx->adapt = TRUE; /* Always initiates to TRUE. Sets to TRUE or FALSE in probe_rtp_info */
     gst_pad_add_probe(rtp_sink_pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)probe_rtp_info,
         scream_rx, g_free);
+    add_rtp_log_probe(transport_agent, stream_id, rtp_sink_pad);
     gst_object_unref(rtp_sink_pad);
 }
 
@@ -1982,6 +2121,9 @@ static void on_component_state_changed(NiceAgent *nice_agent, guint stream_id,
     session = get_session(transport_agent, stream_id);
     g_return_if_fail(OWR_IS_SESSION(session));
 
+    _owr_event_log_state(transport_agent->priv->event_log, OWR_EVENT_LOG_TYPE_ICE_STATE,
+        stream_id, component_id, state);
+
     args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(session));
     g_hash_table_insert(args, "session", session);
     g_hash_table_insert(args, "session-id", GUINT_TO_POINTER(stream_id));
@@ -2089,6 +2231,10 @@ on_dtls_enc_key_set(GstElement *dtls_srtp_enc, AgentAndSessionIdPair *data)
     session = get_session(transport_agent, stream_id);
     g_return_if_fail(session);
 
+    _owr_event_log_state(transport_agent->priv->event_log, OWR_EVENT_LOG_TYPE_DTLS_STATE, stream_id,
+        g_str_has_prefix(GST_OBJECT_NAME(dtls_srtp_enc), "dtls_srtp_rtcp")
+        ? NICE_COMPONENT_TYPE_RTCP : NICE_COMPONENT_TYPE_RTP, TRUE);
+
     /* Once we have the key, the DTLS handshake is done and we can start sending data here. Note
      * that we only wait for the DTLS handshake to be completed for the RTP component.
      */
@@ -2104,6 +2250,7 @@ on_dtls_enc_key_set(GstElement *dtls_srtp_enc, AgentAndSessionIdPair *data)
         args = g_hash_table_new(g_str_hash, g_str_equal);
         g_hash_table_insert(args, "session", session);
         g_hash_table_insert(args, "transport_agent", g_object_ref(transport_agent));
+        g_hash_table_insert(args, "__context", transport_agent->priv->main_context);
         _owr_schedule_with_hash_table((GSourceFunc)maybe_handle_new_send_source_with_payload_from_main_thread, args);
     }
     g_mutex_unlock(&transport_agent->priv->sessions_lock);
@@ -2182,6 +2329,261 @@ static void on_caps(GstElement *sink, GParamSpec *pspec, OwrSession *session)
         GST_CAT_INFO_OBJECT(_owrsession_debug, session, "Sending media configured with caps: %" GST_PTR_FORMAT, caps);
 }
 
+static void send_header_extensions_unref(SendHeaderExtensions *extensions)
+{
+    if (g_atomic_int_dec_and_test(&extensions->ref_count))
+        g_slice_free(SendHeaderExtensions, extensions);
+}
+
+static GstPadProbeReturn probe_measure_audio_level(GstPad *pad, GstPadProbeInfo *info,
+    SendHeaderExtensions *extensions)
+{
+    GstEvent *event;
+    GstCaps *caps;
+    guint8 level;
+    gboolean voice;
+
+    OWR_UNUSED(pad);
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            gst_event_parse_caps(event, &caps);
+            if (!gst_audio_info_from_caps(&extensions->info, caps))
+                gst_audio_info_init(&extensions->info);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    level = _owr_audio_level_compute(GST_PAD_PROBE_INFO_BUFFER(info), &extensions->info);
+    voice = _owr_voice_activity_update(&extensions->vad, level);
+    g_atomic_int_set(&extensions->audio_level, (voice ? 0x80 : 0) | level);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean stamp_header_extensions(GstBuffer **buffer, guint idx, SendHeaderExtensions *extensions)
+{
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    guint8 *ids = extensions->ids;
+    guint8 data[3];
+    gboolean ok = TRUE;
+
+    OWR_UNUSED(idx);
+
+    *buffer = gst_buffer_make_writable(*buffer);
+    if (!gst_rtp_buffer_map(*buffer, GST_MAP_READWRITE, &rtp))
+        return TRUE;
+
+    if (ids[OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL]) {
+        data[0] = g_atomic_int_get(&extensions->audio_level);
+        ok &= gst_rtp_buffer_add_extension_onebyte_header(&rtp,
+            ids[OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL], data, 1);
+    }
+
+    /* The orientation only needs to be known when a frame is complete */
+    if (ids[OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION] && gst_rtp_buffer_get_marker(&rtp)) {
+        data[0] = g_atomic_int_get(&extensions->video_orientation);
+        ok &= gst_rtp_buffer_add_extension_onebyte_header(&rtp,
+            ids[OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION], data, 1);
+    }
+
+    gst_rtp_buffer_unmap(&rtp);
+
+    if (!ok)
+        GST_WARNING("Failed to add header extensions to an RTP packet");
+
+    return TRUE;
+}
+
+/* The payloader output is still plain RTP, before rtpbin and SRTP */
+static GstPadProbeReturn probe_stamp_header_extensions(GstPad *pad, GstPadProbeInfo *info,
+    SendHeaderExtensions *extensions)
+{
+    GstBufferList *list;
+    GstBuffer *buffer;
+
+    OWR_UNUSED(pad);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        list = gst_buffer_list_make_writable(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+        GST_PAD_PROBE_INFO_DATA(info) = list;
+        gst_buffer_list_foreach(list, (GstBufferListFunc)stamp_header_extensions, extensions);
+    } else {
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        stamp_header_extensions(&buffer, 0, extensions);
+        GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean stamp_transport_header_extensions(GstBuffer **buffer, guint idx,
+    TransportHeaderExtensions *extensions)
+{
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    guint abs_send_time_id, transport_cc_id;
+    guint8 data[3];
+    gboolean ok = TRUE;
+
+    OWR_UNUSED(idx);
+
+    /* Read for every packet so that renegotiated ids apply to the running transport */
+    abs_send_time_id = _owr_media_session_get_header_extension(extensions->media_session,
+        OWR_HEADER_EXTENSION_TYPE_ABS_SEND_TIME);
+    transport_cc_id = _owr_media_session_get_header_extension(extensions->media_session,
+        OWR_HEADER_EXTENSION_TYPE_TRANSPORT_CC);
+    if (!abs_send_time_id && !transport_cc_id)
+        return TRUE;
+
+    *buffer = gst_buffer_make_writable(*buffer);
+    if (!gst_rtp_buffer_map(*buffer, GST_MAP_READWRITE, &rtp))
+        return TRUE;
+
+    if (abs_send_time_id) {
+        /* 6.18 fixed point seconds, wrapping every 64 s */
+        GST_WRITE_UINT24_BE(data, ((g_get_monotonic_time() << 18) / G_USEC_PER_SEC) & 0xffffff);
+        ok &= gst_rtp_buffer_add_extension_onebyte_header(&rtp, abs_send_time_id, data, 3);
+    }
+
+    if (transport_cc_id) {
+        GST_WRITE_UINT16_BE(data, extensions->transport_seq++);
+        ok &= gst_rtp_buffer_add_extension_onebyte_header(&rtp, transport_cc_id, data, 2);
+    }
+
+    gst_rtp_buffer_unmap(&rtp);
+
+    if (!ok)
+        GST_WARNING("Failed to add transport header extensions to an RTP packet");
+
+    return TRUE;
+}
+
+/* The SCReAM queue output is every RTP packet put on the transport, RTX
+ * included, at the time it is paced out and still without SRTP */
+static GstPadProbeReturn probe_stamp_transport_header_extensions(GstPad *pad, GstPadProbeInfo *info,
+    TransportHeaderExtensions *extensions)
+{
+    GstBufferList *list;
+    GstBuffer *buffer;
+
+    OWR_UNUSED(pad);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        list = gst_buffer_list_make_writable(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+        GST_PAD_PROBE_INFO_DATA(info) = list;
+        gst_buffer_list_foreach(list, (GstBufferListFunc)stamp_transport_header_extensions, extensions);
+    } else {
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        stamp_transport_header_extensions(&buffer, 0, extensions);
+        GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void transport_header_extensions_free(TransportHeaderExtensions *extensions)
+{
+    g_object_unref(extensions->media_session);
+    g_slice_free(TransportHeaderExtensions, extensions);
+}
+
+/* Stamps abs-send-time and the transport-wide sequence number. There is one
+ * SCReAM queue per transport and it outlives payload changes, so the
+ * sequence numbers stay continuous across them and are never shared with
+ * another transport. */
+static void add_transport_header_extensions(OwrMediaSession *media_session, GstElement *scream_queue)
+{
+    TransportHeaderExtensions *extensions;
+    GstPad *pad;
+
+    extensions = g_slice_new0(TransportHeaderExtensions);
+    extensions->media_session = g_object_ref(media_session);
+
+    pad = gst_element_get_static_pad(scream_queue, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback)probe_stamp_transport_header_extensions, extensions,
+        (GDestroyNotify)transport_header_extensions_free);
+    gst_object_unref(pad);
+}
+
+static void update_video_orientation(OwrPayload *payload, GParamSpec *pspec,
+    SendHeaderExtensions *extensions)
+{
+    guint rotation = 0;
+    gboolean mirror = FALSE;
+    gint flip_method;
+
+    g_return_if_fail(OWR_IS_VIDEO_PAYLOAD(payload));
+    g_return_if_fail(G_IS_PARAM_SPEC(pspec) || !pspec);
+
+    g_object_get(payload, "rotation", &rotation, "mirror", &mirror, NULL);
+    flip_method = _owr_rotation_and_mirror_to_video_flip_method(rotation, mirror);
+    g_atomic_int_set(&extensions->video_orientation, _owr_video_flip_method_to_cvo(flip_method));
+}
+
+/* Stamps the media related header extensions mapped in the media session on
+ * the packets coming out of the payloader. For the audio level, every raw
+ * frame going into the encoder is measured and the level of the latest one is
+ * sent. The transport related ones are added by add_transport_header_extensions(). */
+static void add_send_header_extensions(OwrMediaSession *media_session, OwrPayload *payload,
+    OwrMediaType media_type, GstElement *encoder, GstElement *payloader)
+{
+    SendHeaderExtensions *extensions;
+    gboolean any = FALSE;
+    GstPad *pad;
+    guint i;
+
+    extensions = g_slice_new0(SendHeaderExtensions);
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        if (i == OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL && media_type != OWR_MEDIA_TYPE_AUDIO)
+            continue;
+        if (i == OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION && media_type != OWR_MEDIA_TYPE_VIDEO)
+            continue;
+        if (i == OWR_HEADER_EXTENSION_TYPE_ABS_SEND_TIME || i == OWR_HEADER_EXTENSION_TYPE_TRANSPORT_CC)
+            continue;
+        extensions->ids[i] = _owr_media_session_get_header_extension(media_session, i);
+        any |= extensions->ids[i] != 0;
+    }
+
+    if (!any) {
+        g_slice_free(SendHeaderExtensions, extensions);
+        return;
+    }
+
+    extensions->ref_count = 1;
+
+    if (extensions->ids[OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL]) {
+        gst_audio_info_init(&extensions->info);
+        _owr_voice_activity_init(&extensions->vad);
+        extensions->audio_level = OWR_AUDIO_LEVEL_SILENCE;
+
+        g_atomic_int_inc(&extensions->ref_count);
+        pad = gst_element_get_static_pad(encoder, "sink");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+            (GstPadProbeCallback)probe_measure_audio_level, extensions,
+            (GDestroyNotify)send_header_extensions_unref);
+        gst_object_unref(pad);
+    }
+
+    if (extensions->ids[OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION]) {
+        update_video_orientation(payload, NULL, extensions);
+
+        g_atomic_int_inc(&extensions->ref_count);
+        g_signal_connect_data(payload, "notify::rotation", G_CALLBACK(update_video_orientation),
+            extensions, (GClosureNotify)send_header_extensions_unref, 0);
+        g_atomic_int_inc(&extensions->ref_count);
+        g_signal_connect_data(payload, "notify::mirror", G_CALLBACK(update_video_orientation),
+            extensions, (GClosureNotify)send_header_extensions_unref, 0);
+    }
+
+    pad = gst_element_get_static_pad(payloader, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        (GstPadProbeCallback)probe_stamp_header_extensions, extensions,
+        (GDestroyNotify)send_header_extensions_unref);
+    gst_object_unref(pad);
+}
+
 static void handle_new_send_payload(OwrTransportAgent *transport_agent, OwrMediaSession *media_session, OwrPayload * payload)
 {
     guint stream_id;
@@ -2276,9 +2678,14 @@ static void handle_new_send_payload(OwrTransportAgent *transport_agent, OwrMedia
         g_assert(flip);
         g_free(name);
         g_return_if_fail(OWR_IS_VIDEO_PAYLOAD(payload));
-        g_signal_connect_object(payload, "notify::rotation", G_CALLBACK(update_flip_method), flip, 0);
-        g_signal_connect_object(payload, "notify::mirror", G_CALLBACK(update_flip_method), flip, 0);
-        update_flip_method(payload, NULL, flip);
+        /* With video orientation signalled to the receiver the frames are
+         * sent as they are and the flip stays in passthrough */
+        if (!_owr_media_session_get_header_extension(media_session,
+            OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION)) {
+            g_signal_connect_object(payload, "notify::rotation", G_CALLBACK(update_flip_method), flip, 0);
+            g_signal_connect_object(payload, "notify::mirror", G_CALLBACK(update_flip_method), flip, 0);
+            update_flip_method(payload, NULL, flip);
+        }
 
         name = g_strdup_printf("send-input-video-queue-%u", stream_id);
         queue = gst_element_factory_make("queue", name);
@@ -2290,6 +2697,10 @@ static void handle_new_send_payload(OwrTransportAgent *transport_agent, OwrMedia
         parser = _owr_payload_create_parser(payload);
         payloader = _owr_payload_create_payload_packetizer(payload);
         g_warn_if_fail(payloader && encoder);
+        add_send_header_extensions(media_session, payload, media_type, encoder, payloader);
+        sink_pad = gst_element_get_static_pad(payloader, "sink");
+        _owr_media_session_add_recording_tap(media_session, sink_pad, TRUE);
+        gst_object_unref(sink_pad);
 
         encoder_sink_pad = gst_element_get_static_pad(encoder, "sink");
         g_signal_connect(encoder_sink_pad, "notify::caps", G_CALLBACK(on_caps), OWR_SESSION(media_session));
@@ -2338,6 +2749,11 @@ static void handle_new_send_payload(OwrTransportAgent *transport_agent, OwrMedia
         g_signal_connect(encoder_sink_pad, "notify::caps", G_CALLBACK(on_caps), OWR_SESSION(media_session));
         gst_object_unref(encoder_sink_pad);
 
+        add_send_header_extensions(media_session, payload, media_type, encoder, payloader);
+        sink_pad = gst_element_get_static_pad(payloader, "sink");
+        _owr_media_session_add_recording_tap(media_session, sink_pad, TRUE);
+        gst_object_unref(sink_pad);
+
         gst_bin_add_many(GST_BIN(send_input_bin), encoder, payloader, NULL);
         if (parser) {
             gst_bin_add(GST_BIN(send_input_bin), parser);
@@ -2579,6 +2995,74 @@ static GstPadProbeReturn check_for_keyframe(GstPad *pad, GstPadProbeInfo *info,
     return GST_PAD_PROBE_OK;
 }
 
+static void receive_video_orientation_free(ReceiveVideoOrientation *orientation)
+{
+    g_object_unref(orientation->media_session);
+    g_slice_free(ReceiveVideoOrientation, orientation);
+}
+
+/* Sends the orientation last signalled by the remote side downstream with
+ * the decoded frames, for the video renderer to apply */
+static GstPadProbeReturn probe_push_video_orientation(GstPad *pad, GstPadProbeInfo *info,
+    ReceiveVideoOrientation *orientation)
+{
+    guint cvo;
+    gint flip_method;
+
+    OWR_UNUSED(info);
+
+    if (!_owr_media_session_get_received_extension_value(orientation->media_session,
+        OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION, &cvo))
+        return GST_PAD_PROBE_OK;
+
+    flip_method = _owr_cvo_to_video_flip_method(cvo);
+    if (flip_method != orientation->flip_method) {
+        orientation->flip_method = flip_method;
+        gst_pad_push_event(pad, _owr_video_orientation_event_new(flip_method));
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void add_receive_video_orientation(OwrTransportAgent *transport_agent, guint session_id,
+    GstPad *pad)
+{
+    ReceiveVideoOrientation *orientation;
+    OwrMediaSession *media_session;
+
+    media_session = OWR_MEDIA_SESSION(get_session(transport_agent, session_id));
+    g_return_if_fail(media_session);
+
+    if (!_owr_media_session_get_header_extension(media_session,
+        OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION)) {
+        g_object_unref(media_session);
+        return;
+    }
+
+    orientation = g_slice_new0(ReceiveVideoOrientation);
+    orientation->media_session = media_session;
+    orientation->flip_method = -1;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback)probe_push_video_orientation, orientation,
+        (GDestroyNotify)receive_video_orientation_free);
+}
+
+/* Records the received stream as it enters the decoder, after repair */
+static void add_receive_recording_tap(OwrTransportAgent *transport_agent, guint session_id,
+    GstElement *decoder)
+{
+    OwrMediaSession *media_session;
+    GstPad *pad;
+
+    media_session = OWR_MEDIA_SESSION(get_session(transport_agent, session_id));
+    g_return_if_fail(media_session);
+
+    pad = gst_element_get_static_pad(decoder, "sink");
+    _owr_media_session_add_recording_tap(media_session, pad, FALSE);
+    gst_object_unref(pad);
+    g_object_unref(media_session);
+}
+
 static void setup_video_receive_elements(GstPad *new_pad, guint32 session_id, OwrPayload *payload, OwrTransportAgent *transport_agent)
 {
     GstPad *depay_sink_pad = NULL, *ghost_pad = NULL;
@@ -2621,6 +3105,7 @@ static void setup_video_receive_elements(GstPad *new_pad, guint32 session_id, Ow
     gst_bin_add_many(GST_BIN(receive_output_bin), rtpdepay,
         videorepair1, decoder, /*decoded_tee,*/ NULL);
     depay_sink_pad = gst_element_get_static_pad(rtpdepay, "sink");
+    add_receive_header_extensions(transport_agent, session_id, OWR_MEDIA_TYPE_VIDEO, depay_sink_pad);
     if (parser) {
         gst_bin_add(GST_BIN(receive_output_bin), parser);
         link_ok &= gst_element_link_many(rtpdepay, parser, videorepair1, decoder, NULL);
@@ -2640,13 +3125,129 @@ static void setup_video_receive_elements(GstPad *new_pad, guint32 session_id, Ow
     sync_ok &= gst_element_sync_state_with_parent(rtpdepay);
     g_warn_if_fail(sync_ok);
 
+    add_receive_recording_tap(transport_agent, session_id, decoder);
+
     pad = gst_element_get_static_pad(decoder, "src");
+    add_receive_video_orientation(transport_agent, session_id, pad);
     g_snprintf(name, OWR_OBJECT_NAME_LENGTH_MAX, "video_src_%u_%u", OWR_CODEC_TYPE_NONE,
         session_id);
     add_pads_to_bin_and_transport_bin(pad, receive_output_bin, transport_agent->priv->transport_bin, name);
     gst_object_unref(pad);
 }
 
+static void receive_header_extensions_free(ReceiveHeaderExtensions *extensions)
+{
+    g_object_unref(extensions->media_session);
+    g_slice_free(ReceiveHeaderExtensions, extensions);
+}
+
+static void post_voice_activity(OwrMediaSession *media_session, guint32 ssrc, guint level,
+    gboolean voice)
+{
+    OwrMessageData *event_data;
+
+    event_data = _owr_message_data_new(3);
+    _owr_message_data_add_uint64(event_data, "ssrc", ssrc);
+    _owr_message_data_add_uint64(event_data, "level", level);
+    _owr_message_data_add_boolean(event_data, "voice", voice);
+    OWR_POST_EVENT(media_session, VOICE_ACTIVITY, event_data);
+}
+
+/* Keeps the last value of every mapped extension in the media session, for
+ * the stats. Changes of the voice activity flag of the audio level are also
+ * posted as events. */
+static GstPadProbeReturn probe_parse_header_extensions(GstPad *pad, GstPadProbeInfo *info,
+    ReceiveHeaderExtensions *extensions)
+{
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    gpointer data;
+    guint size, i;
+    gint value, old_audio_level = -1, audio_level = -1;
+    guint32 ssrc;
+
+    OWR_UNUSED(pad);
+
+    if (!gst_rtp_buffer_map(GST_PAD_PROBE_INFO_BUFFER(info), GST_MAP_READ, &rtp))
+        return GST_PAD_PROBE_OK;
+
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        if (!extensions->ids[i]
+            || !gst_rtp_buffer_get_extension_onebyte_header(&rtp, extensions->ids[i], 0, &data, &size))
+            continue;
+
+        switch (i) {
+        case OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL:
+            value = size >= 1 ? GST_READ_UINT8(data) : -1;
+            break;
+        case OWR_HEADER_EXTENSION_TYPE_ABS_SEND_TIME:
+            value = size >= 3 ? (gint)GST_READ_UINT24_BE(data) : -1;
+            break;
+        case OWR_HEADER_EXTENSION_TYPE_TRANSPORT_CC:
+            value = size >= 2 ? GST_READ_UINT16_BE(data) : -1;
+            break;
+        case OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION:
+            value = size >= 1 ? GST_READ_UINT8(data) : -1;
+            break;
+        default:
+            value = -1;
+            break;
+        }
+        if (value < 0)
+            continue;
+
+        if (i == OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL) {
+            audio_level = value;
+            old_audio_level = _owr_media_session_swap_received_extension_value(extensions->media_session,
+                i, value);
+        } else
+            _owr_media_session_swap_received_extension_value(extensions->media_session, i, value);
+    }
+    ssrc = gst_rtp_buffer_get_ssrc(&rtp);
+    gst_rtp_buffer_unmap(&rtp);
+
+    /* Only changes of the voice activity flag become events, the level itself
+     * is reported with the stats */
+    if (audio_level >= 0 && (old_audio_level < 0 ? audio_level & 0x80
+            : (old_audio_level ^ audio_level) & 0x80)
+        && OWR_WANTS_EVENT(extensions->media_session))
+        post_voice_activity(extensions->media_session, ssrc, audio_level & 0x7f, audio_level & 0x80);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void add_receive_header_extensions(OwrTransportAgent *transport_agent, guint session_id,
+    OwrMediaType media_type, GstPad *pad)
+{
+    ReceiveHeaderExtensions *extensions;
+    OwrMediaSession *media_session;
+    gboolean any = FALSE;
+    guint i;
+
+    media_session = OWR_MEDIA_SESSION(get_session(transport_agent, session_id));
+    g_return_if_fail(media_session);
+
+    extensions = g_slice_new0(ReceiveHeaderExtensions);
+    for (i = 0; i < OWR_N_HEADER_EXTENSION_TYPES; i++) {
+        if (i == OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL && media_type != OWR_MEDIA_TYPE_AUDIO)
+            continue;
+        if (i == OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION && media_type != OWR_MEDIA_TYPE_VIDEO)
+            continue;
+        extensions->ids[i] = _owr_media_session_get_header_extension(media_session, i);
+        any |= extensions->ids[i] != 0;
+    }
+
+    if (!any) {
+        g_slice_free(ReceiveHeaderExtensions, extensions);
+        g_object_unref(media_session);
+        return;
+    }
+
+    extensions->media_session = media_session;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback)probe_parse_header_extensions, extensions,
+        (GDestroyNotify)receive_header_extensions_free);
+}
+
 static void setup_audio_receive_elements(GstPad *new_pad, guint32 session_id, OwrPayload *payload, OwrTransportAgent *transport_agent)
 {
     GstElement *receive_output_bin;
@@ -2690,6 +3291,7 @@ static void setup_audio_receive_elements(GstPad *new_pad, guint32 session_id, Ow
     g_warn_if_fail(link_ok);
 
     rtp_caps_sink_pad = gst_element_get_static_pad(rtp_capsfilter, "sink");
+    add_receive_header_extensions(transport_agent, session_id, OWR_MEDIA_TYPE_AUDIO, rtp_caps_sink_pad);
     ghost_pad = ghost_pad_and_add_to_bin(rtp_caps_sink_pad, receive_output_bin, "sink");
     gst_object_unref(rtp_caps_sink_pad);
     if (!GST_PAD_LINK_SUCCESSFUL(gst_pad_link(new_pad, ghost_pad))) {
@@ -2705,6 +3307,8 @@ static void setup_audio_receive_elements(GstPad *new_pad, guint32 session_id, Ow
     sync_ok &= gst_element_sync_state_with_parent(rtp_capsfilter);
     g_warn_if_fail(sync_ok);
 
+    add_receive_recording_tap(transport_agent, session_id, decoder);
+
     pad = gst_element_get_static_pad(decoder, "src");
     pad_name = g_strdup_printf("audio_raw_src_%u", session_id);
     add_pads_to_bin_and_transport_bin(pad, receive_output_bin,
@@ -3036,6 +3640,8 @@ static gboolean on_sending_rtcp(GObject *session, GstBuffer *buffer, gboolean ea
         gst_rtcp_buffer_unmap(&rtcp_buffer);
     }
 
+    _owr_event_log_rtcp(priv->event_log, OWR_EVENT_LOG_TYPE_RTCP_OUT, session_id, buffer);
+
     g_return_val_if_fail(OWR_IS_TRANSPORT_AGENT(agent), do_not_suppress);
 
     media_session = OWR_MEDIA_SESSION(get_session(agent, session_id));
@@ -3064,10 +3670,10 @@ static void on_receiving_rtcp(GObject *session, GstBuffer *buffer,
     gboolean has_packet;
     guint session_id = 0;
 
-    OWR_UNUSED(agent);
-
     session_id = GPOINTER_TO_UINT(g_object_get_data(session, "session_id"));
 
+    _owr_event_log_rtcp(agent->priv->event_log, OWR_EVENT_LOG_TYPE_RTCP_IN, session_id, buffer);
+
     if (gst_rtcp_buffer_map(buffer, GST_MAP_READ, &rtcp_buffer)) {
         has_packet = gst_rtcp_buffer_get_first_packet(&rtcp_buffer, &rtcp_packet);
         for (; has_packet; has_packet = gst_rtcp_packet_move_to_next(&rtcp_packet)) {
@@ -3115,6 +3721,8 @@ static void prepare_rtcp_stats(OwrMediaSession *media_session, GObject *rtp_sour
     GstStructure *stats;
     GHashTable *stats_hash;
     GValue *value;
+    gboolean internal;
+    guint extension_value;
 
     g_object_get(rtp_source, "stats", &stats, NULL);
     stats_hash = _owr_value_table_new();
@@ -3122,12 +3730,44 @@ static void prepare_rtcp_stats(OwrMediaSession *media_session, GObject *rtp_sour
     g_value_set_string(value, "rtcp");
     gst_structure_foreach(stats,
         (GstStructureForeachFunc)update_stats_hash_table, stats_hash);
+
+    if (!gst_structure_get_boolean(stats, "internal", &internal))
+        internal = TRUE;
+    _owr_media_session_add_recording_stats(media_session, internal, stats_hash);
+
+    /* Remote sources get the last header extension values they sent */
+    if (!internal) {
+        if (_owr_media_session_get_received_extension_value(media_session,
+            OWR_HEADER_EXTENSION_TYPE_AUDIO_LEVEL, &extension_value)) {
+            value = _owr_value_table_add(stats_hash, "audio-level", G_TYPE_UINT);
+            g_value_set_uint(value, extension_value & 0x7f);
+            value = _owr_value_table_add(stats_hash, "voice-activity", G_TYPE_BOOLEAN);
+            g_value_set_boolean(value, (extension_value & 0x80) != 0);
+        }
+        if (_owr_media_session_get_received_extension_value(media_session,
+            OWR_HEADER_EXTENSION_TYPE_ABS_SEND_TIME, &extension_value)) {
+            value = _owr_value_table_add(stats_hash, "abs-send-time", G_TYPE_UINT);
+            g_value_set_uint(value, extension_value);
+        }
+        if (_owr_media_session_get_received_extension_value(media_session,
+            OWR_HEADER_EXTENSION_TYPE_TRANSPORT_CC, &extension_value)) {
+            value = _owr_value_table_add(stats_hash, "transport-sequence-number", G_TYPE_UINT);
+            g_value_set_uint(value, extension_value);
+        }
+        if (_owr_media_session_get_received_extension_value(media_session,
+            OWR_HEADER_EXTENSION_TYPE_VIDEO_ORIENTATION, &extension_value)) {
+            value = _owr_value_table_add(stats_hash, "video-orientation", G_TYPE_UINT);
+            g_value_set_uint(value, extension_value);
+        }
+    }
     gst_structure_free(stats);
 
     value = _owr_value_table_add(stats_hash, "media_session", OWR_TYPE_MEDIA_SESSION);
     g_value_set_object(value, media_session);
 
-    _owr_schedule_with_hash_table((GSourceFunc)emit_stats_signal, stats_hash);
+    /* stats_hash holds only GValues, so the context can't be passed in it */
+    _owr_schedule_with_user_data_on_context(_owr_get_main_context_for_object(media_session),
+        (GSourceFunc)emit_stats_signal, stats_hash);
 
 }
 
@@ -3873,6 +4513,8 @@ static void on_new_datachannel(OwrTransportAgent *transport_agent, OwrDataChanne
     guint id;
     gboolean negotiated, remote_initiated;
 
+    _owr_set_main_context_for_object(data_channel, priv->main_context);
+
     if (!priv->data_session_established)
         return;
 
@@ -4176,6 +4818,171 @@ gchar * owr_transport_agent_get_dot_data(OwrTransportAgent *transport_agent)
 #endif
 }
 
+/**
+ * owr_transport_agent_start_event_log:
+ * @transport_agent: the transport agent
+ * @path: the file to write the log to, replaced if it exists
+ *
+ * Starts recording a compact binary log of the RTP and RTCP packets, SCReAM
+ * feedback, bitrate changes and ICE and DTLS state changes of all sessions of
+ * the agent, for offline analysis. Recording only copies a few fields per
+ * packet into a ring buffer that is written to the file by a separate thread,
+ * so it can be kept running in production.
+ *
+ * Returns: %FALSE if the file can't be created or a log is already running
+ */
+gboolean owr_transport_agent_start_event_log(OwrTransportAgent *transport_agent, const gchar *path)
+{
+    g_return_val_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent), FALSE);
+    g_return_val_if_fail(path, FALSE);
+
+    return _owr_event_log_start(transport_agent->priv->event_log, path);
+}
+
+/**
+ * owr_transport_agent_stop_event_log:
+ * @transport_agent: the transport agent
+ *
+ * Stops the log started with owr_transport_agent_start_event_log() and
+ * writes the remaining records to the file.
+ */
+void owr_transport_agent_stop_event_log(OwrTransportAgent *transport_agent)
+{
+    g_return_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent));
+
+    _owr_event_log_stop(transport_agent->priv->event_log);
+}
+
+static gboolean start_replay(GHashTable *args)
+{
+    OwrTransportAgent *transport_agent;
+    OwrMediaSession *media_session;
+    OwrRtpReplay *replay;
+    GstPad *sink_pad;
+    gchar *name;
+    guint stream_id;
+
+    transport_agent = g_hash_table_lookup(args, "transport_agent");
+    media_session = g_hash_table_lookup(args, "media_session");
+    replay = g_hash_table_lookup(args, "replay");
+
+    stream_id = get_stream_id(transport_agent, OWR_SESSION(media_session));
+    if (!stream_id) {
+        _owr_rtp_replay_free(replay);
+        goto end;
+    }
+
+    if (g_hash_table_lookup(transport_agent->priv->replays, GUINT_TO_POINTER(stream_id))) {
+        GST_WARNING_OBJECT(transport_agent, "Session %u is already replaying", stream_id);
+        _owr_rtp_replay_free(replay);
+        goto end;
+    }
+
+    name = g_strdup_printf("recv_rtp_sink_%u", stream_id);
+    sink_pad = gst_element_get_static_pad(transport_agent->priv->rtpbin, name);
+    g_free(name);
+    g_assert(sink_pad);
+
+    if (_owr_rtp_replay_attach(replay, GST_BIN(transport_agent->priv->transport_bin), sink_pad))
+        g_hash_table_insert(transport_agent->priv->replays, GUINT_TO_POINTER(stream_id), replay);
+    else
+        _owr_rtp_replay_free(replay);
+    gst_object_unref(sink_pad);
+
+end:
+    g_object_unref(media_session);
+    g_object_unref(transport_agent);
+    g_hash_table_unref(args);
+    return FALSE;
+}
+
+static gboolean stop_replay(GHashTable *args)
+{
+    OwrTransportAgent *transport_agent;
+    OwrMediaSession *media_session;
+    guint stream_id;
+
+    transport_agent = g_hash_table_lookup(args, "transport_agent");
+    media_session = g_hash_table_lookup(args, "media_session");
+
+    stream_id = get_stream_id(transport_agent, OWR_SESSION(media_session));
+    if (stream_id)
+        g_hash_table_remove(transport_agent->priv->replays, GUINT_TO_POINTER(stream_id));
+
+    g_object_unref(media_session);
+    g_object_unref(transport_agent);
+    g_hash_table_unref(args);
+    return FALSE;
+}
+
+/**
+ * owr_transport_agent_start_replay:
+ * @transport_agent: the transport agent
+ * @media_session: a media session added to the agent
+ * @path: an rtpdump or pcap file
+ * @pacing: the timing of the replayed packets
+ *
+ * Feeds the RTP packets recorded in @path to the receive path of
+ * @media_session, as if they were received from the network, which is
+ * ignored meanwhile. The packets are decoded with the receive payloads of
+ * the session, packets with other payload types are dropped, and RTCP in the
+ * file is skipped. This reproduces a packet trace without a remote peer.
+ *
+ * pcap files can be captured from Ethernet, Linux cooked or raw IP links,
+ * and the RTP must be unencrypted. With %OWR_REPLAY_PACING_FAST, the packets
+ * are replayed as fast as the receive path takes them.
+ *
+ * Returns: %FALSE if the file can't be read or isn't an rtpdump or pcap file
+ */
+gboolean owr_transport_agent_start_replay(OwrTransportAgent *transport_agent,
+    OwrMediaSession *media_session, const gchar *path, OwrReplayPacing pacing)
+{
+    OwrRtpReplay *replay;
+    GHashTable *args;
+
+    g_return_val_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent), FALSE);
+    g_return_val_if_fail(OWR_IS_MEDIA_SESSION(media_session), FALSE);
+    g_return_val_if_fail(path, FALSE);
+
+    replay = _owr_rtp_replay_new(path, pacing);
+    if (!replay)
+        return FALSE;
+
+    /* Scheduled like owr_transport_agent_add_session(), so the session
+     * can be added right before */
+    args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(transport_agent));
+    g_hash_table_insert(args, "transport_agent", g_object_ref(transport_agent));
+    g_hash_table_insert(args, "media_session", g_object_ref(media_session));
+    g_hash_table_insert(args, "replay", replay);
+
+    _owr_schedule_with_hash_table((GSourceFunc)start_replay, args);
+
+    return TRUE;
+}
+
+/**
+ * owr_transport_agent_stop_replay:
+ * @transport_agent: the transport agent
+ * @media_session: the media session
+ *
+ * Stops the replay started with owr_transport_agent_start_replay() and goes
+ * back to receiving from the network.
+ */
+void owr_transport_agent_stop_replay(OwrTransportAgent *transport_agent,
+    OwrMediaSession *media_session)
+{
+    GHashTable *args;
+
+    g_return_if_fail(OWR_IS_TRANSPORT_AGENT(transport_agent));
+    g_return_if_fail(OWR_IS_MEDIA_SESSION(media_session));
+
+    args = _owr_create_schedule_table(OWR_MESSAGE_ORIGIN(transport_agent));
+    g_hash_table_insert(args, "transport_agent", g_object_ref(transport_agent));
+    g_hash_table_insert(args, "media_session", g_object_ref(media_session));
+
+    _owr_schedule_with_hash_table((GSourceFunc)stop_replay, args);
+}
+
 
 static void on_feedback_rtcp(GObject *session, guint type, guint fbtype, guint sender_ssrc,
     guint media_ssrc, GstBuffer *fci, OwrTransportAgent *transport_agent)
@@ -4211,6 +5018,8 @@ static void on_feedback_rtcp(GObject *session, guint type, guint fbtype, guint s
             /* TODO: Fix qbit */
 
             gst_buffer_unmap(fci, &info);
+            _owr_event_log_scream_feedback(transport_agent->priv->event_log, session_id,
+                media_ssrc, highest_seq, n_loss, n_ecn, timestamp);
             g_signal_emit_by_name(scream_queue, "incoming-feedback", media_ssrc, timestamp, highest_seq, n_loss, n_ecn, qbit);
         }
         gst_object_unref(scream_queue);
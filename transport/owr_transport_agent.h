@@ -32,7 +32,9 @@
 #ifndef __OWR_TRANSPORT_AGENT_H__
 #define __OWR_TRANSPORT_AGENT_H__
 
+#include "owr_media_session.h"
 #include "owr_session.h"
+#include "owr_types.h"
 
 #include <glib-object.h>
 
@@ -77,6 +79,12 @@ void owr_transport_agent_add_local_address(OwrTransportAgent *transport_agent, c
 void owr_transport_agent_set_local_port_range(OwrTransportAgent *transport_agent, guint min_port, guint max_port);
 void owr_transport_agent_add_session(OwrTransportAgent *agent, OwrSession *session);
 gchar * owr_transport_agent_get_dot_data(OwrTransportAgent *transport_agent);
+gboolean owr_transport_agent_start_event_log(OwrTransportAgent *transport_agent, const gchar *path);
+void owr_transport_agent_stop_event_log(OwrTransportAgent *transport_agent);
+gboolean owr_transport_agent_start_replay(OwrTransportAgent *transport_agent,
+    OwrMediaSession *media_session, const gchar *path, OwrReplayPacing pacing);
+void owr_transport_agent_stop_replay(OwrTransportAgent *transport_agent,
+    OwrMediaSession *media_session);
 
 G_END_DECLS
 